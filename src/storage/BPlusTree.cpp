@@ -0,0 +1,685 @@
+/******************************************************************************
+*
+*  BPlusTree class implementation
+*
+*  Index file is a header page followed by node pages. Each node is read
+*  into page buffer and verified by its checksum, changed node is written
+*  back with new checksum. Pages released by merges form a list reused by
+*  splits before file grows. Tree header is persisted on flush and close.
+*  Operations are concurrent (see BPlusTree_latches.cpp), open and close
+*  must not be called while other threads use the tree.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "BPlusTree.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief BPlusTree constructor
+*/
+BPlusTree::BPlusTree() : treeHeader{}, filterSaved(false), filterStamp(0), rootPage(0), height(0), keysCount(0), pagesCount(0) {
+	// Checksum algorithm is set by index header on open
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+}
+
+
+
+/*
+* @brief BPlusTree destructor and finalizations
+*/
+BPlusTree::~BPlusTree() {
+	if (!cachedFile.isOpen()) return;
+	close();
+}
+
+
+
+/**
+* @brief Opens index file, creates empty tree if file is empty
+* @return true if index file successfuly opened, false otherwise
+*/
+bool BPlusTree::open(const char* path, bool isReadOnly, size_t cacheSize) {
+
+	std::unique_lock lock(treeMutex);
+
+	// Check if file is open
+	if (!cachedFile.open(path, isReadOnly, cacheSize)) {
+		const char* msg = "Can't operate on closed cached file.";
+		throw std::runtime_error(msg);
+	}
+
+	// If file is empty and write is permitted, then write header and empty root
+	if (cachedFile.getFileSize() == 0 && !cachedFile.isReadOnly()) {
+		createTreeHeader();
+	}
+
+	if (!loadTreeHeader()) {
+		const char* msg = "Index file header is invalid or corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// key cache is filled again by lookups, Bloom filter is set by setBloomFilter
+	keyCache.clear();
+	filterPath = std::string(path) + ".bloom";
+	filterStamp = treeHeader.filterStamp;
+	filterSaved = filterStamp != 0;
+	return true;
+}
+
+
+
+/**
+* @brief Saves tree header and closes index file
+* @return true if index file successfuly closed, false otherwise
+*/
+bool BPlusTree::close() {
+	std::unique_lock lock(treeMutex);
+	if (!cachedFile.isOpen()) return false;
+	std::unique_lock filterLock(filterMutex);
+	if (!cachedFile.isReadOnly()) {
+		if (filter.isEnabled() && !filterSaved) saveFilter();
+		std::lock_guard pagesLock(pagesMutex);
+		writeTreeHeader();
+	}
+	keyCache.clear();
+	filter.destroy();
+	filterSaved = false;
+	return cachedFile.close();
+}
+
+
+
+/**
+*  @brief Persists tree header and all changed nodes to storage device
+*  @return true if all changed cache pages been persisted, false otherwise
+*/
+bool BPlusTree::flush() {
+	if (!cachedFile.isOpen()) return false;
+	if (!cachedFile.isReadOnly()) {
+		// root and height don't change while header latch is held
+		BTreeLatchSet locked{};
+		lockLatch(locked, 0);
+		{
+			// filter is saved before header gets its stamp
+			std::unique_lock filterLock(filterMutex);
+			if (filter.isEnabled() && !filterSaved) saveFilter();
+			std::lock_guard pagesLock(pagesMutex);
+			writeTreeHeader();
+		}
+		releaseLatches(locked);
+	}
+	return cachedFile.flush();
+}
+
+
+bool BPlusTree::isOpen() {
+	return cachedFile.isOpen();
+}
+
+
+bool BPlusTree::isReadOnly() {
+	return cachedFile.isReadOnly();
+}
+
+
+uint64_t BPlusTree::getFileSize() {
+	return pagesCount.load() * PAGE_SIZE;
+}
+
+
+uint64_t BPlusTree::getTotalKeys() {
+	return keysCount.load();
+}
+
+
+uint64_t BPlusTree::getTotalPages() {
+	return pagesCount.load();
+}
+
+
+uint32_t BPlusTree::getHeight() {
+	return height.load();
+}
+
+
+void BPlusTree::resetCacheStats() {
+	cachedFile.resetStats();
+}
+
+
+double BPlusTree::getCacheStats(CachedFileStats type) {
+	return cachedFile.getStats(type);
+}
+
+
+/*
+* @brief Sets in-memory cache of hot keys values in front of lookups,
+* cache is empty after open and filled by found keys
+* @param[in] maxKeys - max keys in cache (0 - no cache)
+*/
+void BPlusTree::setKeyCache(size_t maxKeys) {
+	keyCache.setCapacity(maxKeys);
+}
+
+
+size_t BPlusTree::getKeyCacheSize() {
+	return keyCache.getSize();
+}
+
+
+/*
+* @brief Sets Bloom filter of keys checked before tree pages are read, so lookups,
+* updates and removes of absent keys mostly read no pages. Filter saved with tree
+* header on flush or close is loaded if no keys were inserted since, otherwise it
+* is built by keys scan. Must not be called while other threads use the tree.
+* @param[in] falsePositiveRate - target rate of absent keys passing filter (0 - no filter)
+* @param[in] expectedKeys - keys count filter is sized for (at least 1.5x current keys)
+* @return true if filter is ready (or disabled), false if tree is not open
+*/
+bool BPlusTree::setBloomFilter(double falsePositiveRate, uint64_t expectedKeys) {
+
+	std::unique_lock lock(filterMutex);
+	if (!cachedFile.isOpen()) return false;
+	if (falsePositiveRate <= 0 || falsePositiveRate >= 1) {
+		filter.destroy();
+		return true;
+	}
+
+	// saved filter fits if it has the same rate and room for keys
+	uint64_t keys = keysCount.load();
+	if (filterSaved && filter.load(filterPath.c_str(), filterStamp) && filter.getFalsePositiveRate() == falsePositiveRate &&
+		filter.getCapacity() >= std::max(keys, expectedKeys)) return true;
+
+	filter.create(std::max({ expectedKeys, keys + keys / 2, BTREE_BLOOM_MIN_KEYS }), falsePositiveRate);
+	for (auto cursor = getFirst(); cursor != nullptr; ) {
+		const std::vector<uint8_t>& key = cursor->getKey();
+		filter.add(key.data(), (uint16_t)key.size());
+		if (!cursor->next()) break;
+	}
+	if (!cachedFile.isReadOnly()) saveFilter();
+	return true;
+}
+
+
+uint64_t BPlusTree::getBloomFilterSize() {
+	return filter.getSize();
+}
+
+
+//-----------------------------------------------------------------------------
+// Keys methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Inserts new key
+* @param[in] key - pointer to key bytes
+* @param[in] keyLength - key length (up to BTREE_MAX_KEY_LENGTH)
+* @param[in] value - value (record position or ID)
+* @return true if inserted, false if key exists or fails
+*/
+bool BPlusTree::insert(const void* key, uint32_t keyLength, uint64_t value) {
+	if (cachedFile.isReadOnly() || keyLength > BTREE_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+	// absent key is never in key cache, so nothing to invalidate
+	addFilterKey((const uint8_t*)key, (uint16_t)keyLength);
+	return insertEntry((const uint8_t*)key, (uint16_t)keyLength, value);
+}
+
+
+
+/*
+* @brief Changes value of existing key, latches only its leaf
+* @return true if updated, false if key doesn't exist or fails
+*/
+bool BPlusTree::update(const void* key, uint32_t keyLength, uint64_t value) {
+
+	if (cachedFile.isReadOnly() || keyLength > BTREE_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+	if (filter.isEnabled() && !filter.mayContain((const uint8_t*)key, (uint16_t)keyLength)) return false;
+
+	uint8_t buffers[PAGE_SIZE * 2];
+	uint8_t *node, *parent;
+	BTreePath path;
+	BTreeLatchSet locked{};
+
+	while (true) {
+		BTreeStatus status = descend((const uint8_t*)key, (uint16_t)keyLength, 0, path, buffers, node, parent);
+		if (status == BTreeStatus::FAILED) return false;
+		if (status == BTreeStatus::SUCCESS) {
+			BTreeNode leaf(node);
+			uint32_t index = leaf.lowerBound((const uint8_t*)key, (uint16_t)keyLength);
+			if (index >= leaf.getKeysCount() || leaf.compareKey(index, (const uint8_t*)key, (uint16_t)keyLength) != 0) return false;
+			BTreePathStep& leafStep = path.steps[path.size - 1];
+			if (upgradeLatch(locked, leafStep.pageNo, leafStep.version)) {
+				leaf.setValue(index, value);
+				bool written = writeNode(leafStep.pageNo, node);
+				releaseLatches(locked);
+				keyCache.invalidate((const uint8_t*)key, (uint16_t)keyLength);
+				return written;
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+
+
+/*
+* @brief Removes key
+* @return true if removed, false if key doesn't exist or fails
+*/
+bool BPlusTree::remove(const void* key, uint32_t keyLength) {
+	if (cachedFile.isReadOnly() || keyLength > BTREE_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+	if (filter.isEnabled() && !filter.mayContain((const uint8_t*)key, (uint16_t)keyLength)) return false;
+	if (!removeEntry((const uint8_t*)key, (uint16_t)keyLength)) return false;
+	keyCache.invalidate((const uint8_t*)key, (uint16_t)keyLength);
+	return true;
+}
+
+
+
+/*
+* @brief Looks up key value in key cache or in O(log n) node reads without latches
+* @param[out] value - value of key
+* @return true if key found, false otherwise
+*/
+bool BPlusTree::find(const void* key, uint32_t keyLength, uint64_t& value) {
+
+	if (keyLength > BTREE_MAX_KEY_LENGTH || (key == nullptr && keyLength > 0)) return false;
+	if (filter.isEnabled() && !filter.mayContain((const uint8_t*)key, (uint16_t)keyLength)) return false;
+
+	// generation of key shard is taken before tree is read
+	uint64_t generation = 0;
+	bool isCached = keyCache.isEnabled();
+	if (isCached && keyCache.find((const uint8_t*)key, (uint16_t)keyLength, value, generation)) return true;
+
+	uint8_t buffers[PAGE_SIZE * 2];
+	uint8_t *node, *parent;
+	BTreePath path;
+
+	while (true) {
+		BTreeStatus status = descend((const uint8_t*)key, (uint16_t)keyLength, 0, path, buffers, node, parent);
+		if (status == BTreeStatus::FAILED) return false;
+		if (status == BTreeStatus::SUCCESS) {
+			// leaf copy is validated, so it is consistent
+			BTreeNode leaf(node);
+			uint32_t index = leaf.lowerBound((const uint8_t*)key, (uint16_t)keyLength);
+			if (index >= leaf.getKeysCount() || leaf.compareKey(index, (const uint8_t*)key, (uint16_t)keyLength) != 0) return false;
+			value = leaf.getValue(index);
+			if (isCached) keyCache.put((const uint8_t*)key, (uint16_t)keyLength, value, generation);
+			return true;
+		}
+		std::this_thread::yield();
+	}
+}
+
+
+
+/*
+* @brief Returns cursor at first key not lower than given key
+* @return cursor or nullptr if there is no such key
+*/
+std::shared_ptr<BPlusTreeCursor> BPlusTree::seek(const void* key, uint32_t keyLength) {
+	if (keyLength > BTREE_MAX_KEY_LENGTH || (key == nullptr && keyLength > 0)) return nullptr;
+	uint8_t empty = 0;
+	auto cursor = std::make_shared<BPlusTreeCursor>(*this);
+	const uint8_t* bytes = (key != nullptr) ? (const uint8_t*)key : &empty;
+	if (!cursor->seek(bytes, (uint16_t)keyLength, true, true)) return nullptr;
+	return cursor;
+}
+
+
+
+/*
+* @brief Returns cursor at the lowest key
+* @return cursor or nullptr if tree is empty
+*/
+std::shared_ptr<BPlusTreeCursor> BPlusTree::getFirst() {
+	// empty key is the lowest possible key
+	uint8_t empty = 0;
+	auto cursor = std::make_shared<BPlusTreeCursor>(*this);
+	if (!cursor->seek(&empty, 0, true, true)) return nullptr;
+	return cursor;
+}
+
+
+
+/*
+* @brief Returns cursor at the greatest key
+* @return cursor or nullptr if tree is empty
+*/
+std::shared_ptr<BPlusTreeCursor> BPlusTree::getLast() {
+	auto cursor = std::make_shared<BPlusTreeCursor>(*this);
+	if (!cursor->seek(nullptr, 0, false, true)) return nullptr;
+	return cursor;
+}
+
+
+//-----------------------------------------------------------------------------
+// 64-bit keys are stored big-endian, so memcmp order is numeric order
+//-----------------------------------------------------------------------------
+
+
+void BPlusTree::encodeKey(uint64_t key, uint8_t* buffer) {
+	for (int i = BTREE_UINT64_KEY_LENGTH - 1; i >= 0; i--) {
+		buffer[i] = (uint8_t)(key & 0xFF);
+		key >>= 8;
+	}
+}
+
+
+uint64_t BPlusTree::decodeKey(const uint8_t* buffer) {
+	uint64_t key = 0;
+	for (uint32_t i = 0; i < BTREE_UINT64_KEY_LENGTH; i++) key = (key << 8) | buffer[i];
+	return key;
+}
+
+
+bool BPlusTree::insert(uint64_t key, uint64_t value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	encodeKey(key, buffer);
+	return insert(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+bool BPlusTree::update(uint64_t key, uint64_t value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	encodeKey(key, buffer);
+	return update(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+bool BPlusTree::remove(uint64_t key) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	encodeKey(key, buffer);
+	return remove(buffer, BTREE_UINT64_KEY_LENGTH);
+}
+
+
+bool BPlusTree::find(uint64_t key, uint64_t& value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	encodeKey(key, buffer);
+	return find(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+std::shared_ptr<BPlusTreeCursor> BPlusTree::seek(uint64_t key) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	encodeKey(key, buffer);
+	return seek(buffer, BTREE_UINT64_KEY_LENGTH);
+}
+
+
+//-----------------------------------------------------------------------------
+// Integrity check
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Checks nodes checksums, keys order, nodes fill, leaves depth and
+* leaves links, compares keys count with tree header. Tree must not be
+* changed by other threads during the check.
+* @return true if tree is consistent, false otherwise
+*/
+bool BPlusTree::checkIntegrity() {
+
+	std::shared_lock lock(treeMutex);
+	if (!cachedFile.isOpen()) return false;
+
+	std::vector<uint64_t> leaves;
+	uint64_t keys = 0;
+	if (!checkNode(rootPage.load(), 1, nullptr, nullptr, leaves, keys)) return false;
+	if (keys != keysCount.load()) return false;
+
+	// leaves chain must follow keys order in both directions
+	uint8_t page[PAGE_SIZE];
+	for (size_t i = 0; i < leaves.size(); i++) {
+		if (!readNode(leaves[i], page)) return false;
+		BTreeNodeHeader* header = (BTreeNodeHeader*)page;
+		uint64_t expectedPrev = (i > 0) ? leaves[i - 1] : 0;
+		uint64_t expectedNext = (i + 1 < leaves.size()) ? leaves[i + 1] : 0;
+		if (header->prevPage != expectedPrev || header->nextPage != expectedNext) return false;
+	}
+	return true;
+}
+
+
+
+/*
+* @brief Checks subtree recursively
+* @param[in] depth - node depth (root is 1)
+* @param[in] low - lowest allowed key (nullptr - no limit)
+* @param[in] high - key all keys must be lower than (nullptr - no limit)
+* @param[out] leaves - leaves in keys order
+* @param[out] keys - keys counter
+* @return true if subtree is consistent, false otherwise
+*/
+bool BPlusTree::checkNode(uint64_t pageNo, uint32_t depth, const std::vector<uint8_t>* low,
+	const std::vector<uint8_t>* high, std::vector<uint64_t>& leaves, uint64_t& keys) {
+
+	uint8_t page[PAGE_SIZE];
+	if (!readNode(pageNo, page)) return false;
+	BTreeNode node(page);
+	uint32_t count = node.getKeysCount();
+
+	bool isLeaf = node.isLeaf();
+	if (isLeaf != (depth == height.load())) return false;
+	if (!isLeaf && node.getHeader()->type != BTREE_INNER) return false;
+	if (pageNo != rootPage.load() && node.getFillBytes() < BTREE_MIN_FILL) return false;
+
+	// keys strictly ascending within [low, high)
+	std::vector<BTreeEntry> entries;
+	node.getEntries(entries);
+	for (uint32_t i = 0; i < count; i++) {
+		const std::vector<uint8_t>& key = entries[i].key;
+		if (i > 0 && !(entries[i - 1].key < key)) return false;
+		if (low != nullptr && key < *low) return false;
+		if (high != nullptr && !(key < *high)) return false;
+	}
+
+	if (isLeaf) {
+		leaves.push_back(pageNo);
+		keys += count;
+		return true;
+	}
+
+	for (uint32_t child = 0; child <= count; child++) {
+		const std::vector<uint8_t>* childLow = (child > 0) ? &entries[child - 1].key : low;
+		const std::vector<uint8_t>* childHigh = (child < count) ? &entries[child].key : high;
+		if (!checkNode(node.getChild(child), depth + 1, childLow, childHigh, leaves, keys)) return false;
+	}
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Pages methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Reads node page and checks its consistency
+*  @return true if node is consistent, false otherwise
+*/
+bool BPlusTree::readNode(uint64_t pageNo, uint8_t* page) {
+	if (pageNo == 0 || pageNo >= pagesCount.load()) return false;
+	if (cachedFile.read(pageNo * PAGE_SIZE, page, PAGE_SIZE) != PAGE_SIZE) return false;
+	uint32_t checksum = checksumFunction(page + BTREE_CHECKSUM_SIZE, PAGE_SIZE - BTREE_CHECKSUM_SIZE);
+	return checksum == ((BTreeNodeHeader*)page)->checksum;
+}
+
+
+
+/*
+*  @brief Updates node checksum and writes node page
+*  @return true if node written, false otherwise
+*/
+bool BPlusTree::writeNode(uint64_t pageNo, uint8_t* page) {
+	BTreeNodeHeader* header = (BTreeNodeHeader*)page;
+	header->checksum = checksumFunction(page + BTREE_CHECKSUM_SIZE, PAGE_SIZE - BTREE_CHECKSUM_SIZE);
+	return cachedFile.write(pageNo * PAGE_SIZE, page, PAGE_SIZE) == PAGE_SIZE;
+}
+
+
+
+/*
+*  @brief Takes page from free pages list or grows file
+*  @return page number or NOT_FOUND if free page is corrupt or file is full
+*/
+uint64_t BPlusTree::allocatePage() {
+	std::lock_guard lock(pagesMutex);
+	if (treeHeader.freePages == 0) {
+		if (pagesCount.load() >= BTREE_MAX_PAGES) return NOT_FOUND;
+		return pagesCount.fetch_add(1);
+	}
+	uint8_t page[PAGE_SIZE];
+	uint64_t pageNo = treeHeader.freePages;
+	if (!readNode(pageNo, page)) return NOT_FOUND;
+	treeHeader.freePages = ((BTreeNodeHeader*)page)->nextPage;
+	return pageNo;
+}
+
+
+
+/*
+*  @brief Puts page to the head of free pages list. Page latch is held by
+*  caller if page was reachable, so readers of page restart.
+*  @return true if page released, false otherwise
+*/
+bool BPlusTree::freePage(uint64_t pageNo) {
+	std::lock_guard lock(pagesMutex);
+	uint8_t page[PAGE_SIZE] = {};
+	BTreeNode node(page);
+	node.init(BTREE_FREE);
+	node.getHeader()->nextPage = treeHeader.freePages;
+	if (!writeNode(pageNo, page)) return false;
+	treeHeader.freePages = pageNo;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Header methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Writes header of empty tree (root leaf in page 1)
+*/
+void BPlusTree::createTreeHeader() {
+
+	treeHeader.signature = BTREE_SIGNATURE;
+	treeHeader.version = BTREE_VERSION;
+	treeHeader.checksumType = (uint32_t)ChecksumType::CRC32C;
+	treeHeader.freePages = 0;
+	treeHeader.filterStamp = 0;
+	height.store(1);
+	rootPage.store(1);
+	keysCount.store(0);
+	pagesCount.store(2);
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+
+	// header occupies whole first page, so nodes are page aligned
+	uint8_t page[PAGE_SIZE] = {};
+	cachedFile.write(0, page, PAGE_SIZE);
+	writeTreeHeader();
+
+	BTreeNode root(page);
+	root.init(BTREE_LEAF);
+	writeNode(rootPage.load(), page);
+}
+
+
+
+/*
+*  @brief Saves tree header with actual counters to the file
+*  @return true - if succeeded, false - if failed
+*/
+bool BPlusTree::writeTreeHeader() {
+	treeHeader.height = height.load();
+	treeHeader.rootPage = rootPage.load();
+	treeHeader.keysCount = keysCount.load();
+	treeHeader.pagesCount = pagesCount.load();
+	treeHeader.filterStamp = filterSaved ? filterStamp : 0;
+	treeHeader.headerChecksum = checksumFunction((const uint8_t*)&treeHeader, BTREE_HEADER_PAYLOAD_SIZE);
+	return cachedFile.write(0, &treeHeader, BTREE_HEADER_SIZE) == BTREE_HEADER_SIZE;
+}
+
+
+
+/*
+*  @brief Loads tree header and checks its consistency
+*  @return true - if succeeded, false - if failed
+*/
+bool BPlusTree::loadTreeHeader() {
+
+	BTreeHeader header;
+	if (cachedFile.read(0, &header, BTREE_HEADER_SIZE) != BTREE_HEADER_SIZE) return false;
+	if (header.signature != BTREE_SIGNATURE || header.version != BTREE_VERSION) return false;
+
+	ChecksumFunction fileChecksum = Checksum::getFunction((ChecksumType)header.checksumType);
+	if (fileChecksum == nullptr) return false;
+	if (fileChecksum((const uint8_t*)&header, BTREE_HEADER_PAYLOAD_SIZE) != header.headerChecksum) return false;
+	if (header.height == 0 || header.height > BTREE_MAX_HEIGHT || header.rootPage >= header.pagesCount) return false;
+
+	checksumFunction = fileChecksum;
+	treeHeader = header;
+	height.store(header.height);
+	rootPage.store(header.rootPage);
+	keysCount.store(header.keysCount);
+	pagesCount.store(header.pagesCount);
+	return true;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Bloom filter methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Adds key to Bloom filter before key is written to tree. Saved filter
+*  file is invalidated first (even if filter is disabled), so it is never loaded
+*  without this key.
+*/
+void BPlusTree::addFilterKey(const uint8_t* key, uint16_t length) {
+	if (!filterSaved && !filter.isEnabled()) return;
+	std::shared_lock lock(filterMutex);
+	while (filterSaved) {
+		lock.unlock();
+		{
+			std::unique_lock exclusiveLock(filterMutex);
+			if (filterSaved) filter.invalidate(filterPath.c_str());
+			filterSaved = false;
+		}
+		lock.lock();
+	}
+	if (filter.isEnabled()) filter.add(key, length);
+}
+
+
+
+/*
+*  @brief Saves Bloom filter with new stamp, which tree header gets on write.
+*  Filter mutex is held exclusively by caller.
+*  @return true if saved, false otherwise
+*/
+bool BPlusTree::saveFilter() {
+	uint32_t stamp;
+	std::random_device device;
+	do stamp = device(); while (stamp == 0 || stamp == filterStamp);
+	filterSaved = filter.save(filterPath.c_str(), stamp);
+	if (filterSaved) filterStamp = stamp;
+	return filterSaved;
+}
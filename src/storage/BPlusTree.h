@@ -0,0 +1,538 @@
+/******************************************************************************
+*
+*  BPlusTree & BPlusTreeCursor class header
+*
+*  BPlusTree is page based index mapping keys (document IDs or other byte
+*  strings) to 64-bit values (record positions or record IDs). Each node is
+*  a PAGE_SIZE page of separate index file accessed through CachedFileIO,
+*  so hot nodes stay cached and lookup takes O(log n) page reads. Leaves
+*  are linked in both directions for range scans.
+*
+*  Features:
+*    - insert/update/remove/find variable length keys (memcmp order)
+*    - 64-bit unsigned keys encoded to keep numeric order
+*    - deletion with borrowing from and merging with sibling nodes
+*    - cursors for range scans over linked leaves in both directions
+*    - bottom-up bulk loading of sorted keys with given nodes fill factor
+*    - prefix compressed nodes with integer key heads, shortest separators
+*    - in-node key heads search vectorized with AVX2/SSE2 (runtime dispatch)
+*    - free pages reuse, data consistency check (checksum per node)
+*    - optimistic lock coupling: readers take no latches and validate
+*      node versions, writers latch only nodes they change
+*    - optional bounded in-memory cache of hot keys values (hash + LRU)
+*    - optional blocked Bloom filter of keys saved next to index file,
+*      so lookups of absent keys mostly read no pages
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include "CachedFileIO.h"
+#include "Checksum.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <shared_mutex>
+
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Index file header signature and version
+		//----------------------------------------------------------------------------
+		constexpr uint32_t BTREE_SIGNATURE = 0x45525442;        // BTRE signature
+		constexpr uint32_t BTREE_VERSION = 0x00000002;          // Version 2 (prefix compressed nodes)
+
+		constexpr uint16_t BTREE_LEAF = 1;                      // Leaf node: keys and values
+		constexpr uint16_t BTREE_INNER = 2;                     // Inner node: keys and children
+		constexpr uint16_t BTREE_FREE = 3;                      // Free page in free pages list
+
+		constexpr uint32_t BTREE_MAX_KEY_LENGTH = 1024;         // Max key length (7+ keys per node)
+		constexpr uint32_t BTREE_MAX_HEIGHT = 32;               // Max tree height
+		constexpr uint32_t BTREE_UINT64_KEY_LENGTH = 8;         // Encoded 64-bit key length
+
+		constexpr double   BTREE_BULK_FILL_FACTOR = 0.9;        // Default bulk loaded nodes fill
+		constexpr double   BTREE_MIN_FILL_FACTOR = 0.5;         // Lowest bulk loaded nodes fill
+
+		constexpr uint64_t BTREE_LATCH_LOCKED = 1;              // Latch lowest bit: node is write locked
+		constexpr uint64_t BTREE_LATCH_CHUNK_BITS = 16;         // Latches chunk is 65536 latches
+		constexpr uint64_t BTREE_LATCH_CHUNK_SIZE = 1ULL << BTREE_LATCH_CHUNK_BITS;
+		constexpr uint64_t BTREE_LATCH_CHUNKS = 65536;          // Latches chunks count
+		constexpr uint64_t BTREE_MAX_PAGES = BTREE_LATCH_CHUNKS * BTREE_LATCH_CHUNK_SIZE;
+		constexpr uint32_t BTREE_MAX_LATCHES = 8;               // Max latches held by one operation
+		constexpr uint32_t BTREE_KEY_CACHE_SHARDS = 64;         // Key cache shards (own mutex and LRU list)
+
+		constexpr uint32_t BTREE_BLOOM_SIGNATURE = 0x4D4F4C42;  // BLOM signature
+		constexpr uint32_t BTREE_BLOOM_VERSION = 0x00000001;    // Bloom filter file version
+		constexpr uint32_t BTREE_BLOOM_BLOCK_WORDS = 8;         // Filter block is 512 bits (one cache line)
+		constexpr uint32_t BTREE_BLOOM_MAX_HASHES = 16;         // Max bits set per key
+		constexpr uint64_t BTREE_BLOOM_MIN_KEYS = 1024;         // Min keys count filter is sized for
+		constexpr uint64_t BTREE_BLOOM_DATA_OFFSET = 64;        // Filter blocks position in filter file
+
+		//----------------------------------------------------------------------------
+		// Index file header structure (56 bytes), occupies first page
+		//----------------------------------------------------------------------------
+		struct BTreeHeader {
+			uint32_t      signature;           // BTRE signature
+			uint32_t      version;             // Format version
+			uint32_t      checksumType;        // Checksum algorithm (ChecksumType)
+			uint32_t      height;              // Tree height (1 - root is leaf)
+			uint64_t      rootPage;            // Root node page number
+			uint64_t      keysCount;           // Total keys in tree
+			uint64_t      pagesCount;          // Total pages including header page
+			uint64_t      freePages;           // First page of free pages list (0 - none)
+			uint32_t      filterStamp;         // Stamp of Bloom filter saved with header (0 - none)
+			uint32_t      headerChecksum;      // Checksum for header consistency check
+		};
+
+		constexpr uint64_t BTREE_HEADER_SIZE = sizeof(BTreeHeader);
+		constexpr uint64_t BTREE_HEADER_PAYLOAD_SIZE = BTREE_HEADER_SIZE - sizeof(BTreeHeader::headerChecksum);
+
+		//----------------------------------------------------------------------------
+		// Node header structure (40 bytes). Node keeps prefix common to its keys
+		// after header, then sorted array of slots, entries [suffix tail][value]
+		// are stored from page end. Inner node entry value is child page with
+		// keys >= key, first child keeps keys lower than the first key.
+		//----------------------------------------------------------------------------
+		struct BTreeNodeHeader {
+			uint32_t      checksum;            // Checksum of node data after this field
+			uint16_t      type;                // Node type (BTREE_LEAF, BTREE_INNER, BTREE_FREE)
+			uint16_t      keysCount;           // Keys in node
+			uint16_t      dataStart;           // Start of entries area
+			uint16_t      freeBytes;           // Free bytes including gaps between entries
+			uint16_t      prefixLength;        // Length of prefix common to all keys
+			uint16_t      reserved;            // Reserved (zero)
+			uint64_t      firstChild;          // Inner node: child with keys lower than first key
+			uint64_t      prevPage;            // Leaf node: previous leaf (0 - none)
+			uint64_t      nextPage;            // Leaf node: next leaf, free page: next free (0 - none)
+		};
+
+		constexpr uint64_t BTREE_NODE_HEADER_SIZE = sizeof(BTreeNodeHeader);
+		constexpr uint64_t BTREE_CHECKSUM_SIZE = sizeof(BTreeNodeHeader::checksum);
+		constexpr uint32_t BTREE_NODE_CAPACITY = (uint32_t)(PAGE_SIZE - BTREE_NODE_HEADER_SIZE);
+		constexpr uint32_t BTREE_MIN_FILL = BTREE_NODE_CAPACITY / 4;   // Underflow threshold (entries bytes without prefix compression)
+
+		//----------------------------------------------------------------------------
+		// Node slot (8 bytes): key suffix head is its first 4 bytes as big-endian
+		// integer (zero padded), so most comparisons in search are integer ones.
+		// Head bytes are not repeated in entry.
+		//----------------------------------------------------------------------------
+		struct BTreeNodeSlot {
+			uint32_t      head;                // First 4 bytes of key suffix
+			uint16_t      offset;              // Entry offset in page
+			uint16_t      length;              // Key suffix length
+		};
+
+		constexpr uint32_t BTREE_KEY_HEAD_SIZE = sizeof(BTreeNodeSlot::head);
+
+		typedef uint32_t (*BTreeHeadSearch)(const BTreeNodeSlot* slots, uint32_t count, uint32_t head);
+
+		//----------------------------------------------------------------------------
+		// Decoded node entry for splits, merges and redistributions
+		//----------------------------------------------------------------------------
+		struct BTreeEntry {
+			std::vector<uint8_t> key;          // Key bytes
+			uint64_t             value;        // Value or child page
+		};
+
+		//----------------------------------------------------------------------------
+		// Result of optimistic operation step
+		//----------------------------------------------------------------------------
+		enum class BTreeStatus : uint32_t {
+			SUCCESS,                           // Step completed
+			RESTART,                           // Node changed concurrently, step must restart
+			FAILED                             // Node is corrupt, allocation failed or no keys left
+		};
+
+		//----------------------------------------------------------------------------
+		// Node visited by descent: page, its latch version when read and child taken.
+		// First step is tree header (page 0), its latch guards root page and height.
+		//----------------------------------------------------------------------------
+		struct BTreePathStep {
+			uint64_t      pageNo;              // Node page (0 - tree header)
+			uint64_t      version;             // Latch version of node copy
+			uint32_t      childIndex;          // Child taken (0 - first child)
+		};
+
+		struct BTreePath {
+			BTreePathStep steps[BTREE_MAX_HEIGHT + 1];
+			uint32_t      size;                // Steps count (header and nodes)
+			uint32_t      height;              // Tree height when descended
+		};
+
+		//----------------------------------------------------------------------------
+		// Latches held by write operation, released together
+		//----------------------------------------------------------------------------
+		struct BTreeLatchSet {
+			uint64_t      pages[BTREE_MAX_LATCHES];
+			uint32_t      count;
+		};
+
+		//----------------------------------------------------------------------------
+		// BTreeLatchTable - version latch per page. Latch value is version (even)
+		// plus BTREE_LATCH_LOCKED bit while node is changed. Chunks of latches are
+		// allocated on first access and never released, so latch stays valid.
+		//----------------------------------------------------------------------------
+		class BTreeLatchTable {
+		public:
+			BTreeLatchTable();
+			~BTreeLatchTable();
+			BTreeLatchTable(const BTreeLatchTable&) = delete;
+			void operator=(const BTreeLatchTable&) = delete;
+
+			std::atomic<uint64_t>& get(uint64_t pageNo);
+
+		protected:
+			std::unique_ptr<std::atomic<std::atomic<uint64_t>*>[]> chunks;
+		};
+
+		//----------------------------------------------------------------------------
+		// BTreeNode - node view over page buffer
+		//----------------------------------------------------------------------------
+		class BTreeNode {
+		public:
+			explicit BTreeNode(uint8_t* page);
+
+			void     init(uint16_t type);
+			BTreeNodeHeader* getHeader() const;
+			bool     isLeaf() const;
+			uint32_t getKeysCount() const;
+			uint32_t getUsedBytes() const;
+			uint32_t getFillBytes() const;
+			uint32_t getInsertSize(const uint8_t* key, uint16_t length) const;
+
+			void     getKey(uint32_t index, std::vector<uint8_t>& key) const;
+			int      compareKey(uint32_t index, const uint8_t* key, uint16_t length) const;
+			uint32_t lowerBound(const uint8_t* key, uint16_t length) const;
+			uint32_t upperBound(const uint8_t* key, uint16_t length) const;
+			uint64_t getValue(uint32_t index) const;
+			void     setValue(uint32_t index, uint64_t value);
+			uint64_t getChild(uint32_t childIndex) const;
+
+			bool     insertAt(uint32_t index, const uint8_t* key, uint16_t length, uint64_t value);
+			void     removeAt(uint32_t index);
+			void     getEntries(std::vector<BTreeEntry>& entries) const;
+			void     fill(const std::vector<BTreeEntry>& entries, size_t from, size_t to);
+			void     compact();
+
+			static uint32_t getEntrySize(size_t keyLength);
+			static uint32_t getNodeSize(size_t keys, size_t keyBytes, size_t prefixLength);
+			static uint32_t getFillSize(const std::vector<BTreeEntry>& entries, size_t from, size_t to);
+			static uint32_t getCommonPrefix(const uint8_t* first, size_t firstLength, const uint8_t* second, size_t secondLength);
+			static uint32_t getKeyHead(const uint8_t* key, size_t length);
+			static uint32_t searchHeads(const BTreeNodeSlot* slots, uint32_t count, uint32_t head);
+			static uint32_t searchHeadsScalar(const BTreeNodeSlot* slots, uint32_t count, uint32_t head);
+			static const char* getSearchImplementation();
+
+		protected:
+			uint8_t* page;
+			BTreeNodeSlot* getSlots() const;
+			static uint32_t getPrefixArea(size_t prefixLength);
+			static uint32_t getTailLength(size_t keyLength);
+			int      comparePrefix(const uint8_t* key, uint16_t length) const;
+			int      compareSuffix(const BTreeNodeSlot& slot, const uint8_t* suffix, uint16_t length, uint32_t head) const;
+			uint32_t search(const uint8_t* key, uint16_t length, bool upper) const;
+			void     putEntry(uint32_t index, const uint8_t* key, uint16_t length, uint64_t value);
+		};
+
+		//----------------------------------------------------------------------------
+		// Key cache entries of shard: LRU list and hashmap of key views into list
+		//----------------------------------------------------------------------------
+		struct BTreeKeyCacheEntry {
+			std::string   key;                 // Key bytes
+			uint64_t      value;               // Key value in tree
+		};
+
+		using BTreeKeyCacheList = std::list<BTreeKeyCacheEntry>;
+
+		struct BTreeKeyCacheShard {
+			std::mutex        mutex;
+			BTreeKeyCacheList entries;         // Most recently used first
+			std::unordered_map<std::string_view, BTreeKeyCacheList::iterator> map;
+			uint64_t          generation = 0;  // Invalidations count
+		};
+
+		//----------------------------------------------------------------------------
+		// BPlusTreeKeyCache - bounded in-memory hash of hot keys values in front
+		// of tree lookups. Writers invalidate key after tree change, lookup fills
+		// cache only if key shard had no invalidations since lookup started, so
+		// cache never keeps value older than the tree has.
+		//----------------------------------------------------------------------------
+		class BPlusTreeKeyCache {
+		public:
+			BPlusTreeKeyCache();
+			BPlusTreeKeyCache(const BPlusTreeKeyCache&) = delete;
+			void operator=(const BPlusTreeKeyCache&) = delete;
+
+			void   setCapacity(size_t maxKeys);
+			bool   isEnabled();
+			size_t getSize();
+			bool   find(const uint8_t* key, uint16_t length, uint64_t& value, uint64_t& generation);
+			void   put(const uint8_t* key, uint16_t length, uint64_t value, uint64_t generation);
+			void   invalidate(const uint8_t* key, uint16_t length);
+			void   clear();
+
+		protected:
+			std::atomic<size_t> shardCapacity;   // Max keys of shard (0 - cache disabled)
+			BTreeKeyCacheShard  shards[BTREE_KEY_CACHE_SHARDS];
+
+			BTreeKeyCacheShard& getShard(std::string_view key);
+		};
+
+		//----------------------------------------------------------------------------
+		// Bloom filter file header, filter blocks follow it at BTREE_BLOOM_DATA_OFFSET
+		//----------------------------------------------------------------------------
+		struct BTreeBloomHeader {
+			uint32_t      signature;           // BLOM signature
+			uint32_t      version;             // Format version
+			uint32_t      stamp;               // Equals tree header filter stamp if saved together
+			uint32_t      hashesCount;         // Bits set per key
+			uint64_t      capacity;            // Keys count filter is sized for
+			uint64_t      blocksCount;         // Filter 512-bit blocks count
+			double        falsePositiveRate;   // Target false positive rate at capacity
+			uint32_t      blocksChecksum;      // Checksum of filter blocks
+			uint32_t      headerChecksum;      // Checksum for header consistency check
+		};
+
+		constexpr uint64_t BTREE_BLOOM_HEADER_PAYLOAD_SIZE = sizeof(BTreeBloomHeader) - sizeof(BTreeBloomHeader::headerChecksum);
+
+		//----------------------------------------------------------------------------
+		// BPlusTreeBloomFilter - blocked Bloom filter: all bits of key are in one
+		// 512-bit block, so key check reads one cache line. Bits are atomic words,
+		// keys are added while other threads check keys.
+		//----------------------------------------------------------------------------
+		class BPlusTreeBloomFilter {
+		public:
+			BPlusTreeBloomFilter();
+			BPlusTreeBloomFilter(const BPlusTreeBloomFilter&) = delete;
+			void operator=(const BPlusTreeBloomFilter&) = delete;
+
+			void     create(uint64_t capacity, double falsePositiveRate);
+			void     destroy();
+			bool     load(const char* path, uint32_t stamp);
+			bool     save(const char* path, uint32_t stamp);
+			bool     invalidate(const char* path);
+
+			bool     isEnabled() const;
+			void     add(const uint8_t* key, uint16_t length);
+			bool     mayContain(const uint8_t* key, uint16_t length) const;
+
+			uint64_t getCapacity() const;
+			double   getFalsePositiveRate() const;
+			uint64_t getSize() const;
+
+			static uint64_t hashKey(const uint8_t* key, size_t length);
+
+		protected:
+			std::vector<std::atomic<uint64_t>> words;   // Blocks of BTREE_BLOOM_BLOCK_WORDS words
+			uint64_t blocksCount;
+			uint32_t hashesCount;
+			uint64_t capacity;
+			double   falsePositiveRate;
+
+			uint64_t getBlockOffset(uint64_t hash) const;
+		};
+
+		class BPlusTreeCursor;
+		class BPlusTreeBuilder;
+
+		//----------------------------------------------------------------------------
+		// BPlusTree
+		//----------------------------------------------------------------------------
+		class BPlusTree {
+			friend class BPlusTreeCursor;
+			friend class BPlusTreeBuilder;
+		public:
+			BPlusTree();
+			BPlusTree(const BPlusTree&) = delete;
+			void operator=(const BPlusTree&) = delete;
+			~BPlusTree();
+
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE);
+			bool flush();
+			bool isOpen();
+			bool isReadOnly();
+			bool close();
+
+			uint64_t getFileSize();
+			uint64_t getTotalKeys();
+			uint64_t getTotalPages();
+			uint32_t getHeight();
+
+			bool insert(const void* key, uint32_t keyLength, uint64_t value);
+			bool update(const void* key, uint32_t keyLength, uint64_t value);
+			bool remove(const void* key, uint32_t keyLength);
+			bool find(const void* key, uint32_t keyLength, uint64_t& value);
+			std::shared_ptr<BPlusTreeCursor> seek(const void* key, uint32_t keyLength);
+
+			bool insert(uint64_t key, uint64_t value);
+			bool update(uint64_t key, uint64_t value);
+			bool remove(uint64_t key);
+			bool find(uint64_t key, uint64_t& value);
+			std::shared_ptr<BPlusTreeCursor> seek(uint64_t key);
+
+			std::shared_ptr<BPlusTreeCursor> getFirst();
+			std::shared_ptr<BPlusTreeCursor> getLast();
+
+			bool checkIntegrity();
+
+			void   resetCacheStats();
+			double getCacheStats(CachedFileStats type);
+			void   setKeyCache(size_t maxKeys);
+			size_t getKeyCacheSize();
+			bool   setBloomFilter(double falsePositiveRate, uint64_t expectedKeys = 0);
+			uint64_t getBloomFilterSize();
+
+			static void     encodeKey(uint64_t key, uint8_t* buffer);
+			static uint64_t decodeKey(const uint8_t* buffer);
+
+		protected:
+
+			std::shared_mutex     treeMutex;            // Open, close (exclusive) and integrity check (shared)
+			std::mutex            pagesMutex;           // Pages allocation and free pages list
+			CachedFileIO          cachedFile;
+			BTreeHeader           treeHeader;           // Header image, actual counters are below
+			ChecksumFunction      checksumFunction;
+			BTreeLatchTable       latches;              // Node latches, page 0 latch guards root and height
+			BPlusTreeKeyCache     keyCache;             // Hot keys values (filled by lookups)
+			BPlusTreeBloomFilter  filter;               // Bloom filter of keys (if enabled)
+			std::shared_mutex     filterMutex;          // Filter save (exclusive) and keys adding (shared)
+			std::string           filterPath;           // Filter file path (index path + ".bloom")
+			std::atomic<bool>     filterSaved;          // Filter file has all keys (no inserts since save)
+			uint32_t              filterStamp;          // Stamp of saved filter
+			std::atomic<uint64_t> rootPage;
+			std::atomic<uint32_t> height;
+			std::atomic<uint64_t> keysCount;
+			std::atomic<uint64_t> pagesCount;
+
+			void     createTreeHeader();
+			bool     writeTreeHeader();
+			bool     loadTreeHeader();
+
+			void     addFilterKey(const uint8_t* key, uint16_t length);
+			bool     saveFilter();
+
+			bool     readNode(uint64_t pageNo, uint8_t* page);
+			bool     writeNode(uint64_t pageNo, uint8_t* page);
+			uint64_t allocatePage();
+			bool     freePage(uint64_t pageNo);
+
+			uint64_t readLatch(uint64_t pageNo);
+			bool     validateLatch(uint64_t pageNo, uint64_t version);
+			bool     upgradeLatch(BTreeLatchSet& locked, uint64_t pageNo, uint64_t version);
+			bool     tryLatch(BTreeLatchSet& locked, uint64_t pageNo);
+			void     lockLatch(BTreeLatchSet& locked, uint64_t pageNo);
+			void     releaseLatches(BTreeLatchSet& locked);
+
+			BTreeStatus descend(const uint8_t* key, uint16_t length, uint32_t level, BTreePath& path,
+			                    uint8_t* buffers, uint8_t*& node, uint8_t*& parent);
+
+			bool        insertEntry(const uint8_t* key, uint16_t length, uint64_t value);
+			BTreeStatus splitLeaf(BTreePath& path, uint8_t* node, uint8_t* parent, uint32_t index,
+			                      const uint8_t* key, uint16_t length, uint64_t value);
+			BTreeStatus splitInner(const uint8_t* key, uint16_t length, uint32_t level, uint32_t neededBytes);
+			BTreeStatus addSeparator(BTreeLatchSet& locked, BTreePath& path, uint8_t* parent,
+			                         const std::vector<uint8_t>& key, uint64_t leftPage, uint64_t rightPage);
+
+			bool        removeEntry(const uint8_t* key, uint16_t length);
+			BTreeStatus rebalance(const uint8_t* key, uint16_t length, uint32_t& level);
+
+			bool     checkNode(uint64_t pageNo, uint32_t depth, const std::vector<uint8_t>* low,
+			                   const std::vector<uint8_t>* high, std::vector<uint64_t>& leaves, uint64_t& keys);
+
+			static size_t getSplitIndex(const std::vector<BTreeEntry>& entries, bool isLeaf);
+			static void   getSeparator(const std::vector<uint8_t>& left, const std::vector<uint8_t>& right, std::vector<uint8_t>& separator);
+		};
+
+
+		//----------------------------------------------------------------------------
+		// BPlusTreeCursor - position in leaf level, moves in key order. Cursor keeps
+		// copy of its leaf and steps in it while leaf latch version is unchanged.
+		//----------------------------------------------------------------------------
+		class BPlusTreeCursor {
+			friend class BPlusTree;
+		public:
+			BPlusTreeCursor(BPlusTree& tree);
+
+			const std::vector<uint8_t>& getKey();
+			uint64_t getKeyAsUInt64();
+			uint64_t getValue();
+
+			bool     next();
+			bool     previous();
+
+		protected:
+			BPlusTree&           tree;
+			uint64_t             leafPage;             // Leaf of current key (0 - leaf copy is not valid)
+			uint64_t             leafVersion;          // Leaf latch version of leaf copy
+			uint32_t             index;                // Index of current key in leaf
+			std::vector<uint8_t> key;                  // Current key copy
+			uint64_t             value;                // Current value copy
+			std::vector<uint8_t> page;                 // Leaf copy
+
+			bool        seek(const uint8_t* key, uint16_t length, bool forward, bool inclusive);
+			BTreeStatus walk(uint64_t pageNo, uint64_t version, uint32_t position, bool forward);
+		};
+
+
+		//----------------------------------------------------------------------------
+		// Bulk loaded level: node being filled and completed node kept unwritten,
+		// so the last two nodes of level can be balanced on commit
+		//----------------------------------------------------------------------------
+		struct BTreeBuildLevel {
+			std::vector<uint8_t> previous;             // Completed node buffer
+			std::vector<uint8_t> current;              // Node being filled buffer
+			std::vector<uint8_t> previousLow;          // Separator of completed node in parent
+			std::vector<uint8_t> currentLow;           // Separator of node being filled in parent
+			uint64_t             previousPage;         // Completed node page (0 - none)
+			uint64_t             currentPage;          // Node being filled page (0 - none)
+		};
+
+		//----------------------------------------------------------------------------
+		// BPlusTreeBuilder - builds empty tree bottom-up from keys in ascending
+		// order (e.g. output of external sort) in one sequential pass.
+		// Tree stays empty until commit publishes the new root.
+		//----------------------------------------------------------------------------
+		class BPlusTreeBuilder {
+		public:
+			BPlusTreeBuilder(BPlusTree& tree, double fillFactor = BTREE_BULK_FILL_FACTOR);
+			~BPlusTreeBuilder();
+			BPlusTreeBuilder(const BPlusTreeBuilder&) = delete;
+			void operator=(const BPlusTreeBuilder&) = delete;
+
+			bool     isValid();
+			bool     add(const void* key, uint32_t keyLength, uint64_t value);
+			bool     add(uint64_t key, uint64_t value);
+			bool     commit();
+			void     abort();
+			uint64_t getAddedKeys();
+
+		protected:
+			BPlusTree&                   tree;
+			uint32_t                     fillBytes;    // Node is completed when next entry exceeds it
+			uint64_t                     addedKeys;
+			bool                         failed;
+			bool                         finished;
+			std::vector<uint8_t>         lastKey;
+			std::vector<BTreeBuildLevel> levels;       // Leaves level first
+			std::vector<uint64_t>        pages;        // Allocated pages (released on abort)
+
+			bool     addEntry(size_t level, const uint8_t* key, uint16_t length, uint64_t value);
+			bool     startNode(size_t level, const uint8_t* key, uint16_t length, uint64_t value);
+			bool     writeNode(size_t level, uint64_t pageNo, std::vector<uint8_t>& node, const std::vector<uint8_t>& low, bool isRoot);
+			bool     finishLevel(size_t level, uint64_t& rootPage);
+			uint64_t allocatePage();
+		};
+
+	}
+
+}
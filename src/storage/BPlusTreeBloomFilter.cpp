@@ -0,0 +1,237 @@
+/******************************************************************************
+*
+*  BPlusTreeBloomFilter class implementation
+*
+*  Blocked Bloom filter: key hash selects one 512-bit block (cache line) and
+*  all bits of key are set in that block, so key check costs one cache miss
+*  instead of one per bit. Keys are spread over blocks unevenly, so blocked
+*  filter needs about 10% more bits than classic one for the same false
+*  positive rate. Removed keys can't be cleared, their bits only raise false
+*  positive rate until filter is built again.
+*
+*  Filter file is a header followed by blocks. Blocks are written before the
+*  header, and header is zeroed before the first key inserted after save, so
+*  valid header always describes blocks having all keys of the tree.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "BPlusTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+using namespace Cloudless::Storage;
+
+
+BPlusTreeBloomFilter::BPlusTreeBloomFilter() : blocksCount(0), hashesCount(0), capacity(0), falsePositiveRate(0) {}
+
+
+
+/*
+*  @brief Allocates empty filter
+*  @param[in] capacity - keys count filter is sized for
+*  @param[in] falsePositiveRate - target rate of absent keys passing filter at capacity
+*/
+void BPlusTreeBloomFilter::create(uint64_t capacity, double falsePositiveRate) {
+	// classic filter optimum: -ln(p) / ln(2)^2 bits and ln(2) * bits hashes per key
+	double bitsPerKey = -std::log(falsePositiveRate) / (std::log(2.0) * std::log(2.0));
+	double hashes = std::round(bitsPerKey * std::log(2.0));
+	uint64_t bits = (uint64_t)std::ceil(double(capacity) * bitsPerKey * 1.1);
+	this->capacity = capacity;
+	this->falsePositiveRate = falsePositiveRate;
+	hashesCount = (uint32_t)std::clamp(hashes, 1.0, double(BTREE_BLOOM_MAX_HASHES));
+	blocksCount = std::max<uint64_t>(1, (bits + 511) / 512);
+	std::vector<std::atomic<uint64_t>>(blocksCount * BTREE_BLOOM_BLOCK_WORDS).swap(words);
+}
+
+
+
+void BPlusTreeBloomFilter::destroy() {
+	std::vector<std::atomic<uint64_t>>().swap(words);
+	blocksCount = 0;
+	capacity = 0;
+}
+
+
+
+/*
+*  @brief Loads filter saved with given stamp
+*  @param[in] path - filter file path
+*  @param[in] stamp - filter stamp of tree header
+*  @return true if filter loaded, false if file is missing, invalid or has other stamp
+*/
+bool BPlusTreeBloomFilter::load(const char* path, uint32_t stamp) {
+
+	if (stamp == 0 || !std::filesystem::exists(path)) return false;
+	CachedFileIO file;
+	if (!file.open(path, true, MINIMAL_CACHE)) return false;
+
+	ChecksumFunction checksum = Checksum::getFunction(ChecksumType::CRC32C);
+	BTreeBloomHeader header{};
+	bool loaded = file.read(0, &header, sizeof(header)) == sizeof(header) &&
+		header.signature == BTREE_BLOOM_SIGNATURE && header.version == BTREE_BLOOM_VERSION &&
+		checksum((const uint8_t*)&header, BTREE_BLOOM_HEADER_PAYLOAD_SIZE) == header.headerChecksum &&
+		header.stamp == stamp && header.blocksCount > 0 &&
+		header.hashesCount > 0 && header.hashesCount <= BTREE_BLOOM_MAX_HASHES;
+
+	std::vector<uint64_t> blocks;
+	if (loaded) {
+		size_t length = header.blocksCount * BTREE_BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+		blocks.resize(header.blocksCount * BTREE_BLOOM_BLOCK_WORDS);
+		loaded = file.read(BTREE_BLOOM_DATA_OFFSET, blocks.data(), length) == length &&
+			checksum((const uint8_t*)blocks.data(), length) == header.blocksChecksum;
+	}
+	file.close();
+	if (!loaded) return false;
+
+	std::vector<std::atomic<uint64_t>>(blocks.size()).swap(words);
+	for (size_t i = 0; i < blocks.size(); i++) words[i].store(blocks[i], std::memory_order_relaxed);
+	blocksCount = header.blocksCount;
+	hashesCount = header.hashesCount;
+	capacity = header.capacity;
+	falsePositiveRate = header.falsePositiveRate;
+	return true;
+}
+
+
+
+/*
+*  @brief Writes filter blocks, then header with given stamp
+*  @return true if saved, false if filter is disabled or write fails
+*/
+bool BPlusTreeBloomFilter::save(const char* path, uint32_t stamp) {
+
+	if (!isEnabled()) return false;
+	CachedFileIO file;
+	if (!file.open(path, false, MINIMAL_CACHE)) return false;
+
+	ChecksumFunction checksum = Checksum::getFunction(ChecksumType::CRC32C);
+	std::vector<uint64_t> blocks(words.size());
+	for (size_t i = 0; i < blocks.size(); i++) blocks[i] = words[i].load(std::memory_order_relaxed);
+	size_t length = blocks.size() * sizeof(uint64_t);
+
+	BTreeBloomHeader header{};
+	header.signature = BTREE_BLOOM_SIGNATURE;
+	header.version = BTREE_BLOOM_VERSION;
+	header.stamp = stamp;
+	header.hashesCount = hashesCount;
+	header.capacity = capacity;
+	header.blocksCount = blocksCount;
+	header.falsePositiveRate = falsePositiveRate;
+	header.blocksChecksum = checksum((const uint8_t*)blocks.data(), length);
+	header.headerChecksum = checksum((const uint8_t*)&header, BTREE_BLOOM_HEADER_PAYLOAD_SIZE);
+
+	bool saved = file.write(BTREE_BLOOM_DATA_OFFSET, blocks.data(), length) == length && file.flush();
+	saved = saved && file.write(0, &header, sizeof(header)) == sizeof(header);
+	return file.close() && saved;
+}
+
+
+
+/*
+*  @brief Zeroes filter file header, so saved filter is not loaded anymore
+*  @return true if file has no valid filter, false if write fails
+*/
+bool BPlusTreeBloomFilter::invalidate(const char* path) {
+	if (!std::filesystem::exists(path)) return true;
+	CachedFileIO file;
+	if (!file.open(path, false, MINIMAL_CACHE)) return false;
+	BTreeBloomHeader header{};
+	bool written = file.write(0, &header, sizeof(header)) == sizeof(header);
+	return file.close() && written;
+}
+
+
+
+bool BPlusTreeBloomFilter::isEnabled() const {
+	return blocksCount > 0;
+}
+
+
+
+void BPlusTreeBloomFilter::add(const uint8_t* key, uint16_t length) {
+	uint64_t hash = hashKey(key, length);
+	std::atomic<uint64_t>* block = &words[getBlockOffset(hash)];
+	// bits in block are taken by double hashing from bits not used for block
+	uint64_t mixed = hash * 0xC2B2AE3D27D4EB4FULL;
+	uint32_t bit = (uint32_t)mixed, step = (uint32_t)(mixed >> 32) | 1;
+	for (uint32_t i = 0; i < hashesCount; i++, bit += step) {
+		block[(bit >> 6) & 7].fetch_or(1ULL << (bit & 63), std::memory_order_relaxed);
+	}
+}
+
+
+
+/*
+*  @brief Checks key in filter
+*  @return false if key was never added, true if key may be added
+*/
+bool BPlusTreeBloomFilter::mayContain(const uint8_t* key, uint16_t length) const {
+	uint64_t hash = hashKey(key, length);
+	const std::atomic<uint64_t>* block = &words[getBlockOffset(hash)];
+	uint64_t mixed = hash * 0xC2B2AE3D27D4EB4FULL;
+	uint32_t bit = (uint32_t)mixed, step = (uint32_t)(mixed >> 32) | 1;
+	for (uint32_t i = 0; i < hashesCount; i++, bit += step) {
+		if ((block[(bit >> 6) & 7].load(std::memory_order_relaxed) & (1ULL << (bit & 63))) == 0) return false;
+	}
+	return true;
+}
+
+
+
+uint64_t BPlusTreeBloomFilter::getCapacity() const {
+	return capacity;
+}
+
+
+
+double BPlusTreeBloomFilter::getFalsePositiveRate() const {
+	return falsePositiveRate;
+}
+
+
+
+uint64_t BPlusTreeBloomFilter::getSize() const {
+	return blocksCount * BTREE_BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+}
+
+
+
+/*
+*  @brief 64-bit hash of key bytes (MurmurHash3 style mixing of 8-byte words)
+*/
+uint64_t BPlusTreeBloomFilter::hashKey(const uint8_t* key, size_t length) {
+	auto rotate = [](uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+	uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+	uint64_t word;
+	for (; length >= 8; key += 8, length -= 8) {
+		memcpy(&word, key, 8);
+		hash ^= rotate(word * 0x87C37B91114253D5ULL, 31) * 0x4CF5AD432745937FULL;
+		hash = rotate(hash, 27) * 5 + 0x52DCE729;
+	}
+	word = 0;
+	if (length > 0) memcpy(&word, key, length);
+	hash ^= rotate(word * 0x87C37B91114253D5ULL, 31) * 0x4CF5AD432745937FULL;
+	// final avalanche
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+
+
+/*
+*  @brief Returns position of key block in filter words
+*/
+uint64_t BPlusTreeBloomFilter::getBlockOffset(uint64_t hash) const {
+	// high 32 bits of hash scaled to blocks count (no division)
+	uint64_t block = ((hash >> 32) * blocksCount) >> 32;
+	return block * BTREE_BLOOM_BLOCK_WORDS;
+}
@@ -0,0 +1,313 @@
+/******************************************************************************
+*
+*  BPlusTreeBuilder class implementation
+*
+*  BPlusTreeBuilder loads keys in ascending order into empty tree bottom-up
+*  instead of inserting them one by one. Keys are appended to the rightmost
+*  leaf, which is completed when next key exceeds fill factor, and completed
+*  node adds its lowest key and page to its parent level the same way:
+*
+*    level 2                 [ node ] ......................... (root)
+*    level 1         [ node ] [ node ] [ node ] ...............
+*    level 0  [ leaf ] [ leaf ] [ leaf ] [ leaf ] [ leaf ] ..... <- keys
+*
+*  So only the rightmost node of each level is kept in memory, nodes are
+*  written once and pages are allocated in keys order (sequential writes).
+*  The last node of level may be underfilled, so on commit it is merged
+*  with or takes entries from the previous node of level.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "BPlusTree.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief BPlusTreeBuilder constructor
+*  @param[in] tree - empty B+ Tree to load
+*  @param[in] fillFactor - nodes fill (BTREE_MIN_FILL_FACTOR to 1.0), free space
+*  left in nodes lets later inserts avoid splits
+*/
+BPlusTreeBuilder::BPlusTreeBuilder(BPlusTree& tree, double fillFactor) : tree(tree) {
+	fillFactor = std::clamp(fillFactor, BTREE_MIN_FILL_FACTOR, 1.0);
+	fillBytes = (uint32_t)(BTREE_NODE_CAPACITY * fillFactor);
+	addedKeys = 0;
+	finished = false;
+	levels.reserve(BTREE_MAX_HEIGHT);
+	failed = !tree.isOpen() || tree.isReadOnly() || tree.getTotalKeys() != 0;
+}
+
+
+/*
+*  @brief BPlusTreeBuilder destructor, releases pages if not committed
+*/
+BPlusTreeBuilder::~BPlusTreeBuilder() {
+	abort();
+}
+
+
+/*
+*  @brief Checks if builder accepts keys
+*  @return true if builder is not failed, committed or aborted
+*/
+bool BPlusTreeBuilder::isValid() {
+	return !failed && !finished;
+}
+
+
+/*
+*  @brief Appends key to the rightmost leaf
+*  @param[in] key - pointer to key bytes
+*  @param[in] keyLength - key length (up to BTREE_MAX_KEY_LENGTH)
+*  @param[in] value - value (record position or ID)
+*  @return true if added, false if key is not greater than previous one or fails
+*/
+bool BPlusTreeBuilder::add(const void* key, uint32_t keyLength, uint64_t value) {
+
+	if (!isValid() || keyLength > BTREE_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+
+	const uint8_t* bytes = (const uint8_t*)key;
+	if (addedKeys > 0 && !std::lexicographical_compare(lastKey.begin(), lastKey.end(), bytes, bytes + keyLength)) return false;
+
+	if (!addEntry(0, bytes, (uint16_t)keyLength, value)) {
+		failed = true;
+		return false;
+	}
+	lastKey.assign(bytes, bytes + keyLength);
+	tree.addFilterKey(bytes, (uint16_t)keyLength);
+	addedKeys++;
+	return true;
+}
+
+
+bool BPlusTreeBuilder::add(uint64_t key, uint64_t value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	BPlusTree::encodeKey(key, buffer);
+	return add(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+uint64_t BPlusTreeBuilder::getAddedKeys() {
+	return addedKeys;
+}
+
+
+/*
+*  @brief Completes all levels and publishes the new root in tree header
+*  @return true if tree loaded, false if builder is not valid, tree changed or fails
+*/
+bool BPlusTreeBuilder::commit() {
+
+	if (!isValid()) return false;
+	if (addedKeys == 0) {
+		finished = true;
+		return true;
+	}
+
+	// levels are completed bottom-up until level of single node (root)
+	uint64_t rootPage = 0;
+	size_t level = 0;
+	for (; level < levels.size(); level++) {
+		if (!finishLevel(level, rootPage)) {
+			abort();
+			return false;
+		}
+		if (rootPage != 0) break;
+	}
+	if (rootPage == 0) {
+		abort();
+		return false;
+	}
+
+	// tree must be still empty, its root leaf is released. Header latch
+	// makes readers restart and see new root and height together.
+	BTreeLatchSet locked{};
+	uint64_t emptyRoot = tree.rootPage.load();
+	tree.lockLatch(locked, 0);
+	tree.lockLatch(locked, emptyRoot);
+	if (tree.keysCount.load() != 0 || tree.height.load() != 1 || tree.rootPage.load() != emptyRoot || !tree.freePage(emptyRoot)) {
+		tree.releaseLatches(locked);
+		abort();
+		return false;
+	}
+	tree.rootPage.store(rootPage);
+	tree.height.store((uint32_t)level + 1);
+	tree.keysCount.store(addedKeys);
+	tree.releaseLatches(locked);
+
+	pages.clear();
+	levels.clear();
+	finished = true;
+	return true;
+}
+
+
+/*
+*  @brief Cancels loading and releases allocated pages
+*/
+void BPlusTreeBuilder::abort() {
+	if (finished) return;
+	for (uint64_t pageNo : pages) tree.freePage(pageNo);
+	pages.clear();
+	levels.clear();
+	finished = true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Levels methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Appends entry to the rightmost node of level. If entry exceeds fill
+*  factor, node is completed and node completed before it is written and adds
+*  its lowest key to parent level.
+*  @param[in] level - level (0 - leaves)
+*  @param[in] value - leaf value or child page
+*  @return true if added, false if fails
+*/
+bool BPlusTreeBuilder::addEntry(size_t level, const uint8_t* key, uint16_t length, uint64_t value) {
+
+	if (level >= BTREE_MAX_HEIGHT) return false;
+	if (level >= levels.size()) levels.resize(level + 1, BTreeBuildLevel{ {}, {}, {}, {}, 0, 0 });
+	if (levels[level].currentPage == 0) return startNode(level, key, length, value);
+
+	BTreeNode node(levels[level].current.data());
+	if (node.getUsedBytes() + node.getInsertSize(key, length) <= fillBytes) {
+		return node.insertAt(node.getKeysCount(), key, length, value);
+	}
+
+	// node is completed, node completed before it goes to storage
+	BTreeBuildLevel& nodes = levels[level];
+	if (nodes.previousPage != 0 && !writeNode(level, nodes.previousPage, nodes.previous, nodes.previousLow, false)) return false;
+	std::swap(nodes.previous, nodes.current);
+	std::swap(nodes.previousLow, nodes.currentLow);
+	nodes.previousPage = nodes.currentPage;
+	nodes.currentPage = 0;
+	return startNode(level, key, length, value);
+}
+
+
+
+/*
+*  @brief Starts new rightmost node of level with given entry. Leaf keeps
+*  entry as first key, inner node takes child as first child. Leaf after
+*  other leaf is separated by the shortest key after the last added key.
+*  @return true if started, false if fails
+*/
+bool BPlusTreeBuilder::startNode(size_t level, const uint8_t* key, uint16_t length, uint64_t value) {
+
+	uint64_t pageNo = allocatePage();
+	if (pageNo == NOT_FOUND) return false;
+
+	BTreeBuildLevel& nodes = levels[level];
+	nodes.current.assign(PAGE_SIZE, 0);
+	nodes.currentLow.assign(key, key + length);
+	nodes.currentPage = pageNo;
+	if (level == 0 && nodes.previousPage != 0) {
+		std::vector<uint8_t> low;
+		BPlusTree::getSeparator(lastKey, nodes.currentLow, low);
+		nodes.currentLow.swap(low);
+	}
+
+	BTreeNode node(nodes.current.data());
+	if (level == 0) {
+		node.init(BTREE_LEAF);
+		node.getHeader()->prevPage = nodes.previousPage;
+		if (nodes.previousPage != 0) BTreeNode(nodes.previous.data()).getHeader()->nextPage = pageNo;
+		return node.insertAt(0, key, length, value);
+	}
+	node.init(BTREE_INNER);
+	node.getHeader()->firstChild = value;
+	return true;
+}
+
+
+
+/*
+*  @brief Writes completed node and adds its lowest key to parent level
+*  @param[in] level - node level
+*  @param[in] low - lowest key under node (separator in parent)
+*  @param[in] isRoot - true if node is root (has no parent)
+*  @return true if written, false if fails
+*/
+bool BPlusTreeBuilder::writeNode(size_t level, uint64_t pageNo, std::vector<uint8_t>& node, const std::vector<uint8_t>& low, bool isRoot) {
+	// pages are not reachable from root until commit, so they are not latched
+	if (!tree.writeNode(pageNo, node.data())) return false;
+	if (isRoot) return true;
+	return addEntry(level + 1, low.data(), (uint16_t)low.size(), pageNo);
+}
+
+
+
+/*
+*  @brief Balances two last nodes of level and writes them
+*  @param[in] level - level to complete
+*  @param[out] rootPage - root page if level has single node, otherwise 0
+*  @return true if level completed, false if fails
+*/
+bool BPlusTreeBuilder::finishLevel(size_t level, uint64_t& rootPage) {
+
+	BTreeBuildLevel& nodes = levels[level];
+	BTreeNode left(nodes.previous.data()), right(nodes.current.data());
+	bool isLeaf = (level == 0);
+
+	// single node of level is root
+	if (nodes.previousPage == 0) {
+		rootPage = nodes.currentPage;
+		return writeNode(level, nodes.currentPage, nodes.current, nodes.currentLow, true);
+	}
+
+	if (right.getFillBytes() < BTREE_MIN_FILL) {
+
+		// inner nodes pull separator down between their entries
+		std::vector<BTreeEntry> entries;
+		left.getEntries(entries);
+		if (!isLeaf) entries.push_back(BTreeEntry{ nodes.currentLow, right.getHeader()->firstChild });
+		right.getEntries(entries);
+
+		if (BTreeNode::getFillSize(entries, 0, entries.size()) <= BTREE_NODE_CAPACITY) {
+			// last node merges into previous one
+			left.fill(entries, 0, entries.size());
+			if (isLeaf) left.getHeader()->nextPage = 0;
+			if (!tree.freePage(nodes.currentPage)) return false;
+			pages.erase(std::find(pages.begin(), pages.end(), nodes.currentPage));
+			// previous node is the only one if parent level is empty
+			bool isRoot = (level + 1 >= levels.size());
+			if (isRoot) rootPage = nodes.previousPage;
+			return writeNode(level, nodes.previousPage, nodes.previous, nodes.previousLow, isRoot);
+		}
+
+		size_t split = BPlusTree::getSplitIndex(entries, isLeaf);
+		left.fill(entries, 0, split);
+		if (isLeaf) right.fill(entries, split, entries.size());
+		else {
+			right.getHeader()->firstChild = entries[split].value;
+			right.fill(entries, split + 1, entries.size());
+		}
+		if (isLeaf) BPlusTree::getSeparator(entries[split - 1].key, entries[split].key, nodes.currentLow);
+		else nodes.currentLow = entries[split].key;
+	}
+
+	return writeNode(level, nodes.previousPage, nodes.previous, nodes.previousLow, false) &&
+		writeNode(level, nodes.currentPage, nodes.current, nodes.currentLow, false);
+}
+
+
+
+/*
+*  @brief Allocates page in tree file
+*  @return page number or NOT_FOUND if fails
+*/
+uint64_t BPlusTreeBuilder::allocatePage() {
+	uint64_t pageNo = tree.allocatePage();
+	if (pageNo != NOT_FOUND) pages.push_back(pageNo);
+	return pageNo;
+}
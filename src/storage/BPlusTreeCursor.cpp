@@ -0,0 +1,163 @@
+/******************************************************************************
+*
+*  BPlusTreeCursor class implementation
+*
+*  BPlusTreeCursor keeps copy of current key and value and copy of its leaf.
+*  Cursor steps in leaf copy while leaf latch version is unchanged, walks
+*  linked leaves in both directions skipping empty ones and validates each
+*  leaf version, so it takes no latches. If leaf changed, cursor descends
+*  again by key copy.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "BPlusTree.h"
+
+#include <cstring>
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief BPlusTreeCursor constructor
+* @param[in] tree - B+ Tree
+*/
+BPlusTreeCursor::BPlusTreeCursor(BPlusTree& tree) :
+	tree(tree), leafPage(0), leafVersion(0), index(0), value(0), page(PAGE_SIZE) {}
+
+
+
+const std::vector<uint8_t>& BPlusTreeCursor::getKey() {
+	return key;
+}
+
+
+
+/*
+* @brief Returns current key decoded as 64-bit unsigned integer
+* @return key or NOT_FOUND if key is not 64-bit encoded key
+*/
+uint64_t BPlusTreeCursor::getKeyAsUInt64() {
+	if (key.size() != BTREE_UINT64_KEY_LENGTH) return NOT_FOUND;
+	return BPlusTree::decodeKey(key.data());
+}
+
+
+
+uint64_t BPlusTreeCursor::getValue() {
+	return value;
+}
+
+
+
+/*
+* @brief Moves cursor to next key
+* @return true if moved, false if there is no next key
+*/
+bool BPlusTreeCursor::next() {
+	if (leafPage != 0 && tree.validateLatch(leafPage, leafVersion)) {
+		BTreeStatus status = walk(leafPage, leafVersion, index + 1, true);
+		if (status != BTreeStatus::RESTART) return status == BTreeStatus::SUCCESS;
+	}
+	return seek(key.data(), (uint16_t)key.size(), true, false);
+}
+
+
+
+/*
+* @brief Moves cursor to previous key
+* @return true if moved, false if there is no previous key
+*/
+bool BPlusTreeCursor::previous() {
+	if (leafPage != 0 && tree.validateLatch(leafPage, leafVersion)) {
+		BTreeStatus status = walk(leafPage, leafVersion, index, false);
+		if (status != BTreeStatus::RESTART) return status == BTreeStatus::SUCCESS;
+	}
+	return seek(key.data(), (uint16_t)key.size(), false, false);
+}
+
+
+
+/*
+* @brief Descends to leaf of the key and positions cursor near it
+* @param[in] key - key bytes or nullptr for the last key
+* @param[in] forward - true for key after given one, false for key before it
+* @param[in] inclusive - true if given key itself may be taken
+* @return true if positioned, false if there is no key in that direction
+*/
+bool BPlusTreeCursor::seek(const uint8_t* key, uint16_t length, bool forward, bool inclusive) {
+
+	uint8_t buffers[PAGE_SIZE * 2];
+	uint8_t *node, *parent;
+	BTreePath path;
+
+	while (true) {
+		BTreeStatus status = tree.descend(key, length, 0, path, buffers, node, parent);
+		if (status == BTreeStatus::FAILED) return false;
+		if (status == BTreeStatus::SUCCESS) {
+			memcpy(page.data(), node, PAGE_SIZE);
+			BTreeNode leaf(page.data());
+
+			// position is next key index (forward) or index after previous key (backward)
+			uint32_t position;
+			if (key == nullptr) position = leaf.getKeysCount();
+			else if (forward == inclusive) position = leaf.lowerBound(key, length);
+			else position = leaf.upperBound(key, length);
+
+			BTreePathStep& leafStep = path.steps[path.size - 1];
+			status = walk(leafStep.pageNo, leafStep.version, position, forward);
+			if (status != BTreeStatus::RESTART) return status == BTreeStatus::SUCCESS;
+		}
+		std::this_thread::yield();
+	}
+}
+
+
+
+/*
+* @brief Walks from position in leaf copy to the nearest key in given direction,
+* reads neighbour leaves into leaf copy and validates their versions
+* @param[in] pageNo - page of leaf copy
+* @param[in] version - latch version of leaf copy
+* @param[in] position - next key index (forward) or index after previous key (backward)
+* @return SUCCESS if key loaded, RESTART if leaves changed, FAILED if there is no key
+*/
+BTreeStatus BPlusTreeCursor::walk(uint64_t pageNo, uint64_t version, uint32_t position, bool forward) {
+
+	leafPage = 0;
+
+	while (true) {
+		BTreeNode leaf(page.data());
+		if (forward && position < leaf.getKeysCount()) break;
+		if (!forward && position > 0) {
+			position--;
+			break;
+		}
+
+		// neighbour link is actual if leaf didn't change after neighbour version is read
+		uint64_t neighbour = forward ? leaf.getHeader()->nextPage : leaf.getHeader()->prevPage;
+		if (neighbour == 0 || neighbour >= tree.pagesCount.load()) {
+			return tree.validateLatch(pageNo, version) ? BTreeStatus::FAILED : BTreeStatus::RESTART;
+		}
+		uint64_t neighbourVersion = tree.readLatch(neighbour);
+		if ((neighbourVersion & BTREE_LATCH_LOCKED) || !tree.validateLatch(pageNo, version)) return BTreeStatus::RESTART;
+		if (!tree.readNode(neighbour, page.data())) {
+			return tree.validateLatch(neighbour, neighbourVersion) ? BTreeStatus::FAILED : BTreeStatus::RESTART;
+		}
+		if (!tree.validateLatch(neighbour, neighbourVersion)) return BTreeStatus::RESTART;
+
+		pageNo = neighbour;
+		version = neighbourVersion;
+		position = forward ? 0 : BTreeNode(page.data()).getKeysCount();
+	}
+
+	BTreeNode leaf(page.data());
+	leaf.getKey(position, key);
+	value = leaf.getValue(position);
+	leafPage = pageNo;
+	leafVersion = version;
+	index = position;
+	return BTreeStatus::SUCCESS;
+}
@@ -0,0 +1,145 @@
+/******************************************************************************
+*
+*  BPlusTreeKeyCache class implementation
+*
+*  BPlusTreeKeyCache maps hot keys to their values, so repeated lookup is
+*  one hash probe instead of descending 3-4 cached pages. Keys are spread
+*  over shards, each shard has own mutex, LRU list and hashmap, so threads
+*  looking up different keys rarely wait for each other.
+*
+*  Cache is coherent with the tree without latching it: writer changes the
+*  tree first and then invalidates key, which increments its shard generation.
+*  Lookup takes shard generation before it reads the tree and puts found value
+*  only if generation is unchanged, so value read before concurrent change is
+*  never cached after that change. Inserted key had no cache entry (absent
+*  keys are not cached), so only updates and removes invalidate.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "BPlusTree.h"
+
+using namespace Cloudless::Storage;
+
+
+BPlusTreeKeyCache::BPlusTreeKeyCache() : shardCapacity(0) {}
+
+
+
+/*
+* @brief Sets cache capacity and clears cache
+* @param[in] maxKeys - max keys in cache (0 - cache disabled)
+*/
+void BPlusTreeKeyCache::setCapacity(size_t maxKeys) {
+	shardCapacity = (maxKeys + BTREE_KEY_CACHE_SHARDS - 1) / BTREE_KEY_CACHE_SHARDS;
+	clear();
+}
+
+
+
+bool BPlusTreeKeyCache::isEnabled() {
+	return shardCapacity.load() > 0;
+}
+
+
+
+size_t BPlusTreeKeyCache::getSize() {
+	size_t size = 0;
+	for (auto& shard : shards) {
+		std::lock_guard lock(shard.mutex);
+		size += shard.entries.size();
+	}
+	return size;
+}
+
+
+
+/*
+* @brief Looks up key value in cache
+* @param[out] value - cached value of key
+* @param[out] generation - key shard generation if key is not cached (for put)
+* @return true if key is cached, false otherwise
+*/
+bool BPlusTreeKeyCache::find(const uint8_t* key, uint16_t length, uint64_t& value, uint64_t& generation) {
+	std::string_view view((const char*)key, length);
+	BTreeKeyCacheShard& shard = getShard(view);
+	std::lock_guard lock(shard.mutex);
+	auto it = shard.map.find(view);
+	if (it == shard.map.end()) {
+		generation = shard.generation;
+		return false;
+	}
+	value = it->second->value;
+	shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+	return true;
+}
+
+
+
+/*
+* @brief Caches value found in tree, evicts least recently used key of shard
+* @param[in] generation - key shard generation taken before tree was read
+*/
+void BPlusTreeKeyCache::put(const uint8_t* key, uint16_t length, uint64_t value, uint64_t generation) {
+	size_t capacity = shardCapacity.load();
+	if (capacity == 0) return;
+	std::string_view view((const char*)key, length);
+	BTreeKeyCacheShard& shard = getShard(view);
+	std::lock_guard lock(shard.mutex);
+
+	// keys of shard changed since tree was read, value may be outdated
+	if (shard.generation != generation) return;
+
+	auto it = shard.map.find(view);
+	if (it != shard.map.end()) {
+		it->second->value = value;
+		shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+		return;
+	}
+	while (shard.entries.size() >= capacity) {
+		shard.map.erase(std::string_view(shard.entries.back().key));
+		shard.entries.pop_back();
+	}
+	// list node doesn't move, so map key view of its string stays valid
+	shard.entries.push_front(BTreeKeyCacheEntry{ std::string(view), value });
+	shard.map.emplace(std::string_view(shard.entries.front().key), shard.entries.begin());
+}
+
+
+
+/*
+* @brief Removes key from cache after its value changed in tree
+*/
+void BPlusTreeKeyCache::invalidate(const uint8_t* key, uint16_t length) {
+	if (shardCapacity.load() == 0) return;
+	std::string_view view((const char*)key, length);
+	BTreeKeyCacheShard& shard = getShard(view);
+	std::lock_guard lock(shard.mutex);
+	shard.generation++;
+	auto it = shard.map.find(view);
+	if (it == shard.map.end()) return;
+	// map key views entry string, so map entry goes first
+	BTreeKeyCacheList::iterator entry = it->second;
+	shard.map.erase(it);
+	shard.entries.erase(entry);
+}
+
+
+
+void BPlusTreeKeyCache::clear() {
+	for (auto& shard : shards) {
+		std::lock_guard lock(shard.mutex);
+		shard.map.clear();
+		shard.entries.clear();
+		shard.generation++;
+	}
+}
+
+
+
+BTreeKeyCacheShard& BPlusTreeKeyCache::getShard(std::string_view key) {
+	// hash is mixed, so shards don't depend on hash low bits used by buckets
+	uint64_t hash = (uint64_t)std::hash<std::string_view>{}(key) * 0x9E3779B97F4A7C15ULL;
+	return shards[(hash >> 32) % BTREE_KEY_CACHE_SHARDS];
+}
@@ -0,0 +1,306 @@
+#include "BPlusTree.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// BPlusTree insertion: key goes to its leaf, full node splits in two halves
+// by bytes and separator goes to parent. Leaf split separator is the shortest
+// key between the halves, so inner nodes keep short separators. Split latches only the node, its
+// parent, new right node (and next leaf to link it). If parent has no room
+// for separator, parent is split first by separate step and insertion
+// restarts, so split never propagates while latches are held.
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Inserts key into its leaf, splits leaf if it is full
+* @return true if inserted, false if key exists or fails
+*/
+bool BPlusTree::insertEntry(const uint8_t* key, uint16_t length, uint64_t value) {
+
+	uint8_t buffers[PAGE_SIZE * 2];
+	uint8_t *node, *parent;
+	BTreePath path;
+	BTreeLatchSet locked{};
+
+	while (true) {
+
+		BTreeStatus status = descend(key, length, 0, path, buffers, node, parent);
+		if (status == BTreeStatus::FAILED) return false;
+
+		if (status == BTreeStatus::SUCCESS) {
+			BTreeNode leaf(node);
+			uint32_t index = leaf.lowerBound(key, length);
+			if (index < leaf.getKeysCount() && leaf.compareKey(index, key, length) == 0) return false;
+
+			BTreePathStep& leafStep = path.steps[path.size - 1];
+			if (leaf.getInsertSize(key, length) <= leaf.getHeader()->freeBytes) {
+				// key fits the leaf: only leaf is latched
+				if (upgradeLatch(locked, leafStep.pageNo, leafStep.version)) {
+					leaf.insertAt(index, key, length, value);
+					bool written = writeNode(leafStep.pageNo, node);
+					releaseLatches(locked);
+					if (!written) return false;
+					keysCount.fetch_add(1);
+					return true;
+				}
+			} else {
+				status = splitLeaf(path, node, parent, index, key, length, value);
+				if (status == BTreeStatus::FAILED) return false;
+				if (status == BTreeStatus::SUCCESS) {
+					keysCount.fetch_add(1);
+					return true;
+				}
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+
+
+/*
+* @brief Splits full leaf with new key in two leaves and adds right leaf to parent
+* @param[in] path - path from descent to leaf
+* @param[in] node - leaf copy
+* @param[in] parent - parent copy
+* @param[in] index - position of new key in leaf
+* @return SUCCESS if split, RESTART if tree changed or parent split, FAILED if fails
+*/
+BTreeStatus BPlusTree::splitLeaf(BTreePath& path, uint8_t* node, uint8_t* parent, uint32_t index,
+	const uint8_t* key, uint16_t length, uint64_t value) {
+
+	std::vector<BTreeEntry> entries;
+	BTreeNode left(node);
+	left.getEntries(entries);
+	entries.insert(entries.begin() + index, BTreeEntry{ std::vector<uint8_t>(key, key + length), value });
+	size_t split = getSplitIndex(entries, true);
+
+	// shortest key between leaves separates them, parent needs room for it
+	std::vector<uint8_t> separator;
+	getSeparator(entries[split - 1].key, entries[split].key, separator);
+	BTreePathStep& leafStep = path.steps[path.size - 1];
+	BTreePathStep& parentStep = path.steps[path.size - 2];
+	BTreeNode parentNode(parent);
+	uint32_t separatorSize = (parentStep.pageNo != 0) ? parentNode.getInsertSize(separator.data(), (uint16_t)separator.size()) : 0;
+	if (separatorSize > 0 && parentNode.getHeader()->freeBytes < separatorSize) {
+		BTreeStatus status = splitInner(key, length, 1, separatorSize);
+		return (status == BTreeStatus::FAILED) ? status : BTreeStatus::RESTART;
+	}
+
+	// latches from top to bottom and from left to right
+	BTreeLatchSet locked{};
+	uint64_t leftPage = leafStep.pageNo;
+	uint64_t nextPage = left.getHeader()->nextPage;
+	if (!upgradeLatch(locked, parentStep.pageNo, parentStep.version) ||
+		!upgradeLatch(locked, leftPage, leafStep.version) ||
+		(nextPage != 0 && !tryLatch(locked, nextPage))) {
+		releaseLatches(locked);
+		return BTreeStatus::RESTART;
+	}
+
+	uint64_t rightPage = allocatePage();
+	if (rightPage == NOT_FOUND) {
+		releaseLatches(locked);
+		return BTreeStatus::FAILED;
+	}
+	lockLatch(locked, rightPage);
+
+	uint8_t rightBuffer[PAGE_SIZE], nextBuffer[PAGE_SIZE];
+	BTreeNode right(rightBuffer);
+	right.init(BTREE_LEAF);
+	left.fill(entries, 0, split);
+	right.fill(entries, split, entries.size());
+
+	// right leaf goes between left leaf and its next leaf
+	right.getHeader()->prevPage = leftPage;
+	right.getHeader()->nextPage = nextPage;
+	left.getHeader()->nextPage = rightPage;
+	bool linked = true;
+	if (nextPage != 0) {
+		linked = readNode(nextPage, nextBuffer);
+		((BTreeNodeHeader*)nextBuffer)->prevPage = rightPage;
+		linked = linked && writeNode(nextPage, nextBuffer);
+	}
+
+	BTreeStatus status = BTreeStatus::FAILED;
+	if (linked && writeNode(rightPage, rightBuffer) && writeNode(leftPage, node)) {
+		status = addSeparator(locked, path, parent, separator, leftPage, rightPage);
+	}
+	releaseLatches(locked);
+	return status;
+}
+
+
+
+/*
+* @brief Splits inner node of given level containing the key if it has less
+* free bytes than needed. Middle key moves to parent, its child becomes first
+* child of right node. Parent without room for middle key is split first.
+* @param[in] level - node level (1 - parents of leaves)
+* @param[in] neededBytes - free bytes needed in node
+* @return SUCCESS if node split or has room, RESTART if tree changed, FAILED if fails
+*/
+BTreeStatus BPlusTree::splitInner(const uint8_t* key, uint16_t length, uint32_t level, uint32_t neededBytes) {
+
+	uint8_t buffers[PAGE_SIZE * 2];
+	uint8_t *node, *parent;
+	BTreePath path;
+
+	BTreeStatus status = descend(key, length, level, path, buffers, node, parent);
+	if (status != BTreeStatus::SUCCESS) return status;
+
+	// node could be split by other writer or tree height changed
+	BTreeNode inner(node);
+	if (path.height - (path.size - 1) != level || inner.isLeaf()) return BTreeStatus::SUCCESS;
+	if (inner.getHeader()->freeBytes >= neededBytes) return BTreeStatus::SUCCESS;
+
+	std::vector<BTreeEntry> entries;
+	inner.getEntries(entries);
+	size_t middle = getSplitIndex(entries, false);
+	const std::vector<uint8_t>& separator = entries[middle].key;
+
+	BTreePathStep& nodeStep = path.steps[path.size - 1];
+	BTreePathStep& parentStep = path.steps[path.size - 2];
+	BTreeNode parentNode(parent);
+	uint32_t separatorSize = (parentStep.pageNo != 0) ? parentNode.getInsertSize(separator.data(), (uint16_t)separator.size()) : 0;
+	if (separatorSize > 0 && parentNode.getHeader()->freeBytes < separatorSize) {
+		status = splitInner(key, length, level + 1, separatorSize);
+		return (status == BTreeStatus::FAILED) ? status : BTreeStatus::RESTART;
+	}
+
+	BTreeLatchSet locked{};
+	if (!upgradeLatch(locked, parentStep.pageNo, parentStep.version) ||
+		!upgradeLatch(locked, nodeStep.pageNo, nodeStep.version)) {
+		releaseLatches(locked);
+		return BTreeStatus::RESTART;
+	}
+
+	uint64_t rightPage = allocatePage();
+	if (rightPage == NOT_FOUND) {
+		releaseLatches(locked);
+		return BTreeStatus::FAILED;
+	}
+	lockLatch(locked, rightPage);
+
+	uint8_t rightBuffer[PAGE_SIZE];
+	BTreeNode right(rightBuffer);
+	right.init(BTREE_INNER);
+	inner.fill(entries, 0, middle);
+	right.getHeader()->firstChild = entries[middle].value;
+	right.fill(entries, middle + 1, entries.size());
+
+	status = BTreeStatus::FAILED;
+	if (writeNode(rightPage, rightBuffer) && writeNode(nodeStep.pageNo, node)) {
+		status = addSeparator(locked, path, parent, separator, nodeStep.pageNo, rightPage);
+	}
+	releaseLatches(locked);
+	return status;
+}
+
+
+
+/*
+* @brief Adds separator and right node to latched parent with enough room,
+* or creates new root if split node is root (tree header is latched)
+* @param[in] locked - latches held by split
+* @param[in] path - path from descent to split node
+* @param[in] parent - parent copy
+* @param[in] key - separator (keys of right node are not lower)
+* @param[in] leftPage - split node page
+* @param[in] rightPage - new right node page
+* @return SUCCESS if added, FAILED if fails
+*/
+BTreeStatus BPlusTree::addSeparator(BTreeLatchSet& locked, BTreePath& path, uint8_t* parent,
+	const std::vector<uint8_t>& key, uint64_t leftPage, uint64_t rightPage) {
+
+	BTreePathStep& parentStep = path.steps[path.size - 2];
+	if (parentStep.pageNo != 0) {
+		BTreeNode node(parent);
+		if (!node.insertAt(parentStep.childIndex, key.data(), (uint16_t)key.size(), rightPage)) return BTreeStatus::FAILED;
+		return writeNode(parentStep.pageNo, parent) ? BTreeStatus::SUCCESS : BTreeStatus::FAILED;
+	}
+
+	// root split grows tree height
+	if (path.height >= BTREE_MAX_HEIGHT) return BTreeStatus::FAILED;
+	uint64_t newRoot = allocatePage();
+	if (newRoot == NOT_FOUND) return BTreeStatus::FAILED;
+	lockLatch(locked, newRoot);
+
+	uint8_t page[PAGE_SIZE];
+	BTreeNode root(page);
+	root.init(BTREE_INNER);
+	root.getHeader()->firstChild = leftPage;
+	root.insertAt(0, key.data(), (uint16_t)key.size(), rightPage);
+	if (!writeNode(newRoot, page)) return BTreeStatus::FAILED;
+	rootPage.store(newRoot);
+	height.fetch_add(1);
+	return BTreeStatus::SUCCESS;
+}
+
+
+
+/*
+* @brief Finds split position dividing entries bytes in halves. Node bytes are
+* counted without prefix common to node keys, so halves with longer prefixes
+* shrink, and split keeping both nodes above underflow threshold is preferred.
+* Leaf keeps entry at split position in right node, inner node moves it to parent.
+* @param[in] entries - node entries
+* @param[in] isLeaf - true for leaf node
+* @return split position
+*/
+size_t BPlusTree::getSplitIndex(const std::vector<BTreeEntry>& entries, bool isLeaf) {
+
+	// keys bytes before each entry
+	std::vector<uint64_t> keyBytes(entries.size() + 1, 0);
+	for (size_t i = 0; i < entries.size(); i++) keyBytes[i + 1] = keyBytes[i] + entries[i].key.size();
+
+	// node size estimate, suffixes heads kept in slots make exact size up to 4 bytes per key lower
+	auto getNodeSize = [&](size_t from, size_t to) {
+		const std::vector<uint8_t>& first = entries[from].key;
+		const std::vector<uint8_t>& last = entries[to - 1].key;
+		uint32_t prefixLength = BTreeNode::getCommonPrefix(first.data(), first.size(), last.data(), last.size());
+		return BTreeNode::getNodeSize(to - from, keyBytes[to] - keyBytes[from], prefixLength);
+	};
+
+	// both nodes keep at least one key, the larger node is minimal
+	size_t last = isLeaf ? entries.size() - 1 : entries.size() - 2;
+	size_t split = 1, balanced = 0;
+	uint32_t splitSize = UINT32_MAX, balancedSize = UINT32_MAX;
+	for (size_t i = 1; i <= last; i++) {
+		size_t rightFrom = isLeaf ? i : i + 1;
+		uint32_t leftSize = getNodeSize(0, i);
+		uint32_t rightSize = getNodeSize(rightFrom, entries.size());
+		uint32_t size = std::max(leftSize, rightSize);
+		if (size < splitSize) {
+			split = i;
+			splitSize = size;
+		}
+		// entries bytes without prefix compression (not greater than getFillBytes)
+		uint64_t leftFill = BTreeNode::getNodeSize(i, keyBytes[i], 0) - i * BTREE_KEY_HEAD_SIZE;
+		uint64_t rightKeys = entries.size() - rightFrom;
+		uint64_t rightFill = BTreeNode::getNodeSize(rightKeys, keyBytes[entries.size()] - keyBytes[rightFrom], 0) - rightKeys * BTREE_KEY_HEAD_SIZE;
+		if (leftFill >= BTREE_MIN_FILL && rightFill >= BTREE_MIN_FILL && size < balancedSize) {
+			balanced = i;
+			balancedSize = size;
+		}
+	}
+	return (balanced != 0 && balancedSize <= BTREE_NODE_CAPACITY) ? balanced : split;
+}
+
+
+
+/*
+* @brief Returns the shortest separator of adjacent leaves: the shortest prefix
+* of right key greater than left key (suffix truncation)
+* @param[in] left - the greatest key of left leaf
+* @param[in] right - the lowest key of right leaf (greater than left key)
+* @param[out] separator - key greater than left key and not greater than right key
+*/
+void BPlusTree::getSeparator(const std::vector<uint8_t>& left, const std::vector<uint8_t>& right, std::vector<uint8_t>& separator) {
+	size_t common = BTreeNode::getCommonPrefix(left.data(), left.size(), right.data(), right.size());
+	separator.assign(right.begin(), right.begin() + std::min(common + 1, right.size()));
+}
@@ -0,0 +1,189 @@
+#include "BPlusTree.h"
+
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// BPlusTree optimistic lock coupling: every node has version latch. Reader
+// reads latch version, copies node and checks that version didn't change,
+// so readers never write shared memory. Descent validates parent version
+// after child version is read, so child page taken from parent was actual.
+// Writer upgrades latches of nodes it changes from versions it has read and
+// unlocks them with new versions, so readers of changed nodes restart.
+// Writer never waits for a latch while holding others (failed upgrade
+// releases all latches and restarts), so writers can't deadlock.
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Creates latches table without chunks
+*/
+BTreeLatchTable::BTreeLatchTable() : chunks(new std::atomic<std::atomic<uint64_t>*>[BTREE_LATCH_CHUNKS]) {
+	for (uint64_t i = 0; i < BTREE_LATCH_CHUNKS; i++) chunks[i].store(nullptr);
+}
+
+
+
+/*
+* @brief Releases latches chunks
+*/
+BTreeLatchTable::~BTreeLatchTable() {
+	for (uint64_t i = 0; i < BTREE_LATCH_CHUNKS; i++) delete[] chunks[i].load();
+}
+
+
+
+/*
+* @brief Returns latch of page, allocates latches chunk on first access
+* @param[in] pageNo - page number (lower than BTREE_MAX_PAGES)
+* @return page latch
+*/
+std::atomic<uint64_t>& BTreeLatchTable::get(uint64_t pageNo) {
+	std::atomic<std::atomic<uint64_t>*>& slot = chunks[pageNo >> BTREE_LATCH_CHUNK_BITS];
+	std::atomic<uint64_t>* chunk = slot.load(std::memory_order_acquire);
+	if (chunk == nullptr) {
+		std::atomic<uint64_t>* created = new std::atomic<uint64_t>[BTREE_LATCH_CHUNK_SIZE];
+		for (uint64_t i = 0; i < BTREE_LATCH_CHUNK_SIZE; i++) created[i].store(0, std::memory_order_relaxed);
+		// other thread could allocate chunk first
+		if (slot.compare_exchange_strong(chunk, created, std::memory_order_acq_rel)) chunk = created;
+		else delete[] created;
+	}
+	return chunk[pageNo & (BTREE_LATCH_CHUNK_SIZE - 1)];
+}
+
+
+//-----------------------------------------------------------------------------
+// Latches methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Reads latch version before node copy
+* @return version, has BTREE_LATCH_LOCKED bit if node is being changed
+*/
+uint64_t BPlusTree::readLatch(uint64_t pageNo) {
+	return latches.get(pageNo).load(std::memory_order_acquire);
+}
+
+
+
+/*
+* @brief Checks that node didn't change since its latch version was read
+* @return true if latch has the same version, false otherwise
+*/
+bool BPlusTree::validateLatch(uint64_t pageNo, uint64_t version) {
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return latches.get(pageNo).load(std::memory_order_relaxed) == version;
+}
+
+
+
+/*
+* @brief Locks latch if node didn't change since its copy was read
+* @param[in] locked - latches held by operation
+* @param[in] version - latch version of node copy
+* @return true if locked, false if node changed or is locked
+*/
+bool BPlusTree::upgradeLatch(BTreeLatchSet& locked, uint64_t pageNo, uint64_t version) {
+	for (uint32_t i = 0; i < locked.count; i++) {
+		if (locked.pages[i] == pageNo) return true;
+	}
+	if (locked.count >= BTREE_MAX_LATCHES || (version & BTREE_LATCH_LOCKED)) return false;
+	if (!latches.get(pageNo).compare_exchange_strong(version, version | BTREE_LATCH_LOCKED, std::memory_order_acquire)) return false;
+	locked.pages[locked.count++] = pageNo;
+	return true;
+}
+
+
+
+/*
+* @brief Locks latch of node which copy wasn't read (sibling or next leaf)
+* @return true if locked, false if node is locked by other writer
+*/
+bool BPlusTree::tryLatch(BTreeLatchSet& locked, uint64_t pageNo) {
+	return upgradeLatch(locked, pageNo, readLatch(pageNo));
+}
+
+
+
+/*
+* @brief Waits and locks latch, for pages no other writer keeps for long
+* (new pages and tree header when no other latches are held)
+*/
+void BPlusTree::lockLatch(BTreeLatchSet& locked, uint64_t pageNo) {
+	while (!tryLatch(locked, pageNo)) std::this_thread::yield();
+}
+
+
+
+/*
+* @brief Unlocks latches with new versions, so node copies read before are invalid
+*/
+void BPlusTree::releaseLatches(BTreeLatchSet& locked) {
+	for (uint32_t i = locked.count; i > 0; i--) {
+		latches.get(locked.pages[i - 1]).fetch_add(BTREE_LATCH_LOCKED, std::memory_order_release);
+	}
+	locked.count = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Optimistic descent
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Descends from root to node of given level which should contain the key.
+* Levels are counted from leaves, so they don't change when root splits.
+* @param[in] key - key bytes or nullptr to descend to the rightmost node
+* @param[in] level - node level (0 - leaf), root is returned if level is above it
+* @param[out] path - header and nodes from root to node with latch versions
+* @param[in] buffers - two PAGE_SIZE buffers for node copies
+* @param[out] node - node copy
+* @param[out] parent - parent node copy (if node is not root)
+* @return SUCCESS if node copies are valid, RESTART if tree changed, FAILED if node is corrupt
+*/
+BTreeStatus BPlusTree::descend(const uint8_t* key, uint16_t length, uint32_t level, BTreePath& path,
+	uint8_t* buffers, uint8_t*& node, uint8_t*& parent) {
+
+	node = buffers;
+	parent = buffers + PAGE_SIZE;
+	path.size = 0;
+
+	// root page and height are consistent while header latch is unchanged
+	uint64_t headerVersion = readLatch(0);
+	if (headerVersion & BTREE_LATCH_LOCKED) return BTreeStatus::RESTART;
+	uint64_t pageNo = rootPage.load();
+	path.height = height.load();
+	path.steps[path.size++] = BTreePathStep{ 0, headerVersion, 0 };
+	if (pageNo == 0 || pageNo >= pagesCount.load()) return BTreeStatus::FAILED;
+
+	uint64_t version = readLatch(pageNo);
+	if ((version & BTREE_LATCH_LOCKED) || !validateLatch(0, headerVersion)) return BTreeStatus::RESTART;
+	if (!readNode(pageNo, node)) return validateLatch(pageNo, version) ? BTreeStatus::FAILED : BTreeStatus::RESTART;
+	if (!validateLatch(pageNo, version)) return BTreeStatus::RESTART;
+
+	for (uint32_t nodeLevel = path.height - 1; nodeLevel > level; nodeLevel--) {
+
+		BTreeNode current(node);
+		if (current.isLeaf()) return BTreeStatus::FAILED;
+		uint32_t childIndex = (key != nullptr) ? current.upperBound(key, length) : current.getKeysCount();
+		uint64_t childPage = current.getChild(childIndex);
+		path.steps[path.size++] = BTreePathStep{ pageNo, version, childIndex };
+		if (childPage == 0 || childPage >= pagesCount.load()) return BTreeStatus::FAILED;
+
+		// child page is actual if parent didn't change after child version is read
+		uint64_t childVersion = readLatch(childPage);
+		if ((childVersion & BTREE_LATCH_LOCKED) || !validateLatch(pageNo, version)) return BTreeStatus::RESTART;
+		std::swap(node, parent);
+		if (!readNode(childPage, node)) return validateLatch(childPage, childVersion) ? BTreeStatus::FAILED : BTreeStatus::RESTART;
+		if (!validateLatch(childPage, childVersion)) return BTreeStatus::RESTART;
+
+		pageNo = childPage;
+		version = childVersion;
+	}
+
+	path.steps[path.size++] = BTreePathStep{ pageNo, version, 0 };
+	return BTreeStatus::SUCCESS;
+}
@@ -0,0 +1,492 @@
+/******************************************************************************
+*
+*  BTreeNode class implementation
+*
+*  Node page keeps prefix common to all its keys right after header, sorted
+*  array of 8 bytes slots after prefix and entries area growing backwards
+*  from page end:
+*
+*    [ header ] [ prefix ] [ slot 0 ] [ slot 1 ] ... [ free ] ... [ entry 1 ] [ entry 0 ]
+*    slot:  [ key suffix head (4 bytes) ] [ entry offset (2 bytes) ] [ suffix length (2 bytes) ]
+*    entry: [ key suffix after head ] [ value (8 bytes) ]
+*
+*  Keys are stored without node prefix, so long keys sharing hierarchical
+*  paths (e.g. "category/subcategory/...") take only their distinct bytes,
+*  and the first 4 bytes of suffix are kept in slot only. Search compares
+*  key with prefix once, then finds slots with equal suffix head by vectorized
+*  integer search (BPlusTree_search.cpp) and reads entries of these slots only.
+*
+*  Insertion shifts slots only, entries never move except on compaction,
+*  which closes gaps left by removed entries. Key out of node prefix makes
+*  node filled again with shorter prefix.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "BPlusTree.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief Creates node view over page buffer of PAGE_SIZE bytes
+*/
+BTreeNode::BTreeNode(uint8_t* page) : page(page) {}
+
+
+
+/*
+* @brief Resets page to empty node of given type
+* @param[in] type - node type
+*/
+void BTreeNode::init(uint16_t type) {
+	memset(page, 0, BTREE_NODE_HEADER_SIZE);
+	BTreeNodeHeader* header = getHeader();
+	header->type = type;
+	header->dataStart = (uint16_t)PAGE_SIZE;
+	header->freeBytes = (uint16_t)BTREE_NODE_CAPACITY;
+}
+
+
+
+BTreeNodeHeader* BTreeNode::getHeader() const {
+	return (BTreeNodeHeader*)page;
+}
+
+
+bool BTreeNode::isLeaf() const {
+	return getHeader()->type == BTREE_LEAF;
+}
+
+
+uint32_t BTreeNode::getKeysCount() const {
+	return getHeader()->keysCount;
+}
+
+
+uint32_t BTreeNode::getUsedBytes() const {
+	return BTREE_NODE_CAPACITY - getHeader()->freeBytes;
+}
+
+
+/*
+* @brief Returns bytes node entries would use without prefix compression,
+* so node fill doesn't depend on how long its keys common prefix is
+*/
+uint32_t BTreeNode::getFillBytes() const {
+	const BTreeNodeSlot* slots = getSlots();
+	uint32_t prefixLength = getHeader()->prefixLength;
+	uint32_t bytes = 0;
+	for (uint32_t i = 0; i < getKeysCount(); i++) bytes += getEntrySize(prefixLength + slots[i].length);
+	return bytes;
+}
+
+
+BTreeNodeSlot* BTreeNode::getSlots() const {
+	return (BTreeNodeSlot*)(page + BTREE_NODE_HEADER_SIZE + getPrefixArea(getHeader()->prefixLength));
+}
+
+
+/*
+* @brief Returns bytes taken by prefix, slots are aligned to 4 bytes
+*/
+uint32_t BTreeNode::getPrefixArea(size_t prefixLength) {
+	return (uint32_t)((prefixLength + 3) & ~(size_t)3);
+}
+
+
+/*
+* @brief Returns length of key suffix part stored in entry (after head)
+*/
+uint32_t BTreeNode::getTailLength(size_t keyLength) {
+	return (keyLength > BTREE_KEY_HEAD_SIZE) ? (uint32_t)(keyLength - BTREE_KEY_HEAD_SIZE) : 0;
+}
+
+
+/*
+* @brief Returns bytes taken by key (suffix) slot and entry
+*/
+uint32_t BTreeNode::getEntrySize(size_t keyLength) {
+	return (uint32_t)(sizeof(BTreeNodeSlot) + getTailLength(keyLength) + sizeof(uint64_t));
+}
+
+
+
+/*
+* @brief Returns bytes used by node keeping keys without common prefix,
+* suffixes heads are counted in entries, so it is not lower than exact size
+* @param[in] keys - keys count
+* @param[in] keyBytes - total length of keys
+* @param[in] prefixLength - length of prefix common to all keys
+* @return used bytes estimate
+*/
+uint32_t BTreeNode::getNodeSize(size_t keys, size_t keyBytes, size_t prefixLength) {
+	return (uint32_t)(getPrefixArea(prefixLength) + keys * (sizeof(BTreeNodeSlot) + sizeof(uint64_t)) + keyBytes - keys * prefixLength);
+}
+
+
+
+/*
+* @brief Returns bytes used by node filled with range of entries
+* @param[in] entries - entries in keys order
+* @param[in] from - first entry
+* @param[in] to - entry after the last one
+* @return used bytes (must not exceed BTREE_NODE_CAPACITY to fit the node)
+*/
+uint32_t BTreeNode::getFillSize(const std::vector<BTreeEntry>& entries, size_t from, size_t to) {
+	if (from >= to) return 0;
+	// sorted keys share common prefix of the first and the last key
+	const std::vector<uint8_t>& first = entries[from].key;
+	const std::vector<uint8_t>& last = entries[to - 1].key;
+	uint32_t prefixLength = getCommonPrefix(first.data(), first.size(), last.data(), last.size());
+	uint32_t size = getPrefixArea(prefixLength);
+	for (size_t i = from; i < to; i++) size += getEntrySize(entries[i].key.size() - prefixLength);
+	return size;
+}
+
+
+
+/*
+* @brief Returns length of common prefix of two byte strings
+*/
+uint32_t BTreeNode::getCommonPrefix(const uint8_t* first, size_t firstLength, const uint8_t* second, size_t secondLength) {
+	size_t length = std::min(firstLength, secondLength);
+	size_t i = 0;
+	while (i < length && first[i] == second[i]) i++;
+	return (uint32_t)i;
+}
+
+
+
+/*
+* @brief Returns first BTREE_KEY_HEAD_SIZE bytes of key as big-endian integer
+* padded with zeros, so heads order follows memcmp order of keys
+*/
+uint32_t BTreeNode::getKeyHead(const uint8_t* key, size_t length) {
+	uint32_t head = 0;
+	for (size_t i = 0; i < BTREE_KEY_HEAD_SIZE; i++) {
+		head = (head << 8) | (i < length ? key[i] : 0);
+	}
+	return head;
+}
+
+
+
+/*
+* @brief Returns bytes node uses more after key insertion. Key out of node
+* prefix makes prefix shorter, so suffixes of all keys become longer.
+* @return bytes to compare with free bytes
+*/
+uint32_t BTreeNode::getInsertSize(const uint8_t* key, uint16_t length) const {
+	BTreeNodeHeader* header = getHeader();
+	if (header->keysCount == 0) return getNodeSize(1, length, length);
+
+	uint32_t prefixLength = header->prefixLength;
+	uint32_t shared = getCommonPrefix(page + BTREE_NODE_HEADER_SIZE, prefixLength, key, length);
+	if (shared == prefixLength) return getEntrySize(length - prefixLength);
+
+	// suffixes become longer by prefix bytes cut off
+	uint32_t size = getPrefixArea(shared) + getEntrySize(length - shared);
+	const BTreeNodeSlot* slots = getSlots();
+	for (uint32_t i = 0; i < header->keysCount; i++) size += getEntrySize(slots[i].length + prefixLength - shared);
+	return size - getUsedBytes();
+}
+
+
+
+/*
+* @brief Copies full key (prefix and suffix)
+* @param[in] index - key index
+* @param[out] key - key bytes
+*/
+void BTreeNode::getKey(uint32_t index, std::vector<uint8_t>& key) const {
+	const BTreeNodeSlot& slot = getSlots()[index];
+	const uint8_t* prefix = page + BTREE_NODE_HEADER_SIZE;
+	key.assign(prefix, prefix + getHeader()->prefixLength);
+	for (uint32_t i = 0; i < std::min<uint32_t>(slot.length, BTREE_KEY_HEAD_SIZE); i++) {
+		key.push_back((uint8_t)(slot.head >> (8 * (BTREE_KEY_HEAD_SIZE - 1 - i))));
+	}
+	key.insert(key.end(), page + slot.offset, page + slot.offset + getTailLength(slot.length));
+}
+
+
+
+/*
+* @brief Compares node prefix with key
+* @return negative if all node keys are lower than key, positive if greater,
+* zero if key starts with prefix
+*/
+int BTreeNode::comparePrefix(const uint8_t* key, uint16_t length) const {
+	uint32_t prefixLength = getHeader()->prefixLength;
+	int result = memcmp(page + BTREE_NODE_HEADER_SIZE, key, std::min<uint32_t>(prefixLength, length));
+	if (result != 0) return result;
+	return (length < prefixLength) ? 1 : 0;
+}
+
+
+
+/*
+* @brief Compares key suffix of slot with given suffix, entry is read only
+* if suffix heads are equal
+* @param[in] head - head of given suffix
+* @return negative if slot suffix is lower, zero if equal, positive if greater
+*/
+int BTreeNode::compareSuffix(const BTreeNodeSlot& slot, const uint8_t* suffix, uint16_t length, uint32_t head) const {
+	if (slot.head != head) return (slot.head < head) ? -1 : 1;
+	// equal heads have equal bytes up to head size or shorter suffix
+	uint32_t common = std::min(slot.length, length);
+	if (common > BTREE_KEY_HEAD_SIZE) {
+		int result = memcmp(page + slot.offset, suffix + BTREE_KEY_HEAD_SIZE, common - BTREE_KEY_HEAD_SIZE);
+		if (result != 0) return result;
+	}
+	return (int)slot.length - (int)length;
+}
+
+
+
+/*
+* @brief Compares key at index with given key (memcmp order, shorter prefix first)
+* @return negative if node key is lower, zero if equal, positive if greater
+*/
+int BTreeNode::compareKey(uint32_t index, const uint8_t* key, uint16_t length) const {
+	int result = comparePrefix(key, length);
+	if (result != 0) return result;
+	uint32_t prefixLength = getHeader()->prefixLength;
+	const uint8_t* suffix = key + prefixLength;
+	uint16_t suffixLength = (uint16_t)(length - prefixLength);
+	return compareSuffix(getSlots()[index], suffix, suffixLength, getKeyHead(suffix, suffixLength));
+}
+
+
+
+/*
+* @brief Binary search of first key not lower than given key
+* @return key index (keys count if all keys are lower)
+*/
+uint32_t BTreeNode::lowerBound(const uint8_t* key, uint16_t length) const {
+	return search(key, length, false);
+}
+
+
+
+/*
+* @brief Binary search of first key greater than given key
+* @return key index (keys count if all keys are lower or equal)
+*/
+uint32_t BTreeNode::upperBound(const uint8_t* key, uint16_t length) const {
+	return search(key, length, true);
+}
+
+
+
+/*
+* @brief Search over slots: key is compared with prefix once, then range of
+* slots with the same suffix head is found by vectorized heads search, only
+* keys in this range (usually one) are compared by suffix bytes
+* @param[in] upper - true to find first greater key, false - first not lower
+* @return key index
+*/
+uint32_t BTreeNode::search(const uint8_t* key, uint16_t length, bool upper) const {
+
+	uint32_t count = getKeysCount();
+	int order = comparePrefix(key, length);
+	if (order != 0) return (order < 0) ? count : 0;
+
+	uint32_t prefixLength = getHeader()->prefixLength;
+	const uint8_t* suffix = key + prefixLength;
+	uint16_t suffixLength = (uint16_t)(length - prefixLength);
+	uint32_t head = getKeyHead(suffix, suffixLength);
+	const BTreeNodeSlot* slots = getSlots();
+
+	uint32_t low = searchHeads(slots, count, head);
+	if (low == count || slots[low].head != head) return low;
+	uint32_t high = (head == UINT32_MAX) ? count : low + searchHeads(slots + low, count - low, head + 1);
+	while (low < high) {
+		uint32_t middle = (low + high) / 2;
+		int result = compareSuffix(slots[middle], suffix, suffixLength, head);
+		if (result < 0 || (upper && result == 0)) low = middle + 1;
+		else high = middle;
+	}
+	return low;
+}
+
+
+
+uint64_t BTreeNode::getValue(uint32_t index) const {
+	const BTreeNodeSlot& slot = getSlots()[index];
+	uint64_t value;
+	memcpy(&value, page + slot.offset + getTailLength(slot.length), sizeof(value));
+	return value;
+}
+
+
+
+void BTreeNode::setValue(uint32_t index, uint64_t value) {
+	const BTreeNodeSlot& slot = getSlots()[index];
+	memcpy(page + slot.offset + getTailLength(slot.length), &value, sizeof(value));
+}
+
+
+
+/*
+* @brief Returns child page of inner node
+* @param[in] childIndex - child index (0 - first child, i - value of key i-1)
+* @return child page number
+*/
+uint64_t BTreeNode::getChild(uint32_t childIndex) const {
+	if (childIndex == 0) return getHeader()->firstChild;
+	return getValue(childIndex - 1);
+}
+
+
+
+/*
+* @brief Inserts entry keeping keys order
+* @param[in] index - position of new key
+* @return true if inserted, false if entry doesn't fit the node
+*/
+bool BTreeNode::insertAt(uint32_t index, const uint8_t* key, uint16_t length, uint64_t value) {
+
+	BTreeNodeHeader* header = getHeader();
+	if (getInsertSize(key, length) > header->freeBytes) return false;
+
+	// first key or key out of prefix: node is filled again with new prefix
+	uint32_t prefixLength = header->prefixLength;
+	if (header->keysCount == 0 || getCommonPrefix(page + BTREE_NODE_HEADER_SIZE, prefixLength, key, length) < prefixLength) {
+		std::vector<BTreeEntry> entries;
+		getEntries(entries);
+		entries.insert(entries.begin() + index, BTreeEntry{ std::vector<uint8_t>(key, key + length), value });
+		fill(entries, 0, entries.size());
+		return true;
+	}
+
+	putEntry(index, key, length, value);
+	return true;
+}
+
+
+
+/*
+* @brief Writes entry of key starting with node prefix, node has room for it
+* @param[in] index - position of new key
+*/
+void BTreeNode::putEntry(uint32_t index, const uint8_t* key, uint16_t length, uint64_t value) {
+
+	BTreeNodeHeader* header = getHeader();
+	uint32_t prefixLength = header->prefixLength;
+	const uint8_t* suffix = key + prefixLength;
+	uint16_t suffixLength = (uint16_t)(length - prefixLength);
+	uint32_t tailLength = getTailLength(suffixLength);
+	uint32_t payloadSize = tailLength + sizeof(uint64_t);
+
+	// slots array and entries area must not overlap
+	uint64_t slotsEnd = BTREE_NODE_HEADER_SIZE + getPrefixArea(prefixLength) + (header->keysCount + 1) * sizeof(BTreeNodeSlot);
+	if (slotsEnd + payloadSize > header->dataStart) compact();
+
+	header->dataStart -= (uint16_t)payloadSize;
+	uint8_t* entry = page + header->dataStart;
+	if (tailLength > 0) memcpy(entry, suffix + BTREE_KEY_HEAD_SIZE, tailLength);
+	memcpy(entry + tailLength, &value, sizeof(value));
+
+	BTreeNodeSlot* slots = getSlots();
+	memmove(slots + index + 1, slots + index, (header->keysCount - index) * sizeof(BTreeNodeSlot));
+	slots[index] = BTreeNodeSlot{ getKeyHead(suffix, suffixLength), header->dataStart, suffixLength };
+	header->keysCount++;
+	header->freeBytes -= (uint16_t)getEntrySize(suffixLength);
+}
+
+
+
+/*
+* @brief Removes entry, its space becomes gap until compaction
+* @param[in] index - key index
+*/
+void BTreeNode::removeAt(uint32_t index) {
+	BTreeNodeHeader* header = getHeader();
+	BTreeNodeSlot* slots = getSlots();
+	uint32_t entrySize = getEntrySize(slots[index].length);
+	memmove(slots + index, slots + index + 1, (header->keysCount - index - 1) * sizeof(BTreeNodeSlot));
+	header->keysCount--;
+	header->freeBytes += (uint16_t)entrySize;
+
+	// empty node drops its prefix
+	if (header->keysCount == 0) {
+		header->prefixLength = 0;
+		header->dataStart = (uint16_t)PAGE_SIZE;
+		header->freeBytes = (uint16_t)BTREE_NODE_CAPACITY;
+	}
+}
+
+
+
+/*
+* @brief Copies node entries
+* @param[out] entries - entries in keys order
+*/
+void BTreeNode::getEntries(std::vector<BTreeEntry>& entries) const {
+	uint32_t count = getKeysCount();
+	entries.reserve(entries.size() + count);
+	for (uint32_t i = 0; i < count; i++) {
+		BTreeEntry entry{ {}, getValue(i) };
+		getKey(i, entry.key);
+		entries.push_back(std::move(entry));
+	}
+}
+
+
+
+/*
+* @brief Replaces node entries with range of entries, keeps node type and links.
+* Node prefix becomes common prefix of the range keys.
+* @param[in] entries - entries in keys order (must fit the node, see getFillSize)
+* @param[in] from - first entry
+* @param[in] to - entry after the last one
+*/
+void BTreeNode::fill(const std::vector<BTreeEntry>& entries, size_t from, size_t to) {
+
+	uint32_t prefixLength = 0;
+	if (from < to) {
+		const std::vector<uint8_t>& first = entries[from].key;
+		const std::vector<uint8_t>& last = entries[to - 1].key;
+		prefixLength = getCommonPrefix(first.data(), first.size(), last.data(), last.size());
+	}
+
+	BTreeNodeHeader* header = getHeader();
+	uint32_t prefixArea = getPrefixArea(prefixLength);
+	header->keysCount = 0;
+	header->prefixLength = (uint16_t)prefixLength;
+	header->dataStart = (uint16_t)PAGE_SIZE;
+	header->freeBytes = (uint16_t)(BTREE_NODE_CAPACITY - prefixArea);
+	memset(page + BTREE_NODE_HEADER_SIZE, 0, prefixArea);
+	if (prefixLength > 0) memcpy(page + BTREE_NODE_HEADER_SIZE, entries[from].key.data(), prefixLength);
+
+	for (size_t i = from; i < to; i++) {
+		const BTreeEntry& entry = entries[i];
+		putEntry(header->keysCount, entry.key.data(), (uint16_t)entry.key.size(), entry.value);
+	}
+}
+
+
+
+/*
+* @brief Moves entries to page end closing gaps between them
+*/
+void BTreeNode::compact() {
+
+	BTreeNodeHeader* header = getHeader();
+	BTreeNodeSlot* slots = getSlots();
+	uint8_t buffer[PAGE_SIZE];
+
+	uint32_t position = PAGE_SIZE;
+	for (uint32_t i = 0; i < header->keysCount; i++) {
+		uint32_t payloadSize = getTailLength(slots[i].length) + sizeof(uint64_t);
+		position -= payloadSize;
+		memcpy(buffer + position, page + slots[i].offset, payloadSize);
+		slots[i].offset = (uint16_t)position;
+	}
+	memcpy(page + position, buffer + position, PAGE_SIZE - position);
+	header->dataStart = (uint16_t)position;
+}
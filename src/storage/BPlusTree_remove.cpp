@@ -0,0 +1,199 @@
+#include "BPlusTree.h"
+
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// BPlusTree deletion: key is removed from its leaf. Node used less than
+// BTREE_MIN_FILL bytes merges with sibling if both fit one node, otherwise
+// borrows entries from sibling (entries are redistributed in halves and
+// separator in parent changes). Merge removes separator from parent, so
+// underflow may propagate to root, root with single child is dropped.
+// Rebalance latches only parent, node, sibling (and next leaf to link it),
+// each level is rebalanced by separate step after new descent.
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Removes key from its leaf and rebalances underflown nodes
+* @return true if removed, false if key doesn't exist or fails
+*/
+bool BPlusTree::removeEntry(const uint8_t* key, uint16_t length) {
+
+	uint8_t buffers[PAGE_SIZE * 2];
+	uint8_t *node, *parent;
+	BTreePath path;
+	BTreeLatchSet locked{};
+	bool removed = false;
+	bool underflow = false;
+
+	while (!removed) {
+		BTreeStatus status = descend(key, length, 0, path, buffers, node, parent);
+		if (status == BTreeStatus::FAILED) return false;
+		if (status == BTreeStatus::SUCCESS) {
+			BTreeNode leaf(node);
+			uint32_t index = leaf.lowerBound(key, length);
+			if (index >= leaf.getKeysCount() || leaf.compareKey(index, key, length) != 0) return false;
+
+			BTreePathStep& leafStep = path.steps[path.size - 1];
+			if (upgradeLatch(locked, leafStep.pageNo, leafStep.version)) {
+				leaf.removeAt(index);
+				bool written = writeNode(leafStep.pageNo, node);
+				releaseLatches(locked);
+				if (!written) return false;
+				keysCount.fetch_sub(1);
+				removed = true;
+				// root leaf may be empty
+				underflow = path.size > 2 && leaf.getFillBytes() < BTREE_MIN_FILL;
+				continue;
+			}
+		}
+		std::this_thread::yield();
+	}
+
+	// key is removed, failed rebalance leaves underflown node valid
+	uint32_t level = 0;
+	while (underflow) {
+		BTreeStatus status = rebalance(key, length, level);
+		if (status != BTreeStatus::RESTART) break;
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+
+
+/*
+* @brief Merges underflown node of given level containing the key with sibling
+* or borrows entries from it
+* @param[in,out] level - node level (0 - leaf), raised if parent underflows
+* @return SUCCESS if rebalanced or node is not underflown, RESTART if tree changed
+* or parent must be rebalanced at raised level, FAILED if fails
+*/
+BTreeStatus BPlusTree::rebalance(const uint8_t* key, uint16_t length, uint32_t& level) {
+
+	uint8_t buffers[PAGE_SIZE * 2], siblingBuffer[PAGE_SIZE];
+	uint8_t *node, *parentBuffer;
+	BTreePath path;
+	BTreeLatchSet locked{};
+
+	BTreeStatus status = descend(key, length, level, path, buffers, node, parentBuffer);
+	if (status != BTreeStatus::SUCCESS) return status;
+
+	// root has no siblings, node could be rebalanced by other writer
+	if (path.size < 3 || path.height - (path.size - 1) != level) return BTreeStatus::SUCCESS;
+	BTreeNode parent(parentBuffer);
+	if (BTreeNode(node).getFillBytes() >= BTREE_MIN_FILL || parent.getKeysCount() == 0) return BTreeStatus::SUCCESS;
+
+	// left sibling if any, otherwise right one
+	BTreePathStep& headerStep = path.steps[0];
+	BTreePathStep& parentStep = path.steps[path.size - 2];
+	BTreePathStep& nodeStep = path.steps[path.size - 1];
+	bool parentIsRoot = (path.size == 3);
+	uint32_t separator = (parentStep.childIndex > 0) ? parentStep.childIndex - 1 : 0;
+	uint64_t leftPage = parent.getChild(separator);
+	uint64_t rightPage = parent.getChild(separator + 1);
+	uint64_t siblingPage = (nodeStep.pageNo == leftPage) ? rightPage : leftPage;
+	if (siblingPage == 0 || siblingPage >= pagesCount.load()) return BTreeStatus::FAILED;
+
+	// root with the last separator is dropped on merge, so header is latched
+	bool latched = (!parentIsRoot || parent.getKeysCount() > 1 || upgradeLatch(locked, headerStep.pageNo, headerStep.version)) &&
+		upgradeLatch(locked, parentStep.pageNo, parentStep.version) &&
+		upgradeLatch(locked, nodeStep.pageNo, nodeStep.version) &&
+		tryLatch(locked, siblingPage);
+	if (!latched || !readNode(siblingPage, siblingBuffer)) {
+		releaseLatches(locked);
+		return latched ? BTreeStatus::FAILED : BTreeStatus::RESTART;
+	}
+
+	uint8_t* leftBuffer = (nodeStep.pageNo == leftPage) ? node : siblingBuffer;
+	uint8_t* rightBuffer = (nodeStep.pageNo == leftPage) ? siblingBuffer : node;
+	BTreeNode left(leftBuffer), right(rightBuffer);
+	bool isLeaf = left.isLeaf();
+
+	// inner nodes pull separator down between their entries
+	std::vector<BTreeEntry> entries;
+	left.getEntries(entries);
+	if (!isLeaf) {
+		entries.push_back(BTreeEntry{ {}, right.getHeader()->firstChild });
+		parent.getKey(separator, entries.back().key);
+	}
+	right.getEntries(entries);
+
+	if (BTreeNode::getFillSize(entries, 0, entries.size()) <= BTREE_NODE_CAPACITY) {
+
+		// merge right node into left one, next leaf links to left one
+		left.fill(entries, 0, entries.size());
+		uint64_t nextPage = isLeaf ? right.getHeader()->nextPage : 0;
+		if (isLeaf) left.getHeader()->nextPage = nextPage;
+		if (nextPage != 0) {
+			uint8_t nextBuffer[PAGE_SIZE];
+			if (!tryLatch(locked, nextPage)) {
+				releaseLatches(locked);
+				return BTreeStatus::RESTART;
+			}
+			bool linked = readNode(nextPage, nextBuffer);
+			((BTreeNodeHeader*)nextBuffer)->prevPage = leftPage;
+			if (!linked || !writeNode(nextPage, nextBuffer)) {
+				releaseLatches(locked);
+				return BTreeStatus::FAILED;
+			}
+		}
+		if (!writeNode(leftPage, leftBuffer) || !freePage(rightPage)) {
+			releaseLatches(locked);
+			return BTreeStatus::FAILED;
+		}
+		parent.removeAt(separator);
+
+		// root without keys gives its place to the only child
+		if (parentIsRoot && parent.getKeysCount() == 0) {
+			rootPage.store(leftPage);
+			height.fetch_sub(1);
+			status = freePage(parentStep.pageNo) ? BTreeStatus::SUCCESS : BTreeStatus::FAILED;
+			releaseLatches(locked);
+			return status;
+		}
+		status = writeNode(parentStep.pageNo, parentBuffer) ? BTreeStatus::SUCCESS : BTreeStatus::FAILED;
+		releaseLatches(locked);
+		if (status == BTreeStatus::SUCCESS && !parentIsRoot && parent.getFillBytes() < BTREE_MIN_FILL) {
+			level++;
+			return BTreeStatus::RESTART;
+		}
+		return status;
+	}
+
+	// borrow: redistribute entries in halves, separator changes
+	size_t split = getSplitIndex(entries, isLeaf);
+	std::vector<uint8_t> newKey;
+	if (isLeaf) getSeparator(entries[split - 1].key, entries[split].key, newKey);
+	else newKey = entries[split].key;
+
+	// longer separator may not fit parent (parent copy is discarded on restart),
+	// so parent is split first
+	uint32_t freeBytes = parent.getHeader()->freeBytes;
+	parent.removeAt(separator);
+	if (!parent.insertAt(separator, newKey.data(), (uint16_t)newKey.size(), rightPage)) {
+		releaseLatches(locked);
+		uint32_t neededBytes = parent.getInsertSize(newKey.data(), (uint16_t)newKey.size()) - (parent.getHeader()->freeBytes - freeBytes);
+		status = splitInner(key, length, level + 1, neededBytes);
+		return (status == BTreeStatus::FAILED) ? status : BTreeStatus::RESTART;
+	}
+
+	left.fill(entries, 0, split);
+	if (isLeaf) right.fill(entries, split, entries.size());
+	else {
+		right.getHeader()->firstChild = entries[split].value;
+		right.fill(entries, split + 1, entries.size());
+	}
+	status = (writeNode(leftPage, leftBuffer) && writeNode(rightPage, rightBuffer) &&
+		writeNode(parentStep.pageNo, parentBuffer)) ? BTreeStatus::SUCCESS : BTreeStatus::FAILED;
+	releaseLatches(locked);
+
+	// shorter separator may underflow parent
+	if (status == BTreeStatus::SUCCESS && !parentIsRoot && parent.getFillBytes() < BTREE_MIN_FILL) {
+		level++;
+		return BTreeStatus::RESTART;
+	}
+	return status;
+}
@@ -0,0 +1,145 @@
+#include "BPlusTree.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <bit>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// BTreeNode slot heads search: heads are non-decreasing in slots order, so
+// first slot with head not lower than given one is found by branchless binary
+// search narrowing range down to a window, then heads lower than given one
+// are counted in the window. Vectorized versions compare block of 8 slots
+// heads at once: 2 (SSE2) or 4 (AVX2) slots per compare, heads are unsigned,
+// so they are compared as signed after flipping the sign bit. Implementation
+// is chosen once by runtime CPU dispatch.
+//-----------------------------------------------------------------------------
+
+constexpr uint32_t HEADS_SIGN_BIT = 0x80000000;
+constexpr uint32_t HEADS_BLOCK = 8;
+
+
+/*
+* @brief Narrows range of slots down to window containing first slot with head
+* not lower than given one: all slots before window have lower heads, slot right
+* after window (if any) has not lower head.
+* @param[in,out] length - slots count, then window length
+* @return window start
+*/
+static inline uint32_t narrowHeads(const BTreeNodeSlot* slots, uint32_t& length, uint32_t head, uint32_t window) {
+	uint32_t base = 0;
+	while (length > window) {
+		uint32_t half = length / 2;
+		base = (slots[base + half].head < head) ? base + half : base;
+		length -= half;
+	}
+	return base;
+}
+
+
+
+/*
+* @brief Returns start of block of HEADS_BLOCK slots covering window: block
+* is moved back to stay within slots, slots added before window have lower heads
+* and slots after window have not lower heads, so block counts them correctly
+*/
+static inline uint32_t getHeadsBlock(const BTreeNodeSlot* slots, uint32_t count, uint32_t head) {
+	uint32_t length = count;
+	uint32_t base = narrowHeads(slots, length, head, HEADS_BLOCK);
+	return std::min(base, count - HEADS_BLOCK);
+}
+
+
+
+/*
+* @brief Finds first slot with head not lower than given head (scalar)
+* @param[in] slots - slots array sorted by head
+* @param[in] count - slots count
+* @return slot index (count if all heads are lower)
+*/
+uint32_t BTreeNode::searchHeadsScalar(const BTreeNodeSlot* slots, uint32_t count, uint32_t head) {
+	uint32_t length = count;
+	uint32_t base = narrowHeads(slots, length, head, 1);
+	return base + ((length > 0 && slots[base].head < head) ? 1 : 0);
+}
+
+
+#ifdef CPU_X86
+
+/*
+* @brief Finds first slot with head not lower than given head, block heads are
+* compared by SSE2 (x86-64 baseline): 2 slots per 16 bytes, heads in even lanes
+*/
+static uint32_t searchHeadsSSE2(const BTreeNodeSlot* slots, uint32_t count, uint32_t head) {
+	if (count < HEADS_BLOCK) return BTreeNode::searchHeadsScalar(slots, count, head);
+	uint32_t start = getHeadsBlock(slots, count, head);
+	const __m128i signBit = _mm_set1_epi32((int)HEADS_SIGN_BIT);
+	const __m128i key = _mm_set1_epi32((int)(head ^ HEADS_SIGN_BIT));
+	uint32_t mask = 0;
+	for (uint32_t i = 0; i < HEADS_BLOCK; i += 2) {
+		__m128i heads = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(slots + start + i)), signBit);
+		mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(key, heads))) << (i * 2);
+	}
+	return start + std::popcount(mask & 0x5555);
+}
+
+
+/*
+* @brief Finds first slot with head not lower than given head, block heads are
+* compared by AVX2: 4 slots per 32 bytes, heads in even lanes
+*/
+TARGET_AVX2 static uint32_t searchHeadsAVX2(const BTreeNodeSlot* slots, uint32_t count, uint32_t head) {
+	if (count < HEADS_BLOCK) return BTreeNode::searchHeadsScalar(slots, count, head);
+	uint32_t start = getHeadsBlock(slots, count, head);
+	const __m256i signBit = _mm256_set1_epi32((int)HEADS_SIGN_BIT);
+	const __m256i key = _mm256_set1_epi32((int)(head ^ HEADS_SIGN_BIT));
+	__m256i low = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(slots + start)), signBit);
+	__m256i high = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(slots + start + 4)), signBit);
+	uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(key, low))) |
+		((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(key, high))) << 8);
+	return start + std::popcount(mask & 0x5555);
+}
+
+#endif
+
+
+/*
+* @brief Selects fastest slot heads search supported by CPU
+* @return search function
+*/
+static BTreeHeadSearch getHeadSearch() {
+#ifdef CPU_X86
+	if (CpuFeatures::get().avx2) return searchHeadsAVX2;
+	return searchHeadsSSE2;
+#else
+	return BTreeNode::searchHeadsScalar;
+#endif
+}
+
+
+
+/*
+* @brief Finds first slot with head not lower than given head
+* @param[in] slots - slots array sorted by head
+* @param[in] count - slots count
+* @return slot index (count if all heads are lower)
+*/
+uint32_t BTreeNode::searchHeads(const BTreeNodeSlot* slots, uint32_t count, uint32_t head) {
+	static const BTreeHeadSearch implementation = getHeadSearch();
+	return implementation(slots, count, head);
+}
+
+
+
+/*
+* @brief Returns name of slot heads search implementation selected for CPU
+* @return implementation name
+*/
+const char* BTreeNode::getSearchImplementation() {
+#ifdef CPU_X86
+	return CpuFeatures::get().avx2 ? "AVX2" : "SSE2";
+#else
+	return "scalar";
+#endif
+}
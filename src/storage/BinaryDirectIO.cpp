@@ -85,9 +85,9 @@ size_t BinaryDirectIO::readPage(size_t pageNo, CachePageData* pageBuffer) {
     return bytesRead;
 
 # else
+    // positional read: concurrent readers and writers share file offset
     off_t offset = static_cast<off_t>(pageNo * PAGE_SIZE);
-    if (lseek(fileDescriptor, offset, SEEK_SET) == -1) return 0;    
-    ssize_t bytesRead = ::read(fileDescriptor, pageBuffer, PAGE_SIZE);
+    ssize_t bytesRead = ::pread(fileDescriptor, pageBuffer, PAGE_SIZE, offset);
     if (bytesRead != static_cast<ssize_t>(PAGE_SIZE)) return 0;
 # endif
     return bytesRead;
@@ -121,9 +121,9 @@ size_t BinaryDirectIO::writePage(size_t pageNo, const CachePageData* pageBuffer)
     return bytesWritten;
 
 # else
+    // positional write: concurrent readers and writers share file offset
     off_t offset = static_cast<off_t>(pageNo * PAGE_SIZE);
-    if (lseek(fileDescriptor, offset, SEEK_SET) == -1) return 0;
-    ssize_t bytesWritten = ::write(fileDescriptor, pageBuffer, PAGE_SIZE);
+    ssize_t bytesWritten = ::pwrite(fileDescriptor, pageBuffer, PAGE_SIZE, offset);
     if (bytesWritten != static_cast<ssize_t>(PAGE_SIZE)) return 0;
 # endif
     return bytesWritten;
@@ -151,6 +151,27 @@ size_t BinaryDirectIO::size() {
 
 
 
+/**
+*  @brief Truncates or extends file to the given size
+*  @param[in] fileSize - new file size in bytes
+*  @return true if success, false if fails
+*/
+bool BinaryDirectIO::truncate(size_t fileSize) {
+    if (!writeMode || !isOpen()) return false;
+
+    std::unique_lock lock(fileMutex);
+
+# ifdef _WIN32
+    FILE_END_OF_FILE_INFO endOfFile;
+    endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(fileSize);
+    return SetFileInformationByHandle(fileHandle, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile)) != 0;
+# else
+    return ftruncate(fileDescriptor, static_cast<off_t>(fileSize)) == 0;
+# endif
+}
+
+
+
 /**
 *  @brief Flush file buffers to storage device
 *  @return true if success, false if fails
@@ -162,6 +162,12 @@ size_t CachedFileIO::read(size_t position, void* dataBuffer, size_t length) {
 		{
 			std::shared_lock readLock(pageInfo->pageMutex);
 
+			// page could be evicted before lock, then look it up again
+			if (pageInfo->filePageNo != filePage) {
+				filePage--;
+				continue;
+			}
+
 			// Get cached page description and data
 			pageDataLength = pageInfo->availableDataLength;
 
@@ -240,9 +246,15 @@ size_t CachedFileIO::write(size_t position, const void* dataBuffer, size_t lengt
 		// Fetch-before-write (FBW)
 		pageInfo = searchPageInCache(filePage);
 		
-		// Lock for concurrent reading
+		// Lock for write
 		{ 
-			std::shared_lock pageReadLock(pageInfo->pageMutex);
+			std::unique_lock pageWriteLock(pageInfo->pageMutex);
+
+			// page could be evicted before lock, then look it up again
+			if (pageInfo->filePageNo != filePage) {
+				filePage--;
+				continue;
+			}
 
 			// Get cached page description and data
 			pageDataLength = pageInfo->availableDataLength;
@@ -266,12 +278,8 @@ size_t CachedFileIO::write(size_t position, const void* dataBuffer, size_t lengt
 				dst = pageInfo->data;
 				bytesToCopy = PAGE_SIZE;
 			}
-		}
 
-		// Copy available data from user's data buffer to cache page 
-		{
-			// Lock for write
-			std::unique_lock pageWriteLock(pageInfo->pageMutex);
+			// Copy available data from user's data buffer to cache page 
 			memcpy(dst, src, bytesToCopy);       // copy user buffer data to cache page
 			pageInfo->state = PageState::DIRTY;  // mark page as "dirty" (rewritten)
 			pageInfo->availableDataLength = std::max(pageDataLength, offset + bytesToCopy);
@@ -297,17 +305,21 @@ size_t CachedFileIO::write(size_t position, const void* dataBuffer, size_t lengt
 */
 size_t CachedFileIO::readPage(size_t pageNo, void* pageBuffer) {
 
-	// Lookup or load file page to cache
-	CachePage* pageInfo = searchPageInCache(pageNo);
 	size_t availableData;
 
-	// Copy available data from cache page to user's data buffer	
-	{
+	while (true) {
+		// Lookup or load file page to cache
+		CachePage* pageInfo = searchPageInCache(pageNo);
+
+		// Copy available data from cache page to user's data buffer	
 		std::shared_lock pageReadLock(pageInfo->pageMutex);
+		// page could be evicted before lock, then look it up again
+		if (pageInfo->filePageNo != pageNo) continue;
 		uint8_t* src = pageInfo->data;
 		uint8_t* dst = (uint8_t*) pageBuffer;
 		availableData = pageInfo->availableDataLength;
 		memcpy(dst, src, availableData);
+		break;
 	}
 
 	// Atomic increment bytes read
@@ -326,20 +338,22 @@ size_t CachedFileIO::readPage(size_t pageNo, void* pageBuffer) {
 */
 size_t CachedFileIO::writePage(size_t pageNo, const void* pageBuffer) {
 	
-	// Fetch-before-write (FBW)
-	CachePage* pageInfo = searchPageInCache(pageNo);
-
 	// Initialize local variables
 	uint8_t* src = (uint8_t*)pageBuffer;
-	uint8_t* dst = pageInfo->data;
 	size_t bytesToCopy = PAGE_SIZE;
 
-	// Lock page to write
-	{
+	while (true) {
+		// Fetch-before-write (FBW)
+		CachePage* pageInfo = searchPageInCache(pageNo);
+
+		// Lock page to write
 		std::unique_lock pageWriteLock(pageInfo->pageMutex);
-		memcpy(dst, src, bytesToCopy);               // copy user buffer data to cache page
+		// page could be evicted before lock, then look it up again
+		if (pageInfo->filePageNo != pageNo) continue;
+		memcpy(pageInfo->data, src, bytesToCopy);    // copy user buffer data to cache page
 		pageInfo->state = PageState::DIRTY;          // mark page as "dirty" (rewritten)
 		pageInfo->availableDataLength = bytesToCopy; // set available data as PAGE_SIZE
+		break;
 	}
 
 	// Atomic increment bytes written
@@ -349,6 +363,50 @@ size_t CachedFileIO::writePage(size_t pageNo, const void* pageBuffer) {
 
 
 
+/**
+*  @brief Truncates file to the given size and drops cached pages beyond it
+*  @param[in] fileSize - new file size in bytes
+*  @return true if file truncated, false otherwise
+*/
+bool CachedFileIO::truncate(size_t fileSize) {
+
+	if (!isOpen() || this->readOnly.load()) return false;
+
+	// Persist all changed pages before file size change
+	if (!flush()) return false;
+
+	size_t lastPageNo = fileSize / PAGE_SIZE;
+	size_t lastPageLength = fileSize % PAGE_SIZE;
+
+	{
+		std::lock_guard cacheLock(cacheMutex);
+		std::vector<CachePage*> droppedPages;
+		for (CachePage* page : cacheList) {
+			std::unique_lock pageLock(page->pageMutex);
+			if (page->filePageNo > lastPageNo || (page->filePageNo == lastPageNo && lastPageLength == 0)) {
+				// page is beyond end of file: drop it
+				cacheMap.erase(page->filePageNo);
+				page->filePageNo = NOT_FOUND;
+				page->state = PageState::CLEAN;
+				page->availableDataLength = 0;
+				droppedPages.push_back(page);
+			} else if (page->filePageNo == lastPageNo && page->availableDataLength > lastPageLength) {
+				// page is partially beyond end of file: clear its tail
+				memset(&page->data[lastPageLength], 0, PAGE_SIZE - lastPageLength);
+				page->availableDataLength = lastPageLength;
+			}
+		}
+		// move dropped pages to the list back, so they are reused first
+		for (CachePage* page : droppedPages) {
+			cacheList.splice(cacheList.end(), cacheList, page->it);
+		}
+	}
+
+	return file.truncate(fileSize);
+}
+
+
+
 /**
 *  @brief Persists all changed cache pages to storage device
 *  @return true if all changed cache pages been persisted, false otherwise
@@ -527,10 +585,11 @@ void CachedFileIO::releasePool() {
 */
 CachePage* CachedFileIO::allocatePage() {
 
-	if (pageCounter.load() >= maxPagesCount) return nullptr;
-	
-	// Increment page counter (atomic)
-	uint64_t pageNo = pageCounter.fetch_add(1);
+	// Increment page counter if pool is not exhausted (atomic)
+	uint64_t pageNo = pageCounter.load();
+	do {
+		if (pageNo >= maxPagesCount) return nullptr;
+	} while (!pageCounter.compare_exchange_weak(pageNo, pageNo + 1));
 	
 	// Allocate memory for cache page from pool
 	CachePage* newPage = &cachePageInfoPool[pageNo];
@@ -568,21 +627,22 @@ CachePage* CachedFileIO::getFreeCachePage() {
 			freePage = this->cacheList.back();
 			// remove page from list's back				
 			this->cacheList.pop_back();
-			// remove page from map
-			this->cacheMap.erase(freePage->filePageNo);
-			// Persist page to storage device			
-			if (!writePageToStorage(freePage)) {
-				throw std::runtime_error("Can't persist cache page to the storage device");
-			}			
-		}
-
-		// lock page to clear
-		{
+			// lock page to persist and clear, so no write gets between them
 			std::lock_guard pageLock(freePage->pageMutex);
+			// Persist page to storage device			
+			if (freePage->state == PageState::DIRTY) {
+				if (file.writePage(freePage->filePageNo, (CachePageData*)freePage->data) != PAGE_SIZE) {
+					throw std::runtime_error("Can't persist cache page to the storage device");
+				}
+				freePage->state = PageState::CLEAN;
+			}
+			// remove page from map after it is persisted, so page isn't
+			// loaded from storage before
+			this->cacheMap.erase(freePage->filePageNo);
 			// Clear cache page info fields
 			freePage->filePageNo = NOT_FOUND;
 			freePage->availableDataLength = 0;				
-		}				
+		}
 	}
 
 	// return page reference
@@ -641,8 +701,33 @@ CachePage* CachedFileIO::readPageToCache(size_t filePageNo) {
 	size_t bytesRead = 0;
 
 	{
-		// Lock cache page
-		std::unique_lock pageLock(cachePage->pageMutex);					
+		// Cache page is locked after cache list & map lock (same order as eviction)
+		std::unique_lock pageLock(cachePage->pageMutex, std::defer_lock);
+
+		// cache list & map lock
+		{
+			std::lock_guard cacheLock(cacheMutex);
+			// Other thread could load the same page first, then free
+			// page goes to the list back as the most aged page
+			auto result = cacheMap.find(filePageNo);
+			if (result != cacheMap.end()) {
+				cachePage->filePageNo = NOT_FOUND;
+				cachePage->availableDataLength = 0;
+				cacheList.push_back(cachePage);
+				cachePage->it = std::prev(cacheList.end());
+				return result->second;
+			}
+			// Insert cache page into the list and to the hashmap before
+			// fetch, so other threads wait for this page instead of
+			// loading its copy (page is locked until fetched)
+			pageLock.lock();
+			cachePage->filePageNo = filePageNo;
+			cachePage->state = PageState::CLEAN;
+			cacheList.push_front(cachePage);
+			cachePage->it = cacheList.begin();
+			cacheMap[filePageNo] = cachePage;
+		}
+
 		// Fetch page from storage device		
 		bytesRead = file.readPage(filePageNo, (CachePageData*) cachePage->data);
 		if (bytesRead < PAGE_SIZE) {
@@ -651,18 +736,7 @@ CachePage* CachedFileIO::readPageToCache(size_t filePageNo) {
 		}
 
 		// fill loaded page description info
-		cachePage->filePageNo = filePageNo;
-		cachePage->state = PageState::CLEAN;
 		cachePage->availableDataLength = bytesRead;
-			
-		// cache list & map lock
-		{
-			std::lock_guard cacheLock(cacheMutex);
-			// Insert cache page into the list and to the hashmap
-			cacheList.push_front(cachePage);
-			cachePage->it = cacheList.begin();
-			cacheMap[filePageNo] = cachePage;
-		}
 	}
 
 	return cachePage;
@@ -37,6 +37,7 @@
 #include <fstream>
 #include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 #ifdef _WIN32
 	#define NOMINMAX
@@ -106,6 +107,7 @@ namespace Cloudless {
 			size_t readPage(size_t pageNo, CachePageData* pageBuffer);
 			size_t writePage(size_t pageNo, const CachePageData* pageBuffer);
 			size_t size();
+			bool truncate(size_t fileSize);
 			bool flush();
 			bool isOpen();
 			bool close();			
@@ -136,6 +138,7 @@ namespace Cloudless {
 
 			size_t read(size_t position, void* dataBuffer, size_t length);
 			size_t write(size_t position, const void* dataBuffer, size_t length);
+			bool truncate(size_t fileSize);
 			bool flush();
 
 			void   resetStats();
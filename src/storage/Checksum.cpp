@@ -0,0 +1,267 @@
+/******************************************************************************
+*
+*  Checksum class implementation
+*
+*  Adler-32 defers modulo operations up to NMAX bytes (the largest n such
+*  that 255n(n+1)/2 + (n+1)(MOD-1) fits 32 bits), AVX2 version sums 32 bytes
+*  per step. CRC32C uses SSE4.2 CRC32 instruction if CPU supports it,
+*  otherwise slicing-by-8 lookup tables.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "Checksum.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Algorithm constants and lookup tables
+//-----------------------------------------------------------------------------
+
+constexpr uint32_t ADLER_MOD = 65521;        // Largest prime less than 2^16
+constexpr uint32_t ADLER_NMAX = 5552;        // Max bytes before modulo
+constexpr uint32_t ADLER_BLOCK = 32;         // Bytes per AVX2 step
+constexpr uint32_t CRC32C_POLY = 0x82F63B78; // Reflected Castagnoli polynomial
+
+typedef std::array<std::array<uint32_t, 256>, 8> CRC32CTable;
+
+/*
+*  @brief Generates slicing-by-8 CRC32C lookup tables at compile time
+*  @return CRC32C lookup tables
+*/
+static constexpr CRC32CTable makeCRC32CTable() {
+	CRC32CTable table{};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+		table[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int slice = 1; slice < 8; slice++) {
+			uint32_t previous = table[slice - 1][i];
+			table[slice][i] = (previous >> 8) ^ table[0][previous & 0xFF];
+		}
+	}
+	return table;
+}
+
+static constexpr CRC32CTable CRC32C_TABLE = makeCRC32CTable();
+
+
+//-----------------------------------------------------------------------------
+// SIMD implementations
+//-----------------------------------------------------------------------------
+
+#ifdef CPU_X86
+
+/*
+*  @brief Adler-32 vectorized with AVX2: every 32 bytes block adds bytes sum
+*  to "a" and weighted (32..1) bytes sum to "b", "b" also gets 32 * "a" of
+*  each block start, which is accumulated separately and added once per NMAX.
+*  @param[in] data - byte array of data to be checksummed
+*  @param[in] length - length of data in bytes
+*  @return 32-bit checksum of given data
+*/
+TARGET_AVX2 static uint32_t adler32AVX2(const uint8_t* data, uint64_t length) {
+
+	uint32_t a = 1, b = 0;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i weights = _mm256_setr_epi8(
+		32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+
+	while (length >= ADLER_BLOCK) {
+		uint64_t blocks = std::min<uint64_t>(length, ADLER_NMAX) / ADLER_BLOCK;
+		length -= blocks * ADLER_BLOCK;
+		b += a * ADLER_BLOCK * (uint32_t)blocks;
+
+		__m256i sumA = zero, sumB = zero, prefixA = zero;
+		for (uint64_t i = 0; i < blocks; i++) {
+			__m256i bytes = _mm256_loadu_si256((const __m256i*)data);
+			prefixA = _mm256_add_epi32(prefixA, sumA);
+			sumA = _mm256_add_epi32(sumA, _mm256_sad_epu8(bytes, zero));
+			__m256i weighted = _mm256_maddubs_epi16(bytes, weights);
+			sumB = _mm256_add_epi32(sumB, _mm256_madd_epi16(weighted, ones));
+			data += ADLER_BLOCK;
+		}
+		sumB = _mm256_add_epi32(sumB, _mm256_slli_epi32(prefixA, 5));
+
+		// horizontal sums in 64 bits, lanes could be close to 32 bit limit
+		alignas(32) uint32_t lanesA[8], lanesB[8];
+		_mm256_store_si256((__m256i*)lanesA, sumA);
+		_mm256_store_si256((__m256i*)lanesB, sumB);
+		uint64_t totalA = 0, totalB = 0;
+		for (int lane = 0; lane < 8; lane++) {
+			totalA += lanesA[lane];
+			totalB += lanesB[lane];
+		}
+		a = (uint32_t)((a + totalA) % ADLER_MOD);
+		b = (uint32_t)((b + totalB) % ADLER_MOD);
+	}
+
+	// tail bytes
+	while (length--) {
+		a += *data++;
+		b += a;
+	}
+	a %= ADLER_MOD;
+	b %= ADLER_MOD;
+
+	return (b << 16) | a;
+}
+
+
+/*
+*  @brief CRC32C with SSE4.2 CRC32 instruction (8 bytes per step)
+*  @param[in] data - byte array of data to be checksummed
+*  @param[in] length - length of data in bytes
+*  @return 32-bit checksum of given data
+*/
+TARGET_SSE42 static uint32_t crc32cSSE42(const uint8_t* data, uint64_t length) {
+
+	uint64_t crc = 0xFFFFFFFF;
+	while (length >= sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data, sizeof(uint64_t));
+		crc = _mm_crc32_u64(crc, word);
+		data += sizeof(uint64_t);
+		length -= sizeof(uint64_t);
+	}
+
+	uint32_t crc32 = (uint32_t)crc;
+	while (length--) crc32 = _mm_crc32_u8(crc32, *data++);
+
+	return ~crc32;
+}
+
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Checksum public methods
+//-----------------------------------------------------------------------------
+
+
+/**
+*  @brief Adler-32 checksum with deferred modulo (portable implementation)
+*  @param[in] data - byte array of data to be checksummed
+*  @param[in] length - length of data in bytes
+*  @return 32-bit checksum of given data
+*/
+uint32_t Checksum::adler32Scalar(const uint8_t* data, uint64_t length) {
+	uint32_t a = 1, b = 0;
+	while (length > 0) {
+		uint64_t chunk = std::min<uint64_t>(length, ADLER_NMAX);
+		length -= chunk;
+		while (chunk--) {
+			a += *data++;
+			b += a;
+		}
+		a %= ADLER_MOD;
+		b %= ADLER_MOD;
+	}
+	return (b << 16) | a;
+}
+
+
+
+/**
+*  @brief CRC32C checksum with slicing-by-8 tables (portable implementation)
+*  @param[in] data - byte array of data to be checksummed
+*  @param[in] length - length of data in bytes
+*  @return 32-bit checksum of given data
+*/
+uint32_t Checksum::crc32cScalar(const uint8_t* data, uint64_t length) {
+
+	const CRC32CTable& t = CRC32C_TABLE;
+	uint32_t crc = 0xFFFFFFFF;
+
+	while (length >= sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data, sizeof(uint64_t));
+		word ^= crc;
+		crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^
+		      t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF] ^
+		      t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^
+		      t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+		data += sizeof(uint64_t);
+		length -= sizeof(uint64_t);
+	}
+
+	while (length--) crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+
+
+/**
+*  @brief Adler-32 checksum using fastest implementation supported by CPU
+*  @param[in] data - byte array of data to be checksummed
+*  @param[in] length - length of data in bytes
+*  @return 32-bit checksum of given data
+*/
+uint32_t Checksum::adler32(const uint8_t* data, uint64_t length) {
+	static const ChecksumFunction implementation = getFunction(ChecksumType::ADLER32);
+	return implementation(data, length);
+}
+
+
+
+/**
+*  @brief CRC32C checksum using fastest implementation supported by CPU
+*  @param[in] data - byte array of data to be checksummed
+*  @param[in] length - length of data in bytes
+*  @return 32-bit checksum of given data
+*/
+uint32_t Checksum::crc32c(const uint8_t* data, uint64_t length) {
+	static const ChecksumFunction implementation = getFunction(ChecksumType::CRC32C);
+	return implementation(data, length);
+}
+
+
+
+/**
+*  @brief Selects fastest implementation of checksum algorithm supported by CPU
+*  @param[in] type - checksum algorithm
+*  @return checksum function or nullptr if algorithm is unknown
+*/
+ChecksumFunction Checksum::getFunction(ChecksumType type) {
+	[[maybe_unused]] const CpuFeatures& features = CpuFeatures::get();
+	switch (type) {
+	case ChecksumType::ADLER32:
+#ifdef CPU_X86
+		if (features.avx2) return adler32AVX2;
+#endif
+		return adler32Scalar;
+	case ChecksumType::CRC32C:
+#ifdef CPU_X86
+		if (features.sse42) return crc32cSSE42;
+#endif
+		return crc32cScalar;
+	}
+	return nullptr;
+}
+
+
+
+/**
+*  @brief Returns name of checksum algorithm implementation selected for CPU
+*  @param[in] type - checksum algorithm
+*  @return implementation name
+*/
+const char* Checksum::getImplementation(ChecksumType type) {
+	const CpuFeatures& features = CpuFeatures::get();
+	switch (type) {
+	case ChecksumType::ADLER32: return features.avx2 ? "Adler-32 AVX2" : "Adler-32 scalar";
+	case ChecksumType::CRC32C: return features.sse42 ? "CRC32C SSE4.2" : "CRC32C slicing-by-8";
+	}
+	return "unknown";
+}
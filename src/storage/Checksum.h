@@ -0,0 +1,52 @@
+/******************************************************************************
+*
+*  Checksum class header
+*
+*  Checksum provides data consistency check algorithms used by storage:
+*    - Adler-32 with deferred modulo (scalar and AVX2 vectorized)
+*    - CRC32C (slicing-by-8 table and SSE4.2 hardware instruction)
+*
+*  Implementation is chosen once by runtime CPU dispatch, all implementations
+*  of the same algorithm give the same result, so algorithm (not its
+*  implementation) is stored in the storage file header.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Checksum algorithm types (persisted in storage header)
+		//----------------------------------------------------------------------------
+		enum class ChecksumType : uint32_t {
+			ADLER32 = 1,                       // Adler-32 (RFC 1950)
+			CRC32C = 2                         // CRC-32 Castagnoli polynomial
+		};
+
+		typedef uint32_t (*ChecksumFunction)(const uint8_t* data, uint64_t length);
+
+		//----------------------------------------------------------------------------
+		// Checksum algorithms with runtime CPU dispatch
+		//----------------------------------------------------------------------------
+		class Checksum {
+		public:
+			static uint32_t adler32(const uint8_t* data, uint64_t length);
+			static uint32_t crc32c(const uint8_t* data, uint64_t length);
+
+			static ChecksumFunction getFunction(ChecksumType type);
+			static const char* getImplementation(ChecksumType type);
+
+			static uint32_t adler32Scalar(const uint8_t* data, uint64_t length);
+			static uint32_t crc32cScalar(const uint8_t* data, uint64_t length);
+		};
+
+	}
+
+}
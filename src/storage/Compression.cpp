@@ -0,0 +1,412 @@
+/******************************************************************************
+*
+*  Compression class implementation
+*
+*  Block is a sequence of (token, literals, match) where token keeps literals
+*  count in high 4 bits and match length minus MIN_MATCH in low 4 bits,
+*  value 15 continues with bytes of 255 until byte less than 255. Match is
+*  16-bit little endian offset back from the current output position. The
+*  last sequence has literals only. Compressor finds matches by 4 bytes hash
+*  table of the latest positions, skipping faster in incompressible data.
+*  With shared dictionary positions are counted from dictionary start, so
+*  match offset reaching before data start refers to dictionary end.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "Compression.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Codec constants
+//-----------------------------------------------------------------------------
+
+constexpr uint32_t MIN_MATCH = 4;             // Minimal match length
+constexpr uint32_t LAST_LITERALS = 5;         // Block always ends with literals
+constexpr uint32_t MATCH_SEARCH_LIMIT = 12;   // No match search close to block end
+constexpr uint32_t MAX_OFFSET = 65535;        // Max match distance (16 bits)
+constexpr uint32_t HASH_BITS = 12;            // Hash table of 4096 positions
+constexpr uint32_t SKIP_TRIGGER = 6;          // Step grows every 64 bytes without match
+constexpr uint32_t RUN_MASK = 15;             // Length continues in next bytes
+constexpr uint32_t HASH_TABLE_SIZE = 1 << HASH_BITS;
+
+constexpr uint32_t TRAIN_DMER = 8;            // Bytes sequence length counted by training
+constexpr uint32_t TRAIN_SEGMENT = 64;        // Dictionary segment length picked by training
+constexpr uint32_t TRAIN_HASH_BITS = 20;      // Sequences frequency table of 1M entries
+
+
+/*
+*  @brief Reads 4 bytes of data (unaligned)
+*/
+static inline uint32_t read32(const uint8_t* data) {
+	uint32_t value;
+	memcpy(&value, data, sizeof(uint32_t));
+	return value;
+}
+
+
+/*
+*  @brief Hashes 4 bytes sequence to hash table index
+*/
+static inline uint32_t hash32(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+/*
+*  @brief Writes length continuation bytes (255, 255, ..., rest)
+*  @return false if target capacity exceeded
+*/
+static inline bool writeLength(uint32_t length, uint8_t* target, uint32_t& position, uint32_t capacity) {
+	for (; length >= 255; length -= 255) {
+		if (position >= capacity) return false;
+		target[position++] = 255;
+	}
+	if (position >= capacity) return false;
+	target[position++] = (uint8_t)length;
+	return true;
+}
+
+
+/*
+*  @brief Reads length continuation bytes
+*  @return false if source ends before length
+*/
+static inline bool readLength(const uint8_t* source, uint32_t length, uint32_t& position, uint64_t& value) {
+	uint8_t byte;
+	do {
+		if (position >= length) return false;
+		byte = source[position++];
+		value += byte;
+	} while (byte == 255);
+	return true;
+}
+
+
+/*
+*  @brief Writes sequence of literals and match (match length 0 for the last literals)
+*  @return false if target capacity exceeded
+*/
+static bool writeSequence(const uint8_t* literals, uint32_t literalsCount, uint32_t offset, uint32_t matchLength,
+	uint8_t* target, uint32_t& position, uint32_t capacity) {
+
+	if (position >= capacity) return false;
+	uint32_t tokenPosition = position++;
+	uint8_t token = 0;
+
+	// literals count and literals
+	if (literalsCount >= RUN_MASK) {
+		token = (uint8_t)(RUN_MASK << 4);
+		if (!writeLength(literalsCount - RUN_MASK, target, position, capacity)) return false;
+	} else token = (uint8_t)(literalsCount << 4);
+	if ((uint64_t)position + literalsCount > capacity) return false;
+	if (literalsCount > 0) memcpy(target + position, literals, literalsCount);
+	position += literalsCount;
+
+	// offset and match length
+	if (matchLength > 0) {
+		if ((uint64_t)position + 2 > capacity) return false;
+		target[position++] = (uint8_t)(offset & 0xFF);
+		target[position++] = (uint8_t)(offset >> 8);
+		uint32_t length = matchLength - MIN_MATCH;
+		if (length >= RUN_MASK) {
+			token |= RUN_MASK;
+			if (!writeLength(length - RUN_MASK, target, position, capacity)) return false;
+		} else token |= (uint8_t)length;
+	}
+
+	target[tokenPosition] = token;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Compression public methods
+//-----------------------------------------------------------------------------
+
+
+/**
+*  @brief Worst case compressed length (incompressible data)
+*  @param[in] length - source data length
+*  @return max compressed length in bytes
+*/
+uint32_t Compression::getMaxCompressedLength(uint32_t length) {
+	return length + length / 255 + 16;
+}
+
+
+
+/**
+*  @brief Compresses data block
+*  @param[in] source - data to compress
+*  @param[in] length - source data length
+*  @param[out] target - compressed data buffer
+*  @param[in] capacity - target buffer capacity
+*  @param[in] dictionary - shared dictionary (nullptr if none)
+*  @return compressed length or zero if it doesn't fit target capacity
+*/
+uint32_t Compression::compress(const uint8_t* source, uint32_t length, uint8_t* target, uint32_t capacity,
+	const CompressionDictionary* dictionary) {
+
+	if (target == nullptr || (source == nullptr && length > 0)) return 0;
+
+	// hash table keeps positions counted from dictionary start (dictionary precedes data)
+	uint32_t hashTable[HASH_TABLE_SIZE];
+	const uint8_t* prefix = nullptr;
+	uint32_t base = 0;
+	if (dictionary != nullptr && dictionary->getSize() >= MIN_MATCH) {
+		prefix = dictionary->getData();
+		base = dictionary->getSize();
+		memcpy(hashTable, dictionary->getHashTable(), sizeof(hashTable));
+	} else memset(hashTable, 0, sizeof(hashTable));
+
+	uint32_t position = 0;
+	uint32_t anchor = 0;
+	uint32_t output = 0;
+
+	if (length > MATCH_SEARCH_LIMIT) {
+
+		uint32_t searchLimit = length - MATCH_SEARCH_LIMIT;
+		uint32_t matchLimit = length - LAST_LITERALS;
+		position = base > 0 ? 0 : 1;
+
+		while (position < searchLimit) {
+
+			uint32_t sequence = read32(source + position);
+			uint32_t hash = hash32(sequence);
+			uint32_t candidate = hashTable[hash];
+			uint32_t current = base + position;
+			hashTable[hash] = current;
+
+			// candidate is in dictionary or in data, match never crosses their boundary
+			bool inDictionary = candidate < base;
+			const uint8_t* windowStart = inDictionary ? prefix : source;
+			const uint8_t* windowEnd = inDictionary ? prefix + base : source + length;
+			const uint8_t* match = inDictionary ? prefix + candidate : source + (candidate - base);
+
+			// no match - step further, faster while there are no matches
+			if (current - candidate > MAX_OFFSET || read32(match) != sequence) {
+				position += 1 + ((position - anchor) >> SKIP_TRIGGER);
+				continue;
+			}
+
+			// extend match backward over pending literals and forward
+			uint32_t offset = current - candidate;
+			while (position > anchor && match > windowStart && source[position - 1] == match[-1]) {
+				position--;
+				match--;
+			}
+			uint32_t matchLength = MIN_MATCH;
+			uint32_t matchSpace = (uint32_t)std::min<size_t>(matchLimit - position, windowEnd - match);
+			while (matchLength < matchSpace && match[matchLength] == source[position + matchLength]) {
+				matchLength++;
+			}
+
+			if (!writeSequence(source + anchor, position - anchor, offset, matchLength, target, output, capacity)) return 0;
+
+			position += matchLength;
+			anchor = position;
+			if (position < searchLimit) hashTable[hash32(read32(source + position - 2))] = base + position - 2;
+		}
+	}
+
+	// the rest of data is literals
+	if (!writeSequence(source + anchor, length - anchor, 0, 0, target, output, capacity)) return 0;
+
+	return output;
+}
+
+
+
+/**
+*  @brief Decompresses data block checking all bounds
+*  @param[in] source - compressed data
+*  @param[in] length - compressed data length
+*  @param[out] target - buffer for decompressed data
+*  @param[in] targetLength - expected decompressed data length
+*  @param[in] dictionary - shared dictionary used to compress block (nullptr if none)
+*  @return true if decompressed exactly targetLength bytes, false if block is corrupt
+*/
+bool Compression::decompress(const uint8_t* source, uint32_t length, uint8_t* target, uint32_t targetLength,
+	const CompressionDictionary* dictionary) {
+
+	if (source == nullptr || (target == nullptr && targetLength > 0)) return false;
+
+	uint32_t dictionarySize = dictionary != nullptr ? dictionary->getSize() : 0;
+	uint32_t position = 0;
+	uint32_t output = 0;
+
+	while (position < length) {
+
+		uint8_t token = source[position++];
+
+		// copy literals
+		uint64_t literalsCount = token >> 4;
+		if (literalsCount == RUN_MASK && !readLength(source, length, position, literalsCount)) return false;
+		if (position + literalsCount > length || output + literalsCount > targetLength) return false;
+		if (literalsCount > 0) memcpy(target + output, source + position, (size_t)literalsCount);
+		position += (uint32_t)literalsCount;
+		output += (uint32_t)literalsCount;
+
+		// the last sequence has no match
+		if (position == length) break;
+
+		// copy match (it may overlap output being produced)
+		if (position + 2 > length) return false;
+		uint32_t offset = source[position] | (source[position + 1] << 8);
+		position += 2;
+		uint64_t matchLength = token & RUN_MASK;
+		if (matchLength == RUN_MASK && !readLength(source, length, position, matchLength)) return false;
+		matchLength += MIN_MATCH;
+		if (offset == 0 || offset > output + dictionarySize || output + matchLength > targetLength) return false;
+
+		// match starting before data continues from dictionary end to data start
+		if (offset > output) {
+			uint32_t back = offset - output;
+			uint64_t copied = std::min<uint64_t>(back, matchLength);
+			memcpy(target + output, dictionary->getData() + dictionarySize - back, (size_t)copied);
+			for (uint64_t i = copied; i < matchLength; i++) target[output + i] = target[i - back];
+			output += (uint32_t)matchLength;
+			continue;
+		}
+
+		uint8_t* match = target + output - offset;
+		if (offset >= matchLength) memcpy(target + output, match, (size_t)matchLength);
+		else for (uint64_t i = 0; i < matchLength; i++) target[output + i] = match[i];
+		output += (uint32_t)matchLength;
+	}
+
+	return output == targetLength;
+}
+
+
+
+/**
+*  @brief Trains shared dictionary on data samples. Corpus is divided into
+*  epochs, and each epoch gives segment of the most frequent byte sequences
+*  not covered yet. Sequence frequency is the number of samples containing it.
+*  @param[in] samples - data samples (typical records)
+*  @param[in] size - dictionary size
+*  @return dictionary, the most valuable segments are at the end (closest to data)
+*/
+std::vector<uint8_t> Compression::trainDictionary(const std::vector<std::vector<uint8_t>>& samples, uint32_t size) {
+
+	size = std::min(size, COMPRESSION_MAX_DICTIONARY);
+
+	// concatenate samples and hash byte sequences which don't cross samples boundaries
+	std::vector<uint8_t> corpus;
+	for (auto& sample : samples) corpus.insert(corpus.end(), sample.begin(), sample.end());
+	if (corpus.size() <= size) return corpus;
+
+	constexpr uint32_t NO_SEQUENCE = UINT32_MAX;
+	std::vector<uint32_t> sequences(corpus.size(), NO_SEQUENCE);
+	std::vector<uint32_t> frequency(1 << TRAIN_HASH_BITS, 0);
+	std::vector<uint32_t> lastSample(1 << TRAIN_HASH_BITS, NO_SEQUENCE);
+
+	size_t sampleStart = 0;
+	for (uint32_t s = 0; s < samples.size(); s++) {
+		size_t sampleEnd = sampleStart + samples[s].size();
+		for (size_t i = sampleStart; i + TRAIN_DMER <= sampleEnd; i++) {
+			uint64_t sequence;
+			memcpy(&sequence, corpus.data() + i, sizeof(uint64_t));
+			uint32_t hash = (uint32_t)((sequence * 0x9E3779B185EBCA87ULL) >> (64 - TRAIN_HASH_BITS));
+			sequences[i] = hash;
+			if (lastSample[hash] != s) {
+				lastSample[hash] = s;
+				frequency[hash]++;
+			}
+		}
+		sampleStart = sampleEnd;
+	}
+
+	// sequence met in a single sample is not worth to share
+	for (auto& count : frequency) if (count < 2) count = 0;
+
+	// pick best segment of each epoch, sequences of picked segment don't count anymore
+	struct Segment { uint64_t score; size_t start; };
+	std::vector<Segment> segments;
+	std::vector<uint16_t> inWindow(1 << TRAIN_HASH_BITS, 0);
+	size_t epochs = std::max<size_t>(1, size / TRAIN_SEGMENT);
+	size_t epochSize = std::max<size_t>(TRAIN_SEGMENT, corpus.size() / epochs);
+	constexpr uint32_t WINDOW = TRAIN_SEGMENT - TRAIN_DMER + 1;
+
+	for (size_t epochStart = 0; epochStart + TRAIN_SEGMENT <= corpus.size(); epochStart += epochSize) {
+
+		size_t epochEnd = std::min(corpus.size() - TRAIN_DMER + 1, epochStart + epochSize);
+		Segment best = { 0, 0 };
+		uint64_t score = 0;
+
+		// slide window of segment sequences counting each distinct sequence once
+		for (size_t i = epochStart; i < epochEnd; i++) {
+			uint32_t hash = sequences[i];
+			if (hash != NO_SEQUENCE && inWindow[hash]++ == 0) score += frequency[hash];
+			if (i >= epochStart + WINDOW) {
+				uint32_t removed = sequences[i - WINDOW];
+				if (removed != NO_SEQUENCE && --inWindow[removed] == 0) score -= frequency[removed];
+			}
+			if (score > best.score && i + 1 >= epochStart + WINDOW) best = { score, i + 1 - WINDOW };
+		}
+		for (size_t i = epochEnd > WINDOW && epochEnd - WINDOW > epochStart ? epochEnd - WINDOW : epochStart; i < epochEnd; i++) {
+			if (sequences[i] != NO_SEQUENCE) inWindow[sequences[i]] = 0;
+		}
+
+		if (best.score == 0) continue;
+		for (size_t i = best.start; i < best.start + WINDOW; i++) {
+			if (sequences[i] != NO_SEQUENCE) frequency[sequences[i]] = 0;
+		}
+		segments.push_back(best);
+	}
+
+	// the most valuable segments go to the end of dictionary, so they get shorter offsets
+	std::stable_sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.score < b.score; });
+	std::vector<uint8_t> dictionary;
+	for (auto& segment : segments) {
+		size_t segmentEnd = std::min(corpus.size(), segment.start + TRAIN_SEGMENT);
+		dictionary.insert(dictionary.end(), corpus.begin() + segment.start, corpus.begin() + segmentEnd);
+	}
+	if (dictionary.size() > size) dictionary.erase(dictionary.begin(), dictionary.end() - size);
+
+	return dictionary;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// CompressionDictionary methods
+//-----------------------------------------------------------------------------
+
+
+/**
+*  @brief Copies dictionary and prebuilds matches lookup table
+*  @param[in] data - dictionary content
+*  @param[in] size - dictionary size (last COMPRESSION_MAX_DICTIONARY bytes used)
+*/
+CompressionDictionary::CompressionDictionary(const uint8_t* data, uint32_t size) {
+	if (size > COMPRESSION_MAX_DICTIONARY) {
+		data += size - COMPRESSION_MAX_DICTIONARY;
+		size = COMPRESSION_MAX_DICTIONARY;
+	}
+	dictionary.assign(data, data + size);
+	hashTable.assign(HASH_TABLE_SIZE, 0);
+	for (uint32_t i = 0; i + MIN_MATCH <= size; i++) hashTable[hash32(read32(data + i))] = i;
+}
+
+
+const uint8_t* CompressionDictionary::getData() const {
+	return dictionary.data();
+}
+
+
+uint32_t CompressionDictionary::getSize() const {
+	return (uint32_t)dictionary.size();
+}
+
+
+const uint32_t* CompressionDictionary::getHashTable() const {
+	return hashTable.data();
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+*
+*  Compression class header
+*
+*  Compression provides built-in fast LZ77 class codec used by storage for
+*  transparent records compression. Compressed block is a sequence of
+*  literal runs followed by matches (16-bit offset) with no external
+*  dependencies, decompression checks all bounds, so corrupted block is
+*  rejected instead of read or written out of buffers.
+*
+*  Small documents have too little context to compress well on their own,
+*  so block may refer to shared dictionary, which virtually precedes data.
+*  Dictionary is trained on samples by picking segments of the most common
+*  byte sequences (COVER algorithm, one best segment per corpus epoch).
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Compression codec types (persisted in record header bit flags)
+		//----------------------------------------------------------------------------
+		enum class CompressionType : uint32_t {
+			NONE = 0,                          // Data stored as is
+			LZ = 1,                            // Built-in LZ77 codec
+			LZ_DICTIONARY = 2                  // Built-in LZ77 codec with shared dictionary
+		};
+
+		constexpr uint32_t COMPRESSION_MAX_DICTIONARY = 65535;   // Matches reach 64Kb back at most
+
+		//----------------------------------------------------------------------------
+		// Shared dictionary with prebuilt matches lookup table
+		//----------------------------------------------------------------------------
+		class CompressionDictionary {
+		public:
+			CompressionDictionary(const uint8_t* data, uint32_t size);
+
+			const uint8_t*  getData() const;
+			uint32_t        getSize() const;
+			const uint32_t* getHashTable() const;
+
+		private:
+			std::vector<uint8_t>  dictionary;
+			std::vector<uint32_t> hashTable;   // Latest dictionary position by 4 bytes hash
+		};
+
+		//----------------------------------------------------------------------------
+		// Built-in LZ codec
+		//----------------------------------------------------------------------------
+		class Compression {
+		public:
+			static uint32_t getMaxCompressedLength(uint32_t length);
+			static uint32_t compress(const uint8_t* source, uint32_t length, uint8_t* target, uint32_t capacity,
+			                         const CompressionDictionary* dictionary = nullptr);
+			static bool     decompress(const uint8_t* source, uint32_t length, uint8_t* target, uint32_t targetLength,
+			                           const CompressionDictionary* dictionary = nullptr);
+			static std::vector<uint8_t> trainDictionary(const std::vector<std::vector<uint8_t>>& samples, uint32_t size);
+		};
+
+	}
+
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+*
+*  CpuFeatures implementation
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "CpuFeatures.h"
+
+#include <cstdint>
+
+#ifdef CPU_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief Detects CPU instruction sets supported by CPU and OS
+*  @return supported instruction sets
+*/
+static CpuFeatures detectCpuFeatures() {
+	CpuFeatures features;
+#ifdef CPU_X86
+	uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+	uint32_t maxLeaf = 0;
+	#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 0);
+		maxLeaf = regs[0];
+		__cpuid(regs, 1);
+		ecx = regs[2];
+	#else
+		__get_cpuid(0, &maxLeaf, &ebx, &ecx, &edx);
+		__get_cpuid(1, &eax, &ebx, &ecx, &edx);
+	#endif
+	features.sse42 = (ecx >> 20) & 1;
+
+	// AVX2 requires OS to save YMM registers (OSXSAVE and XCR0 bits 1,2)
+	bool osxsave = (ecx >> 27) & 1;
+	if (!osxsave || maxLeaf < 7) return features;
+	#ifdef _MSC_VER
+		uint64_t xcr0 = _xgetbv(0);
+		__cpuidex(regs, 7, 0);
+		ebx = regs[1];
+	#else
+		uint32_t xcr0Low, xcr0High;
+		__asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+		uint64_t xcr0 = ((uint64_t)xcr0High << 32) | xcr0Low;
+		__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+	#endif
+	features.avx2 = ((xcr0 & 6) == 6) && ((ebx >> 5) & 1);
+#endif
+	return features;
+}
+
+
+/*
+*  @brief Returns CPU features detected once
+*  @return supported instruction sets
+*/
+const CpuFeatures& CpuFeatures::get() {
+	static const CpuFeatures features = detectCpuFeatures();
+	return features;
+}
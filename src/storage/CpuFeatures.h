@@ -0,0 +1,45 @@
+/******************************************************************************
+*
+*  CpuFeatures header
+*
+*  Runtime detection of instruction sets supported by CPU and OS, used by
+*  storage algorithms (checksums, B+ Tree node search) to choose vectorized
+*  implementation once. Vectorized functions are compiled with TARGET_*
+*  attributes, so the rest of code keeps baseline instruction set.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#pragma once
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define CPU_X86
+	#include <immintrin.h>
+#endif
+
+// GCC and Clang require target attribute to use instructions beyond baseline
+#if defined(__GNUC__) || defined(__clang__)
+	#define TARGET_AVX2  __attribute__((target("avx2")))
+	#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+	#define TARGET_AVX2
+	#define TARGET_SSE42
+#endif
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Instruction sets supported by CPU and OS (detected once)
+		//----------------------------------------------------------------------------
+		struct CpuFeatures {
+			bool sse42 = false;
+			bool avx2 = false;
+
+			static const CpuFeatures& get();
+		};
+
+	}
+}
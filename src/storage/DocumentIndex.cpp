@@ -0,0 +1,781 @@
+/******************************************************************************
+*
+*  DocumentIndex class implementation
+*
+*  DocumentIndex keeps B+ Tree of keys [ encoded value ] [ record ID ], so
+*  documents with equal values are neighbours ordered by record ID, and
+*  value lookup is a range scan from the first key with value prefix.
+*  Value encoding is prefix free, so keys of value "a" never mix with keys
+*  of value "ab", and keeps values order, so range lookup over values is
+*  a range scan over keys.
+*
+*  Covering index appends encoded values of projected fields to each key
+*  [ encoded value ] [ record ID ] [ field 1 ] ... [ field N ], so listing
+*  of documents fields reads only index leaves instead of records. Record ID
+*  before projection keeps keys unique, and a change of projected field is
+*  a change of key.
+*
+*  Index state key [ 0x00 ] sorts before keys of values, its value is
+*  DOCUMENT_INDEX_CHANGED from the first change after flush until the next
+*  flush, so index found changed on open was not flushed after its last
+*  change (process stopped) and is rebuilt from records. Flushed index
+*  keeps commit stamp of records it is in sync with, so index of records
+*  changed while it was not declared is rebuilt too.
+*
+*  JSON document is not parsed entirely: members are skipped until the next
+*  path member is found, only value at path is decoded. Strings are indexed
+*  with escapes decoded, numbers as 64-bit doubles.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "DocumentStore.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+using namespace Cloudless::Storage;
+
+
+//-----------------------------------------------------------------------------
+// JSON reading: pointer moves over document bytes, false if malformed
+//-----------------------------------------------------------------------------
+
+static void skipSpaces(const uint8_t*& p, const uint8_t* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+}
+
+
+
+static bool readHex(const uint8_t*& p, const uint8_t* end, uint32_t& code) {
+	if (end - p < 4) return false;
+	code = 0;
+	for (int i = 0; i < 4; i++) {
+		uint8_t c = *p++;
+		code <<= 4;
+		if (c >= '0' && c <= '9') code |= c - '0';
+		else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+		else return false;
+	}
+	return true;
+}
+
+
+
+static void appendUTF8(std::string& text, uint32_t code) {
+	if (code < 0x80) text.push_back((char)code);
+	else if (code < 0x800) {
+		text.push_back((char)(0xC0 | (code >> 6)));
+		text.push_back((char)(0x80 | (code & 0x3F)));
+	} else if (code < 0x10000) {
+		text.push_back((char)(0xE0 | (code >> 12)));
+		text.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+		text.push_back((char)(0x80 | (code & 0x3F)));
+	} else {
+		text.push_back((char)(0xF0 | (code >> 18)));
+		text.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+		text.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+		text.push_back((char)(0x80 | (code & 0x3F)));
+	}
+}
+
+
+
+/*
+*  @brief Reads JSON string and decodes its escapes
+*  @param[out] text - decoded string (nullptr to skip string)
+*/
+static bool readString(const uint8_t*& p, const uint8_t* end, std::string* text) {
+	if (p >= end || *p != '"') return false;
+	p++;
+	while (p < end) {
+		uint8_t c = *p++;
+		if (c == '"') return true;
+		if (c < 0x20) return false;
+		if (c != '\\') {
+			if (text != nullptr) text->push_back((char)c);
+			continue;
+		}
+		if (p >= end) return false;
+		c = *p++;
+		uint32_t code = c;
+		switch (c) {
+		case '"': case '\\': case '/': break;
+		case 'b': code = '\b'; break;
+		case 'f': code = '\f'; break;
+		case 'n': code = '\n'; break;
+		case 'r': code = '\r'; break;
+		case 't': code = '\t'; break;
+		case 'u': {
+			if (!readHex(p, end, code)) return false;
+			// surrogate pair gives one code point
+			const uint8_t* low = p + 2;
+			uint32_t second;
+			if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+				readHex(low, end, second) && second >= 0xDC00 && second < 0xE000) {
+				code = 0x10000 + ((code - 0xD800) << 10) + (second - 0xDC00);
+				p = low;
+			}
+			break;
+		}
+		default: return false;
+		}
+		if (text != nullptr) appendUTF8(*text, code);
+	}
+	return false;
+}
+
+
+
+static bool readLiteral(const uint8_t*& p, const uint8_t* end, const char* literal) {
+	size_t length = strlen(literal);
+	if ((size_t)(end - p) < length || memcmp(p, literal, length) != 0) return false;
+	p += length;
+	return true;
+}
+
+
+
+static bool readNumber(const uint8_t*& p, const uint8_t* end, double& value) {
+	const uint8_t* start = p;
+	while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) p++;
+	auto result = std::from_chars((const char*)start, (const char*)p, value);
+	return p > start && result.ec == std::errc() && result.ptr == (const char*)p;
+}
+
+
+
+/*
+*  @brief Reads JSON value, collects scalar values
+*  @param[out] values - encoded scalar values (nullptr to skip value)
+*  @param[in] elements - true to collect scalar elements of array value
+*/
+static bool readValue(const uint8_t*& p, const uint8_t* end, uint32_t depth, std::vector<DocumentValue>* values, bool elements) {
+
+	skipSpaces(p, end);
+	if (p >= end || depth > DOCUMENT_MAX_DEPTH) return false;
+
+	// objects are not indexed, nested arrays too
+	if (*p == '{' || *p == '[') {
+		bool isObject = (*p == '{');
+		char closing = isObject ? '}' : ']';
+		p++;
+		skipSpaces(p, end);
+		if (p < end && *p == closing) {
+			p++;
+			return true;
+		}
+		for (;;) {
+			if (isObject) {
+				skipSpaces(p, end);
+				if (!readString(p, end, nullptr)) return false;
+				skipSpaces(p, end);
+				if (p >= end || *p != ':') return false;
+				p++;
+			}
+			if (!readValue(p, end, depth + 1, (!isObject && elements) ? values : nullptr, false)) return false;
+			skipSpaces(p, end);
+			if (p >= end) return false;
+			if (*p == closing) {
+				p++;
+				return true;
+			}
+			if (*p != ',') return false;
+			p++;
+		}
+	}
+
+	if (*p == '"') {
+		std::string text;
+		if (!readString(p, end, values != nullptr ? &text : nullptr)) return false;
+		if (values != nullptr) values->push_back(DocumentIndex::encodeString(text));
+		return true;
+	}
+
+	DocumentValue value;
+	double number;
+	if (readLiteral(p, end, "null")) value = DocumentIndex::encodeNull();
+	else if (readLiteral(p, end, "true")) value = DocumentIndex::encodeBoolean(true);
+	else if (readLiteral(p, end, "false")) value = DocumentIndex::encodeBoolean(false);
+	else if (readNumber(p, end, number)) value = DocumentIndex::encodeNumber(number);
+	else return false;
+	if (values != nullptr) values->push_back(std::move(value));
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// DocumentIndex
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief DocumentIndex constructor
+*  @param[in] jsonPath - object member names separated by dots (e.g. "meta.updatedAt")
+*  @param[in] projection - paths of fields stored in index keys (covering index)
+*/
+DocumentIndex::DocumentIndex(const std::string& jsonPath, const std::vector<std::string>& projection) :
+	jsonPath(jsonPath), projection(projection), readOnly(false), cacheSize(DEFAULT_CACHE),
+	stateKept(false), state(DOCUMENT_INDEX_CHANGED), stale(false) {
+	splitPath(jsonPath, segments);
+	projectionSegments.resize(projection.size());
+	for (size_t i = 0; i < projection.size(); i++) splitPath(projection[i], projectionSegments[i]);
+}
+
+
+
+/*
+*  @brief Opens index file (creates empty index if file doesn't exist)
+*  @param[in] path - index file path
+*  @param[in] isReadOnly - read only mode
+*  @param[in] cacheSize - index pages cache size in bytes
+*  @return true if opened, false if fails
+*/
+bool DocumentIndex::open(const char* path, bool isReadOnly, size_t cacheSize) {
+	if (path == nullptr || !tree.open(path, isReadOnly, cacheSize)) return false;
+	filePath = path;
+	readOnly = isReadOnly;
+	this->cacheSize = cacheSize;
+	stale = false;
+	// index without state key is new or written before states were kept
+	uint8_t stateKey = DOCUMENT_INDEX_STATE;
+	stateKept = tree.find(&stateKey, 1, state);
+	if (!stateKept) state = DOCUMENT_INDEX_CHANGED;
+	return true;
+}
+
+
+
+/*
+*  @brief Persists index pages (index state is kept as is)
+*  @return true if flushed, false if fails
+*/
+bool DocumentIndex::flush() {
+	return tree.flush();
+}
+
+
+
+bool DocumentIndex::close() {
+	return tree.close();
+}
+
+
+
+const std::string& DocumentIndex::getPath() const {
+	return jsonPath;
+}
+
+
+
+const std::vector<std::string>& DocumentIndex::getProjection() const {
+	return projection;
+}
+
+
+
+uint64_t DocumentIndex::getTotalKeys() {
+	uint64_t keys = tree.getTotalKeys();
+	return stateKept && keys > 0 ? keys - 1 : keys;
+}
+
+
+
+/*
+*  @brief Loads values of all documents into empty index in one records scan
+*  @param[in] records - documents records file
+*  @return true if index is built, false if records scan or index write fails
+*/
+bool DocumentIndex::build(RecordFileIO& records) {
+
+	std::vector<std::vector<uint8_t>> keys, documentKeys;
+	RecordScanner scanner(records);
+	ScanRecord record;
+	while (scanner.next(record)) {
+		getKeys(record.header.bitFlags & RECORD_ID_MASK, record.data, record.length, documentKeys);
+		for (auto& key : documentKeys) keys.push_back(std::move(key));
+	}
+	if (scanner.isInterrupted()) return false;
+	if (keys.empty()) return true;
+
+	// record ID follows indexed value, it is the value of key
+	std::sort(keys.begin(), keys.end());
+	BPlusTreeBuilder builder(tree);
+	for (auto& key : keys) {
+		uint64_t recordID = BPlusTree::decodeKey(key.data() + getValueLength(key.data(), key.size()));
+		if (!builder.add(key.data(), (uint32_t)key.size(), recordID)) return false;
+	}
+	return builder.commit();
+}
+
+
+
+/*
+*  @brief Builds index again from records: deletes index file and loads values
+*  of all documents into new empty one
+*  @param[in] records - documents records file
+*  @return true if index is built, false if index file or records scan fails
+*/
+bool DocumentIndex::rebuild(RecordFileIO& records) {
+	if (readOnly || filePath.empty()) return false;
+	tree.close();
+	std::remove(filePath.c_str());
+	if (!tree.open(filePath.c_str(), false, cacheSize)) return false;
+	stateKept = false;
+	state = DOCUMENT_INDEX_CHANGED;
+	if (!build(records)) return false;
+	stale = false;
+	return true;
+}
+
+
+
+/*
+*  @brief Replaces index keys of document before change by keys of document after it
+*  @param[in] recordID - document record ID
+*  @param[in] change - document before and after change
+*  @return true if index updated, false if index write fails
+*/
+bool DocumentIndex::update(uint64_t recordID, const DocumentChange& change) {
+
+	std::vector<std::vector<uint8_t>> oldKeys, newKeys;
+	if (change.existed) getKeys(recordID, change.before.data(), change.before.size(), oldKeys);
+	if (change.exists) getKeys(recordID, change.after.data(), change.after.size(), newKeys);
+
+	// keys of values both versions have stay
+	bool result = true;
+	for (auto& key : oldKeys) {
+		if (std::binary_search(newKeys.begin(), newKeys.end(), key)) continue;
+		result = tree.remove(key.data(), (uint32_t)key.size()) && result;
+	}
+	for (auto& key : newKeys) {
+		if (std::binary_search(oldKeys.begin(), oldKeys.end(), key)) continue;
+		result = tree.insert(key.data(), (uint32_t)key.size(), recordID) && result;
+	}
+	// index that missed a change gives wrong lookups until rebuilt
+	if (!result) stale = true;
+	return result;
+}
+
+
+
+/*
+*  @brief Checks if index was flushed in sync with records and not changed since
+*  @param[in] commitStamp - records commit stamp
+*  @return true if index is in sync, false if it must be rebuilt
+*/
+bool DocumentIndex::isSynced(uint64_t commitStamp) {
+	return state == commitStamp && state != DOCUMENT_INDEX_CHANGED && !stale;
+}
+
+
+
+/*
+*  @brief Checks if index failed to apply change and must be rebuilt
+*  @return true if index is stale, false otherwise
+*/
+bool DocumentIndex::isStale() {
+	return stale;
+}
+
+
+
+/*
+*  @brief Marks index changed before the first change after flush, so index
+*  interrupted by process stop is found changed on open
+*  @return true if index is marked, false if state write fails
+*/
+bool DocumentIndex::markChanged() {
+	if (readOnly) return false;
+	if (state == DOCUMENT_INDEX_CHANGED) return true;
+	return writeState(DOCUMENT_INDEX_CHANGED);
+}
+
+
+
+/*
+*  @brief Flushes index and marks it in sync with records, stale index stays changed
+*  @param[in] commitStamp - records commit stamp
+*  @return true if index is flushed in sync, false if it is stale or write fails
+*/
+bool DocumentIndex::markSynced(uint64_t commitStamp) {
+	if (readOnly) return true;
+	if (stale) {
+		tree.flush();
+		return false;
+	}
+	if (state == commitStamp) return tree.flush();
+	// changes are persisted before the state saying so
+	return tree.flush() && writeState(commitStamp);
+}
+
+
+
+/*
+*  @brief Writes state key and flushes index
+*/
+bool DocumentIndex::writeState(uint64_t value) {
+	uint8_t stateKey = DOCUMENT_INDEX_STATE;
+	bool written = stateKept ? tree.update(&stateKey, 1, value) : tree.insert(&stateKey, 1, value);
+	if (!written) return false;
+	stateKept = true;
+	state = value;
+	return tree.flush();
+}
+
+
+
+/*
+*  @brief Finds documents with given value at path
+*  @param[in] value - encoded value
+*  @param[out] recordIDs - record IDs of documents in ascending order
+*  @return true if index is open, false otherwise or if index is stale
+*/
+bool DocumentIndex::find(const DocumentValue& value, std::vector<uint64_t>& recordIDs) {
+	recordIDs.clear();
+	if (!tree.isOpen() || stale) return false;
+	auto cursor = seekValue(value);
+	while (cursor != nullptr) {
+		// prefix free value is the whole value part of key it starts
+		const std::vector<uint8_t>& key = cursor->getKey();
+		if (key.size() < value.size() + DOCUMENT_RECORD_ID_LENGTH) break;
+		if (memcmp(key.data(), value.data(), value.size()) != 0) break;
+		recordIDs.push_back(cursor->getValue());
+		if (!cursor->next()) break;
+	}
+	return true;
+}
+
+
+
+/*
+*  @brief Finds documents with value at path in range
+*  @param[in] from - encoded lowest value (inclusive)
+*  @param[in] to - encoded highest value (inclusive)
+*  @param[out] recordIDs - record IDs of documents in values order
+*  @return true if index is open, false otherwise or if index is stale
+*/
+bool DocumentIndex::findRange(const DocumentValue& from, const DocumentValue& to, std::vector<uint64_t>& recordIDs) {
+	recordIDs.clear();
+	if (!tree.isOpen() || stale) return false;
+	auto cursor = seekValue(from);
+	while (cursor != nullptr) {
+		const std::vector<uint8_t>& key = cursor->getKey();
+		auto valueEnd = key.begin() + getValueLength(key.data(), key.size());
+		if (std::lexicographical_compare(to.begin(), to.end(), key.begin(), valueEnd)) break;
+		recordIDs.push_back(cursor->getValue());
+		if (!cursor->next()) break;
+	}
+	return true;
+}
+
+
+
+/*
+*  @brief Reads documents entries with value at path in range from index keys,
+*  covering index entries have projected fields, so records are not read.
+*  Entry is incomplete if fields didn't fit key: missing fields are null and
+*  the last field may be truncated string.
+*  @param[in] from - encoded lowest value (inclusive)
+*  @param[in] to - encoded highest value (inclusive)
+*  @param[out] entries - documents entries in values order
+*  @return true if index is open, false otherwise or if index is stale
+*/
+bool DocumentIndex::findEntries(const DocumentValue& from, const DocumentValue& to, std::vector<DocumentEntry>& entries) {
+	entries.clear();
+	if (!tree.isOpen() || stale) return false;
+	auto cursor = seekValue(from);
+	while (cursor != nullptr) {
+		const std::vector<uint8_t>& key = cursor->getKey();
+		size_t valueLength = getValueLength(key.data(), key.size());
+		if (std::lexicographical_compare(to.begin(), to.end(), key.begin(), key.begin() + valueLength)) break;
+		DocumentEntry& entry = entries.emplace_back();
+		entry.recordID = cursor->getValue();
+		entry.value.assign(key.begin(), key.begin() + valueLength);
+		// fields that didn't fit into key are null
+		size_t offset = valueLength + DOCUMENT_RECORD_ID_LENGTH;
+		size_t decoded = 0;
+		entry.fields.resize(projection.size(), encodeNull());
+		for (; decoded < projection.size() && offset < key.size(); decoded++) {
+			size_t fieldLength = getValueLength(key.data() + offset, key.size() - offset);
+			entry.fields[decoded].assign(key.begin() + offset, key.begin() + offset + fieldLength);
+			offset += fieldLength;
+		}
+		// truncated string fills key up to max length (but half of escape)
+		entry.complete = projection.empty() ||
+			(decoded == projection.size() && key.size() + 1 < BTREE_MAX_KEY_LENGTH);
+		if (!cursor->next()) break;
+	}
+	return true;
+}
+
+
+
+/*
+*  @brief Seeks the first key of value not below given one, state key is skipped
+*/
+std::shared_ptr<BPlusTreeCursor> DocumentIndex::seekValue(const DocumentValue& from) {
+	uint8_t lowest = DOCUMENT_VALUE_NULL;
+	if (from.empty() || from[0] < DOCUMENT_VALUE_NULL) return tree.seek(&lowest, 1);
+	return tree.seek(from.data(), (uint32_t)from.size());
+}
+
+
+
+/*
+*  @brief Extracts values at index path from JSON document
+*  @param[in] json - document
+*  @param[in] length - document length in bytes
+*  @param[out] values - encoded values (none if document has no value at path)
+*  @return true if values extracted, false if document is malformed
+*/
+bool DocumentIndex::extractValues(const uint8_t* json, size_t length, std::vector<DocumentValue>& values) const {
+	return extractPath(segments, json, length, values);
+}
+
+
+
+/*
+*  @brief Returns sorted unique index keys of document
+*/
+void DocumentIndex::getKeys(uint64_t recordID, const uint8_t* json, size_t length, std::vector<std::vector<uint8_t>>& keys) const {
+	std::vector<DocumentValue> values;
+	keys.clear();
+	// malformed document keeps values read before error
+	extractValues(json, length, values);
+	for (auto& value : values) {
+		keys.emplace_back();
+		makeKey(value, recordID, keys.back());
+		if (!projection.empty()) appendProjection(json, length, keys.back());
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+
+
+/*
+*  @brief Extracts projected fields values from JSON document: first value
+*  at field path or null
+*  @param[out] fields - encoded values in projection order
+*/
+void DocumentIndex::extractFields(const uint8_t* json, size_t length, std::vector<DocumentValue>& fields) const {
+	std::vector<DocumentValue> values;
+	fields.clear();
+	for (auto& fieldSegments : projectionSegments) {
+		extractPath(fieldSegments, json, length, values);
+		fields.push_back(values.empty() ? encodeNull() : std::move(values.front()));
+	}
+}
+
+
+
+/*
+*  @brief Appends projected fields values to index key: strings are truncated
+*  to fit key length limit, fields that don't fit at all are left out (read
+*  as null, entry is incomplete)
+*/
+void DocumentIndex::appendProjection(const uint8_t* json, size_t length, std::vector<uint8_t>& key) const {
+	std::vector<DocumentValue> fields;
+	extractFields(json, length, fields);
+	for (auto& field : fields) {
+		size_t room = BTREE_MAX_KEY_LENGTH - key.size();
+		if (field.size() > room) {
+			if (field[0] == DOCUMENT_VALUE_STRING && room >= 3) truncateString(field, room);
+			else return;
+		}
+		key.insert(key.end(), field.begin(), field.end());
+	}
+}
+
+
+
+/*
+*  @brief Extracts values at path of member names from JSON document
+*/
+bool DocumentIndex::extractPath(const std::vector<std::string>& segments, const uint8_t* json, size_t length, std::vector<DocumentValue>& values) {
+
+	const uint8_t* p = json;
+	const uint8_t* end = json + length;
+	values.clear();
+
+	for (const std::string& segment : segments) {
+		// path through non object value leads nowhere
+		skipSpaces(p, end);
+		if (p >= end) return false;
+		if (*p != '{') return true;
+		p++;
+		skipSpaces(p, end);
+		if (p < end && *p == '}') return true;
+		std::string name;
+		for (;;) {
+			skipSpaces(p, end);
+			name.clear();
+			if (!readString(p, end, &name)) return false;
+			skipSpaces(p, end);
+			if (p >= end || *p != ':') return false;
+			p++;
+			if (name == segment) break;
+			if (!readValue(p, end, 1, nullptr, false)) return false;
+			skipSpaces(p, end);
+			if (p >= end) return false;
+			if (*p == '}') return true;
+			if (*p != ',') return false;
+			p++;
+		}
+	}
+	return readValue(p, end, (uint32_t)segments.size(), &values, true);
+}
+
+
+
+void DocumentIndex::makeKey(const DocumentValue& value, uint64_t recordID, std::vector<uint8_t>& key) {
+	key.assign(value.begin(), value.end());
+	key.resize(value.size() + DOCUMENT_RECORD_ID_LENGTH);
+	BPlusTree::encodeKey(recordID, key.data() + value.size());
+}
+
+
+
+void DocumentIndex::splitPath(const std::string& jsonPath, std::vector<std::string>& segments) {
+	size_t start = 0;
+	segments.clear();
+	for (;;) {
+		size_t dot = jsonPath.find('.', start);
+		segments.push_back(jsonPath.substr(start, dot - start));
+		if (dot == std::string::npos) break;
+		start = dot + 1;
+	}
+}
+
+
+
+DocumentValue DocumentIndex::encodeNull() {
+	return DocumentValue{ DOCUMENT_VALUE_NULL };
+}
+
+
+
+DocumentValue DocumentIndex::encodeBoolean(bool value) {
+	return DocumentValue{ value ? DOCUMENT_VALUE_TRUE : DOCUMENT_VALUE_FALSE };
+}
+
+
+
+/*
+*  @brief Encodes number: negative doubles get all bits inverted, others
+*  get sign bit set, so bytes order of big-endian bits is numbers order
+*/
+DocumentValue DocumentIndex::encodeNumber(double value) {
+	// negative zero equals zero
+	if (value == 0) value = 0;
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = (bits >> 63) ? ~bits : bits | (1ULL << 63);
+	DocumentValue result(1 + sizeof(bits));
+	result[0] = DOCUMENT_VALUE_NUMBER;
+	for (size_t i = 0; i < sizeof(bits); i++) result[1 + i] = (uint8_t)(bits >> (56 - 8 * i));
+	return result;
+}
+
+
+
+/*
+*  @brief Encodes string: zero bytes are escaped to keep zero pair terminator
+*  lower than any content, too long strings are truncated (their documents
+*  are found by truncated value)
+*/
+DocumentValue DocumentIndex::encodeString(const std::string& value) {
+	DocumentValue result;
+	result.reserve(value.size() + 3);
+	result.push_back(DOCUMENT_VALUE_STRING);
+	for (char c : value) {
+		result.push_back((uint8_t)c);
+		if (c == 0) result.push_back(0xFF);
+	}
+	result.push_back(0);
+	result.push_back(0);
+	truncateString(result, DOCUMENT_MAX_VALUE_LENGTH);
+	return result;
+}
+
+
+
+/*
+*  @brief Decodes number encoded by encodeNumber
+*  @return true if value is number, false otherwise
+*/
+bool DocumentIndex::decodeNumber(const DocumentValue& value, double& number) {
+	if (value.size() != 9 || value[0] != DOCUMENT_VALUE_NUMBER) return false;
+	uint64_t bits = 0;
+	for (size_t i = 0; i < sizeof(bits); i++) bits = (bits << 8) | value[1 + i];
+	bits = (bits >> 63) ? bits & ~(1ULL << 63) : ~bits;
+	memcpy(&number, &bits, sizeof(number));
+	return true;
+}
+
+
+
+/*
+*  @brief Decodes string encoded by encodeString
+*  @return true if value is string, false otherwise
+*/
+bool DocumentIndex::decodeString(const DocumentValue& value, std::string& text) {
+	if (value.size() < 3 || value[0] != DOCUMENT_VALUE_STRING) return false;
+	text.clear();
+	for (size_t i = 1; i + 2 < value.size(); i++) {
+		text.push_back((char)value[i]);
+		if (value[i] == 0) i++;
+	}
+	return true;
+}
+
+
+
+/*
+*  @brief Returns length of encoded value at the beginning of data
+*  @param[in] data - encoded value followed by any bytes
+*  @param[in] length - data length
+*  @return encoded value length (data length if value is malformed)
+*/
+size_t DocumentIndex::getValueLength(const uint8_t* data, size_t length) {
+	if (length == 0) return 0;
+	switch (data[0]) {
+	case DOCUMENT_VALUE_NULL:
+	case DOCUMENT_VALUE_FALSE:
+	case DOCUMENT_VALUE_TRUE:
+		return 1;
+	case DOCUMENT_VALUE_NUMBER:
+		return std::min<size_t>(9, length);
+	case DOCUMENT_VALUE_STRING:
+		// content zero byte is escaped by 0xFF, zero pair terminates
+		for (size_t i = 1; i + 1 < length; i++) {
+			if (data[i] != 0) continue;
+			if (data[i + 1] == 0) return i + 2;
+			i++;
+		}
+		return length;
+	default:
+		return length;
+	}
+}
+
+
+
+/*
+*  @brief Truncates encoded string keeping escapes whole and zero pair
+*  terminator, so truncated string is still prefix free
+*  @param[in] maxLength - encoded length limit (at least 3)
+*/
+void DocumentIndex::truncateString(DocumentValue& value, size_t maxLength) {
+	if (value.size() <= maxLength) return;
+	value.resize(maxLength - 2);
+	// content zero byte is always followed by 0xFF, so last zero is half of escape
+	if (value.back() == 0) value.pop_back();
+	value.push_back(0);
+	value.push_back(0);
+}
@@ -0,0 +1,329 @@
+/******************************************************************************
+*
+*  DocumentStore class implementation
+*
+*  DocumentStore keeps each index in its own B+ Tree file next to records
+*  file ("<records file>.<json path>.index"). Index declared for the first
+*  time is loaded from existing documents by one records scan and bulk
+*  loading, later it is opened as is if it was flushed in sync with records.
+*  Index keeps records commit stamp of its last flush, so index changed after
+*  it (process stopped between records commit and index update) or behind
+*  records (not declared while documents changed) is built again. Covering index file
+*  name has projected paths too ("<records file>.<json path>+<field>.index"),
+*  so index declared with other projection is built as a new index.
+*
+*  Records commit and indexes update are serialized by commit mutex, so
+*  index changes are applied in the order of records commits. Indexes are
+*  marked changed before records commit and in sync on flush and close.
+*  Index that fails to apply committed change is rebuilt right away, commit
+*  of records stands.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "DocumentStore.h"
+
+#include <cstdio>
+
+using namespace Cloudless::Storage;
+
+
+DocumentStore::DocumentStore() {
+	readOnly = false;
+	indexCacheSize = DEFAULT_CACHE;
+}
+
+
+
+DocumentStore::~DocumentStore() {
+	if (!records.isOpen()) return;
+	close();
+}
+
+
+
+/*
+*  @brief Opens documents records file, indexes are declared by createIndex
+*  @param[in] path - records file path
+*  @param[in] isReadOnly - read only mode
+*  @param[in] cacheSize - cache size of records file and of each index
+*  @return true if opened, false if fails
+*/
+bool DocumentStore::open(const char* path, bool isReadOnly, size_t cacheSize) {
+	if (path == nullptr || records.isOpen()) return false;
+	if (!records.open(path, isReadOnly, cacheSize)) return false;
+	storagePath = path;
+	readOnly = isReadOnly;
+	indexCacheSize = cacheSize;
+	return true;
+}
+
+
+
+/*
+*  @brief Flushes records and indexes, indexes are marked in sync with records
+*  @return true if flushed, false if fails or an index is stale
+*/
+bool DocumentStore::flush() {
+	std::lock_guard commitLock(commitMutex);
+	std::shared_lock lock(indexesMutex);
+	bool result = records.flush();
+	for (auto& [jsonPath, index] : indexes) result = index->markSynced(records.getCommitStamp()) && result;
+	return result;
+}
+
+
+
+bool DocumentStore::close() {
+	std::lock_guard commitLock(commitMutex);
+	std::unique_lock lock(indexesMutex);
+	bool result = records.flush();
+	for (auto& [jsonPath, index] : indexes) {
+		result = index->markSynced(records.getCommitStamp()) && result;
+		result = index->close() && result;
+	}
+	indexes.clear();
+	return records.close() && result;
+}
+
+
+
+RecordFileIO& DocumentStore::getRecords() {
+	return records;
+}
+
+
+
+/*
+*  @brief Declares index on JSON path: opens its file or builds it from
+*  existing documents if index is new or was not flushed in sync with records
+*  (commit stamp of records differs)
+*  @param[in] jsonPath - object member names separated by dots (e.g. "meta.updatedAt")
+*  @param[in] projection - paths of fields kept in index (covering index)
+*  @return true if index is ready, false if fails, path has index with other
+*  projection or index needs rebuild in read only mode
+*/
+bool DocumentStore::createIndex(const std::string& jsonPath, const std::vector<std::string>& projection) {
+	if (!records.isOpen() || jsonPath.empty()) return false;
+
+	// no commits while index is loaded
+	std::lock_guard commitLock(commitMutex);
+	std::unique_lock lock(indexesMutex);
+	auto it = indexes.find(jsonPath);
+	if (it != indexes.end()) return it->second->getProjection() == projection;
+
+	auto index = std::make_unique<DocumentIndex>(jsonPath, projection);
+	if (!index->open(getIndexFileName(jsonPath, projection).c_str(), readOnly, indexCacheSize)) return false;
+	if (!index->isSynced(records.getCommitStamp()) && (readOnly || !index->rebuild(records))) {
+		index->close();
+		return false;
+	}
+	indexes[jsonPath] = std::move(index);
+	return true;
+}
+
+
+
+/*
+*  @brief Closes index and deletes its file
+*  @param[in] jsonPath - indexed JSON path
+*  @return true if index is dropped, false if there is no such index
+*/
+bool DocumentStore::dropIndex(const std::string& jsonPath) {
+	if (readOnly) return false;
+	std::lock_guard commitLock(commitMutex);
+	std::unique_lock lock(indexesMutex);
+	auto it = indexes.find(jsonPath);
+	if (it == indexes.end()) return false;
+	std::string fileName = getIndexFileName(jsonPath, it->second->getProjection());
+	it->second->close();
+	indexes.erase(it);
+	return std::remove(fileName.c_str()) == 0;
+}
+
+
+
+bool DocumentStore::hasIndex(const std::string& jsonPath) {
+	std::shared_lock lock(indexesMutex);
+	return indexes.count(jsonPath) > 0;
+}
+
+
+
+/*
+*  @brief Inserts document and its indexes values
+*  @param[in] json - JSON document
+*  @param[in] length - document length in bytes
+*  @return record ID or NOT_FOUND if fails
+*/
+uint64_t DocumentStore::insertDocument(const void* json, uint32_t length) {
+	DocumentTransaction transaction(*this);
+	uint64_t recordID = transaction.insertDocument(json, length);
+	if (recordID == NOT_FOUND || !transaction.commit()) return NOT_FOUND;
+	return recordID;
+}
+
+
+
+bool DocumentStore::getDocument(uint64_t recordID, std::vector<uint8_t>& json) {
+	auto cursor = records.getRecordByID(recordID);
+	if (cursor == nullptr) return false;
+	json.resize(cursor->getDataLength());
+	return cursor->getRecordData(json.data());
+}
+
+
+
+/*
+*  @brief Replaces document and its indexes values
+*  @return true if updated, false if document doesn't exist or changed concurrently
+*/
+bool DocumentStore::updateDocument(uint64_t recordID, const void* json, uint32_t length) {
+	DocumentTransaction transaction(*this);
+	return transaction.updateDocument(recordID, json, length) && transaction.commit();
+}
+
+
+
+/*
+*  @brief Removes document and its indexes values
+*  @return true if removed, false if document doesn't exist or changed concurrently
+*/
+bool DocumentStore::removeDocument(uint64_t recordID) {
+	DocumentTransaction transaction(*this);
+	return transaction.removeDocument(recordID) && transaction.commit();
+}
+
+
+
+/*
+*  @brief Finds documents with given value at indexed path
+*  @param[in] jsonPath - indexed JSON path
+*  @param[in] value - encoded value (DocumentIndex::encodeString etc.)
+*  @param[out] positions - records positions of documents
+*  @return true if found (may be none), false if there is no such index
+*/
+bool DocumentStore::find(const std::string& jsonPath, const DocumentValue& value, std::vector<uint64_t>& positions) {
+	std::vector<uint64_t> recordIDs;
+	{
+		std::shared_lock lock(indexesMutex);
+		auto it = indexes.find(jsonPath);
+		if (it == indexes.end() || !it->second->find(value, recordIDs)) return false;
+	}
+	getPositions(recordIDs, positions);
+	return true;
+}
+
+
+
+/*
+*  @brief Finds documents with value at indexed path in range [from, to]
+*  @param[out] positions - records positions of documents in values order
+*  @return true if found (may be none), false if there is no such index
+*/
+bool DocumentStore::findRange(const std::string& jsonPath, const DocumentValue& from, const DocumentValue& to, std::vector<uint64_t>& positions) {
+	std::vector<uint64_t> recordIDs;
+	if (!findIDs(jsonPath, from, to, recordIDs)) return false;
+	getPositions(recordIDs, positions);
+	return true;
+}
+
+
+
+/*
+*  @brief Finds record IDs of documents with value at indexed path in range [from, to],
+*  record IDs stay the same when records move, unlike records positions
+*  @return true if found (may be none), false if there is no such index
+*/
+bool DocumentStore::findIDs(const std::string& jsonPath, const DocumentValue& from, const DocumentValue& to, std::vector<uint64_t>& recordIDs) {
+	std::shared_lock lock(indexesMutex);
+	auto it = indexes.find(jsonPath);
+	return it != indexes.end() && it->second->findRange(from, to, recordIDs);
+}
+
+
+
+/*
+*  @brief Reads documents entries with value at indexed path in range [from, to]
+*  from index, entries of covering index have projected fields values. Fields
+*  that didn't fit index key are read from documents, entry of document
+*  removed meanwhile stays incomplete.
+*  @param[out] entries - documents entries in values order
+*  @return true if found (may be none), false if there is no such index
+*/
+bool DocumentStore::findEntries(const std::string& jsonPath, const DocumentValue& from, const DocumentValue& to, std::vector<DocumentEntry>& entries) {
+	std::shared_lock lock(indexesMutex);
+	auto it = indexes.find(jsonPath);
+	if (it == indexes.end() || !it->second->findEntries(from, to, entries)) return false;
+	std::vector<uint8_t> json;
+	for (auto& entry : entries) {
+		if (entry.complete || !getDocument(entry.recordID, json)) continue;
+		it->second->extractFields(json.data(), json.size(), entry.fields);
+		entry.complete = true;
+	}
+	return true;
+}
+
+
+
+std::string DocumentStore::getIndexFileName(const std::string& jsonPath, const std::vector<std::string>& projection) {
+	std::string fileName = storagePath + "." + jsonPath;
+	for (auto& field : projection) fileName += "+" + field;
+	return fileName + ".index";
+}
+
+
+
+/*
+*  @brief Marks indexes changed before records commit (caller holds commit mutex)
+*  @return true if all indexes marked, false if index write fails
+*/
+bool DocumentStore::markIndexesChanged() {
+	std::shared_lock lock(indexesMutex);
+	bool result = true;
+	for (auto& [jsonPath, index] : indexes) result = index->markChanged() && result;
+	return result;
+}
+
+
+
+/*
+*  @brief Applies committed documents changes to all indexes (caller holds commit mutex)
+*  @return true if all indexes updated, false if index write fails (index is stale)
+*/
+bool DocumentStore::updateIndexes(const DocumentChanges& changes) {
+	std::shared_lock lock(indexesMutex);
+	bool result = true;
+	for (auto& [jsonPath, index] : indexes) {
+		for (auto& [recordID, change] : changes) result = index->update(recordID, change) && result;
+	}
+	return result;
+}
+
+
+
+/*
+*  @brief Builds stale indexes again from records (caller holds commit mutex),
+*  index failed to rebuild stays stale and its lookups fail
+*/
+void DocumentStore::rebuildIndexes() {
+	std::unique_lock lock(indexesMutex);
+	for (auto& [jsonPath, index] : indexes) {
+		if (index->isStale()) index->rebuild(records);
+	}
+}
+
+
+
+/*
+*  @brief Resolves records positions of documents, removed documents are skipped
+*/
+void DocumentStore::getPositions(const std::vector<uint64_t>& recordIDs, std::vector<uint64_t>& positions) {
+	positions.clear();
+	positions.reserve(recordIDs.size());
+	for (uint64_t recordID : recordIDs) {
+		auto cursor = records.getRecordByID(recordID);
+		if (cursor != nullptr) positions.push_back(cursor->getPosition());
+	}
+}
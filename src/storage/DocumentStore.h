@@ -0,0 +1,229 @@
+/******************************************************************************
+*
+*  DocumentStore, DocumentIndex & DocumentTransaction class header
+*
+*  DocumentStore keeps JSON documents in RecordFileIO records and maintains
+*  declared secondary indexes on JSON paths (e.g. "author", "category",
+*  "meta.updatedAt"). Each index is B+ Tree mapping value at the path to
+*  record IDs, so documents are found by field value without records scan.
+*
+*  Features:
+*    - declarative indexes on JSON paths, built from existing documents
+*    - arrays of values at path are indexed by each value (multi-key)
+*    - indexes maintained on document insert/update/remove by transaction
+*    - index changed and not flushed or behind records is rebuilt on open
+*    - equality and range lookups returning record positions or IDs
+*    - covering indexes keeping projection of other fields in index keys
+*    - values order: null, false, true, numbers, strings (bytes order)
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include "RecordFileIO.h"
+#include "BPlusTree.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Index key is encoded value, record ID (big-endian) and encoded values of
+		// projected fields if any. Value encoding is prefix free and keeps values
+		// order in bytes order:
+		//   [ type tag ] [ number: 8 bytes | string: bytes (0x00 as 0x00 0xFF), 0x00 0x00 ]
+		//----------------------------------------------------------------------------
+		constexpr uint8_t  DOCUMENT_VALUE_NULL = 0x01;           // null
+		constexpr uint8_t  DOCUMENT_VALUE_FALSE = 0x02;          // false
+		constexpr uint8_t  DOCUMENT_VALUE_TRUE = 0x03;           // true
+		constexpr uint8_t  DOCUMENT_VALUE_NUMBER = 0x04;         // Number as ordered 64-bit double
+		constexpr uint8_t  DOCUMENT_VALUE_STRING = 0x05;         // String bytes (UTF-8)
+		constexpr uint32_t DOCUMENT_RECORD_ID_LENGTH = 8;        // Record ID suffix of index key
+		constexpr uint32_t DOCUMENT_MAX_VALUE_LENGTH = BTREE_MAX_KEY_LENGTH - DOCUMENT_RECORD_ID_LENGTH; // Longer strings are truncated
+		constexpr uint32_t DOCUMENT_MAX_DEPTH = 64;              // Max JSON nesting parsed
+
+		//----------------------------------------------------------------------------
+		// Index state key [ 0x00 ] sorts before values keys, its value is records
+		// commit stamp index was flushed in sync with or DOCUMENT_INDEX_CHANGED
+		//----------------------------------------------------------------------------
+		constexpr uint8_t  DOCUMENT_INDEX_STATE = 0x00;          // State key (below values type tags)
+		constexpr uint64_t DOCUMENT_INDEX_CHANGED = UINT64_MAX;  // Index changed since last flush
+
+		typedef std::vector<uint8_t> DocumentValue;              // Encoded JSON value
+
+		//----------------------------------------------------------------------------
+		// Document state before and after transaction (used to update indexes)
+		//----------------------------------------------------------------------------
+		struct DocumentChange {
+			bool                  existed;     // Document existed before transaction
+			bool                  exists;      // Document exists after transaction
+			std::vector<uint8_t>  before;      // Document before transaction
+			std::vector<uint8_t>  after;       // Document after transaction
+		};
+
+		typedef std::map<uint64_t, DocumentChange> DocumentChanges;   // Changes by record ID
+
+		//----------------------------------------------------------------------------
+		// Covering index entry: document fields read from index key only
+		//----------------------------------------------------------------------------
+		struct DocumentEntry {
+			uint64_t                   recordID;    // Document record ID
+			DocumentValue              value;       // Indexed value
+			std::vector<DocumentValue> fields;      // Projected fields values (null if missing)
+			bool                       complete;    // Fields are whole (false - some didn't fit index key)
+		};
+
+		//----------------------------------------------------------------------------
+		// DocumentIndex - secondary index of values at JSON path
+		//----------------------------------------------------------------------------
+		class DocumentIndex {
+		public:
+			DocumentIndex(const std::string& jsonPath, const std::vector<std::string>& projection = {});
+			DocumentIndex(const DocumentIndex&) = delete;
+			void operator=(const DocumentIndex&) = delete;
+
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE);
+			bool flush();
+			bool close();
+
+			const std::string& getPath() const;
+			const std::vector<std::string>& getProjection() const;
+			uint64_t getTotalKeys();
+			bool     build(RecordFileIO& records);
+			bool     rebuild(RecordFileIO& records);
+			bool     update(uint64_t recordID, const DocumentChange& change);
+
+			bool     isSynced(uint64_t commitStamp);
+			bool     isStale();
+			bool     markChanged();
+			bool     markSynced(uint64_t commitStamp);
+
+			bool     find(const DocumentValue& value, std::vector<uint64_t>& recordIDs);
+			bool     findRange(const DocumentValue& from, const DocumentValue& to, std::vector<uint64_t>& recordIDs);
+			bool     findEntries(const DocumentValue& from, const DocumentValue& to, std::vector<DocumentEntry>& entries);
+
+			bool     extractValues(const uint8_t* json, size_t length, std::vector<DocumentValue>& values) const;
+			void     extractFields(const uint8_t* json, size_t length, std::vector<DocumentValue>& fields) const;
+
+			static DocumentValue encodeNull();
+			static DocumentValue encodeBoolean(bool value);
+			static DocumentValue encodeNumber(double value);
+			static DocumentValue encodeString(const std::string& value);
+			static bool   decodeNumber(const DocumentValue& value, double& number);
+			static bool   decodeString(const DocumentValue& value, std::string& text);
+			static size_t getValueLength(const uint8_t* data, size_t length);
+
+		protected:
+			std::string              jsonPath;
+			std::vector<std::string> segments;     // Object member names along path
+			std::vector<std::string> projection;   // Projected fields paths
+			std::vector<std::vector<std::string>> projectionSegments;
+			BPlusTree                tree;
+			std::string              filePath;
+			bool                     readOnly;
+			size_t                   cacheSize;
+			bool                     stateKept;    // Index has state key
+			uint64_t                 state;        // State key value (commit stamp or DOCUMENT_INDEX_CHANGED)
+			std::atomic<bool>        stale;        // Index failed to apply change, rebuild needed
+
+			bool     writeState(uint64_t value);
+			std::shared_ptr<BPlusTreeCursor> seekValue(const DocumentValue& from);
+
+			void     getKeys(uint64_t recordID, const uint8_t* json, size_t length, std::vector<std::vector<uint8_t>>& keys) const;
+			void     appendProjection(const uint8_t* json, size_t length, std::vector<uint8_t>& key) const;
+			static void makeKey(const DocumentValue& value, uint64_t recordID, std::vector<uint8_t>& key);
+			static void splitPath(const std::string& jsonPath, std::vector<std::string>& segments);
+			static bool extractPath(const std::vector<std::string>& segments, const uint8_t* json, size_t length, std::vector<DocumentValue>& values);
+			static void truncateString(DocumentValue& value, size_t maxLength);
+		};
+
+		class DocumentTransaction;
+
+		//----------------------------------------------------------------------------
+		// DocumentStore - JSON documents with secondary indexes. Documents must be
+		// changed through DocumentTransaction to keep indexes consistent.
+		//----------------------------------------------------------------------------
+		class DocumentStore {
+			friend class DocumentTransaction;
+		public:
+			DocumentStore();
+			DocumentStore(const DocumentStore&) = delete;
+			void operator=(const DocumentStore&) = delete;
+			~DocumentStore();
+
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE);
+			bool flush();
+			bool close();
+			RecordFileIO& getRecords();
+
+			bool createIndex(const std::string& jsonPath, const std::vector<std::string>& projection = {});
+			bool dropIndex(const std::string& jsonPath);
+			bool hasIndex(const std::string& jsonPath);
+
+			uint64_t insertDocument(const void* json, uint32_t length);
+			bool     getDocument(uint64_t recordID, std::vector<uint8_t>& json);
+			bool     updateDocument(uint64_t recordID, const void* json, uint32_t length);
+			bool     removeDocument(uint64_t recordID);
+
+			bool find(const std::string& jsonPath, const DocumentValue& value, std::vector<uint64_t>& positions);
+			bool findRange(const std::string& jsonPath, const DocumentValue& from, const DocumentValue& to, std::vector<uint64_t>& positions);
+			bool findIDs(const std::string& jsonPath, const DocumentValue& from, const DocumentValue& to, std::vector<uint64_t>& recordIDs);
+			bool findEntries(const std::string& jsonPath, const DocumentValue& from, const DocumentValue& to, std::vector<DocumentEntry>& entries);
+
+		protected:
+			RecordFileIO          records;
+			std::string           storagePath;
+			bool                  readOnly;
+			size_t                indexCacheSize;
+			std::shared_mutex     indexesMutex;      // Indexes map (exclusive to create or drop)
+			std::mutex            commitMutex;       // Commit and indexes update are done together
+			std::map<std::string, std::unique_ptr<DocumentIndex>> indexes;   // Indexes by JSON path
+
+			std::string getIndexFileName(const std::string& jsonPath, const std::vector<std::string>& projection);
+			bool        markIndexesChanged();
+			bool        updateIndexes(const DocumentChanges& changes);
+			void        rebuildIndexes();
+			void        getPositions(const std::vector<uint64_t>& recordIDs, std::vector<uint64_t>& positions);
+		};
+
+		//----------------------------------------------------------------------------
+		// DocumentTransaction - record transaction that updates indexes on commit.
+		// Documents are read before the first write, so their old index values
+		// belong to record versions validated by commit. Indexes are marked
+		// changed before records commit, so interrupted update is rebuilt.
+		//----------------------------------------------------------------------------
+		class DocumentTransaction {
+		public:
+			DocumentTransaction(DocumentStore& store);
+			DocumentTransaction(const DocumentTransaction&) = delete;
+			void operator=(const DocumentTransaction&) = delete;
+
+			uint64_t insertDocument(const void* json, uint32_t length);
+			bool     getDocument(uint64_t recordID, std::vector<uint8_t>& json);
+			bool     updateDocument(uint64_t recordID, const void* json, uint32_t length);
+			bool     removeDocument(uint64_t recordID);
+			bool     commit();
+			void     abort();
+			bool     isActive();
+
+		protected:
+			DocumentStore&        store;
+			RecordTransaction     transaction;
+			DocumentChanges       changes;        // Documents written by transaction
+
+			bool     keepOriginal(uint64_t recordID);
+		};
+
+	}
+
+}
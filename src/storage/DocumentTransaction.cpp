@@ -0,0 +1,122 @@
+/******************************************************************************
+*
+*  DocumentTransaction class implementation
+*
+*  DocumentTransaction is RecordTransaction over documents of DocumentStore
+*  that also remembers each document as it was before the first write. On
+*  commit records are committed first and then indexes get removed values
+*  of old documents and added values of new ones, so aborted or conflicting
+*  transaction changes neither records nor indexes. Indexes are marked
+*  changed before records commit, so index left behind records by process
+*  stop is rebuilt on open, and index failed to apply change is rebuilt
+*  at once: committed transaction is never reported failed.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "DocumentStore.h"
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief Begins transaction
+*  @param[in] store - documents store
+*/
+DocumentTransaction::DocumentTransaction(DocumentStore& store) : store(store), transaction(store.records) {}
+
+
+
+/*
+*  @brief Creates document when transaction commits
+*  @return record ID or NOT_FOUND if failed
+*/
+uint64_t DocumentTransaction::insertDocument(const void* json, uint32_t length) {
+	uint64_t recordID = transaction.createRecord(json, length);
+	if (recordID == NOT_FOUND) return NOT_FOUND;
+	changes[recordID] = DocumentChange{ false, true, {}, {} };
+	return recordID;
+}
+
+
+
+/*
+*  @brief Reads document including writes of this transaction
+*  @return true if document exists, false otherwise
+*/
+bool DocumentTransaction::getDocument(uint64_t recordID, std::vector<uint8_t>& json) {
+	return transaction.getRecordData(recordID, json);
+}
+
+
+
+/*
+*  @brief Replaces document when transaction commits
+*  @return true if write buffered, false if document doesn't exist
+*/
+bool DocumentTransaction::updateDocument(uint64_t recordID, const void* json, uint32_t length) {
+	return keepOriginal(recordID) && transaction.setRecordData(recordID, json, length);
+}
+
+
+
+/*
+*  @brief Removes document when transaction commits
+*  @return true if removal buffered, false if document doesn't exist
+*/
+bool DocumentTransaction::removeDocument(uint64_t recordID) {
+	return keepOriginal(recordID) && transaction.removeRecord(recordID);
+}
+
+
+
+/*
+*  @brief Commits records writes, then updates indexes by changed documents
+*  @return true if committed, false if documents were changed by others
+*  meanwhile or indexes can't be marked changed (nothing is written)
+*/
+bool DocumentTransaction::commit() {
+	if (!transaction.isActive()) return false;
+	std::lock_guard lock(store.commitMutex);
+	// removed documents (and created then removed) don't exist after commit
+	for (auto& [recordID, change] : changes) {
+		change.exists = transaction.getRecordData(recordID, change.after);
+	}
+	if (!store.markIndexesChanged()) {
+		abort();
+		return false;
+	}
+	bool committed = transaction.commit();
+	if (committed && !store.updateIndexes(changes)) store.rebuildIndexes();
+	changes.clear();
+	return committed;
+}
+
+
+
+void DocumentTransaction::abort() {
+	transaction.abort();
+	changes.clear();
+}
+
+
+
+bool DocumentTransaction::isActive() {
+	return transaction.isActive();
+}
+
+
+
+/*
+*  @brief Reads document before its first write in transaction, the version
+*  read is the one commit validates, so its index values are the ones to remove
+*  @return true if document exists, false otherwise
+*/
+bool DocumentTransaction::keepOriginal(uint64_t recordID) {
+	if (changes.count(recordID) > 0) return true;
+	DocumentChange change{ true, true, {}, {} };
+	if (!transaction.getRecordData(recordID, change.before)) return false;
+	changes.emplace(recordID, std::move(change));
+	return true;
+}
@@ -0,0 +1,849 @@
+/******************************************************************************
+*
+*  HashIndex class implementation
+*
+*  Index file is a header page listing directory pages, directory pages and
+*  bucket pages. Low globalDepth bits of key hash select directory entry,
+*  which is bucket page number. Bucket of local depth d keeps keys with the
+*  same low d bits of hash and is referenced by 2^(globalDepth - d) entries.
+*  Full bucket is split by bit d, and only entries of split bucket change.
+*  Directory is doubled (entries copied) if split bucket has d = globalDepth.
+*  Buckets at max depth get overflow pages, which are freed by next split.
+*  Split writes both buckets, then changed directory pages and header, so
+*  pages reaching disk give the same directory as in memory. Header state
+*  is set to changed and flushed before the first change after flush, so
+*  index found changed on open was not flushed (process stopped), pages
+*  evicted in any order could lose a split, and index is checked.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "HashIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief HashIndex constructor
+*/
+HashIndex::HashIndex() : indexHeader{} {
+	// Checksum algorithm is set by index header on open
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+}
+
+
+
+/*
+* @brief HashIndex destructor and finalizations
+*/
+HashIndex::~HashIndex() {
+	if (!cachedFile.isOpen()) return;
+	close();
+}
+
+
+
+/**
+* @brief Opens index file, creates empty index if file is empty
+* @return true if index file successfuly opened, false otherwise
+*/
+bool HashIndex::open(const char* path, bool isReadOnly, size_t cacheSize) {
+
+	std::unique_lock lock(indexMutex);
+
+	if (!cachedFile.open(path, isReadOnly, cacheSize)) {
+		const char* msg = "Can't operate on closed cached file.";
+		throw std::runtime_error(msg);
+	}
+
+	// If file is empty and write is permitted, then write header and empty bucket
+	if (cachedFile.getFileSize() == 0 && !cachedFile.isReadOnly()) {
+		createHeader();
+	}
+
+	if (!loadHeader()) {
+		const char* msg = "Hash index file header is invalid or corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// index changed after its last flush is used only if its pages are consistent
+	if (indexHeader.state == HASH_CHANGED && !checkDirectory()) {
+		const char* msg = "Hash index file was not flushed after change and is inconsistent.\n";
+		throw std::runtime_error(msg);
+	}
+	return true;
+}
+
+
+
+/**
+* @brief Persists changed pages, marks index flushed and closes index file
+* @return true if index file successfuly closed, false otherwise
+*/
+bool HashIndex::close() {
+	std::unique_lock lock(indexMutex);
+	if (!cachedFile.isOpen()) return false;
+	if (!cachedFile.isReadOnly()) markSynced();
+	directory.clear();
+	directoryPages.clear();
+	return cachedFile.close();
+}
+
+
+
+/**
+*  @brief Persists all changed pages to storage device and marks index flushed
+*  @return true if all changed cache pages been persisted, false otherwise
+*/
+bool HashIndex::flush() {
+	if (!cachedFile.isOpen()) return false;
+	if (!cachedFile.isReadOnly()) {
+		std::unique_lock lock(indexMutex);
+		return markSynced();
+	}
+	return cachedFile.flush();
+}
+
+
+bool HashIndex::isOpen() {
+	return cachedFile.isOpen();
+}
+
+
+bool HashIndex::isReadOnly() {
+	return cachedFile.isReadOnly();
+}
+
+
+uint64_t HashIndex::getFileSize() {
+	std::shared_lock lock(indexMutex);
+	return indexHeader.pagesCount * PAGE_SIZE;
+}
+
+
+uint64_t HashIndex::getTotalKeys() {
+	std::shared_lock lock(indexMutex);
+	return indexHeader.keysCount;
+}
+
+
+uint64_t HashIndex::getTotalPages() {
+	std::shared_lock lock(indexMutex);
+	return indexHeader.pagesCount;
+}
+
+
+uint64_t HashIndex::getTotalBuckets() {
+	std::shared_lock lock(indexMutex);
+	return indexHeader.bucketsCount;
+}
+
+
+uint32_t HashIndex::getGlobalDepth() {
+	std::shared_lock lock(indexMutex);
+	return indexHeader.globalDepth;
+}
+
+
+/*
+* @brief Returns bucket pages (including overflow pages) space used by keys
+* @return load factor from 0 to 1
+*/
+double HashIndex::getLoadFactor() {
+	std::shared_lock lock(indexMutex);
+	uint64_t pages = indexHeader.bucketsCount + indexHeader.overflowPages;
+	if (pages == 0) return 0;
+	return double(indexHeader.usedBytes) / (double(pages) * HASH_BUCKET_CAPACITY);
+}
+
+
+void HashIndex::resetCacheStats() {
+	cachedFile.resetStats();
+}
+
+
+double HashIndex::getCacheStats(CachedFileStats type) {
+	return cachedFile.getStats(type);
+}
+
+
+//-----------------------------------------------------------------------------
+// Keys methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Inserts key with value, splits full bucket or doubles directory
+* @return true if inserted, false if key exists or fails
+*/
+bool HashIndex::insert(const void* key, uint32_t keyLength, uint64_t value) {
+
+	if (cachedFile.isReadOnly() || keyLength > HASH_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+
+	std::unique_lock lock(indexMutex);
+	const uint8_t* bytes = (const uint8_t*)key;
+	uint32_t hash = getHash(bytes, (uint16_t)keyLength);
+	uint8_t page[PAGE_SIZE];
+	uint64_t pageNo;
+	uint32_t index;
+	if (locateKey(bytes, (uint16_t)keyLength, hash, page, pageNo, index) || pageNo == NOT_FOUND) return false;
+	if (!markChanged()) return false;
+
+	uint32_t neededBytes = sizeof(HashSlot) + keyLength + sizeof(uint64_t);
+	HashPageHeader* header = (HashPageHeader*)page;
+	while (true) {
+		// first page of bucket with room for entry
+		uint64_t bucketPage = directory[hash & (directory.size() - 1)];
+		uint64_t lastPage = 0;
+		uint16_t localDepth = 0;
+		for (pageNo = bucketPage; pageNo != 0; pageNo = header->nextPage) {
+			if (!readPage(pageNo, page)) return false;
+			if (pageNo == bucketPage) localDepth = header->localDepth;
+			if (getFreeBytes(page) >= neededBytes) break;
+			lastPage = pageNo;
+		}
+
+		if (pageNo == 0) {
+			if (localDepth < HASH_MAX_DEPTH) {
+				if (localDepth == indexHeader.globalDepth && !doubleDirectory()) return false;
+				if (!splitBucket(bucketPage)) return false;
+				continue;
+			}
+			// bucket can't be split anymore, overflow page is linked to the last page
+			pageNo = allocatePage();
+			if (pageNo == NOT_FOUND) return false;
+			header->nextPage = pageNo;
+			if (!writePage(lastPage, page)) return false;
+			initPage(page, HASH_BUCKET, localDepth);
+			indexHeader.overflowPages++;
+		}
+
+		addEntry(page, hash, bytes, (uint16_t)keyLength, value);
+		if (!writePage(pageNo, page)) return false;
+		indexHeader.keysCount++;
+		indexHeader.usedBytes += neededBytes;
+		return writeHeader();
+	}
+}
+
+
+
+/*
+* @brief Changes value of existing key in its bucket page
+* @return true if updated, false if key doesn't exist or fails
+*/
+bool HashIndex::update(const void* key, uint32_t keyLength, uint64_t value) {
+
+	if (cachedFile.isReadOnly() || keyLength > HASH_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+
+	std::unique_lock lock(indexMutex);
+	const uint8_t* bytes = (const uint8_t*)key;
+	uint8_t page[PAGE_SIZE];
+	uint64_t pageNo;
+	uint32_t index;
+	if (!locateKey(bytes, (uint16_t)keyLength, getHash(bytes, (uint16_t)keyLength), page, pageNo, index)) return false;
+	if (!markChanged()) return false;
+	HashSlot* slot = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE) + index;
+	memcpy(page + slot->offset + slot->length, &value, sizeof(value));
+	return writePage(pageNo, page);
+}
+
+
+
+/*
+* @brief Removes key from its bucket page (buckets are not merged)
+* @return true if removed, false if key doesn't exist or fails
+*/
+bool HashIndex::remove(const void* key, uint32_t keyLength) {
+
+	if (cachedFile.isReadOnly() || keyLength > HASH_MAX_KEY_LENGTH) return false;
+	if (key == nullptr && keyLength > 0) return false;
+
+	std::unique_lock lock(indexMutex);
+	const uint8_t* bytes = (const uint8_t*)key;
+	uint8_t page[PAGE_SIZE];
+	uint64_t pageNo;
+	uint32_t index;
+	if (!locateKey(bytes, (uint16_t)keyLength, getHash(bytes, (uint16_t)keyLength), page, pageNo, index)) return false;
+	if (!markChanged()) return false;
+	removeEntry(page, index);
+	if (!writePage(pageNo, page)) return false;
+	indexHeader.keysCount--;
+	indexHeader.usedBytes -= sizeof(HashSlot) + keyLength + sizeof(uint64_t);
+	return writeHeader();
+}
+
+
+
+/*
+* @brief Finds value of key, reads one bucket page (and its overflow pages)
+* @return true if key found, false otherwise
+*/
+bool HashIndex::find(const void* key, uint32_t keyLength, uint64_t& value) {
+
+	if (keyLength > HASH_MAX_KEY_LENGTH || (key == nullptr && keyLength > 0)) return false;
+
+	std::shared_lock lock(indexMutex);
+	const uint8_t* bytes = (const uint8_t*)key;
+	uint8_t page[PAGE_SIZE];
+	uint64_t pageNo;
+	uint32_t index;
+	if (!locateKey(bytes, (uint16_t)keyLength, getHash(bytes, (uint16_t)keyLength), page, pageNo, index)) return false;
+	HashSlot* slot = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE) + index;
+	memcpy(&value, page + slot->offset + slot->length, sizeof(value));
+	return true;
+}
+
+
+bool HashIndex::insert(uint64_t key, uint64_t value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	BPlusTree::encodeKey(key, buffer);
+	return insert(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+bool HashIndex::update(uint64_t key, uint64_t value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	BPlusTree::encodeKey(key, buffer);
+	return update(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+bool HashIndex::remove(uint64_t key) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	BPlusTree::encodeKey(key, buffer);
+	return remove(buffer, BTREE_UINT64_KEY_LENGTH);
+}
+
+
+bool HashIndex::find(uint64_t key, uint64_t& value) {
+	uint8_t buffer[BTREE_UINT64_KEY_LENGTH];
+	BPlusTree::encodeKey(key, buffer);
+	return find(buffer, BTREE_UINT64_KEY_LENGTH, value);
+}
+
+
+
+/*
+* @brief Checks directory references, buckets keys hashes and index counters
+* @return true if index is consistent, false otherwise
+*/
+bool HashIndex::checkIntegrity() {
+	std::shared_lock lock(indexMutex);
+	if (!cachedFile.isOpen()) return false;
+	return checkDirectory();
+}
+
+
+
+/*
+* @brief Checks every bucket referenced by directory (called under lock or by open)
+* @return true if index is consistent, false otherwise
+*/
+bool HashIndex::checkDirectory() {
+
+	struct BucketRefs { uint64_t firstIndex; uint16_t localDepth; uint64_t refs; };
+	std::map<uint64_t, BucketRefs> buckets;
+	uint64_t keys = 0, bytes = 0, pages = 0;
+
+	for (uint64_t i = 0; i < directory.size(); i++) {
+		auto it = buckets.find(directory[i]);
+		if (it == buckets.end()) {
+			uint16_t localDepth;
+			if (!checkBucket(directory[i], i, localDepth, keys, bytes, pages)) return false;
+			buckets.emplace(directory[i], BucketRefs{ i, localDepth, 1 });
+			continue;
+		}
+		// all entries of bucket have the same low localDepth bits
+		uint64_t mask = (1ULL << it->second.localDepth) - 1;
+		if ((i & mask) != (it->second.firstIndex & mask)) return false;
+		it->second.refs++;
+	}
+
+	for (auto& [bucketPage, bucket] : buckets) {
+		if (bucket.refs != 1ULL << (indexHeader.globalDepth - bucket.localDepth)) return false;
+	}
+
+	return buckets.size() == indexHeader.bucketsCount && keys == indexHeader.keysCount &&
+		bytes == indexHeader.usedBytes && pages == indexHeader.bucketsCount + indexHeader.overflowPages;
+}
+
+
+//-----------------------------------------------------------------------------
+// Buckets methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Finds key slot in bucket pages of key hash
+*  @param[out] page - page with key or the last bucket page if key not found
+*  @param[out] pageNo - page number (NOT_FOUND if page read fails)
+*  @param[out] index - key slot index in page
+*  @return true if key found, false otherwise
+*/
+bool HashIndex::locateKey(const uint8_t* key, uint16_t length, uint32_t hash, uint8_t* page, uint64_t& pageNo, uint32_t& index) {
+	HashPageHeader* header = (HashPageHeader*)page;
+	HashSlot* slots = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE);
+	uint64_t nextPage = directory[hash & (directory.size() - 1)];
+	while (nextPage != 0) {
+		pageNo = nextPage;
+		if (!readPage(pageNo, page) || header->type != HASH_BUCKET) {
+			pageNo = NOT_FOUND;
+			return false;
+		}
+		for (index = 0; index < header->keysCount; index++) {
+			if (slots[index].hash == hash && slots[index].length == length &&
+				(length == 0 || memcmp(page + slots[index].offset, key, length) == 0)) return true;
+		}
+		nextPage = header->nextPage;
+	}
+	return false;
+}
+
+
+
+/*
+*  @brief Splits bucket by its next hash bit to new bucket. Both buckets are
+*  written first, then old overflow pages are freed, and changed directory
+*  pages and header are written. Directory has bit for split.
+*  @return true if split, false if failed (bucket and directory are as they were)
+*/
+bool HashIndex::splitBucket(uint64_t bucketPage) {
+
+	uint16_t localDepth;
+	std::vector<HashEntry> entries;
+	std::vector<uint64_t> overflow;
+	if (!readBucket(bucketPage, localDepth, entries, overflow)) return false;
+
+	uint32_t bit = 1U << localDepth;
+	std::vector<HashEntry> lowEntries, highEntries;
+	for (auto& entry : entries) {
+		if (entry.hash & bit) highEntries.push_back(std::move(entry));
+		else lowEntries.push_back(std::move(entry));
+	}
+
+	uint64_t newPage = allocatePage();
+	if (newPage == NOT_FOUND) return false;
+	std::vector<uint64_t> highPages, lowPages;
+	if (!writeBucket(newPage, localDepth + 1, highEntries, highPages)) {
+		freePage(newPage);
+		return false;
+	}
+	if (!writeBucket(bucketPage, localDepth + 1, lowEntries, lowPages)) {
+		for (uint64_t pageNo : highPages) freePage(pageNo);
+		return false;
+	}
+	for (uint64_t pageNo : overflow) freePage(pageNo);
+	indexHeader.overflowPages += highPages.size() + lowPages.size() - 2;
+	indexHeader.overflowPages -= overflow.size();
+
+	// half of entries referencing bucket now reference new bucket
+	size_t firstPage = directoryPages.size(), lastPage = 0;
+	for (uint64_t i = 0; i < directory.size(); i++) {
+		if (directory[i] != bucketPage || !(i & bit)) continue;
+		directory[i] = newPage;
+		firstPage = std::min<size_t>(firstPage, i / HASH_DIRECTORY_ENTRIES);
+		lastPage = i / HASH_DIRECTORY_ENTRIES;
+	}
+	indexHeader.bucketsCount++;
+	for (size_t i = firstPage; i <= lastPage && i < directoryPages.size(); i++) {
+		if (!writeDirectoryPage(i)) return false;
+	}
+	return writeHeader();
+}
+
+
+
+/*
+*  @brief Doubles directory: entries with new high bit reference the same
+*  buckets, so no bucket is changed
+*  @return true if doubled, false if directory is at max depth
+*/
+bool HashIndex::doubleDirectory() {
+	if (indexHeader.globalDepth >= HASH_MAX_DEPTH) return false;
+	size_t size = directory.size();
+	size_t pagesSize = directoryPages.size();
+	directory.resize(size * 2);
+	std::copy(directory.begin(), directory.begin() + size, directory.begin() + size);
+	size_t neededPages = (directory.size() + HASH_DIRECTORY_ENTRIES - 1) / HASH_DIRECTORY_ENTRIES;
+	while (directoryPages.size() < neededPages) {
+		uint64_t pageNo = allocatePage();
+		if (pageNo == NOT_FOUND) {
+			for (size_t i = pagesSize; i < directoryPages.size(); i++) freePage(directoryPages[i]);
+			directoryPages.resize(pagesSize);
+			directory.resize(size);
+			return false;
+		}
+		directoryPages.push_back(pageNo);
+	}
+	indexHeader.globalDepth++;
+	// directory pages are written before header listing them
+	return writeDirectory() && writeHeader();
+}
+
+
+
+/*
+*  @brief Reads entries of bucket pages
+*  @param[out] overflow - overflow pages of bucket
+*  @return true if read, false otherwise
+*/
+bool HashIndex::readBucket(uint64_t bucketPage, uint16_t& localDepth, std::vector<HashEntry>& entries, std::vector<uint64_t>& overflow) {
+	uint8_t page[PAGE_SIZE];
+	HashPageHeader* header = (HashPageHeader*)page;
+	HashSlot* slots = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE);
+	for (uint64_t pageNo = bucketPage; pageNo != 0; pageNo = header->nextPage) {
+		if (!readPage(pageNo, page) || header->type != HASH_BUCKET) return false;
+		if (pageNo == bucketPage) localDepth = header->localDepth;
+		else overflow.push_back(pageNo);
+		for (uint32_t i = 0; i < header->keysCount; i++) {
+			const uint8_t* entry = page + slots[i].offset;
+			HashEntry decoded{ slots[i].hash, std::vector<uint8_t>(entry, entry + slots[i].length), 0 };
+			memcpy(&decoded.value, entry + slots[i].length, sizeof(uint64_t));
+			entries.push_back(std::move(decoded));
+		}
+	}
+	return true;
+}
+
+
+
+/*
+*  @brief Writes entries to bucket page and overflow pages if needed. Overflow
+*  pages are allocated before any page is written, so bucket page is not
+*  changed if allocation fails.
+*  @param[out] pages - bucket page and its overflow pages (empty if failed)
+*  @return true if written, false otherwise
+*/
+bool HashIndex::writeBucket(uint64_t bucketPage, uint16_t localDepth, const std::vector<HashEntry>& entries, std::vector<uint64_t>& pages) {
+
+	pages.assign(1, bucketPage);
+	uint32_t freeBytes = HASH_BUCKET_CAPACITY;
+	for (auto& entry : entries) {
+		uint32_t neededBytes = uint32_t(sizeof(HashSlot) + entry.key.size() + sizeof(uint64_t));
+		if (freeBytes < neededBytes) {
+			uint64_t nextPage = allocatePage();
+			if (nextPage == NOT_FOUND) {
+				for (size_t i = 1; i < pages.size(); i++) freePage(pages[i]);
+				pages.clear();
+				return false;
+			}
+			pages.push_back(nextPage);
+			freeBytes = HASH_BUCKET_CAPACITY;
+		}
+		freeBytes -= neededBytes;
+	}
+
+	uint8_t page[PAGE_SIZE];
+	size_t current = 0;
+	initPage(page, HASH_BUCKET, localDepth);
+	for (auto& entry : entries) {
+		uint32_t neededBytes = uint32_t(sizeof(HashSlot) + entry.key.size() + sizeof(uint64_t));
+		if (getFreeBytes(page) < neededBytes) {
+			((HashPageHeader*)page)->nextPage = pages[current + 1];
+			if (!writePage(pages[current], page)) return false;
+			initPage(page, HASH_BUCKET, localDepth);
+			current++;
+		}
+		addEntry(page, entry.hash, entry.key.data(), (uint16_t)entry.key.size(), entry.value);
+	}
+	return writePage(pages[current], page);
+}
+
+
+
+/*
+*  @brief Checks bucket pages and hashes of keys against directory index
+*  @return true if bucket is consistent, false otherwise
+*/
+bool HashIndex::checkBucket(uint64_t bucketPage, uint64_t directoryIndex, uint16_t& localDepth, uint64_t& keys, uint64_t& bytes, uint64_t& pages) {
+	uint8_t page[PAGE_SIZE];
+	HashPageHeader* header = (HashPageHeader*)page;
+	HashSlot* slots = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE);
+	for (uint64_t pageNo = bucketPage; pageNo != 0; pageNo = header->nextPage) {
+		if (!readPage(pageNo, page) || header->type != HASH_BUCKET) return false;
+		if (pageNo == bucketPage) localDepth = header->localDepth;
+		if (header->localDepth != localDepth || localDepth > indexHeader.globalDepth) return false;
+		uint32_t mask = (uint32_t)((1ULL << localDepth) - 1);
+		uint32_t entriesBytes = 0;
+		for (uint32_t i = 0; i < header->keysCount; i++) {
+			if (slots[i].offset < header->dataStart || slots[i].offset + slots[i].length + sizeof(uint64_t) > PAGE_SIZE) return false;
+			if (getHash(page + slots[i].offset, slots[i].length) != slots[i].hash) return false;
+			if ((slots[i].hash & mask) != (directoryIndex & mask)) return false;
+			entriesBytes += slots[i].length + sizeof(uint64_t);
+		}
+		// entries are stored without gaps
+		if (entriesBytes != PAGE_SIZE - header->dataStart) return false;
+		keys += header->keysCount;
+		bytes += header->keysCount * sizeof(HashSlot) + entriesBytes;
+		pages++;
+	}
+	return true;
+}
+
+
+
+void HashIndex::initPage(uint8_t* page, uint16_t type, uint16_t localDepth) {
+	memset(page, 0, PAGE_SIZE);
+	HashPageHeader* header = (HashPageHeader*)page;
+	header->type = type;
+	header->dataStart = (uint16_t)PAGE_SIZE;
+	header->localDepth = localDepth;
+}
+
+
+
+uint32_t HashIndex::getFreeBytes(const uint8_t* page) {
+	const HashPageHeader* header = (const HashPageHeader*)page;
+	return header->dataStart - uint32_t(HASH_PAGE_HEADER_SIZE + header->keysCount * sizeof(HashSlot));
+}
+
+
+
+/*
+*  @brief Low 32 bits of key hash (the same hash as Bloom filter of BPlusTree)
+*/
+uint32_t HashIndex::getHash(const uint8_t* key, uint16_t length) {
+	return (uint32_t)BPlusTreeBloomFilter::hashKey(key, length);
+}
+
+
+
+/*
+*  @brief Appends entry and its slot, page must have free bytes for them
+*/
+void HashIndex::addEntry(uint8_t* page, uint32_t hash, const uint8_t* key, uint16_t length, uint64_t value) {
+	HashPageHeader* header = (HashPageHeader*)page;
+	HashSlot* slots = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE);
+	header->dataStart -= uint16_t(length + sizeof(uint64_t));
+	if (length > 0) memcpy(page + header->dataStart, key, length);
+	memcpy(page + header->dataStart + length, &value, sizeof(uint64_t));
+	slots[header->keysCount++] = HashSlot{ hash, header->dataStart, length };
+}
+
+
+
+/*
+*  @brief Removes entry closing its gap, the last slot takes its place
+*/
+void HashIndex::removeEntry(uint8_t* page, uint32_t index) {
+	HashPageHeader* header = (HashPageHeader*)page;
+	HashSlot* slots = (HashSlot*)(page + HASH_PAGE_HEADER_SIZE);
+	uint16_t offset = slots[index].offset;
+	uint16_t size = uint16_t(slots[index].length + sizeof(uint64_t));
+	memmove(page + header->dataStart + size, page + header->dataStart, offset - header->dataStart);
+	for (uint32_t i = 0; i < header->keysCount; i++) {
+		if (slots[i].offset < offset) slots[i].offset += size;
+	}
+	header->dataStart += size;
+	slots[index] = slots[--header->keysCount];
+	memset(slots + header->keysCount, 0, sizeof(HashSlot));
+}
+
+
+//-----------------------------------------------------------------------------
+// Pages methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Reads page and verifies its checksum
+*  @return true if page is read and consistent, false otherwise
+*/
+bool HashIndex::readPage(uint64_t pageNo, uint8_t* page) {
+	if (pageNo == 0 || pageNo >= indexHeader.pagesCount) return false;
+	if (cachedFile.read(pageNo * PAGE_SIZE, page, PAGE_SIZE) != PAGE_SIZE) return false;
+	uint32_t checksum = checksumFunction(page + HASH_CHECKSUM_SIZE, PAGE_SIZE - HASH_CHECKSUM_SIZE);
+	return checksum == ((HashPageHeader*)page)->checksum;
+}
+
+
+
+/*
+*  @brief Updates page checksum and writes page
+*  @return true if page written, false otherwise
+*/
+bool HashIndex::writePage(uint64_t pageNo, uint8_t* page) {
+	HashPageHeader* header = (HashPageHeader*)page;
+	header->checksum = checksumFunction(page + HASH_CHECKSUM_SIZE, PAGE_SIZE - HASH_CHECKSUM_SIZE);
+	return cachedFile.write(pageNo * PAGE_SIZE, page, PAGE_SIZE) == PAGE_SIZE;
+}
+
+
+
+/*
+*  @brief Takes page from free pages list or grows file
+*  @return page number or NOT_FOUND if free page is corrupt
+*/
+uint64_t HashIndex::allocatePage() {
+	if (indexHeader.freePages == 0) return indexHeader.pagesCount++;
+	uint8_t page[PAGE_SIZE];
+	uint64_t pageNo = indexHeader.freePages;
+	if (!readPage(pageNo, page) || ((HashPageHeader*)page)->type != HASH_FREE) return NOT_FOUND;
+	indexHeader.freePages = ((HashPageHeader*)page)->nextPage;
+	return pageNo;
+}
+
+
+
+/*
+*  @brief Puts page to the head of free pages list
+*  @return true if page released, false otherwise
+*/
+bool HashIndex::freePage(uint64_t pageNo) {
+	uint8_t page[PAGE_SIZE];
+	initPage(page, HASH_FREE, 0);
+	((HashPageHeader*)page)->nextPage = indexHeader.freePages;
+	if (!writePage(pageNo, page)) return false;
+	indexHeader.freePages = pageNo;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Header methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Writes header of empty index: directory page 1 references
+*  empty bucket page 2
+*/
+void HashIndex::createHeader() {
+
+	indexHeader = HashHeader{};
+	indexHeader.signature = HASH_SIGNATURE;
+	indexHeader.version = HASH_VERSION;
+	indexHeader.checksumType = (uint32_t)ChecksumType::CRC32C;
+	indexHeader.globalDepth = 0;
+	indexHeader.pagesCount = 3;
+	indexHeader.bucketsCount = 1;
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+	directoryPages.assign(1, 1);
+	directory.assign(1, 2);
+
+	// header occupies whole first page, so other pages are page aligned
+	uint8_t page[PAGE_SIZE] = {};
+	cachedFile.write(0, page, PAGE_SIZE);
+	initPage(page, HASH_BUCKET, 0);
+	writePage(directory[0], page);
+	writeDirectory();
+	writeHeader();
+}
+
+
+
+/*
+*  @brief Saves header to the first page
+*  @return true - if succeeded, false - if failed
+*/
+bool HashIndex::writeHeader() {
+	indexHeader.headerChecksum = checksumFunction((const uint8_t*)&indexHeader, HASH_HEADER_PAYLOAD_SIZE);
+	return cachedFile.write(0, &indexHeader, HASH_HEADER_SIZE) == HASH_HEADER_SIZE;
+}
+
+
+
+/*
+*  @brief Sets header state to changed and persists it before the first change
+*  after flush, so index not flushed since is known on open
+*  @return true - if succeeded, false - if failed
+*/
+bool HashIndex::markChanged() {
+	if (indexHeader.state == HASH_CHANGED) return true;
+	indexHeader.state = HASH_CHANGED;
+	return writeHeader() && cachedFile.flush();
+}
+
+
+
+/*
+*  @brief Persists changed pages, then header state saying index is flushed
+*  @return true - if succeeded, false - if failed
+*/
+bool HashIndex::markSynced() {
+	if (indexHeader.state == HASH_SYNCED) return cachedFile.flush();
+	// changes are persisted before the state saying so
+	if (!cachedFile.flush()) return false;
+	indexHeader.state = HASH_SYNCED;
+	return writeHeader() && cachedFile.flush();
+}
+
+
+
+/*
+*  @brief Loads header and directory, checks their consistency
+*  @return true - if succeeded, false - if failed
+*/
+bool HashIndex::loadHeader() {
+
+	HashHeader header;
+	if (cachedFile.read(0, &header, HASH_HEADER_SIZE) != HASH_HEADER_SIZE) return false;
+	if (header.signature != HASH_SIGNATURE || header.version != HASH_VERSION) return false;
+
+	ChecksumFunction fileChecksum = Checksum::getFunction((ChecksumType)header.checksumType);
+	if (fileChecksum == nullptr) return false;
+	if (fileChecksum((const uint8_t*)&header, HASH_HEADER_PAYLOAD_SIZE) != header.headerChecksum) return false;
+	if (header.globalDepth > HASH_MAX_DEPTH || header.pagesCount < 3) return false;
+
+	checksumFunction = fileChecksum;
+	indexHeader = header;
+
+	// directory pages listed after header, each keeps HASH_DIRECTORY_ENTRIES entries
+	uint64_t entries = 1ULL << header.globalDepth;
+	directory.resize(entries);
+	directoryPages.resize((entries + HASH_DIRECTORY_ENTRIES - 1) / HASH_DIRECTORY_ENTRIES);
+	size_t pagesLength = directoryPages.size() * sizeof(uint64_t);
+	if (cachedFile.read(HASH_HEADER_SIZE, directoryPages.data(), pagesLength) != pagesLength) return false;
+
+	uint8_t page[PAGE_SIZE];
+	const uint64_t* pageEntries = (const uint64_t*)(page + HASH_PAGE_HEADER_SIZE);
+	for (size_t i = 0; i < directoryPages.size(); i++) {
+		if (!readPage(directoryPages[i], page) || ((HashPageHeader*)page)->type != HASH_DIRECTORY) return false;
+		uint64_t first = i * HASH_DIRECTORY_ENTRIES;
+		uint64_t count = std::min(HASH_DIRECTORY_ENTRIES, entries - first);
+		for (uint64_t j = 0; j < count; j++) {
+			uint64_t bucketPage = pageEntries[j];
+			if (bucketPage == 0 || bucketPage >= header.pagesCount) return false;
+			directory[first + j] = bucketPage;
+		}
+	}
+	return true;
+}
+
+
+
+/*
+*  @brief Writes directory entries to directory pages and their list after header
+*  @return true - if succeeded, false - if failed
+*/
+bool HashIndex::writeDirectory() {
+	for (size_t i = 0; i < directoryPages.size(); i++) {
+		if (!writeDirectoryPage(i)) return false;
+	}
+	size_t pagesLength = directoryPages.size() * sizeof(uint64_t);
+	return cachedFile.write(HASH_HEADER_SIZE, directoryPages.data(), pagesLength) == pagesLength;
+}
+
+
+
+/*
+*  @brief Writes directory entries kept by one directory page
+*  @param[in] index - directory page index in directory pages list
+*  @return true - if succeeded, false - if failed
+*/
+bool HashIndex::writeDirectoryPage(size_t index) {
+	uint8_t page[PAGE_SIZE];
+	initPage(page, HASH_DIRECTORY, 0);
+	uint64_t first = index * HASH_DIRECTORY_ENTRIES;
+	uint64_t count = std::min<uint64_t>(HASH_DIRECTORY_ENTRIES, directory.size() - first);
+	memcpy(page + HASH_PAGE_HEADER_SIZE, directory.data() + first, count * sizeof(uint64_t));
+	return writePage(directoryPages[index], page);
+}
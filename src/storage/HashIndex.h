@@ -0,0 +1,197 @@
+/******************************************************************************
+*
+*  HashIndex class header
+*
+*  HashIndex is page based extendible hash index mapping keys (document IDs,
+*  UUIDs or other byte strings) to 64-bit values, alternative to BPlusTree
+*  for point lookups only. Directory of 2^depth bucket pages is kept in
+*  memory, so lookup reads one bucket page through CachedFileIO regardless
+*  of keys count (two if bucket has overflow page).
+*
+*  Features:
+*    - insert/update/remove/find variable length keys (no keys order)
+*    - 64-bit unsigned keys encoded as in BPlusTree
+*    - incremental growth: full bucket is split alone, directory is doubled
+*      only when split bucket is as deep as directory
+*    - overflow pages for buckets at max depth
+*    - load factor metric, free pages reuse, checksum per page
+*    - directory and header written with each split, index not flushed
+*      after its last change is checked on open
+*    - lookups run in parallel, changes are exclusive
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include "CachedFileIO.h"
+#include "Checksum.h"
+#include "BPlusTree.h"
+
+#include <shared_mutex>
+#include <vector>
+
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Hash index file header signature and version
+		//----------------------------------------------------------------------------
+		constexpr uint32_t HASH_SIGNATURE = 0x48534148;         // HASH signature
+		constexpr uint32_t HASH_VERSION = 0x00000001;           // Version 1
+
+		constexpr uint16_t HASH_BUCKET = 1;                     // Bucket page: keys and values
+		constexpr uint16_t HASH_DIRECTORY = 2;                  // Directory page: bucket pages numbers
+		constexpr uint16_t HASH_FREE = 3;                       // Free page in free pages list
+
+		constexpr uint32_t HASH_MAX_KEY_LENGTH = BTREE_MAX_KEY_LENGTH;  // Max key length
+		constexpr uint32_t HASH_MAX_DEPTH = 19;                 // Max directory depth (512K buckets)
+
+		constexpr uint32_t HASH_SYNCED = 0;                     // Index flushed, all pages persisted
+		constexpr uint32_t HASH_CHANGED = 1;                    // Index changed since last flush
+
+		//----------------------------------------------------------------------------
+		// Hash index header structure (72 bytes), occupies first page followed by
+		// directory pages numbers
+		//----------------------------------------------------------------------------
+		struct HashHeader {
+			uint32_t      signature;           // HASH signature
+			uint32_t      version;             // Format version
+			uint32_t      checksumType;        // Checksum type of pages
+			uint32_t      globalDepth;         // Directory has 2^globalDepth entries
+			uint64_t      keysCount;           // Total keys in index
+			uint64_t      pagesCount;          // Total pages including header page
+			uint64_t      bucketsCount;        // Buckets count (directory targets)
+			uint64_t      overflowPages;       // Overflow pages count
+			uint64_t      usedBytes;           // Slots and entries bytes in buckets
+			uint64_t      freePages;           // First page of free pages list (0 - none)
+			uint32_t      state;               // HASH_SYNCED or HASH_CHANGED
+			uint32_t      headerChecksum;      // Checksum for header consistency check
+		};
+
+		constexpr uint64_t HASH_HEADER_SIZE = sizeof(HashHeader);
+		constexpr uint64_t HASH_HEADER_PAYLOAD_SIZE = HASH_HEADER_SIZE - sizeof(HashHeader::headerChecksum);
+		constexpr uint64_t HASH_MAX_DIRECTORY_PAGES = (PAGE_SIZE - HASH_HEADER_SIZE) / sizeof(uint64_t);
+
+		//----------------------------------------------------------------------------
+		// Page header structure (24 bytes). Bucket page keeps array of slots after
+		// header, entries [key][value] are stored from page end without gaps.
+		// Directory page keeps array of bucket pages numbers after header.
+		//----------------------------------------------------------------------------
+		struct HashPageHeader {
+			uint32_t      checksum;            // Checksum of page data after this field
+			uint16_t      type;                // Page type (HASH_BUCKET, HASH_DIRECTORY, HASH_FREE)
+			uint16_t      keysCount;           // Bucket: keys in page
+			uint16_t      dataStart;           // Bucket: start of entries area
+			uint16_t      localDepth;          // Bucket: low hash bits common to its keys
+			uint32_t      reserved;            // Reserved (zero)
+			uint64_t      nextPage;            // Bucket: overflow page, free page: next free (0 - none)
+		};
+
+		//----------------------------------------------------------------------------
+		// Bucket slot (8 bytes): low 32 bits of key hash (directory bits), so most
+		// keys are rejected without comparing key bytes
+		//----------------------------------------------------------------------------
+		struct HashSlot {
+			uint32_t      hash;                // Low 32 bits of key hash
+			uint16_t      offset;              // Entry offset in page
+			uint16_t      length;              // Key length
+		};
+
+		constexpr uint64_t HASH_PAGE_HEADER_SIZE = sizeof(HashPageHeader);
+		constexpr uint64_t HASH_CHECKSUM_SIZE = sizeof(HashPageHeader::checksum);
+		constexpr uint32_t HASH_BUCKET_CAPACITY = (uint32_t)(PAGE_SIZE - HASH_PAGE_HEADER_SIZE);
+		constexpr uint64_t HASH_DIRECTORY_ENTRIES = (PAGE_SIZE - HASH_PAGE_HEADER_SIZE) / sizeof(uint64_t);
+
+		static_assert((1ULL << HASH_MAX_DEPTH) <= HASH_MAX_DIRECTORY_PAGES * HASH_DIRECTORY_ENTRIES,
+			"Directory of max depth must fit directory pages listed in header page");
+
+		//----------------------------------------------------------------------------
+		// Decoded bucket entry for splits
+		//----------------------------------------------------------------------------
+		struct HashEntry {
+			uint32_t              hash;
+			std::vector<uint8_t>  key;
+			uint64_t              value;
+		};
+
+		//----------------------------------------------------------------------------
+		// HashIndex
+		//----------------------------------------------------------------------------
+		class HashIndex {
+		public:
+			HashIndex();
+			HashIndex(const HashIndex&) = delete;
+			void operator=(const HashIndex&) = delete;
+			~HashIndex();
+
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE);
+			bool flush();
+			bool isOpen();
+			bool isReadOnly();
+			bool close();
+
+			uint64_t getFileSize();
+			uint64_t getTotalKeys();
+			uint64_t getTotalPages();
+			uint64_t getTotalBuckets();
+			uint32_t getGlobalDepth();
+			double   getLoadFactor();
+
+			bool insert(const void* key, uint32_t keyLength, uint64_t value);
+			bool update(const void* key, uint32_t keyLength, uint64_t value);
+			bool remove(const void* key, uint32_t keyLength);
+			bool find(const void* key, uint32_t keyLength, uint64_t& value);
+
+			bool insert(uint64_t key, uint64_t value);
+			bool update(uint64_t key, uint64_t value);
+			bool remove(uint64_t key);
+			bool find(uint64_t key, uint64_t& value);
+
+			bool checkIntegrity();
+
+			void   resetCacheStats();
+			double getCacheStats(CachedFileStats type);
+
+		protected:
+
+			std::shared_mutex     indexMutex;           // Lookups (shared), changes, open and close (exclusive)
+			CachedFileIO          cachedFile;
+			HashHeader            indexHeader;          // Header with actual counters
+			ChecksumFunction      checksumFunction;
+			std::vector<uint64_t> directory;            // Bucket page of each low hash bits value
+			std::vector<uint64_t> directoryPages;       // Pages keeping directory
+
+			void     createHeader();
+			bool     writeHeader();
+			bool     loadHeader();
+			bool     writeDirectory();
+			bool     writeDirectoryPage(size_t index);
+			bool     markChanged();
+			bool     markSynced();
+			bool     checkDirectory();
+
+			bool     readPage(uint64_t pageNo, uint8_t* page);
+			bool     writePage(uint64_t pageNo, uint8_t* page);
+			uint64_t allocatePage();
+			bool     freePage(uint64_t pageNo);
+
+			bool     locateKey(const uint8_t* key, uint16_t length, uint32_t hash, uint8_t* page, uint64_t& pageNo, uint32_t& index);
+			bool     splitBucket(uint64_t bucketPage);
+			bool     doubleDirectory();
+			bool     readBucket(uint64_t bucketPage, uint16_t& localDepth, std::vector<HashEntry>& entries, std::vector<uint64_t>& overflow);
+			bool     writeBucket(uint64_t bucketPage, uint16_t localDepth, const std::vector<HashEntry>& entries, std::vector<uint64_t>& pages);
+			bool     checkBucket(uint64_t bucketPage, uint64_t directoryIndex, uint16_t& localDepth, uint64_t& keys, uint64_t& bytes, uint64_t& pages);
+
+			static void     initPage(uint8_t* page, uint16_t type, uint16_t localDepth);
+			static uint32_t getFreeBytes(const uint8_t* page);
+			static uint32_t getHash(const uint8_t* key, uint16_t length);
+			static void     addEntry(uint8_t* page, uint32_t hash, const uint8_t* key, uint16_t length, uint64_t value);
+			static void     removeEntry(uint8_t* page, uint32_t index);
+		};
+
+	}
+
+}
@@ -0,0 +1,112 @@
+/******************************************************************************
+*
+*  LogCursor class implementation
+*
+*  LogCursor refers to record of log file by record ID, so it stays valid
+*  while record versions move: update appends new version to the log head
+*  and cleaner moves versions out of cleaned segments. Cursor navigates
+*  records in record ID order.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "LogFileIO.h"
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief LogCursor constructor
+* @param[in] lf - log file
+* @param[in] id - record ID
+* @param[in] length - record data length
+*/
+LogCursor::LogCursor(LogFileIO& lf, uint64_t id, uint32_t length) : logFile(lf) {
+	recordID.store(id);
+	dataLength.store(length);
+}
+
+
+
+/*
+* @brief Reads current version of record data
+* @param[out] data - pointer to buffer of getDataLength() bytes
+* @return true if data read, false if record changed length, removed or corrupt
+*/
+bool LogCursor::getRecordData(void* data) {
+	if (logFile.readRecordData(recordID.load(), data, dataLength.load())) return true;
+	// record could be updated by other cursor, refresh length
+	LogIndexEntry entry;
+	if (logFile.getIndexEntry(recordID.load(), entry)) dataLength.store(entry.dataLength);
+	return false;
+}
+
+
+
+/*
+* @brief Appends new version of record data
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes
+* @return true if record updated, false if removed or fails
+*/
+bool LogCursor::setRecordData(const void* data, uint32_t length) {
+	if (data == nullptr && length > 0) return false;
+	if (logFile.appendEntry(recordID.load(), 0, data, length, true) == NOT_FOUND) return false;
+	dataLength.store(length);
+	return true;
+}
+
+
+
+/*
+* @brief Checks if record still exists
+* @return true if record exists
+*/
+bool LogCursor::isValid() {
+	LogIndexEntry entry;
+	return logFile.getIndexEntry(recordID.load(), entry);
+}
+
+
+
+uint64_t LogCursor::getRecordID() {
+	return recordID.load();
+}
+
+
+
+uint32_t LogCursor::getDataLength() {
+	return dataLength.load();
+}
+
+
+
+/*
+* @brief Moves cursor to the record with next higher ID
+* @return true if moved, false if there is no next record
+*/
+bool LogCursor::next() {
+	std::shared_lock lock(logFile.indexMutex);
+	auto it = logFile.recordIndex.upper_bound(recordID.load());
+	if (it == logFile.recordIndex.end()) return false;
+	recordID.store(it->first);
+	dataLength.store(it->second.dataLength);
+	return true;
+}
+
+
+
+/*
+* @brief Moves cursor to the record with next lower ID
+* @return true if moved, false if there is no previous record
+*/
+bool LogCursor::previous() {
+	std::shared_lock lock(logFile.indexMutex);
+	auto it = logFile.recordIndex.lower_bound(recordID.load());
+	if (it == logFile.recordIndex.begin()) return false;
+	--it;
+	recordID.store(it->first);
+	dataLength.store(it->second.dataLength);
+	return true;
+}
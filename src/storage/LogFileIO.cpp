@@ -0,0 +1,762 @@
+/******************************************************************************
+*
+*  LogFileIO class implementation
+*
+*  Log file is a header page followed by fixed size segments. Segment is
+*  either free or keeps entries appended in log order after its header:
+*
+*    [ log header ] [ segment 0 ] [ segment 1 ] ... [ segment N ]
+*    segment: [ header (sequence) ] [ entry ] [ entry ] ... [ unused ]
+*    entry:   [ entry header ] [ data ] [ padding to 8 bytes ]
+*
+*  Segments are ordered by sequence rather than position, because cleaned
+*  segments are reused by the log head. On open segments are replayed by
+*  sequence: later entry of record replaces earlier one, tombstone removes
+*  record. Replay of segment stops at the first inconsistent entry, so torn
+*  write at the log tail is ignored. Entry keeps its segment sequence, so
+*  entries left from previous use of segment are never replayed.
+*
+*  Cleaner picks sealed segment with the best cost-benefit ratio (outdated
+*  space weighted by segment age), appends its live records to the head
+*  and releases batch of such segments only after moved records are
+*  flushed. Tombstones are moved too, unless segment is the oldest one
+*  (there are no older versions to hide).
+*  Lock order: append -> index. Readers hold index shared while reading
+*  entry, so segment is not reused under them.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "LogFileIO.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief LogFileIO constructor
+*/
+LogFileIO::LogFileIO() : logHeader{} {
+	// Checksum algorithm is set by log header on open
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+	headSegment = NOT_FOUND;
+	headPosition = 0;
+	nextSequence = 1;
+	nextRecordID.store(1);
+	segmentsCleaned.store(0);
+	cleanerStopped = true;
+}
+
+
+
+/*
+* @brief LogFileIO destructor and finalizations
+*/
+LogFileIO::~LogFileIO() {
+	if (!cachedFile.isOpen()) return;
+	close();
+}
+
+
+
+/**
+* @brief Opens log file and rebuilds records index replaying its segments
+* @param[in] segmentSize - segment size of new file (existing file keeps its own)
+* @param[in] backgroundCleaning - clean segments in background thread
+* @return true if log file successfuly opened, false otherwise
+*/
+bool LogFileIO::open(const char* path, bool isReadOnly, size_t cacheSize, uint32_t segmentSize, bool backgroundCleaning) {
+
+	std::unique_lock lock(storageMutex);
+
+	// Check if file is open
+	if (!cachedFile.open(path, isReadOnly, cacheSize)) {
+		const char* msg = "Can't operate on closed cached file.";
+		throw std::runtime_error(msg);
+	}
+
+	// If file is empty and write is permitted, then write initial log header
+	if (cachedFile.getFileSize() == 0 && !cachedFile.isReadOnly()) {
+		createLogHeader(segmentSize);
+	}
+
+	if (!loadLogHeader()) {
+		const char* msg = "Log file header is invalid or corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	if (!loadSegments()) {
+		const char* msg = "Log file segments are corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// Start background segment cleaning
+	if (!cachedFile.isReadOnly() && backgroundCleaning) {
+		cleanerStopped = false;
+		cleaner = std::thread(&LogFileIO::runCleaner, this);
+	}
+
+	return true;
+}
+
+
+
+/**
+* @brief Stops segment cleaning, saves log header and closes log file
+* @return true if log file successfuly closed, false otherwise
+*/
+bool LogFileIO::close() {
+
+	if (cleaner.joinable()) {
+		{
+			std::lock_guard lock(cleanerMutex);
+			cleanerStopped = true;
+		}
+		cleanerSignal.notify_all();
+		cleaner.join();
+	}
+
+	std::unique_lock lock(storageMutex);
+	if (!cachedFile.isOpen()) return false;
+	if (!cachedFile.isReadOnly()) {
+		std::lock_guard appendLock(appendMutex);
+		writeLogHeader();
+	}
+	return cachedFile.close();
+}
+
+
+
+/**
+*  @brief Persists log header and all changed cache pages to storage device
+*  @return true if all changed cache pages been persisted, false otherwise
+*/
+bool LogFileIO::flush() {
+	std::unique_lock lock(storageMutex);
+	if (!cachedFile.isReadOnly()) {
+		std::lock_guard appendLock(appendMutex);
+		writeLogHeader();
+	}
+	return cachedFile.flush();
+}
+
+
+bool LogFileIO::isOpen() {
+	return cachedFile.isOpen();
+}
+
+
+bool LogFileIO::isReadOnly() {
+	return cachedFile.isReadOnly();
+}
+
+
+uint64_t LogFileIO::getFileSize() {
+	return cachedFile.getFileSize();
+}
+
+
+uint64_t LogFileIO::getTotalRecords() {
+	std::shared_lock lock(indexMutex);
+	return recordIndex.size();
+}
+
+
+uint64_t LogFileIO::getTotalSegments() {
+	std::shared_lock lock(indexMutex);
+	return segments.size();
+}
+
+
+uint64_t LogFileIO::getFreeSegments() {
+	std::shared_lock lock(indexMutex);
+	return std::count_if(segments.begin(), segments.end(), [](const LogSegment& s) { return s.sequence == 0; });
+}
+
+
+uint64_t LogFileIO::getSegmentsCleaned() {
+	return segmentsCleaned.load();
+}
+
+
+/*
+*  @brief Returns max record data length (entry must fit segment)
+*  @return max data length in bytes
+*/
+uint32_t LogFileIO::getMaxDataLength() {
+	return (uint32_t)(logHeader.segmentSize - LOG_SEGMENT_HEADER_SIZE - LOG_ENTRY_HEADER_SIZE);
+}
+
+
+/*
+*  @brief Returns share of outdated entries in sealed (not head) segments
+*  @return garbage ratio (0-1)
+*/
+double LogFileIO::getGarbageRatio() {
+	std::shared_lock lock(indexMutex);
+	uint64_t usedBytes = 0, garbageBytes = 0;
+	for (uint64_t i = 0; i < segments.size(); i++) {
+		if (segments[i].sequence == 0 || i == headSegment) continue;
+		usedBytes += segments[i].usedBytes;
+		garbageBytes += segments[i].usedBytes - LOG_SEGMENT_HEADER_SIZE - segments[i].liveBytes;
+	}
+	return usedBytes == 0 ? 0.0 : double(garbageBytes) / double(usedBytes);
+}
+
+
+void LogFileIO::resetCacheStats() {
+	cachedFile.resetStats();
+}
+
+
+double LogFileIO::getCacheStats(CachedFileStats type) {
+	return cachedFile.getStats(type);
+}
+
+
+//-----------------------------------------------------------------------------
+// Records methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Creates new record appending it to the log
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes
+* @return returns shared pointer to the new record or nullptr if fails
+*/
+std::shared_ptr<LogCursor> LogFileIO::createRecord(const void* data, uint32_t length) {
+	if (cachedFile.isReadOnly() || (data == nullptr && length > 0)) return nullptr;
+	uint64_t recordID = nextRecordID.fetch_add(1);
+	if (appendEntry(recordID, 0, data, length, false) == NOT_FOUND) return nullptr;
+	return std::make_shared<LogCursor>(*this, recordID, length);
+}
+
+
+
+/*
+* @brief Returns cursor of record with given ID
+* @param[in] recordID - record ID
+* @return returns shared pointer to the record or nullptr if record doesn't exist
+*/
+std::shared_ptr<LogCursor> LogFileIO::getRecordByID(uint64_t recordID) {
+	LogIndexEntry entry;
+	if (!getIndexEntry(recordID, entry)) return nullptr;
+	return std::make_shared<LogCursor>(*this, recordID, entry.dataLength);
+}
+
+
+
+/*
+* @brief Returns cursor of record with the lowest ID
+* @return returns shared pointer to the record or nullptr if there are no records
+*/
+std::shared_ptr<LogCursor> LogFileIO::getFirstRecord() {
+	std::shared_lock lock(indexMutex);
+	if (recordIndex.empty()) return nullptr;
+	auto it = recordIndex.begin();
+	return std::make_shared<LogCursor>(*this, it->first, it->second.dataLength);
+}
+
+
+
+/*
+* @brief Returns cursor of record with the highest ID
+* @return returns shared pointer to the record or nullptr if there are no records
+*/
+std::shared_ptr<LogCursor> LogFileIO::getLastRecord() {
+	std::shared_lock lock(indexMutex);
+	if (recordIndex.empty()) return nullptr;
+	auto it = recordIndex.rbegin();
+	return std::make_shared<LogCursor>(*this, it->first, it->second.dataLength);
+}
+
+
+
+/*
+* @brief Removes record appending tombstone to the log
+* @return returns true if record is removed or false if fails
+*/
+bool LogFileIO::removeRecord(std::shared_ptr<LogCursor> cursor) {
+	if (cursor == nullptr || cachedFile.isReadOnly()) return false;
+	return appendEntry(cursor->getRecordID(), LOG_ENTRY_TOMBSTONE, nullptr, 0, true) != NOT_FOUND;
+}
+
+
+
+/*
+*  @brief Looks up current version of record
+*  @param[in] recordID - record ID
+*  @param[out] entry - current version position and length
+*  @return true if record exists, false otherwise
+*/
+bool LogFileIO::getIndexEntry(uint64_t recordID, LogIndexEntry& entry) {
+	std::shared_lock lock(indexMutex);
+	auto it = recordIndex.find(recordID);
+	if (it == recordIndex.end()) return false;
+	entry = it->second;
+	return true;
+}
+
+
+
+/*
+*  @brief Reads current version of record and checks its consistency
+*  @param[in] recordID - record ID
+*  @param[out] data - buffer for data
+*  @param[in] length - expected data length (buffer size)
+*  @return true if data read, false if record doesn't exist, has other length or is corrupt
+*/
+bool LogFileIO::readRecordData(uint64_t recordID, void* data, uint32_t length) {
+
+	// segment can't be released and reused while index is locked
+	std::shared_lock lock(indexMutex);
+	auto it = recordIndex.find(recordID);
+	if (it == recordIndex.end() || it->second.dataLength != length) return false;
+
+	uint64_t offset = it->second.offset;
+	LogEntryHeader header;
+	if (!readEntryHeader(offset, segments[getSegmentIndex(offset)].sequence, header)) return false;
+	if (header.recordID != recordID || header.dataLength != length) return false;
+	if (length > 0 && cachedFile.read(offset + LOG_ENTRY_HEADER_SIZE, data, length) != length) return false;
+
+	return checksumFunction((const uint8_t*)data, length) == header.dataChecksum;
+}
+
+
+
+/*
+*  @brief Appends entry to the log head and updates records index
+*  @param[in] recordID - record ID
+*  @param[in] flags - entry flags (LOG_ENTRY_TOMBSTONE)
+*  @param[in] data - pointer to data
+*  @param[in] length - length of data in bytes
+*  @param[in] mustExist - record must exist (update or removal)
+*  @param[in] expectedOffset - record must be at this position (move by cleaner)
+*  @return entry position or NOT_FOUND if failed or record changed
+*/
+uint64_t LogFileIO::appendEntry(uint64_t recordID, uint32_t flags, const void* data, uint32_t length,
+	bool mustExist, uint64_t expectedOffset) {
+
+	if (cachedFile.isReadOnly()) return NOT_FOUND;
+	uint64_t entrySize = getEntrySize(length);
+	if (length > getMaxDataLength()) return NOT_FOUND;
+
+	// Appends are sequential, index changes only here and in cleaner
+	std::lock_guard appendLock(appendMutex);
+
+	if (mustExist) {
+		std::shared_lock lock(indexMutex);
+		auto it = recordIndex.find(recordID);
+		if (it == recordIndex.end()) return NOT_FOUND;
+		if (expectedOffset != NOT_FOUND && it->second.offset != expectedOffset) return NOT_FOUND;
+	}
+
+	// Seal head segment if entry doesn't fit
+	if (headSegment == NOT_FOUND || headPosition + entrySize > getSegmentOffset(headSegment) + logHeader.segmentSize) {
+		if (!openHeadSegment()) return NOT_FOUND;
+	}
+
+	LogEntryHeader header;
+	header.recordID = recordID;
+	header.sequence = segments[headSegment].sequence;
+	header.dataLength = length;
+	header.flags = flags;
+	header.dataChecksum = checksumFunction((const uint8_t*)data, length);
+	header.headChecksum = checksumFunction((const uint8_t*)&header, LOG_ENTRY_HEADER_PAYLOAD_SIZE);
+
+	uint64_t offset = headPosition;
+	if (cachedFile.write(offset, &header, LOG_ENTRY_HEADER_SIZE) != LOG_ENTRY_HEADER_SIZE) return NOT_FOUND;
+	if (length > 0 && cachedFile.write(offset + LOG_ENTRY_HEADER_SIZE, data, length) != length) return NOT_FOUND;
+	headPosition += entrySize;
+
+	// Previous version becomes outdated
+	std::unique_lock lock(indexMutex);
+	segments[headSegment].usedBytes += entrySize;
+	auto it = recordIndex.find(recordID);
+	if (it != recordIndex.end()) {
+		segments[getSegmentIndex(it->second.offset)].liveBytes -= getEntrySize(it->second.dataLength);
+	}
+	if (flags & LOG_ENTRY_TOMBSTONE) {
+		if (it != recordIndex.end()) recordIndex.erase(it);
+	} else {
+		recordIndex[recordID] = { offset, length };
+		segments[headSegment].liveBytes += entrySize;
+	}
+
+	return offset;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Segments methods
+//-----------------------------------------------------------------------------
+
+
+uint64_t LogFileIO::getSegmentOffset(uint64_t index) {
+	return LOG_HEADER_AREA + index * logHeader.segmentSize;
+}
+
+
+uint64_t LogFileIO::getSegmentIndex(uint64_t offset) {
+	return (offset - LOG_HEADER_AREA) / logHeader.segmentSize;
+}
+
+
+uint64_t LogFileIO::getEntrySize(uint32_t dataLength) {
+	return (LOG_ENTRY_HEADER_SIZE + dataLength + LOG_ENTRY_ALIGNMENT - 1) / LOG_ENTRY_ALIGNMENT * LOG_ENTRY_ALIGNMENT;
+}
+
+
+
+/*
+*  @brief Starts new head segment reusing free segment or growing the file
+*  (caller holds append lock)
+*  @return true if succeeded, false otherwise
+*/
+bool LogFileIO::openHeadSegment() {
+
+	std::unique_lock lock(indexMutex);
+
+	uint64_t index = 0;
+	while (index < segments.size() && (segments[index].sequence != 0 || index == headSegment)) index++;
+	if (index == segments.size()) segments.emplace_back();
+
+	LogSegmentHeader header;
+	header.sequence = nextSequence;
+	header.signature = LOG_SEGMENT_SIGNATURE;
+	header.headerChecksum = checksumFunction((const uint8_t*)&header, LOG_SEGMENT_HEADER_PAYLOAD_SIZE);
+	uint64_t offset = getSegmentOffset(index);
+	if (cachedFile.write(offset, &header, LOG_SEGMENT_HEADER_SIZE) != LOG_SEGMENT_HEADER_SIZE) return false;
+
+	segments[index].sequence = nextSequence++;
+	segments[index].usedBytes = LOG_SEGMENT_HEADER_SIZE;
+	segments[index].liveBytes = 0;
+	headSegment = index;
+	headPosition = offset + LOG_SEGMENT_HEADER_SIZE;
+
+	// sealed segment could be worth cleaning
+	cleanerSignal.notify_one();
+
+	return true;
+}
+
+
+
+/*
+*  @brief Reads entry header and checks it belongs to segment of given sequence
+*  @return true if entry header is consistent, false otherwise
+*/
+bool LogFileIO::readEntryHeader(uint64_t offset, uint64_t sequence, LogEntryHeader& header) {
+	if (cachedFile.read(offset, &header, LOG_ENTRY_HEADER_SIZE) != LOG_ENTRY_HEADER_SIZE) return false;
+	if (checksumFunction((const uint8_t*)&header, LOG_ENTRY_HEADER_PAYLOAD_SIZE) != header.headChecksum) return false;
+	return header.sequence == sequence;
+}
+
+
+
+/*
+*  @brief Finds used segments and replays them in log order to rebuild records index
+*  @return true if succeeded, false otherwise
+*/
+bool LogFileIO::loadSegments() {
+
+	std::unique_lock lock(indexMutex);
+
+	uint64_t fileSize = cachedFile.getFileSize();
+	uint64_t segmentsCount = 0;
+	if (fileSize > LOG_HEADER_AREA) {
+		segmentsCount = (fileSize - LOG_HEADER_AREA + logHeader.segmentSize - 1) / logHeader.segmentSize;
+	}
+
+	segments.assign(segmentsCount, LogSegment{});
+	recordIndex.clear();
+	headSegment = NOT_FOUND;
+	nextSequence = 1;
+
+	// used segments in log order
+	std::vector<std::pair<uint64_t, uint64_t>> order;
+	LogSegmentHeader header;
+	for (uint64_t index = 0; index < segmentsCount; index++) {
+		if (cachedFile.read(getSegmentOffset(index), &header, LOG_SEGMENT_HEADER_SIZE) != LOG_SEGMENT_HEADER_SIZE) continue;
+		if (header.signature != LOG_SEGMENT_SIGNATURE || header.sequence == 0) continue;
+		if (checksumFunction((const uint8_t*)&header, LOG_SEGMENT_HEADER_PAYLOAD_SIZE) != header.headerChecksum) continue;
+		order.emplace_back(header.sequence, index);
+	}
+	std::sort(order.begin(), order.end());
+
+	uint64_t maxRecordID = 0;
+	for (auto& [sequence, index] : order) {
+		if (sequence < nextSequence) return false;
+		segments[index].sequence = sequence;
+		maxRecordID = std::max(maxRecordID, replaySegment(index));
+		nextSequence = sequence + 1;
+	}
+
+	// continue appending to the latest segment
+	if (!order.empty()) {
+		headSegment = order.back().second;
+		headPosition = getSegmentOffset(headSegment) + segments[headSegment].usedBytes;
+	}
+
+	nextRecordID.store(std::max(logHeader.nextRecordID, maxRecordID + 1));
+
+	return true;
+}
+
+
+
+/*
+*  @brief Applies segment entries to records index (caller holds index lock)
+*  @param[in] index - segment index
+*  @return max record ID found in segment
+*/
+uint64_t LogFileIO::replaySegment(uint64_t index) {
+
+	LogSegment& segment = segments[index];
+	uint64_t start = getSegmentOffset(index);
+	uint64_t end = start + logHeader.segmentSize;
+	uint64_t position = start + LOG_SEGMENT_HEADER_SIZE;
+	uint64_t maxRecordID = 0;
+	LogEntryHeader header;
+
+	// the first inconsistent entry is the end of segment
+	while (position + LOG_ENTRY_HEADER_SIZE <= end && readEntryHeader(position, segment.sequence, header)) {
+		uint64_t entrySize = getEntrySize(header.dataLength);
+		if (position + entrySize > end) break;
+
+		auto it = recordIndex.find(header.recordID);
+		if (it != recordIndex.end()) {
+			segments[getSegmentIndex(it->second.offset)].liveBytes -= getEntrySize(it->second.dataLength);
+		}
+		if (header.flags & LOG_ENTRY_TOMBSTONE) {
+			if (it != recordIndex.end()) recordIndex.erase(it);
+		} else {
+			recordIndex[header.recordID] = { position, header.dataLength };
+			segment.liveBytes += entrySize;
+		}
+
+		maxRecordID = std::max(maxRecordID, header.recordID);
+		position += entrySize;
+	}
+
+	segment.usedBytes = position - start;
+	return maxRecordID;
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Segments cleaning methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Cleans segments while outdated share of sealed segments exceeds ratio
+*  @param[in] garbageRatio - outdated share to stop at (0 - clean all outdated)
+*  @return number of segments cleaned
+*/
+uint32_t LogFileIO::clean(double garbageRatio) {
+
+	if (!cachedFile.isOpen() || cachedFile.isReadOnly()) return 0;
+	std::lock_guard lock(cleaningMutex);
+
+	// each segment is cleaned once at most, moved records fill new segments
+	uint32_t cleaned = 0;
+	uint64_t limit = getTotalSegments();
+	std::vector<uint64_t> moved;
+	while (cleaned + moved.size() < limit && getGarbageRatio() > garbageRatio) {
+		uint64_t victim = pickVictimSegment();
+		if (victim == NOT_FOUND || !moveSegmentRecords(victim)) break;
+		moved.push_back(victim);
+		if (moved.size() >= LOG_CLEANING_BATCH) {
+			cleaned += releaseSegments(moved);
+			moved.clear();
+		}
+	}
+	cleaned += releaseSegments(moved);
+
+	return cleaned;
+}
+
+
+
+/*
+*  @brief Picks sealed segment with the best benefit to cost ratio:
+*  (1 - u) * age / (1 + u), where u is live share of segment
+*  @return segment index or NOT_FOUND if nothing to clean
+*/
+uint64_t LogFileIO::pickVictimSegment() {
+
+	std::shared_lock lock(indexMutex);
+	uint64_t victim = NOT_FOUND;
+	double bestScore = 0;
+	double capacity = double(logHeader.segmentSize - LOG_SEGMENT_HEADER_SIZE);
+
+	for (uint64_t i = 0; i < segments.size(); i++) {
+		const LogSegment& segment = segments[i];
+		if (segment.sequence == 0 || i == headSegment) continue;
+		if (segment.liveBytes + LOG_SEGMENT_HEADER_SIZE >= segment.usedBytes) continue;
+		double utilization = double(segment.liveBytes) / capacity;
+		double age = double(nextSequence - segment.sequence);
+		double score = (1.0 - utilization) * age / (1.0 + utilization);
+		if (score > bestScore) {
+			bestScore = score;
+			victim = i;
+		}
+	}
+
+	return victim;
+}
+
+
+
+/*
+*  @brief Moves live records of segment to the log head. Segment is kept
+*  until moved records are flushed, but it's not used and not picked again.
+*  @param[in] index - segment index
+*  @return true if all records moved, false otherwise
+*/
+bool LogFileIO::moveSegmentRecords(uint64_t index) {
+
+	uint64_t sequence, usedBytes;
+	bool isOldest = true;
+	{
+		std::shared_lock lock(indexMutex);
+		if (index >= segments.size() || index == headSegment || segments[index].sequence == 0) return false;
+		sequence = segments[index].sequence;
+		usedBytes = segments[index].usedBytes;
+		for (auto& segment : segments) {
+			if (segment.sequence != 0 && segment.sequence < sequence) isOldest = false;
+		}
+	}
+
+	// sealed segment doesn't change, its entries are moved unless outdated
+	uint64_t start = getSegmentOffset(index);
+	uint64_t position = start + LOG_SEGMENT_HEADER_SIZE;
+	LogEntryHeader header;
+	std::vector<uint8_t> data;
+	while (position < start + usedBytes && readEntryHeader(position, sequence, header)) {
+		if (header.flags & LOG_ENTRY_TOMBSTONE) {
+			// tombstone hides versions in older segments
+			if (!isOldest) appendEntry(header.recordID, LOG_ENTRY_TOMBSTONE, nullptr, 0, false);
+		} else {
+			LogIndexEntry entry;
+			if (getIndexEntry(header.recordID, entry) && entry.offset == position) {
+				data.resize(header.dataLength);
+				if (header.dataLength > 0) cachedFile.read(position + LOG_ENTRY_HEADER_SIZE, data.data(), header.dataLength);
+				if (checksumFunction(data.data(), header.dataLength) != header.dataChecksum) return false;
+				appendEntry(header.recordID, 0, data.data(), header.dataLength, true, position);
+			}
+		}
+		position += getEntrySize(header.dataLength);
+	}
+
+	std::unique_lock lock(indexMutex);
+	if (segments[index].liveBytes != 0) return false;
+	segments[index].usedBytes = LOG_SEGMENT_HEADER_SIZE;
+
+	return true;
+}
+
+
+
+/*
+*  @brief Releases segments which records have been moved, after moved
+*  records reach storage device
+*  @param[in] moved - segments indexes
+*  @return number of segments released
+*/
+uint32_t LogFileIO::releaseSegments(const std::vector<uint64_t>& moved) {
+
+	if (moved.empty() || !cachedFile.flush()) return 0;
+
+	std::unique_lock lock(indexMutex);
+	LogSegmentHeader freeHeader{};
+	for (uint64_t index : moved) {
+		cachedFile.write(getSegmentOffset(index), &freeHeader, LOG_SEGMENT_HEADER_SIZE);
+		segments[index] = LogSegment{};
+	}
+	segmentsCleaned += moved.size();
+
+	return (uint32_t)moved.size();
+}
+
+
+
+/*
+*  @brief Background cleaner: checks garbage ratio periodically and when segment is sealed
+*/
+void LogFileIO::runCleaner() {
+	std::unique_lock lock(cleanerMutex);
+	while (!cleanerStopped) {
+		cleanerSignal.wait_for(lock, std::chrono::milliseconds(LOG_CLEANING_PERIOD_MS));
+		if (cleanerStopped) break;
+		lock.unlock();
+		clean(LOG_CLEANING_GARBAGE_RATIO);
+		lock.lock();
+	}
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Log header methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Initialize log header for new log file
+* @param[in] segmentSize - segment size (rounded up to pages)
+*/
+void LogFileIO::createLogHeader(uint32_t segmentSize) {
+	segmentSize = std::max(segmentSize, LOG_MIN_SEGMENT_SIZE);
+	logHeader.signature = LOG_SIGNATURE;
+	logHeader.version = LOG_VERSION;
+	logHeader.segmentSize = (uint32_t)((segmentSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE);
+	logHeader.checksumType = (uint32_t)ChecksumType::CRC32C;
+	logHeader.nextRecordID = 1;
+	logHeader.reserved = 0;
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+	writeLogHeader();
+}
+
+
+
+/*
+*  @brief Saves log header with next record ID to the file
+*  @return true - if succeeded, false - if failed
+*/
+bool LogFileIO::writeLogHeader() {
+	logHeader.nextRecordID = nextRecordID.load();
+	logHeader.headerChecksum = checksumFunction((const uint8_t*)&logHeader, LOG_HEADER_PAYLOAD_SIZE);
+	return cachedFile.write(0, &logHeader, LOG_HEADER_SIZE) == LOG_HEADER_SIZE;
+}
+
+
+
+/*
+*  @brief Loads log header and checks its consistency
+*  @return true - if succeeded, false - if failed
+*/
+bool LogFileIO::loadLogHeader() {
+
+	LogHeader header;
+	if (cachedFile.read(0, &header, LOG_HEADER_SIZE) != LOG_HEADER_SIZE) return false;
+	if (header.signature != LOG_SIGNATURE || header.version != LOG_VERSION) return false;
+
+	ChecksumFunction fileChecksum = Checksum::getFunction((ChecksumType)header.checksumType);
+	if (fileChecksum == nullptr) return false;
+	if (fileChecksum((const uint8_t*)&header, LOG_HEADER_PAYLOAD_SIZE) != header.headerChecksum) return false;
+	if (header.segmentSize < LOG_MIN_SEGMENT_SIZE || header.segmentSize % PAGE_SIZE != 0) return false;
+
+	checksumFunction = fileChecksum;
+	logHeader = header;
+	nextRecordID.store(header.nextRecordID);
+
+	return true;
+}
@@ -0,0 +1,226 @@
+/******************************************************************************
+*
+*  LogFileIO & LogCursor class header
+*
+*  LogFileIO is log-structured alternative to RecordFileIO for workloads of
+*  mostly new records and new record versions. Records are immutable entries
+*  appended sequentially to the head segment, update appends new version and
+*  removal appends tombstone, so nothing is rewritten in place. Offsets of
+*  current record versions are kept in memory index rebuilt on open by
+*  replaying segments in log order. Segment cleaner moves live records out
+*  of segments holding mostly outdated versions and reuses their space.
+*
+*  Features:
+*    - create/read/update/delete records by ID with RecordFileIO like API
+*    - purely sequential writes (HDD and cheap SSD friendly)
+*    - navigate records in record ID order
+*    - background cleaning of segments (cost-benefit victim selection)
+*    - data consistency check (checksum), torn log tail is ignored on open
+*    - thread safety
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include "CachedFileIO.h"
+#include "Checksum.h"
+
+#include <memory>
+#include <vector>
+#include <map>
+#include <shared_mutex>
+#include <condition_variable>
+
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Log file header signature and version
+		//----------------------------------------------------------------------------
+		constexpr uint32_t LOG_SIGNATURE = 0x474F4C4B;          // KLOG signature
+		constexpr uint32_t LOG_VERSION = 0x00000001;            // Version 1
+		constexpr uint32_t LOG_SEGMENT_SIGNATURE = 0x4D474553;  // SEGM signature
+		constexpr uint32_t LOG_ENTRY_TOMBSTONE = 1;             // Entry marks record removal
+
+		constexpr uint32_t LOG_SEGMENT_SIZE = 4 * 1024 * 1024;  // Default segment size
+		constexpr uint32_t LOG_MIN_SEGMENT_SIZE = 64 * 1024;    // Minimal segment size
+		constexpr uint64_t LOG_HEADER_AREA = PAGE_SIZE;         // Segments start after header page
+		constexpr uint32_t LOG_ENTRY_ALIGNMENT = 8;             // Entries are 8 bytes aligned
+		constexpr double   LOG_CLEANING_GARBAGE_RATIO = 0.25;   // Outdated share of sealed segments to clean
+		constexpr uint32_t LOG_CLEANING_PERIOD_MS = 100;        // Background cleaner check period
+		constexpr uint32_t LOG_CLEANING_BATCH = 16;             // Segments released by one flush
+
+		//----------------------------------------------------------------------------
+		// Log file header structure (32 bytes)
+		//----------------------------------------------------------------------------
+		struct LogHeader {
+			uint32_t      signature;           // KLOG signature
+			uint32_t      version;             // Format version
+			uint32_t      segmentSize;         // Segment size in bytes
+			uint32_t      checksumType;        // Checksum algorithm (ChecksumType)
+			uint64_t      nextRecordID;        // Next record ID to assign
+			uint32_t      reserved;            // Reserved (zero)
+			uint32_t      headerChecksum;      // Checksum for log header consistency check
+		};
+
+		constexpr uint64_t LOG_HEADER_SIZE = sizeof(LogHeader);
+		constexpr uint64_t LOG_HEADER_PAYLOAD_SIZE = LOG_HEADER_SIZE - sizeof(LogHeader::headerChecksum);
+
+		//----------------------------------------------------------------------------
+		// Segment header structure (16 bytes), free segment has zero sequence
+		//----------------------------------------------------------------------------
+		struct LogSegmentHeader {
+			uint64_t      sequence;            // Log order of segment
+			uint32_t      signature;           // SEGM signature
+			uint32_t      headerChecksum;      // Checksum for segment header consistency check
+		};
+
+		constexpr uint64_t LOG_SEGMENT_HEADER_SIZE = sizeof(LogSegmentHeader);
+		constexpr uint64_t LOG_SEGMENT_HEADER_PAYLOAD_SIZE = LOG_SEGMENT_HEADER_SIZE - sizeof(LogSegmentHeader::headerChecksum);
+
+		//----------------------------------------------------------------------------
+		// Log entry header structure (32 bytes), entry belongs to segment sequence,
+		// so entries left from previous use of segment are never replayed
+		//----------------------------------------------------------------------------
+		struct LogEntryHeader {
+			uint64_t      recordID;            // Record ID
+			uint64_t      sequence;            // Sequence of segment entry written to
+			uint32_t      dataLength;          // Data length in bytes
+			uint32_t      flags;               // Entry flags (LOG_ENTRY_TOMBSTONE)
+			uint32_t      dataChecksum;        // Checksum for data consistency check
+			uint32_t      headChecksum;        // Checksum for header consistency check
+		};
+
+		constexpr uint64_t LOG_ENTRY_HEADER_SIZE = sizeof(LogEntryHeader);
+		constexpr uint32_t LOG_ENTRY_HEADER_PAYLOAD_SIZE = LOG_ENTRY_HEADER_SIZE - sizeof(LogEntryHeader::headChecksum);
+
+		//----------------------------------------------------------------------------
+		// Current record version position and segment usage (in memory)
+		//----------------------------------------------------------------------------
+		struct LogIndexEntry {
+			uint64_t      offset;              // Entry position in file
+			uint32_t      dataLength;          // Data length in bytes
+		};
+
+		struct LogSegment {
+			uint64_t      sequence = 0;        // Log order of segment (0 - free)
+			uint64_t      usedBytes = 0;       // Bytes written including segment header
+			uint64_t      liveBytes = 0;       // Bytes of current record versions
+		};
+
+		class LogCursor;
+
+		//----------------------------------------------------------------------------
+		// LogFileIO
+		//----------------------------------------------------------------------------
+		class LogFileIO {
+			friend class LogCursor;
+		public:
+			LogFileIO();
+			LogFileIO(const LogFileIO&) = delete;
+			void operator=(const LogFileIO&) = delete;
+			~LogFileIO();
+
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE,
+				uint32_t segmentSize = LOG_SEGMENT_SIZE, bool backgroundCleaning = true);
+			bool flush();
+			bool isOpen();
+			bool isReadOnly();
+			bool close();
+
+			uint64_t getFileSize();
+			uint64_t getTotalRecords();
+			uint64_t getTotalSegments();
+			uint64_t getFreeSegments();
+			uint64_t getSegmentsCleaned();
+			uint32_t getMaxDataLength();
+			double   getGarbageRatio();
+
+			std::shared_ptr<LogCursor> createRecord(const void* data, uint32_t length);
+			std::shared_ptr<LogCursor> getRecordByID(uint64_t recordID);
+			std::shared_ptr<LogCursor> getFirstRecord();
+			std::shared_ptr<LogCursor> getLastRecord();
+			bool removeRecord(std::shared_ptr<LogCursor> cursor);
+
+			uint32_t clean(double garbageRatio = LOG_CLEANING_GARBAGE_RATIO);
+
+			void   resetCacheStats();
+			double getCacheStats(CachedFileStats type);
+
+		protected:
+
+			std::shared_mutex storageMutex;
+			std::shared_mutex indexMutex;                 // Records index and segments table
+			std::mutex        appendMutex;                // Log head (appends are sequential)
+			std::mutex        cleaningMutex;              // One cleaning at a time
+
+			CachedFileIO      cachedFile;
+			LogHeader         logHeader;
+			ChecksumFunction  checksumFunction;
+
+			std::map<uint64_t, LogIndexEntry> recordIndex; // Current versions by record ID
+			std::vector<LogSegment> segments;             // Segments by file order
+			uint64_t          headSegment;                // Segment appended to
+			uint64_t          headPosition;               // Next entry position
+			uint64_t          nextSequence;               // Sequence of next segment
+			std::atomic<uint64_t> nextRecordID;
+			std::atomic<uint64_t> segmentsCleaned;
+
+			std::thread             cleaner;
+			std::mutex              cleanerMutex;
+			std::condition_variable cleanerSignal;
+			bool                    cleanerStopped;
+
+			void     createLogHeader(uint32_t segmentSize);
+			bool     writeLogHeader();
+			bool     loadLogHeader();
+			bool     loadSegments();
+			uint64_t replaySegment(uint64_t index);
+
+			uint64_t getSegmentOffset(uint64_t index);
+			uint64_t getSegmentIndex(uint64_t offset);
+			bool     openHeadSegment();
+			bool     readEntryHeader(uint64_t offset, uint64_t sequence, LogEntryHeader& header);
+			uint64_t appendEntry(uint64_t recordID, uint32_t flags, const void* data, uint32_t length,
+			                     bool mustExist, uint64_t expectedOffset = NOT_FOUND);
+			bool     readRecordData(uint64_t recordID, void* data, uint32_t length);
+			bool     getIndexEntry(uint64_t recordID, LogIndexEntry& entry);
+
+			uint64_t pickVictimSegment();
+			bool     moveSegmentRecords(uint64_t index);
+			uint32_t releaseSegments(const std::vector<uint64_t>& moved);
+			void     runCleaner();
+
+			static uint64_t getEntrySize(uint32_t dataLength);
+		};
+
+
+		//----------------------------------------------------------------------------
+		// LogCursor - record of log file by ID, navigates records in ID order
+		//----------------------------------------------------------------------------
+		class LogCursor {
+		public:
+			LogCursor(LogFileIO& lf, uint64_t recordID, uint32_t dataLength);
+
+			bool     getRecordData(void* data);
+			bool     setRecordData(const void* data, uint32_t length);
+			bool     isValid();
+
+			uint64_t getRecordID();
+			uint32_t getDataLength();
+
+			bool     next();
+			bool     previous();
+
+		protected:
+			LogFileIO&            logFile;
+			std::atomic<uint64_t> recordID;
+			std::atomic<uint32_t> dataLength;
+		};
+
+	}
+
+}
@@ -0,0 +1,324 @@
+/******************************************************************************
+*
+*  ParallelScanner class implementation
+*
+*  ParallelScanner splits records file into partitions (page aligned ranges)
+*  and scans them in worker threads. Records tile the file from storage
+*  header to the end of data, so worker doesn't need records chain: it finds
+*  the first record header in its partition by checksum validated parsing
+*  (header is confirmed by the next header validation), then walks records
+*  physically by their capacity. Worker owns records which headers start in
+*  its partition. Deleted (free) and system records are skipped.
+*
+*  Records are delivered to callback concurrently from worker threads, or,
+*  in ordered mode, by the calling thread in file order. Scanner is intended
+*  for integrity checks, reindexing and exports.
+*
+*  Features:
+*    - no dependency on records chain, corrupt areas are skipped by resync
+*    - data consistency check (checksum)
+*    - bounded memory in ordered mode (partitions in flight per thread)
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "RecordFileIO.h"
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief ParallelScanner constructor
+*  @param[in] rf - records file
+*  @param[in] threadsCount - number of worker threads (0 - hardware concurrency)
+*  @param[in] ordered - true if records must be delivered in file order
+*/
+ParallelScanner::ParallelScanner(RecordFileIO& rf, uint32_t threadsCount, bool ordered) : recordFile(rf) {
+	if (threadsCount == 0) threadsCount = std::thread::hardware_concurrency();
+	this->threadsCount = std::max(1u, threadsCount);
+	this->ordered = ordered;
+	endOfData = 0;
+	scannedRecords = 0;
+	resyncs = 0;
+	stopped = false;
+}
+
+
+/*
+*  @brief Returns number of live records delivered by the last scan
+*  @return number of records
+*/
+uint64_t ParallelScanner::getScannedRecords() {
+	return scannedRecords;
+}
+
+
+/*
+*  @brief Returns number of times workers lost record boundary and searched
+*  for the next valid header (corrupt or concurrently changed areas)
+*  @return number of resyncs
+*/
+uint64_t ParallelScanner::getResyncs() {
+	return resyncs;
+}
+
+
+/*
+*  @brief Scans all live records of the file in parallel
+*  @param[in] callback - called for each record, returns false to stop scan
+*  (must be thread safe if scan is not ordered)
+*  @return true if all partitions scanned, false if stopped by callback
+*/
+bool ParallelScanner::scan(const ScanCallback& callback) {
+
+	uint64_t dataStart;
+	{
+		std::shared_lock lock(recordFile.headerMutex);
+		endOfData = recordFile.storageHeader.endOfData;
+		dataStart = recordFile.dataStart;
+	}
+
+	scannedRecords = 0;
+	resyncs = 0;
+	stopped = false;
+
+	if (endOfData <= dataStart) return true;
+
+	uint64_t partitionsCount = (endOfData - dataStart + SCAN_PARTITION_SIZE - 1) / SCAN_PARTITION_SIZE;
+	uint32_t workersCount = (uint32_t)std::min<uint64_t>(threadsCount, partitionsCount);
+	std::atomic<uint64_t> nextPartition = 0;
+
+	auto partitionStart = [&](uint64_t index) {
+		return std::min(endOfData, dataStart + index * SCAN_PARTITION_SIZE);
+	};
+
+	std::vector<std::thread> workers;
+
+	if (!ordered) {
+		// every worker delivers records of its partitions right away
+		for (uint32_t i = 0; i < workersCount; i++) {
+			workers.emplace_back([&]() {
+				Partition partition;
+				uint64_t index;
+				while (!stopped && (index = nextPartition++) < partitionsCount) {
+					scanPartition(partitionStart(index), partitionStart(index + 1), partition);
+					if (!deliver(partition, callback)) stopped = true;
+				}
+			});
+		}
+		for (std::thread& worker : workers) worker.join();
+		return !stopped;
+	}
+
+	// ordered: workers fill partitions, calling thread delivers them in order
+	uint64_t maxInFlight = (uint64_t)workersCount * SCAN_PARTITIONS_IN_FLIGHT;
+	std::vector<Partition> partitions(partitionsCount);
+	std::mutex partitionsMutex;
+	std::condition_variable partitionReady, partitionConsumed;
+	uint64_t consumed = 0;
+
+	for (uint32_t i = 0; i < workersCount; i++) {
+		workers.emplace_back([&]() {
+			uint64_t index;
+			while ((index = nextPartition++) < partitionsCount) {
+				{
+					// don't run too far ahead of consumer
+					std::unique_lock lock(partitionsMutex);
+					partitionConsumed.wait(lock, [&]() { return stopped || index < consumed + maxInFlight; });
+					if (stopped) return;
+				}
+				scanPartition(partitionStart(index), partitionStart(index + 1), partitions[index]);
+				{
+					std::lock_guard lock(partitionsMutex);
+					partitions[index].ready = true;
+				}
+				partitionReady.notify_all();
+			}
+		});
+	}
+
+	for (uint64_t index = 0; index < partitionsCount && !stopped; index++) {
+		{
+			std::unique_lock lock(partitionsMutex);
+			partitionReady.wait(lock, [&]() { return partitions[index].ready; });
+		}
+		if (!deliver(partitions[index], callback)) stopped = true;
+		Partition().buffer.swap(partitions[index].buffer);         // release memory
+		{
+			std::lock_guard lock(partitionsMutex);
+			consumed = index + 1;
+		}
+		partitionConsumed.notify_all();
+	}
+
+	partitionConsumed.notify_all();
+	for (std::thread& worker : workers) worker.join();
+
+	return !stopped;
+}
+
+
+/*
+*  @brief Delivers partition records to callback and clears partition
+*  @param[in] partition - scanned partition
+*  @param[in] callback - records callback
+*  @return true if scan should continue, false if stopped by callback
+*/
+bool ParallelScanner::deliver(Partition& partition, const ScanCallback& callback) {
+
+	bool proceed = true;
+	ScanRecord record;
+
+	for (ScanEntry& entry : partition.entries) {
+		if (stopped) { proceed = false; break; }
+		record.offset = entry.offset;
+		memcpy(&record.header, &entry.header, RECORD_HEADER_SIZE);
+		record.data = partition.buffer.data() + entry.dataOffset;
+		record.length = entry.dataLength;
+		scannedRecords++;
+		if (!callback(record)) { proceed = false; break; }
+	}
+
+	partition.entries.clear();
+	partition.buffer.clear();
+	partition.ready = false;
+
+	return proceed;
+}
+
+
+/*
+*  @brief Scans records which headers start in given file range
+*  @param[in] start - partition start position
+*  @param[in] end - partition end position
+*  @param[out] partition - live records headers and data
+*/
+void ParallelScanner::scanPartition(uint64_t start, uint64_t end, Partition& partition) {
+
+	partition.entries.clear();
+	partition.buffer.clear();
+
+	// read partition with a tail for records crossing partition end
+	std::vector<uint8_t> chunk;
+	uint64_t chunkStart = start;
+	uint64_t chunkLength = std::min<uint64_t>(end - start + SCAN_WINDOW_SIZE, endOfData - start);
+	chunk.resize(chunkLength);
+	chunk.resize(recordFile.cachedFile.read(start, chunk.data(), chunkLength));
+	uint64_t chunkEnd = chunkStart + chunk.size();
+
+	RecordHeader header;
+	uint64_t offset = syncRecord(start, end, chunk, chunkStart);
+
+	while (offset < end && !stopped) {
+
+		// record boundary lost - find next valid header
+		if (!readHeader(offset, header, chunk, chunkStart)) {
+			resyncs++;
+			offset = syncRecord(offset + 1, end, chunk, chunkStart);
+			continue;
+		}
+
+		uint64_t nextOffset = offset + RECORD_HEADER_SIZE + header.recordCapacity;
+
+		if (!(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG))) {
+			ScanEntry entry;
+			entry.offset = offset;
+			entry.dataOffset = partition.buffer.size();
+			memcpy(&entry.header, &header, RECORD_HEADER_SIZE);
+
+			uint64_t dataStart = offset + RECORD_HEADER_SIZE;
+			size_t storedLength = (size_t)RecordFileIO::getStoredLength(header);
+			partition.buffer.resize(entry.dataOffset + storedLength);
+			uint8_t* data = partition.buffer.data() + entry.dataOffset;
+			if (dataStart + storedLength <= chunkEnd) {
+				memcpy(data, chunk.data() + (dataStart - chunkStart), storedLength);
+			} else {
+				recordFile.cachedFile.read(dataStart, data, storedLength);
+			}
+			size_t tableSize = storedLength - header.dataLength;
+			// overflow record data is in overflow pages, so it is read under record lock
+			bool valid = !(header.bitFlags & RECORD_OVERFLOW_FLAG);
+			valid = valid && recordFile.verifyRecordData(header, data, data + tableSize);
+
+			// record is being changed, so read it again under record lock
+			if (!valid) {
+				recordFile.lockRecord(offset, false);
+				valid = recordFile.readRecordHeader(offset, entry.header) != NOT_FOUND;
+				valid = valid && !(entry.header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+				valid = valid && entry.header.recordCapacity == header.recordCapacity;
+				if (valid) {
+					tableSize = 0;
+					partition.buffer.resize(entry.dataOffset + entry.header.dataLength);
+					valid = recordFile.readStoredData(offset, entry.header, partition.buffer.data() + entry.dataOffset);
+				}
+				recordFile.unlockRecord(offset, false);
+			}
+
+			// decompress compressed record data
+			valid = valid && recordFile.decodeScanData(entry.header, partition.buffer, entry.dataOffset, entry.dataLength);
+
+			if (valid) {
+				// skip chunk checksums table of chunked record
+				entry.dataOffset += tableSize;
+				partition.entries.push_back(entry);
+			} else partition.buffer.resize(entry.dataOffset);
+		}
+
+		offset = nextOffset;
+	}
+
+}
+
+
+/*
+*  @brief Finds first record header position in given range. Candidate header
+*  must be valid and followed by valid header (or end of data).
+*  @param[in] from - search start position
+*  @param[in] end - search end position
+*  @param[in] chunk - partition data
+*  @param[in] chunkStart - partition data position in file
+*  @return position of record header or end if there is no record start in range
+*/
+uint64_t ParallelScanner::syncRecord(uint64_t from, uint64_t end, const std::vector<uint8_t>& chunk, uint64_t chunkStart) {
+
+	RecordHeader header, nextHeader;
+
+	for (uint64_t offset = from; offset < end; offset++) {
+		if (!readHeader(offset, header, chunk, chunkStart)) continue;
+		uint64_t nextOffset = offset + RECORD_HEADER_SIZE + header.recordCapacity;
+		if (nextOffset == endOfData || readHeader(nextOffset, nextHeader, chunk, chunkStart)) return offset;
+	}
+
+	return end;
+}
+
+
+/*
+*  @brief Reads record header and validates it against checksum and file bounds
+*  @param[in] offset - header position
+*  @param[out] header - record header
+*  @param[in] chunk - partition data
+*  @param[in] chunkStart - partition data position in file
+*  @return true if header is valid, false otherwise
+*/
+bool ParallelScanner::readHeader(uint64_t offset, RecordHeader& header, const std::vector<uint8_t>& chunk, uint64_t chunkStart) {
+
+	if (offset + RECORD_HEADER_SIZE > endOfData) return false;
+
+	if (offset >= chunkStart && offset + RECORD_HEADER_SIZE <= chunkStart + chunk.size()) {
+		memcpy(&header, chunk.data() + (offset - chunkStart), RECORD_HEADER_SIZE);
+	} else if (recordFile.cachedFile.read(offset, &header, RECORD_HEADER_SIZE) != RECORD_HEADER_SIZE) {
+		return false;
+	}
+
+	if (recordFile.checksum((uint8_t*)&header, RECORD_HEADER_PAYLOAD_SIZE) != header.headChecksum) return false;
+	if (RecordFileIO::getStoredLength(header) > header.recordCapacity) return false;
+
+	return offset + RECORD_HEADER_SIZE + header.recordCapacity <= endOfData;
+}
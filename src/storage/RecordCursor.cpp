@@ -9,6 +9,7 @@
 *  Features:
 *    - read/update/delete records of arbitrary size
 *    - navigate records: next, previous
+*    - follow record by its ID when record moves
 *    - data consistency check (checksum)
 *    - thread safety
 *
@@ -33,6 +34,7 @@ RecordCursor::RecordCursor(RecordFileIO& rf, RecordHeader& header, uint64_t posi
 	memcpy(&recordHeader, &header, RECORD_HEADER_SIZE);  
 	// Set current position of cursor
 	currentPosition.store(position);
+	recordID.store(header.bitFlags & RECORD_ID_MASK);
 }
 
 
@@ -42,23 +44,45 @@ RecordCursor::RecordCursor(RecordFileIO& rf, RecordHeader& header, uint64_t posi
 */
 bool RecordCursor::isValid() {
 
-	bool invalid = false;
-	uint64_t position = currentPosition.load();
-
 	// Check if cursor invalidated after record deletion
-	if (position == NOT_FOUND) return false;
+	if (currentPosition.load() == NOT_FOUND) return false;
 		
 	// Make sure synchronized read of header
-	{   		 
-		std::unique_lock lockCursor(cursorMutex);				
+	std::unique_lock lockCursor(cursorMutex);
+	return loadHeader();
+}
+
+
+/*
+*  @brief Loads record header at current position. If record has been moved
+*  (updated or compacted), follows it to the new position by its record ID.
+*  Caller holds cursorMutex.
+*  @returns true if record header loaded, false if record deleted or corrupt
+*/
+bool RecordCursor::loadHeader() {
+
+	uint64_t position = currentPosition.load();
+	uint64_t expectedID = recordID.load();
+
+	for (int attempt = 0; attempt < 2 && position != NOT_FOUND; attempt++) {
 		recordFile.lockRecord(position, false);
-		uint64_t actualPosition = recordFile.readRecordHeader(position, this->recordHeader);
+		uint64_t actualPosition = recordFile.readRecordHeader(position, recordHeader);
 		recordFile.unlockRecord(position, false);
-		// Check if record invalidated (moved or deleted)
-		invalid = (actualPosition == NOT_FOUND) || (recordHeader.bitFlags & RECORD_DELETED_FLAG);
+		// Check record is live and it is the same record (position could be reused)
+		bool valid = (actualPosition != NOT_FOUND);
+		valid = valid && !(recordHeader.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+		uint64_t headerID = recordHeader.bitFlags & RECORD_ID_MASK;
+		if (valid && (expectedID == 0 || expectedID == headerID)) {
+			currentPosition.store(position);
+			recordID.store(headerID);
+			return true;
+		}
+		// Unknown record ID means cursor just moved to this position
+		if (expectedID == 0) break;
+		position = recordFile.getRecordOffset(expectedID);
 	}
 
-	return !invalid;
+	return false;
 }
 
 
@@ -67,6 +91,7 @@ bool RecordCursor::isValid() {
 */
 void RecordCursor::invalidate() {	
 	currentPosition.store(NOT_FOUND);	
+	recordID.store(0);
 }
 
 
@@ -79,14 +104,25 @@ uint64_t RecordCursor::getPosition() {
 }
 
 
+/*
+* @brief Get record ID, which does not change when record moves
+* @return current record ID or NOT_FOUND if cursor is invalid
+*/
+uint64_t RecordCursor::getRecordID() {
+	uint64_t id = recordID.load();
+	return (currentPosition.load() == NOT_FOUND || id == 0) ? NOT_FOUND : id;
+}
+
+
 /*
 * @brief Set cursor position or invalidates it if fails
 * @param[in] offset - offset from file beginning
 * @return true - if offset points to consistent record, false - otherwise and invalidates cursor
 */
 bool RecordCursor::setPosition(uint64_t offset) {	
-	// Store new cursor position
+	// Store new cursor position, record ID will be taken from its header
 	currentPosition.store(offset);
+	recordID.store(0);
 	// Check if position is valid by loading its header
 	if (!isValid()) {
 		invalidate();
@@ -105,11 +141,8 @@ bool RecordCursor::next() {
 	if (currentPosition.load() == NOT_FOUND) return false;
 		
 	{
-		std::shared_lock lock(cursorMutex);
-		recordFile.lockRecord(currentPosition, false);
-		uint64_t actualPosition = recordFile.readRecordHeader(currentPosition, recordHeader);
-		recordFile.unlockRecord(currentPosition, false);
-		if (actualPosition == NOT_FOUND) {
+		std::unique_lock lock(cursorMutex);
+		if (!loadHeader()) {
 			invalidate();
 			return false;
 		}
@@ -130,11 +163,8 @@ bool RecordCursor::previous() {
 	if (currentPosition.load() == NOT_FOUND) return false;
 
 	{
-		std::shared_lock lock(cursorMutex);
-		recordFile.lockRecord(currentPosition, false);
-		uint64_t actualPosition = recordFile.readRecordHeader(currentPosition, recordHeader);
-		recordFile.unlockRecord(currentPosition, false);
-		if (actualPosition == NOT_FOUND) {
+		std::unique_lock lock(cursorMutex);
+		if (!loadHeader()) {
 			invalidate();
 			return false;
 		}
@@ -153,7 +183,10 @@ bool RecordCursor::previous() {
 */
 uint32_t RecordCursor::getDataLength() {
 	std::shared_lock lock(cursorMutex);	
-	return (currentPosition.load() == NOT_FOUND) ? 0 : recordHeader.dataLength;
+	if (currentPosition.load() == NOT_FOUND) return 0;
+	// compressed record keeps decompressed length in its data
+	if (recordHeader.bitFlags & RECORD_CODEC_MASK) return recordFile.readDataLength(currentPosition.load());
+	return recordHeader.dataLength;
 }
 
 
@@ -211,13 +244,48 @@ bool RecordCursor::getRecordData(void* data) {
 * @return returns true or false if fails
 */
 bool RecordCursor::setRecordData(const void* data, uint32_t length) {
-	// Write data to the record
+	// Write data to the record keeping its current version for open snapshots
+	auto version = recordFile.beginVersion(currentPosition.load());
 	uint64_t actualPosition = recordFile.writeRecordData(currentPosition.load(), data, length);
+	recordFile.commitVersion(version, actualPosition != NOT_FOUND);
 	if (actualPosition == NOT_FOUND) return false;
 	// if record position changed after update
 	if (currentPosition.load() != actualPosition) {
 		return setPosition(actualPosition);
 	}
+	// record updated in place, reload its header (length and codec could change)
+	std::unique_lock lock(cursorMutex);
+	loadHeader();
 	return true;
 }
 
+
+
+
+/*
+* @brief Reads range of record data in current position and checks its consistency
+* @param[in] position - first data byte to read
+* @param[out] data - pointer to the user buffer
+* @param[in] length - bytes to read
+* @return returns bytes read or zero if range is out of data or data corrupted
+*/
+uint32_t RecordCursor::readRange(uint32_t position, void* data, uint32_t length) {
+	return recordFile.readRecordRange(currentPosition.load(), position, data, length);
+}
+
+
+
+/*
+* @brief Overwrites range of record data in current position,
+* range must be within current data length.
+* @param[in] position - first data byte to write
+* @param[in] data - pointer to new data
+* @param[in] length - bytes to write
+* @return returns true or false if fails
+*/
+bool RecordCursor::writeRange(uint32_t position, const void* data, uint32_t length) {
+	auto version = recordFile.beginVersion(currentPosition.load());
+	bool written = recordFile.writeRecordRange(currentPosition.load(), position, data, length);
+	recordFile.commitVersion(version, written);
+	return written;
+}
@@ -9,8 +9,8 @@
 *
 *  Features:
 *    - create/read/delete records of arbitrary size
-*    - navigate records: first, last, exact position
-*    - reuse space of deleted records
+*    - navigate records: first, last, exact position, stable record ID
+*    - reuse space of deleted records (split and merge free records)
 *    - data consistency check (checksum)
 *    - thread safety
 *
@@ -29,9 +29,27 @@ using namespace Cloudless::Storage;
 /*
 * @brief RecordFileIO constructor
 */
-RecordFileIO::RecordFileIO() : storageHeader{} {
+RecordFileIO::RecordFileIO() : storageHeader{}, dataStart(STORAGE_HEADER_SIZE) {
+	// Checksum algorithm is set by storage header on open
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
 	// Set default free record lookup depth (fragmentation/performance)
 	freeLookupDepth.store(FREE_RECORD_LOOKUP_DEPTH);
+	// Reset compaction statistics
+	compactionCancelled.store(false);
+	compactionRecordsToMove.store(0);
+	compactionRecordsMoved.store(0);
+	compactionBytesMoved.store(0);
+	compactionBytesReclaimed.store(0);
+	// Records are stored uncompressed unless compression is enabled
+	compressionType.store(CompressionType::NONE);
+	compressionThreshold.store(COMPRESSION_THRESHOLD);
+	// No writes committed yet
+	commitTimestamp.store(0);
+	// No snapshots opened, versions data is limited by default
+	snapshotSequence = 0;
+	expiredSequence.store(0);
+	versionsBytes = 0;
+	versionsLimit.store(VERSIONS_MEMORY_LIMIT);
 }
 
 
@@ -52,9 +70,10 @@ RecordFileIO::~RecordFileIO() {
 
 /**
 * @brief Open records file
+* @param[in] checksumType - checksum algorithm of new file (existing file keeps its own)
 * @return true if records file successfuly opened, false otherwise 
 */
-bool RecordFileIO::open(const char* path, bool isReadOnly, size_t cacheSize) {
+bool RecordFileIO::open(const char* path, bool isReadOnly, size_t cacheSize, ChecksumType checksumType) {
 
 	std::unique_lock lock(storageMutex);
 
@@ -67,7 +86,7 @@ bool RecordFileIO::open(const char* path, bool isReadOnly, size_t cacheSize) {
 	// If file is empty and write is permitted, then write initial storage header
 	if (cachedFile.getFileSize() == 0 && !cachedFile.isReadOnly()) {
 		std::unique_lock lock(headerMutex);
-		createStorageHeader();
+		createStorageHeader(checksumType);
 	}
 
 	// Try to load storage header
@@ -79,6 +98,42 @@ bool RecordFileIO::open(const char* path, bool isReadOnly, size_t cacheSize) {
 		}
 	}
 
+	// Load free records positions for physical neighbour lookups
+	if (!loadFreeRecordsMap()) {
+		const char* msg = "Storage file free records list is corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// Load record ID table pages positions
+	if (!loadIDTable()) {
+		const char* msg = "Storage file record ID table is corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// Load free overflow pages positions
+	if (!loadOverflowFreeMap()) {
+		const char* msg = "Storage file overflow pages free map is corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// Load compression dictionaries of all versions
+	if (!loadDictionaries()) {
+		const char* msg = "Storage file compression dictionaries are corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// Upgrade file of older format version (read only file is read as is)
+	if (!cachedFile.isReadOnly() && !upgradeStorage()) {
+		const char* msg = "Storage file can't be upgraded to current format version.\n";
+		throw std::runtime_error(msg);
+	}
+
+	// Complete transaction interrupted after its journal was written
+	if (!replayJournal()) {
+		const char* msg = "Storage file transaction journal can't be applied.\n";
+		throw std::runtime_error(msg);
+	}
+
 	return true;
 
 }
@@ -172,6 +227,30 @@ uint64_t RecordFileIO::getTotalFreeRecords() {
 
 
 
+/*
+* @brief Returns total number of free overflow pages
+* @return total number of free overflow pages
+*/
+uint64_t RecordFileIO::getTotalFreeOverflowPages() {
+	std::shared_lock lock(headerMutex);
+	return storageHeader.totalFreeOverflowPages;
+}
+
+
+
+/*
+* @brief Returns stamp of records state changed by transactions: number of
+* committed transactions kept in storage header, so state saved elsewhere
+* (e.g. index) with the stamp is known to match records
+* @return commit stamp
+*/
+uint64_t RecordFileIO::getCommitStamp() {
+	std::shared_lock lock(headerMutex);
+	return storageHeader.commitStamp;
+}
+
+
+
 /*
 * @brief Creates new record in the storage
 * @param[in] data - pointer to data
@@ -182,11 +261,53 @@ std::shared_ptr<RecordCursor> RecordFileIO::createRecord(const void* data, uint3
 
 	// Check if file writes are permitted
 	if (cachedFile.isReadOnly()) return nullptr;
-	
+
+	// Snapshot can't be opened while record ID is reserved but record is not created
+	std::shared_lock gate(versionGate);
+
+	// Reserve record ID, so record can be found after it moves
+	uint64_t recordID = reserveRecordID();
+	if (recordID == NOT_FOUND) return nullptr;
+
+	return insertRecord(recordID, data, length);
+}
+
+
+
+/*
+* @brief Creates new record with already reserved record ID
+* @param[in] recordID - reserved record ID
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes
+* @return returns shared pointer to the new record or nullptr if fails
+*/
+std::shared_ptr<RecordCursor> RecordFileIO::insertRecord(uint64_t recordID, const void* data, uint32_t length) {
+
+	// Large data is stored in overflow pages
+	if (length >= OVERFLOW_THRESHOLD) return createOverflowRecord(recordID, data, length);
+
+	// Compress data if compression is enabled
+	std::vector<uint8_t> stored;
+	uint64_t codecFlags = encodeRecordData(data, length, stored);
+	if (codecFlags != 0) {
+		data = stored.data();
+		length = (uint32_t)stored.size();
+	}
+
 	// Allocate new record and link to last record
 	RecordHeader newRecordHeader;
+	newRecordHeader.bitFlags = recordID | codecFlags;
 	uint64_t recordPosition = allocateRecord(length, newRecordHeader, data, length ,true);
 	if (recordPosition == NOT_FOUND) return nullptr;
+
+	// Publish record position in ID table unless record has been moved meanwhile
+	RecordHeader header;
+	lockRecord(recordPosition, false);
+	uint64_t recPos = readRecordHeader(recordPosition, header);
+	if (recPos != NOT_FOUND && (header.bitFlags & (RECORD_DELETED_FLAG | RECORD_ID_MASK)) == recordID) {
+		setRecordOffset(recordID, recordPosition);
+	}
+	unlockRecord(recordPosition, false);
 	
 	// Create cursor and return it
 	std::shared_ptr<RecordCursor> recordCursor;
@@ -212,7 +333,7 @@ std::shared_ptr<RecordCursor> RecordFileIO::getRecord(uint64_t recordPosition) {
 	lockRecord(recordPosition, false);
 	uint64_t recPos = readRecordHeader(recordPosition, header);
 	unlockRecord(recordPosition, false);
-	if (recPos == NOT_FOUND || header.bitFlags & RECORD_DELETED_FLAG) return nullptr;
+	if (recPos == NOT_FOUND || header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG)) return nullptr;
 
 	// If everything is ok - create cursor and copy to its internal buffer
 	std::shared_ptr<RecordCursor> recordCursor;
@@ -223,6 +344,25 @@ std::shared_ptr<RecordCursor> RecordFileIO::getRecord(uint64_t recordPosition) {
 }
 
 
+/*
+* @brief Returns cursor to the record with specified ID regardless of its position
+* @param[in] recordID - record ID
+* @return returns shared pointer to the consistent record or nullptr if record is not found or corrupt
+*/
+std::shared_ptr<RecordCursor> RecordFileIO::getRecordByID(uint64_t recordID) {
+
+	// Record could move between ID lookup and header read, so try again
+	for (int attempt = 0; attempt < 2; attempt++) {
+		uint64_t recordPosition = getRecordOffset(recordID);
+		if (recordPosition == NOT_FOUND) return nullptr;
+		std::shared_ptr<RecordCursor> recordCursor = getRecord(recordPosition);
+		if (recordCursor != nullptr && recordCursor->getRecordID() == recordID) return recordCursor;
+	}
+
+	return nullptr;
+}
+
+
 /*
 * @brief Returns cursor to first record in database
 * @return Cursor to consistent record, false - otherwise
@@ -290,19 +430,48 @@ bool RecordFileIO::removeRecord(std::shared_ptr<RecordCursor> cursor) {
 	// FYI: cursor::isValid locks storageMutex so do it before unique lock
 	if (cursor == nullptr || cachedFile.isReadOnly()) return false;
 
+	// Keep record version for open snapshots
+	auto version = beginVersion(cursor->currentPosition.load());
+	bool removed = unlinkRecord(cursor);
+	commitVersion(version, removed);
+
+	return removed;
+}
+
+
+
+/*
+* @brief Unlinks record in cursor position from records list and releases it
+* @return returns true if record is deleted or false if fails
+*/
+bool RecordFileIO::unlinkRecord(std::shared_ptr<RecordCursor> cursor) {
+
 	std::unique_lock lockCursor(cursor->cursorMutex);
 
+	// Unlink record under free list and storage header locks, so concurrent
+	// appends and moves can't link to the record being deleted
+	std::unique_lock freeLock(freeListMutex);
+	std::unique_lock lockHeader(headerMutex);
+
 	// Lock current record
 	uint64_t currentPosition = cursor->currentPosition;
 	lockRecord(currentPosition, false);
 	// Update header and check is it still valid		
 	uint64_t pos = readRecordHeader(cursor->currentPosition, cursor->recordHeader);
+	// Collect overflow pages to release them after record is deleted
+	std::vector<uint8_t> overflowTable;
+	std::vector<uint64_t> overflowPages;
+	bool isOverflow = pos != NOT_FOUND && (cursor->recordHeader.bitFlags & RECORD_OVERFLOW_FLAG);
+	if (isOverflow && loadChunksTable(currentPosition, cursor->recordHeader, overflowTable)) {
+		getOverflowPages(cursor->recordHeader, overflowTable, overflowPages);
+	}
 	// Unlock current record
 	unlockRecord(currentPosition, false);
 	if (pos == NOT_FOUND || cursor->recordHeader.bitFlags & RECORD_DELETED_FLAG) return false;
 				
 	// make shortcuts for code readability
 	RecordHeader& recordHeader = cursor->recordHeader;	
+	uint64_t recordID = recordHeader.bitFlags & RECORD_ID_MASK;
 	uint64_t leftSiblingOffset = recordHeader.previous;
 	uint64_t rightSiblingOffset = recordHeader.next;
 
@@ -312,91 +481,68 @@ bool RecordFileIO::removeRecord(std::shared_ptr<RecordCursor> cursor) {
 
 	RecordHeader leftSiblingHeader;
 	RecordHeader rightSiblingHeader;
-	RecordHeader* newCursorRecordHeader;
-	uint64_t newCursorPosition;
+	RecordHeader* newCursorRecordHeader = nullptr;
+	uint64_t newCursorPosition = NOT_FOUND;
 
-	if (leftSiblingExists && rightSiblingExists) {  
-		// removing record in the middle
+	// interconnect left sibling with right one or update first record
+	if (leftSiblingExists) {
 		lockRecord(leftSiblingOffset, true);
-		lockRecord(rightSiblingOffset, true);
 		readRecordHeader(leftSiblingOffset, leftSiblingHeader);
-		readRecordHeader(rightSiblingOffset, rightSiblingHeader);
 		leftSiblingHeader.next = rightSiblingOffset;
-		rightSiblingHeader.previous = leftSiblingOffset;
 		writeRecordHeader(leftSiblingOffset, leftSiblingHeader);
-		writeRecordHeader(rightSiblingOffset, rightSiblingHeader);		
 		unlockRecord(leftSiblingOffset, true);
-		unlockRecord(rightSiblingOffset, true);
-		// add record to free list and mark as deleted
-		addRecordToFreeList(currentPosition);
-		newCursorPosition = rightSiblingOffset;
-		newCursorRecordHeader = &rightSiblingHeader;
-		{
-			// update header
-			std::unique_lock lockHeader(headerMutex);
-			storageHeader.totalRecords--;
-			writeStorageHeader();		}
-		
-	} else if (leftSiblingExists) {		             
-		// removing last record
-		lockRecord(leftSiblingOffset, true);		
-		readRecordHeader(leftSiblingOffset, leftSiblingHeader);
-		leftSiblingHeader.next = NOT_FOUND;
-		writeRecordHeader(leftSiblingOffset, leftSiblingHeader);		
-		unlockRecord(leftSiblingOffset, true);		
-		// add record to free list and mark as deleted (contains headerMutex lock & record lock)				
-		addRecordToFreeList(currentPosition);		
-		{
-			// update storage header
-			std::unique_lock lockHeader(headerMutex);
-			storageHeader.lastRecord = leftSiblingOffset;
-			storageHeader.totalRecords--;
-			writeStorageHeader();
-		}		
 		newCursorPosition = leftSiblingOffset;
 		newCursorRecordHeader = &leftSiblingHeader;
-	} else if (rightSiblingExists) {		         				
-		// removing first record		
+	} else storageHeader.firstRecord = rightSiblingOffset;
+
+	// interconnect right sibling with left one or update last record
+	if (rightSiblingExists) {
 		lockRecord(rightSiblingOffset, true);
 		readRecordHeader(rightSiblingOffset, rightSiblingHeader);
-		rightSiblingHeader.previous = NOT_FOUND;
+		rightSiblingHeader.previous = leftSiblingOffset;
 		writeRecordHeader(rightSiblingOffset, rightSiblingHeader);
 		unlockRecord(rightSiblingOffset, true);
-		// add record to free list and mark as deleted
-		addRecordToFreeList(currentPosition);
-		{
-			// update storage header			
-			std::unique_lock lockHeader(headerMutex);
-			storageHeader.firstRecord = rightSiblingOffset;
-			storageHeader.totalRecords--;
-			writeStorageHeader();
-		}		
+		// cursor moves to the right sibling if it exists
 		newCursorPosition = rightSiblingOffset;
 		newCursorRecordHeader = &rightSiblingHeader;
-	} else {                         
-		// add record to free list and mark as deleted
-		addRecordToFreeList(currentPosition);		
-		{
-			// update storage header
-			std::unique_lock lockHeader(headerMutex);
-			storageHeader.firstRecord = NOT_FOUND;
-			storageHeader.lastRecord = NOT_FOUND;
-			storageHeader.totalRecords--;
-			writeStorageHeader();
-		}		
-		newCursorPosition = NOT_FOUND;
-		newCursorRecordHeader = nullptr;
-	}
-
+	} else storageHeader.lastRecord = leftSiblingOffset;
+
+	storageHeader.totalRecords--;
+	writeStorageHeader();
+
+	// Mark record as deleted, so cursors at this position are invalidated
+	RecordHeader freeRecord;
+	memcpy(&freeRecord, &recordHeader, RECORD_HEADER_SIZE);
+	freeRecord.next = NOT_FOUND;
+	freeRecord.previous = NOT_FOUND;
+	freeRecord.dataLength = 0;
+	freeRecord.dataChecksum = 0;
+	freeRecord.bitFlags = RECORD_DELETED_FLAG;
+	lockRecord(currentPosition, true);
+	writeRecordHeader(currentPosition, freeRecord);
+	unlockRecord(currentPosition, true);
+	lockHeader.unlock();
+
+	// Merge with free neighbours and add to the free list
+	releaseRecord(currentPosition, freeRecord);
+	freeLock.unlock();
+
+	// Release overflow pages (takes overflow pages lock before free list lock)
+	freeOverflowPages(overflowPages);
+
+	// Release record ID
+	setRecordOffset(recordID, NOT_FOUND);
 	
 	// Update cursor position to the neighbour record	
 	if (newCursorPosition != NOT_FOUND) {
 		memcpy(&cursor->recordHeader, newCursorRecordHeader, RECORD_HEADER_SIZE);
 		cursor->currentPosition = newCursorPosition;
+		cursor->recordID = newCursorRecordHeader->bitFlags & RECORD_ID_MASK;
 	}
 	else {
 		// invalidate cursor if there is no neighbour records
 		cursor->currentPosition = NOT_FOUND;
+		cursor->recordID = 0;
 		cursor->recordHeader.next = NOT_FOUND;
 		cursor->recordHeader.previous = NOT_FOUND;
 		cursor->recordHeader.dataLength = 0;
@@ -410,7 +556,6 @@ bool RecordFileIO::removeRecord(std::shared_ptr<RecordCursor> cursor) {
 
 
 
-
 //=============================================================================
 // 
 // 
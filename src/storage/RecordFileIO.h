@@ -20,16 +20,20 @@
 #pragma once
 
 #include "CachedFileIO.h"
+#include "Checksum.h"
+#include "Compression.h"
 
 #include <memory>
 #include <vector>
 #include <string>
+#include <map>
 #include <unordered_map>
 #include <shared_mutex>
+#include <set>
+#include <functional>
 
 
 
-// TODO: StorageHeader - add checksum field
 // TODO: RecordHeader - break bitFlags into system/user flags and give access
 
 
@@ -41,11 +45,19 @@ namespace Cloudless {
 		// Knowledge Storage header signature and version
 		//----------------------------------------------------------------------------
 		constexpr uint32_t KNOWLEDGE_SIGNATURE = 0x574F4E4B;   // KNOW signature
-		constexpr uint32_t KNOWLEDGE_VERSION   = 0x00000001;   // Version 1
+		constexpr uint32_t KNOWLEDGE_VERSION   = 0x00000007;   // Version 7
 		constexpr uint64_t RECORD_DELETED_FLAG = 1ULL << 63;   // Highest bit
+		constexpr uint64_t RECORD_SYSTEM_FLAG  = 1ULL << 62;   // System record, not in records list
+		constexpr uint64_t RECORD_CHUNKED_FLAG = 1ULL << 61;   // Data checksummed by chunks
+		constexpr uint64_t RECORD_OVERFLOW_FLAG = 1ULL << 60;  // Data stored in overflow pages
+		constexpr uint64_t RECORD_CODEC_SHIFT = 56;            // Bits 56-59 keep compression codec
+		constexpr uint64_t RECORD_CODEC_MASK = 15ULL << RECORD_CODEC_SHIFT;
+		constexpr uint64_t RECORD_ID_MASK = (1ULL << 48) - 1;  // Lower 48 bits keep record ID
 
 		//----------------------------------------------------------------------------
-		// Knowledge Storage header structure (64 bytes)
+		// Knowledge Storage header structure (128 bytes). Every format version
+		// appended fields to the header of previous version, files of older
+		// versions are upgraded to the current one on open for write.
 		//----------------------------------------------------------------------------
 		struct StorageHeader {
 			uint32_t      signature;           // BSDB signature
@@ -59,11 +71,44 @@ namespace Cloudless {
 			uint64_t      totalFreeRecords;    // Total number of free records
 			uint64_t      firstFreeRecord;     // First free record offset
 			uint64_t      lastFreeRecord;      // Last free record offset
+
+			uint64_t      nextRecordID;        // Next record ID to assign
+			uint64_t      idTableRecord;       // First record ID table page offset
+
+			uint64_t      totalFreeOverflowPages; // Total number of free overflow pages
+			uint64_t      firstFreeOverflowPage;  // First free overflow page offset
+
+			uint64_t      lastDictionary;      // Latest compression dictionary offset
+			uint64_t      transactionJournal;  // Committed transaction journal being applied
+			uint64_t      commitStamp;         // Transactions committed (stamp of records state)
+
+			uint32_t      checksumType;        // Checksum algorithm (ChecksumType)
+			uint32_t      headerChecksum;      // Checksum for storage header consistency check
 		};
 		
 		constexpr uint64_t STORAGE_HEADER_SIZE  = sizeof(StorageHeader);
+		constexpr uint64_t STORAGE_HEADER_PAYLOAD_SIZE = STORAGE_HEADER_SIZE - sizeof(StorageHeader::headerChecksum);
 		constexpr uint64_t FREE_RECORD_LOOKUP_DEPTH = 64; // Minimal search depth is 64
 		constexpr uint64_t FREE_RECORD_LOOKUP_RATIO = 10; // Max search depth is 1/10
+		constexpr uint64_t MINIMAL_SPLIT_CAPACITY = 64;   // Minimal capacity of split remainder
+		constexpr uint32_t COMPACTION_BATCH_SIZE = 256;   // Records moved per compaction batch
+		constexpr uint32_t COMPACTION_PAUSE_MS = 10;      // Pause between compaction batches
+		constexpr uint32_t SCAN_READ_AHEAD = 256;         // Records read ahead by scanner
+		constexpr uint32_t SCAN_WINDOW_SIZE = 64 * 1024;  // Max bytes read at once by scanner
+		constexpr uint32_t SCAN_MIN_WINDOW_SIZE = 1024;   // Min bytes read at once by scanner
+		constexpr uint32_t SCAN_PARTITION_SIZE = 1024 * 1024; // Bytes of file scanned by parallel scan task
+		constexpr uint32_t SCAN_PARTITIONS_IN_FLIGHT = 4; // Ordered parallel scan partitions per thread
+		constexpr uint32_t RECORD_CHUNK_SIZE = 64 * 1024; // Data bytes covered by one chunk checksum
+		constexpr uint32_t OVERFLOW_PAGE_SIZE = RECORD_CHUNK_SIZE;   // Overflow page keeps one chunk
+		constexpr uint32_t OVERFLOW_THRESHOLD = 4 * 1024 * 1024;     // Data length stored in overflow pages
+		constexpr uint32_t COMPRESSION_THRESHOLD = 256;   // Smaller records are not compressed
+		constexpr uint32_t DICTIONARY_SIZE = 16 * 1024;   // Default compression dictionary size
+		constexpr uint32_t DICTIONARY_MIN_SIZE = 256;     // Smaller dictionary is not worth to store
+		constexpr uint32_t DICTIONARY_SAMPLES = 4096;     // Max records sampled to train dictionary
+		constexpr uint32_t DICTIONARY_SAMPLES_RATIO = 100;   // Max sampled bytes per dictionary byte
+		constexpr uint64_t VERSION_PENDING = UINT64_MAX;  // Version replaced by write in progress
+		constexpr uint32_t SNAPSHOT_READ_ATTEMPTS = 64;   // Lock free reads of moving record before giving up
+		constexpr uint64_t VERSIONS_MEMORY_LIMIT = 256ULL * 1024 * 1024;   // Versions data kept for snapshots
 
 		//----------------------------------------------------------------------------
 		// Record header structure (40 bytes)
@@ -82,11 +127,89 @@ namespace Cloudless {
 		constexpr uint32_t RECORD_HEADER_PAYLOAD_SIZE = RECORD_HEADER_SIZE - sizeof(RecordHeader::headChecksum);
 
 		//----------------------------------------------------------------------------
-		// Record lock structure
+		// Record ID table page (system record): next page offset and record offsets
+		//----------------------------------------------------------------------------
+		constexpr uint32_t ID_TABLE_PAGE_CAPACITY = PAGE_SIZE - RECORD_HEADER_SIZE;
+		constexpr uint64_t ID_TABLE_PAGE_ENTRIES = (ID_TABLE_PAGE_CAPACITY - sizeof(uint64_t)) / sizeof(uint64_t);
+
+		//----------------------------------------------------------------------------
+		// Record lock structure (pooled and reused by record lock table)
 		//----------------------------------------------------------------------------	
 		struct RecordLock {			
 			std::shared_mutex     mutex;
-			std::atomic<int32_t>  counter;						
+			uint64_t              offset = NOT_FOUND;  // Locked record position
+			int32_t               counter = 0;         // Lock holders and waiters (guarded by stripe)
+			RecordLock*           next = nullptr;      // Next lock in stripe or in pool
+		};
+
+		//----------------------------------------------------------------------------
+		// Record lock table stripe (cache line padded to avoid false sharing)
+		//----------------------------------------------------------------------------	
+		constexpr uint32_t RECORD_LOCK_STRIPES = 256;     // Power of two
+		constexpr uint32_t CACHE_LINE_SIZE = 64;
+
+		struct alignas(CACHE_LINE_SIZE) RecordLockStripe {
+			std::mutex            mutex;
+			RecordLock*           locks = nullptr;     // Record locks in use
+			RecordLock*           pool = nullptr;      // Record locks to reuse
+		};
+
+		//----------------------------------------------------------------------------
+		// Record lock table: fixed size table of stripes, offset hash picks stripe.
+		// Each locked offset gets its own RecordLock, so records sharing the stripe
+		// never block each other, and stripe mutex is held only for list lookup.
+		//----------------------------------------------------------------------------	
+		class RecordLockTable {
+		public:
+			RecordLockTable() = default;
+			~RecordLockTable();
+			RecordLockTable(const RecordLockTable&) = delete;
+			void operator=(const RecordLockTable&) = delete;
+
+			void lock(uint64_t offset, bool exclusive);
+			void unlock(uint64_t offset, bool exclusive);
+		private:
+			RecordLockStripe& getStripe(uint64_t offset);
+			RecordLockStripe  stripes[RECORD_LOCK_STRIPES];
+		};
+
+		//----------------------------------------------------------------------------
+		// Record version kept for open snapshots: record data as it was before
+		// the write committed at validTo timestamp (VERSION_PENDING until done)
+		//----------------------------------------------------------------------------
+		struct RecordVersion {
+			uint64_t              recordID;    // Record ID
+			uint64_t              validTo;     // Commit timestamp of the write replaced version
+			bool                  exists;      // Record existed before the write
+			std::vector<uint8_t>  data;        // Record data before the write
+		};
+
+		//----------------------------------------------------------------------------
+		// Transaction write: the last operation of transaction on record
+		//----------------------------------------------------------------------------
+		enum class TransactionOperation : uint32_t {
+			UPDATE = 1,                        // Record data replaced
+			CREATE = 2,                        // Record created with reserved ID
+			REMOVE = 3                         // Record removed
+		};
+
+		struct TransactionWrite {
+			TransactionOperation  operation;   // Operation on record
+			std::vector<uint8_t>  data;        // New record data
+		};
+
+		typedef std::map<uint64_t, TransactionWrite> TransactionWrites;   // Write set by record ID
+		typedef std::map<uint64_t, RecordHeader> TransactionReads;        // Read set by record ID
+
+		//----------------------------------------------------------------------------
+		// Compaction statistics types
+		//----------------------------------------------------------------------------
+		enum class CompactionStats : uint32_t {
+			RECORDS_TO_MOVE,                   // Live records found behind live data size
+			RECORDS_MOVED,                     // Records relocated to free space
+			BYTES_MOVED,                       // Payload bytes relocated
+			BYTES_RECLAIMED,                   // Bytes released by file truncation
+			PROGRESS                           // Compaction progress (0-100%)
 		};
 
 		//----------------------------------------------------------------------------
@@ -103,13 +226,18 @@ namespace Cloudless {
 		//----------------------------------------------------------------------------
 		class RecordFileIO {
 			friend class RecordCursor;
+			friend class RecordScanner;
+			friend class ParallelScanner;
+			friend class RecordWriter;
+			friend class RecordSnapshot;
+			friend class RecordTransaction;
 		public:
 			RecordFileIO();
 			RecordFileIO(const RecordFileIO&) = delete;
 			void operator=(const RecordFileIO&) = delete;
 			~RecordFileIO();
 
-			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE);
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE, ChecksumType checksumType = ChecksumType::CRC32C);
 			bool flush();
 			bool isOpen();
 			bool isReadOnly();
@@ -118,9 +246,11 @@ namespace Cloudless {
 			uint64_t getFileSize();
 			uint64_t getTotalRecords();
 			uint64_t getTotalFreeRecords();
+			uint64_t getTotalFreeOverflowPages();
 
 			std::shared_ptr<RecordCursor> createRecord(const void* data, uint32_t length);
 			std::shared_ptr<RecordCursor> getRecord(uint64_t offset);
+			std::shared_ptr<RecordCursor> getRecordByID(uint64_t recordID);
 			std::shared_ptr<RecordCursor> getFirstRecord();
 			std::shared_ptr<RecordCursor> getLastRecord();
 			bool removeRecord(std::shared_ptr<RecordCursor> cursor);
@@ -132,38 +262,166 @@ namespace Cloudless {
 			void   resetCacheStats();
 			double getCacheStats(CachedFileStats type);
 
+			bool   compact(uint32_t batchSize = COMPACTION_BATCH_SIZE, uint32_t pauseMs = COMPACTION_PAUSE_MS);
+			void   cancelCompaction();
+			double getCompactionStats(CompactionStats type);
+
+			void   setCompression(CompressionType type, uint32_t threshold = COMPRESSION_THRESHOLD);
+			CompressionType getCompression();
+			uint32_t trainDictionary(uint32_t dictionarySize = DICTIONARY_SIZE);
+			uint32_t getDictionaryID();
+
+			uint64_t getCommitStamp();
+
+			void     setVersionsLimit(uint64_t bytes);
+			uint64_t getVersionsLimit();
+			uint64_t getTotalVersions();
+			uint64_t getTotalVersionBytes();
+
+			static uint32_t getChunksCount(uint32_t length);
+			static uint64_t getStoredLength(const RecordHeader& header);
+
 		protected:
 
 			std::shared_mutex storageMutex;			
 			std::shared_mutex headerMutex;
 			std::shared_mutex freeListMutex;
-			std::shared_mutex recordLocksMutex;
 			std::shared_mutex errorCodesMutex;
-			std::unordered_map<uint64_t, std::shared_ptr<RecordLock>> recordLocks;
+			std::shared_mutex idTableMutex;
+			std::mutex        idTableGrowMutex;
+			std::mutex        overflowMutex;
+			std::set<uint64_t> overflowFreePages;         // Free overflow pages by file order
+			std::shared_mutex dictionaryMutex;
+			std::mutex        dictionaryGrowMutex;
+			std::map<uint32_t, std::shared_ptr<CompressionDictionary>> dictionaries;   // Dictionaries by ID
+			std::vector<uint64_t> idTablePages;            // Record ID table pages offsets
+			RecordLockTable   recordLocks;
 			std::unordered_map<std::thread::id, RecordErrorCode> errorCodes;
+			std::map<uint64_t, uint32_t> freeRecordsMap;   // Free records by file order (offset -> capacity)
 						
 			CachedFileIO  cachedFile;
 			StorageHeader storageHeader;
+			uint64_t      dataStart;            // First record position (storage header size of file version)
 			std::atomic<size_t> freeLookupDepth;
-
-			void     createStorageHeader();
+			ChecksumFunction    checksumFunction;
+
+			std::mutex            compactionMutex;
+			std::atomic<bool>     compactionCancelled;
+			std::atomic<uint64_t> compactionRecordsToMove;
+			std::atomic<uint64_t> compactionRecordsMoved;
+			std::atomic<uint64_t> compactionBytesMoved;
+			std::atomic<uint64_t> compactionBytesReclaimed;
+
+			std::atomic<CompressionType> compressionType;
+			std::atomic<uint32_t>        compressionThreshold;
+
+			std::shared_mutex     versionGate;          // Writes in progress (shared), snapshot opening or transaction commit
+			std::mutex            versionsMutex;
+			std::atomic<uint64_t> commitTimestamp;      // Timestamp of the last committed write
+			std::map<uint64_t, uint64_t> activeSnapshots; // Open snapshots timestamps by snapshot sequence
+			uint64_t              snapshotSequence;     // Sequence of the last opened snapshot
+			std::atomic<uint64_t> expiredSequence;      // Snapshots of this sequence and below are expired
+			uint64_t              versionsBytes;        // Data bytes of kept versions
+			std::atomic<uint64_t> versionsLimit;        // Data bytes of kept versions before snapshots expire
+			std::unordered_map<uint64_t, std::vector<std::shared_ptr<RecordVersion>>> recordVersions; // By record ID
+
+			void     createStorageHeader(ChecksumType checksumType);
 			bool     writeStorageHeader();
 			bool     loadStorageHeader();
+			bool     upgradeStorage();
+			bool     relocateHeaderArea();
+			bool     moveSystemRecord(uint64_t offset, uint64_t newOffset);
+			bool     assignRecordIDs();
 			
 			uint64_t readRecordHeader(uint64_t offset, RecordHeader& result);
 			uint64_t writeRecordHeader(uint64_t offset, RecordHeader& header);
 			uint64_t readRecordData(uint64_t offset, void* data);
 			uint64_t writeRecordData(uint64_t offset, const void* data, uint32_t length);
+			uint64_t writeStoredData(uint64_t offset, const void* stored, uint32_t storedLength, uint32_t dataLength,
+			                         uint64_t layoutFlags, const RecordHeader* expected, std::vector<uint64_t>& oldPages);
+			bool     readStoredData(uint64_t offset, const RecordHeader& header, uint8_t* data);
+			uint32_t readRecordRange(uint64_t offset, uint32_t position, void* data, uint32_t length);
+			bool     writeRecordRange(uint64_t offset, uint32_t position, const void* data, uint32_t length);
+			bool     verifyRecordData(const RecordHeader& header, const uint8_t* table, const uint8_t* data);
 			uint32_t checksum(const uint8_t* data, uint64_t length);
 
 			uint64_t allocateRecord(uint32_t capacity, RecordHeader& result, const void* data, uint32_t length, bool createNewRecord);
 			uint64_t createFirstRecord(uint32_t capacity, RecordHeader& result, const void* data, uint32_t length);
 			uint64_t appendNewRecord(uint32_t capacity, RecordHeader& result, const void* data, uint32_t length, bool createNewRecord);
+			uint64_t allocateSystemRecord(uint32_t capacity, RecordHeader& result, const void* data);
+			uint64_t allocatePendingRecord(uint32_t capacity, RecordHeader& result);
+			bool     publishRecord(uint64_t offset, RecordHeader& header);
 			
 			uint64_t getFromFreeList(uint32_t capacity, RecordHeader& result, const void* data, uint32_t length, bool createNewRecord);
 			bool     addRecordToFreeList(uint64_t offset);
-			void     removeRecordFromFreeList(RecordHeader& freeRecord);
+			void     releaseRecord(uint64_t offset, RecordHeader& freeRecord);
+			void     removeRecordFromFreeList(uint64_t offset, RecordHeader& freeRecord);
+			void     linkFreeRecord(uint64_t offset, RecordHeader& freeRecord);
+			uint32_t splitFreeRecord(uint64_t offset, RecordHeader& freeRecord, uint32_t capacity);
+			uint64_t coalesceFreeRecord(uint64_t offset, RecordHeader& freeRecord);
+			bool     loadFreeRecordsMap();
 			
+			uint64_t reserveRecordID();
+			uint64_t getRecordOffset(uint64_t recordID);
+			bool     setRecordOffset(uint64_t recordID, uint64_t offset);
+			bool     appendIDTablePage();
+			bool     loadIDTable();
+			bool     moveIDTablePage(uint64_t offset, uint64_t newOffset);
+			bool     isIDTablePage(uint64_t offset);
+
+			uint64_t allocateOverflowPage();
+			void     freeOverflowPages(const std::vector<uint64_t>& pages);
+			bool     loadOverflowFreeMap();
+			bool     loadChunksTable(uint64_t offset, const RecordHeader& header, std::vector<uint8_t>& table);
+			uint64_t getChunkPosition(uint64_t offset, const RecordHeader& header, const std::vector<uint8_t>& table, uint32_t index);
+			uint32_t getChunkChecksum(const RecordHeader& header, const std::vector<uint8_t>& table, uint32_t index);
+			void     setChunkChecksum(const RecordHeader& header, std::vector<uint8_t>& table, uint32_t index, uint32_t value);
+			void     getOverflowPages(const RecordHeader& header, const std::vector<uint8_t>& table, std::vector<uint64_t>& pages);
+			bool     writeOverflowPages(const uint8_t* data, uint32_t length, const RecordHeader* oldHeader,
+			                            const std::vector<uint8_t>& oldTable, std::vector<uint8_t>& table, std::vector<uint64_t>& allocated);
+			std::shared_ptr<RecordCursor> createOverflowRecord(uint64_t recordID, const void* data, uint32_t length);
+			uint64_t writeOverflowData(uint64_t offset, const void* data, uint32_t length);
+
+			uint64_t encodeRecordData(const void* data, uint32_t length, std::vector<uint8_t>& stored);
+			bool     decodeRecordData(const RecordHeader& header, const uint8_t* stored, uint8_t* data);
+			bool     decodeScanData(const RecordHeader& header, std::vector<uint8_t>& buffer, size_t dataOffset, uint32_t& length);
+			bool     writeCompressedRange(uint64_t offset, uint32_t position, const void* data, uint32_t length);
+			uint32_t readDataLength(uint64_t offset);
+			bool     loadDictionaries();
+			bool     moveDictionary(uint64_t offset, uint64_t newOffset);
+			std::shared_ptr<CompressionDictionary> getDictionary(uint32_t dictionaryID);
+			static uint32_t getDecodedLength(const RecordHeader& header, const uint8_t* stored);
+
+			std::shared_ptr<RecordCursor> insertRecord(uint64_t recordID, const void* data, uint32_t length);
+			bool     unlinkRecord(std::shared_ptr<RecordCursor> cursor);
+
+			std::shared_ptr<RecordVersion> beginVersion(uint64_t offset);
+			void     commitVersion(std::shared_ptr<RecordVersion> version, bool committed);
+			std::shared_ptr<RecordVersion> keepVersion(uint64_t offset);
+			std::shared_ptr<RecordVersion> keepCreatedVersion(uint64_t recordID);
+			void     tagVersion(std::shared_ptr<RecordVersion> version, bool committed, uint64_t timestamp);
+			bool     findVersion(uint64_t recordID, uint64_t timestamp, std::shared_ptr<RecordVersion>& result);
+			uint64_t openSnapshot(uint64_t& nextRecordID, uint64_t& sequence);
+			void     releaseSnapshot(uint64_t sequence);
+			void     expireSnapshots();
+			void     collectVersions();
+			bool     isSnapshotExpired(uint64_t sequence);
+			bool     readSnapshotData(uint64_t recordID, uint64_t timestamp, uint64_t sequence, std::vector<uint8_t>& data);
+			bool     readDecodedData(uint64_t offset, const RecordHeader& header, std::vector<uint8_t>& data);
+
+			bool     readRecordVersion(uint64_t recordID, RecordHeader& header, std::vector<uint8_t>* data);
+			bool     isSameVersion(const RecordHeader& header, const RecordHeader& expected);
+			bool     commitTransaction(const TransactionReads& reads, const TransactionWrites& writes);
+			uint64_t writeJournal(const TransactionWrites& writes);
+			bool     applyJournal(const TransactionWrites& writes);
+			bool     applyWrite(uint64_t recordID, const TransactionWrite& write);
+			bool     clearJournal(uint64_t offset);
+			bool     replayJournal();
+
+			std::vector<uint64_t> collectTailRecords();
+			bool     relocateRecord(uint64_t offset);
+			uint64_t truncateFreeSpace();
+
 			void     lockRecord(uint64_t offset, bool exclusive);
 			void     unlockRecord(uint64_t offset, bool exclusive);
 			
@@ -182,9 +440,12 @@ namespace Cloudless {
 
 			bool getRecordData(void* data);
 			bool setRecordData(const void* data, uint32_t length);
+			uint32_t readRange(uint32_t position, void* data, uint32_t length);
+			bool     writeRange(uint32_t position, const void* data, uint32_t length);
 			bool isValid();			
 
 			uint64_t getPosition();
+			uint64_t getRecordID();
 			uint32_t getDataLength();
 			uint32_t getRecordCapacity();
 			uint64_t getNextPosition();
@@ -198,12 +459,206 @@ namespace Cloudless {
 			RecordFileIO& recordFile;
 			RecordHeader recordHeader;			
 			std::atomic<uint64_t> currentPosition;
+			std::atomic<uint64_t> recordID;
 			std::shared_mutex cursorMutex;
 
 			bool setPosition(uint64_t);
+			bool loadHeader();
 			void invalidate();
 		};
 
+
+		//----------------------------------------------------------------------------
+		// Scanned record: position, header and data span (valid until next read ahead)
+		//----------------------------------------------------------------------------
+		struct ScanRecord {
+			uint64_t       offset;             // Record position
+			RecordHeader   header;             // Record header
+			const uint8_t* data;               // Record data
+			uint32_t       length;             // Record data length
+		};
+
+		struct ScanEntry {
+			uint64_t       offset;             // Record position
+			RecordHeader   header;             // Record header
+			size_t         dataOffset;         // Record data position in scan buffer
+			uint32_t       dataLength;         // Record data length (decompressed)
+		};
+
+		typedef std::function<bool(const ScanRecord&)> ScanCallback;
+
+		//----------------------------------------------------------------------------
+		// RecordScanner - scan mode cursor for linear traversal of all records
+		//----------------------------------------------------------------------------
+		class RecordScanner {
+		public:
+			RecordScanner(RecordFileIO& rf, uint32_t readAhead = SCAN_READ_AHEAD);
+			RecordScanner(const RecordScanner&) = delete;
+			void operator=(const RecordScanner&) = delete;
+
+			bool next(ScanRecord& record);
+			bool isInterrupted();
+			void reset();
+
+		protected:
+
+			RecordFileIO&          recordFile;
+			uint32_t               readAheadCount;
+			uint64_t               nextPosition;
+			bool                   interrupted;
+			std::vector<ScanEntry> entries;
+			std::vector<uint8_t>   buffer;
+			std::vector<uint8_t>   window;
+			size_t                 windowSize;     // Adaptive window size
+			size_t                 currentEntry;
+
+			bool readAhead();
+			bool readLocked(uint64_t offset, RecordHeader& header);
+		};
+
+		//----------------------------------------------------------------------------
+		// ParallelScanner - scans file partitions (page ranges) in parallel threads.
+		// Record boundaries are found by checksum validated headers parsing,
+		// so records are scanned in file order rather than records list order.
+		//----------------------------------------------------------------------------
+		class ParallelScanner {
+		public:
+			ParallelScanner(RecordFileIO& rf, uint32_t threadsCount = 0, bool ordered = false);
+			ParallelScanner(const ParallelScanner&) = delete;
+			void operator=(const ParallelScanner&) = delete;
+
+			bool     scan(const ScanCallback& callback);
+			uint64_t getScannedRecords();
+			uint64_t getResyncs();
+
+		protected:
+
+			struct Partition {
+				std::vector<ScanEntry> entries;
+				std::vector<uint8_t>   buffer;
+				bool                   ready = false;
+			};
+
+			RecordFileIO&         recordFile;
+			uint32_t              threadsCount;
+			bool                  ordered;
+			uint64_t              endOfData;
+			std::atomic<uint64_t> scannedRecords;
+			std::atomic<uint64_t> resyncs;
+			std::atomic<bool>     stopped;
+
+			void     scanPartition(uint64_t start, uint64_t end, Partition& partition);
+			bool     deliver(Partition& partition, const ScanCallback& callback);
+			uint64_t syncRecord(uint64_t from, uint64_t end, const std::vector<uint8_t>& chunk, uint64_t chunkStart);
+			bool     readHeader(uint64_t offset, RecordHeader& header, const std::vector<uint8_t>& chunk, uint64_t chunkStart);
+		};
+
+		//----------------------------------------------------------------------------
+		// RecordReader - sequential reader of record data by ranges
+		//----------------------------------------------------------------------------
+		class RecordReader {
+		public:
+			RecordReader(std::shared_ptr<RecordCursor> cursor);
+
+			uint32_t read(void* data, uint32_t length);
+			bool     seek(uint32_t position);
+			uint32_t getPosition();
+			uint32_t getLength();
+			bool     isFailed();
+
+		protected:
+			std::shared_ptr<RecordCursor> cursor;
+			uint32_t position;
+			uint32_t length;
+			bool     failed;
+		};
+
+		//----------------------------------------------------------------------------
+		// RecordWriter - streams data of known length to a new chunked record.
+		// Record is hidden (system record) until commit publishes it.
+		//----------------------------------------------------------------------------
+		class RecordWriter {
+		public:
+			RecordWriter(RecordFileIO& rf, uint32_t length);
+			~RecordWriter();
+			RecordWriter(const RecordWriter&) = delete;
+			void operator=(const RecordWriter&) = delete;
+
+			bool     isValid();
+			bool     write(const void* data, uint32_t length);
+			std::shared_ptr<RecordCursor> commit();
+			void     abort();
+			uint32_t getWrittenBytes();
+
+		protected:
+			RecordFileIO&         recordFile;
+			RecordHeader          recordHeader;
+			uint64_t              offset;
+			uint32_t              length;
+			uint32_t              written;
+			std::vector<uint8_t>  chunk;
+			std::vector<uint32_t> chunkChecksums;
+			std::vector<uint64_t> overflowPages;
+
+			bool     flushChunk();
+		};
+
+		//----------------------------------------------------------------------------
+		// RecordSnapshot - stable view of records as they were when snapshot opened.
+		// Reads take no record locks, writers keep replaced versions while needed.
+		// Snapshot expires (reads fail) if versions kept for it exceed memory limit.
+		//----------------------------------------------------------------------------
+		class RecordSnapshot {
+		public:
+			RecordSnapshot(RecordFileIO& rf);
+			~RecordSnapshot();
+			RecordSnapshot(const RecordSnapshot&) = delete;
+			void operator=(const RecordSnapshot&) = delete;
+
+			bool     getRecordData(uint64_t recordID, std::vector<uint8_t>& data);
+			bool     next(uint64_t& recordID, std::vector<uint8_t>& data);
+			void     reset();
+			bool     isValid();
+			uint64_t getTimestamp();
+
+		protected:
+			RecordFileIO&         recordFile;
+			uint64_t              timestamp;      // Last write timestamp visible to snapshot
+			uint64_t              sequence;       // Snapshot open sequence (expiry order)
+			uint64_t              nextRecordID;   // Records of this ID and above are created later
+			uint64_t              currentID;      // Last record ID returned by next()
+		};
+
+		//----------------------------------------------------------------------------
+		// RecordTransaction - multi-record atomic transaction. Writes are buffered
+		// in private write set and applied all at once on commit if records read
+		// or written by transaction have not been changed by others meanwhile.
+		//----------------------------------------------------------------------------
+		class RecordTransaction {
+		public:
+			RecordTransaction(RecordFileIO& rf);
+			~RecordTransaction();
+			RecordTransaction(const RecordTransaction&) = delete;
+			void operator=(const RecordTransaction&) = delete;
+
+			uint64_t createRecord(const void* data, uint32_t length);
+			bool     getRecordData(uint64_t recordID, std::vector<uint8_t>& data);
+			bool     setRecordData(uint64_t recordID, const void* data, uint32_t length);
+			bool     removeRecord(uint64_t recordID);
+			bool     commit();
+			void     abort();
+			bool     isActive();
+			size_t   getWritesCount();
+
+		protected:
+			RecordFileIO&         recordFile;
+			TransactionReads      readSet;        // Record versions transaction relies on
+			TransactionWrites     writeSet;       // Buffered writes by record ID
+			bool                  active;
+
+			bool     readRecord(uint64_t recordID, std::vector<uint8_t>* data);
+		};
+
 	}
 
 }
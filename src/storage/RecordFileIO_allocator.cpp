@@ -12,7 +12,7 @@ using namespace Cloudless::Storage;
 *
 *  @brief Allocates new record from free records list or appends to the ond of file
 *  @param[in] capacity - requested capacity of record
-*  @param[out] result  - record header of created new record
+*  @param[in,out] result - record header of created new record (bit flags set by caller)
 *  @param[in] data     - record data
 *  @param[in] length   - record data length
 *  @param[in] createNewRecord - true if creating new record, false if moving old record
@@ -53,21 +53,21 @@ uint64_t RecordFileIO::allocateRecord(uint32_t capacity, RecordHeader& result, c
 */
 uint64_t RecordFileIO::createFirstRecord(uint32_t capacity, RecordHeader& result, const void* data, uint32_t length) {
 
-	// calculate offset right after Storage header
-	uint64_t offset = STORAGE_HEADER_SIZE;
+	uint64_t offset;
 
 	// Fill record header fields
 	result.next = NOT_FOUND;
 	result.previous = NOT_FOUND;
 	result.dataLength = length;
 	result.recordCapacity = capacity;
-	result.bitFlags = 0;
 	result.dataChecksum = checksum((uint8_t*)data, length);
 	result.headChecksum = checksum((uint8_t*)&result, RECORD_HEADER_PAYLOAD_SIZE);
 
 	// update storage header
 	{
 		std::unique_lock lock(headerMutex);
+		// place right after Storage header and system records (record ID table)
+		offset = storageHeader.endOfData;
 		storageHeader.firstRecord = offset;
 		storageHeader.lastRecord = offset;
 		storageHeader.endOfData = offset + RECORD_HEADER_SIZE + capacity;
@@ -107,7 +107,6 @@ uint64_t RecordFileIO::appendNewRecord(uint32_t capacity, RecordHeader& result,
 
 	// fill record header	
 	result.recordCapacity = capacity;
-	result.bitFlags = 0;
 	result.dataLength = length;
 	result.dataChecksum = checksum((uint8_t*)data, length);
 
@@ -119,6 +118,8 @@ uint64_t RecordFileIO::appendNewRecord(uint32_t capacity, RecordHeader& result,
 
 		if (createNewRecord) {
 			lastRecordOffset = storageHeader.lastRecord;
+			// if all records were deleted, new record becomes first one
+			if (storageHeader.firstRecord == NOT_FOUND) storageHeader.firstRecord = freeRecordOffset;
 			storageHeader.lastRecord = freeRecordOffset;
 			storageHeader.totalRecords++;
 
@@ -127,11 +128,13 @@ uint64_t RecordFileIO::appendNewRecord(uint32_t capacity, RecordHeader& result,
 			result.next = NOT_FOUND;
 
 			// update last record and connect to new record
-			lockRecord(lastRecordOffset, true);
-			readRecordHeader(lastRecordOffset, lastRecord);
-			lastRecord.next = freeRecordOffset;
-			writeRecordHeader(lastRecordOffset, lastRecord);
-			unlockRecord(lastRecordOffset, true);
+			if (lastRecordOffset != NOT_FOUND) {
+				lockRecord(lastRecordOffset, true);
+				readRecordHeader(lastRecordOffset, lastRecord);
+				lastRecord.next = freeRecordOffset;
+				writeRecordHeader(lastRecordOffset, lastRecord);
+				unlockRecord(lastRecordOffset, true);
+			}
 
 		}
 
@@ -150,4 +153,96 @@ uint64_t RecordFileIO::appendNewRecord(uint32_t capacity, RecordHeader& result,
 
 
 
+/*
+*
+*  @brief Allocates system record, which is not linked to the records list
+*  @param[in] capacity - requested capacity of record
+*  @param[out] result  - record header of allocated system record
+*  @param[in] data     - initial record data of capacity length
+*  @return offset of record in the storage file
+*/
+uint64_t RecordFileIO::allocateSystemRecord(uint32_t capacity, RecordHeader& result, const void* data) {
+
+	result.next = NOT_FOUND;
+	result.previous = NOT_FOUND;
+	result.bitFlags = RECORD_SYSTEM_FLAG;
+
+	// look up free list for record of suitable capacity
+	uint64_t offset = getFromFreeList(capacity, result, data, capacity, false);
+	if (offset != NOT_FOUND) return offset;
+
+	// otherwise append to the end of file
+	return appendNewRecord(capacity, result, data, capacity, false);
+}
+
+
+
+/*
+*
+*  @brief Allocates hidden record for data being streamed by RecordWriter.
+*  Record is system record (not in records list) with empty data until published.
+*  @param[in] capacity - requested capacity of record
+*  @param[in,out] result  - record header of allocated record (bit flags set by caller)
+*  @return offset of record in the storage file
+*/
+uint64_t RecordFileIO::allocatePendingRecord(uint32_t capacity, RecordHeader& result) {
 
+	result.next = NOT_FOUND;
+	result.previous = NOT_FOUND;
+	result.bitFlags |= RECORD_SYSTEM_FLAG;
+
+	// look up free list for record of suitable capacity
+	uint64_t offset = getFromFreeList(capacity, result, nullptr, 0, false);
+	if (offset != NOT_FOUND) return offset;
+
+	// otherwise append to the end of file
+	return appendNewRecord(capacity, result, nullptr, 0, false);
+}
+
+
+
+/*
+*
+*  @brief Publishes pending record: links it to the end of records list
+*  and points its record ID to it
+*  @param[in] offset - pending record position
+*  @param[in,out] header - record header with final data length and checksum
+*  @return true if published, false otherwise
+*/
+bool RecordFileIO::publishRecord(uint64_t offset, RecordHeader& header) {
+
+	RecordHeader lastRecord;
+
+	// unique lock for whole relinking, so concurrent appends can't lose the link
+	std::unique_lock lock(headerMutex);
+	uint64_t lastRecordOffset = storageHeader.lastRecord;
+
+	header.previous = lastRecordOffset;
+	header.next = NOT_FOUND;
+	header.bitFlags &= ~RECORD_SYSTEM_FLAG;
+
+	lockRecord(offset, true);
+	bool published = writeRecordHeader(offset, header) != NOT_FOUND;
+	unlockRecord(offset, true);
+	if (!published) return false;
+
+	// update last record and connect to published record
+	if (lastRecordOffset != NOT_FOUND) {
+		lockRecord(lastRecordOffset, true);
+		readRecordHeader(lastRecordOffset, lastRecord);
+		lastRecord.next = offset;
+		writeRecordHeader(lastRecordOffset, lastRecord);
+		unlockRecord(lastRecordOffset, true);
+	}
+
+	// if all records were deleted, record becomes first one
+	if (storageHeader.firstRecord == NOT_FOUND) storageHeader.firstRecord = offset;
+	storageHeader.lastRecord = offset;
+	storageHeader.totalRecords++;
+	writeStorageHeader();
+
+	// record can't be moved by compaction while storage header is locked
+	setRecordOffset(header.bitFlags & RECORD_ID_MASK, offset);
+
+	return true;
+}
@@ -0,0 +1,342 @@
+#include "RecordFileIO.h"
+
+#include <chrono>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Online compaction methods
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Compacts storage file: moves live records from the file tail to the
+*  free records closer to the file beginning, then truncates released tail.
+*  Records are moved one by one in throttled batches, so concurrent readers
+*  and writers are blocked only while a single record is being moved.
+*  @param[in] batchSize - records to move before pause
+*  @param[in] pauseMs - pause between batches in milliseconds
+*  @return true if compaction completed, false if cancelled or not permitted
+*/
+bool RecordFileIO::compact(uint32_t batchSize, uint32_t pauseMs) {
+
+	if (!cachedFile.isOpen() || cachedFile.isReadOnly()) return false;
+
+	// Only one compaction at a time
+	std::unique_lock compactionLock(compactionMutex, std::try_to_lock);
+	if (!compactionLock.owns_lock()) return false;
+
+	// Reset compaction statistics
+	compactionCancelled.store(false);
+	compactionRecordsToMove.store(0);
+	compactionRecordsMoved.store(0);
+	compactionBytesMoved.store(0);
+	compactionBytesReclaimed.store(0);
+
+	// Collect live records placed behind the live data size
+	std::vector<uint64_t> tailRecords = collectTailRecords();
+	compactionRecordsToMove.store(tailRecords.size());
+
+	// Move records to the free space starting from the file end
+	uint32_t batchCounter = 0;
+	for (auto it = tailRecords.rbegin(); it != tailRecords.rend(); ++it) {
+		if (compactionCancelled.load()) return false;
+		// stop if there is no suitable free space before the record
+		if (!relocateRecord(*it)) break;
+		// throttle to give way to concurrent readers and writers
+		if (++batchCounter >= batchSize) {
+			batchCounter = 0;
+			std::this_thread::sleep_for(std::chrono::milliseconds(pauseMs));
+		}
+	}
+
+	// Release free space at the file end
+	uint64_t endOfData = truncateFreeSpace();
+	uint64_t newFileSize = (endOfData + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+	// Truncate file under storage header lock, so nothing is appended meanwhile
+	{
+		std::unique_lock lock(headerMutex);
+		if (storageHeader.endOfData > newFileSize) return true;
+		writeStorageHeader();
+		if (!cachedFile.flush()) return false;
+		uint64_t fileSize = cachedFile.getFileSize();
+		if (fileSize > newFileSize && cachedFile.truncate(newFileSize)) {
+			compactionBytesReclaimed.store(fileSize - newFileSize);
+		}
+	}
+
+	return true;
+}
+
+
+
+/*
+*  @brief Requests running compaction to stop after current record
+*/
+void RecordFileIO::cancelCompaction() {
+	compactionCancelled.store(true);
+}
+
+
+
+/*
+*  @brief Returns compaction statistics requested value
+*  @param[in] type of statistics
+*  @return compaction statistics requested value
+*/
+double RecordFileIO::getCompactionStats(CompactionStats type) {
+
+	double recordsToMove = (double)compactionRecordsToMove.load();
+	double recordsMoved = (double)compactionRecordsMoved.load();
+
+	switch (type) {
+	case CompactionStats::RECORDS_TO_MOVE:
+		return recordsToMove;
+	case CompactionStats::RECORDS_MOVED:
+		return recordsMoved;
+	case CompactionStats::BYTES_MOVED:
+		return double(compactionBytesMoved.load());
+	case CompactionStats::BYTES_RECLAIMED:
+		return double(compactionBytesReclaimed.load());
+	case CompactionStats::PROGRESS:
+		if (recordsToMove == 0) return 100.0;
+		return std::min(100.0, recordsMoved / recordsToMove * 100.0);
+	}
+	return 0.0;
+}
+
+
+
+/*
+*  @brief Walks records in file order from the live data end to the end of data
+*  @return positions of live records in ascending order
+*/
+std::vector<uint64_t> RecordFileIO::collectTailRecords() {
+
+	std::vector<uint64_t> records;
+	RecordHeader header;
+	uint64_t endOfData, offset;
+	uint64_t freeBytes = 0;
+
+	{
+		std::unique_lock freeLock(freeListMutex);
+		if (freeRecordsMap.empty()) return records;
+		{
+			std::shared_lock lock(headerMutex);
+			endOfData = storageHeader.endOfData;
+		}
+		// Live data would end here if there was no free space at all
+		for (auto& freeRecord : freeRecordsMap) {
+			freeBytes += RECORD_HEADER_SIZE + freeRecord.second;
+		}
+		uint64_t liveDataEnd = endOfData - std::min(freeBytes, endOfData);
+		// Free record before live data end is a known record boundary to start from
+		auto it = freeRecordsMap.upper_bound(liveDataEnd);
+		offset = (it == freeRecordsMap.begin()) ? STORAGE_HEADER_SIZE : std::prev(it)->first;
+	}
+
+	// Walk in batches, free records are split and merged only under free list lock
+	while (offset < endOfData) {
+		std::unique_lock freeLock(freeListMutex);
+		for (uint32_t i = 0; i < COMPACTION_BATCH_SIZE && offset < endOfData; i++) {
+			lockRecord(offset, false);
+			uint64_t pos = readRecordHeader(offset, header);
+			unlockRecord(offset, false);
+			// record boundary changed meanwhile - stop here
+			if (pos == NOT_FOUND) return records;
+			if (!(header.bitFlags & RECORD_DELETED_FLAG)) records.push_back(offset);
+			offset += RECORD_HEADER_SIZE + header.recordCapacity;
+		}
+	}
+
+	return records;
+}
+
+
+
+/*
+*  @brief Moves live record to the first suitable free record placed before it
+*  @param[in] offset - record position
+*  @return false if there is no suitable free space, true if moved or skipped
+*/
+bool RecordFileIO::relocateRecord(uint64_t offset) {
+
+	RecordHeader header, freeRecord, sibling;
+	uint64_t freeRecordOffset = NOT_FOUND;
+	std::vector<uint8_t> data;
+	bool moved = false;
+
+	// Synchronize all modification in free list
+	std::unique_lock freeLock(freeListMutex);
+
+	// Read record header to know required capacity, skip if deleted or moved meanwhile
+	lockRecord(offset, false);
+	uint64_t pos = readRecordHeader(offset, header);
+	unlockRecord(offset, false);
+	if (pos == NOT_FOUND || header.bitFlags & RECORD_DELETED_FLAG) return true;
+
+	// System records are pinned to their position, except ID table pages
+	bool isSystem = header.bitFlags & RECORD_SYSTEM_FLAG;
+	if (isSystem && !isIDTablePage(offset)) return true;
+
+	// Chunked record keeps chunk checksums table before data, overflow record only pages table
+	uint64_t storedLength = getStoredLength(header);
+
+	// First fit lookup of free record before the record position
+	for (auto& [freeOffset, freeCapacity] : freeRecordsMap) {
+		if (freeOffset >= offset) break;
+		if (freeCapacity >= storedLength) {
+			freeRecordOffset = freeOffset;
+			break;
+		}
+	}
+	// ID table page needs large hole, so keep moving smaller records after it
+	if (freeRecordOffset == NOT_FOUND) return isSystem;
+
+	// Take free record from the free list and cut requested capacity
+	lockRecord(freeRecordOffset, true);
+	bool isFree = readRecordHeader(freeRecordOffset, freeRecord) != NOT_FOUND;
+	isFree = isFree && (freeRecord.bitFlags & RECORD_DELETED_FLAG);
+	if (isFree) removeRecordFromFreeList(freeRecordOffset, freeRecord);
+	unlockRecord(freeRecordOffset, true);
+	if (!isFree) return false;
+	uint32_t capacity = splitFreeRecord(freeRecordOffset, freeRecord, (uint32_t)storedLength);
+
+	// Move record under storage header lock, so siblings and first/last links are consistent
+	{
+		std::unique_lock lock(headerMutex);
+		lockRecord(offset, true);
+		// ID table entries must not change while ID table page is moved
+		std::unique_lock idLock(idTableMutex, std::defer_lock);
+		if (isSystem) idLock.lock();
+
+		// Check record is still live and read its data (system records data has no checksum)
+		pos = readRecordHeader(offset, header);
+		moved = (pos != NOT_FOUND) && !(header.bitFlags & RECORD_DELETED_FLAG);
+		storedLength = getStoredLength(header);
+		moved = moved && (storedLength <= capacity);
+		if (moved) {
+			data.resize(storedLength);
+			if (storedLength > 0) cachedFile.read(offset + RECORD_HEADER_SIZE, data.data(), storedLength);
+			// overflow record keeps only pages table, pages themselves are pinned
+			const uint8_t* payload = data.data();
+			if (!(header.bitFlags & RECORD_OVERFLOW_FLAG)) payload += storedLength - header.dataLength;
+			moved = isSystem || verifyRecordData(header, data.data(), payload);
+		}
+
+		if (moved) {
+			// Write record data and header to the new place
+			RecordHeader movedRecord;
+			memcpy(&movedRecord, &header, RECORD_HEADER_SIZE);
+			movedRecord.recordCapacity = capacity;
+			lockRecord(freeRecordOffset, true);
+			if (storedLength > 0) cachedFile.write(freeRecordOffset + RECORD_HEADER_SIZE, data.data(), storedLength);
+			writeRecordHeader(freeRecordOffset, movedRecord);
+			unlockRecord(freeRecordOffset, true);
+
+			// interconnect with left sibling if exists
+			if (header.previous != NOT_FOUND) {
+				lockRecord(header.previous, true);
+				readRecordHeader(header.previous, sibling);
+				sibling.next = freeRecordOffset;
+				writeRecordHeader(header.previous, sibling);
+				unlockRecord(header.previous, true);
+			}
+
+			// interconnect with right sibling if exists
+			if (header.next != NOT_FOUND) {
+				lockRecord(header.next, true);
+				readRecordHeader(header.next, sibling);
+				sibling.previous = freeRecordOffset;
+				writeRecordHeader(header.next, sibling);
+				unlockRecord(header.next, true);
+			}
+
+			// if moved record was first or last, update storage header
+			if (storageHeader.firstRecord == offset) storageHeader.firstRecord = freeRecordOffset;
+			if (storageHeader.lastRecord == offset) storageHeader.lastRecord = freeRecordOffset;
+			writeStorageHeader();
+
+			// Point ID table (or ID table pages chain) to the new position
+			if (isSystem) moveIDTablePage(offset, freeRecordOffset);
+			else setRecordOffset(header.bitFlags & RECORD_ID_MASK, freeRecordOffset);
+
+			// Mark old position as deleted, so cursors at this position are invalidated
+			header.next = NOT_FOUND;
+			header.previous = NOT_FOUND;
+			header.dataLength = 0;
+			header.dataChecksum = 0;
+			header.bitFlags = RECORD_DELETED_FLAG;
+			writeRecordHeader(offset, header);
+		}
+
+		if (idLock.owns_lock()) idLock.unlock();
+		unlockRecord(offset, true);
+	}
+
+	// If record changed meanwhile, return taken free record back to the free list
+	if (!moved) {
+		freeRecord.recordCapacity = capacity;
+		releaseRecord(freeRecordOffset, freeRecord);
+		return true;
+	}
+
+	// Release old record space, it merges with the free space at the file end
+	compactionRecordsMoved.fetch_add(1);
+	compactionBytesMoved.fetch_add(data.size());
+	releaseRecord(offset, header);
+
+	return true;
+}
+
+
+
+/*
+*  @brief Cuts free records placed at the end of data
+*  @return new end of data position
+*/
+uint64_t RecordFileIO::truncateFreeSpace() {
+
+	RecordHeader freeRecord;
+
+	// Synchronize all modification in free list
+	std::unique_lock freeLock(freeListMutex);
+
+	while (!freeRecordsMap.empty()) {
+
+		// Check if last free record in file order ends at the end of data
+		auto last = std::prev(freeRecordsMap.end());
+		uint64_t offset = last->first;
+		uint64_t endOfRecord = offset + RECORD_HEADER_SIZE + last->second;
+		{
+			std::shared_lock lock(headerMutex);
+			if (storageHeader.endOfData != endOfRecord) break;
+		}
+
+		// Remove free record from the free list
+		lockRecord(offset, true);
+		bool isFree = readRecordHeader(offset, freeRecord) != NOT_FOUND;
+		isFree = isFree && (freeRecord.bitFlags & RECORD_DELETED_FLAG);
+		if (isFree) removeRecordFromFreeList(offset, freeRecord);
+		unlockRecord(offset, true);
+		if (!isFree) break;
+
+		// Move end of data back if nothing has been appended meanwhile
+		{
+			std::unique_lock lock(headerMutex);
+			if (storageHeader.endOfData == endOfRecord) {
+				storageHeader.endOfData = offset;
+				writeStorageHeader();
+				continue;
+			}
+		}
+
+		// Records were appended, so return free record back to the free list
+		releaseRecord(offset, freeRecord);
+		break;
+	}
+
+	std::shared_lock lock(headerMutex);
+	return storageHeader.endOfData;
+}
@@ -0,0 +1,398 @@
+#include "RecordFileIO.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Records compression methods
+//
+// Record data of COMPRESSION_THRESHOLD or more is compressed if compression
+// is enabled and the data actually shrinks. Codec is kept in record header
+// bits 56-59, compressed record stores decompressed length before data:
+//
+//   [ header ][ decompressed length (uint32) ][ compressed data ]
+//
+// Header data length and checksum describe stored bytes, so free list,
+// compaction and scanners treat compressed record as plain one. Chunked and
+// overflow records (streamed or large data) are never compressed.
+//
+// Shared dictionary codec keeps dictionary ID after decompressed length.
+// Dictionaries are system records chained from the latest one:
+//
+//   [ dictionary ID ][ dictionary size ][ previous dictionary offset ][ dictionary ]
+//
+// Retraining adds new dictionary version, records keep the version they
+// were compressed with, so all versions are loaded on open and kept.
+// Lock order: record -> dictionaries.
+//-----------------------------------------------------------------------------
+
+constexpr uint32_t DECODED_LENGTH_SIZE = sizeof(uint32_t);
+constexpr uint32_t DICTIONARY_ID_SIZE = sizeof(uint32_t);
+constexpr uint32_t DICTIONARY_HEADER_SIZE = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+
+/*
+*  @brief Sets compression codec for records written from now on. Records
+*  keep their codec, so file can contain records of different codecs.
+*  Shared dictionary codec works as LZ until dictionary is trained.
+*  @param[in] type - compression codec (CompressionType::NONE to disable)
+*  @param[in] threshold - minimal data length to compress
+*/
+void RecordFileIO::setCompression(CompressionType type, uint32_t threshold) {
+	compressionThreshold.store(threshold);
+	compressionType.store(type);
+}
+
+
+
+/*
+*  @brief Returns compression codec for records written from now on
+*  @return compression codec
+*/
+CompressionType RecordFileIO::getCompression() {
+	return compressionType.load();
+}
+
+
+
+/*
+*  @brief Compresses record data if compression enabled and data shrinks
+*  @param[in] data - record data
+*  @param[in] length - record data length
+*  @param[out] stored - bytes to store in record (decompressed length and compressed data)
+*  @return codec bit flags or zero if data should be stored as is
+*/
+uint64_t RecordFileIO::encodeRecordData(const void* data, uint32_t length, std::vector<uint8_t>& stored) {
+
+	CompressionType type = compressionType.load();
+	if (type == CompressionType::NONE || length < compressionThreshold.load()) return 0;
+	if (length >= OVERFLOW_THRESHOLD) return 0;
+
+	// compress with the latest dictionary version if there is one
+	std::shared_ptr<CompressionDictionary> dictionary;
+	uint32_t dictionaryID = 0;
+	if (type == CompressionType::LZ_DICTIONARY) {
+		dictionaryID = getDictionaryID();
+		dictionary = getDictionary(dictionaryID);
+		if (dictionary == nullptr) type = CompressionType::LZ;
+	}
+	uint32_t prefixSize = DECODED_LENGTH_SIZE + (dictionary != nullptr ? DICTIONARY_ID_SIZE : 0);
+	if (length <= prefixSize) return 0;
+
+	// compressed data must be smaller than original, otherwise store as is
+	stored.resize(length);
+	uint32_t capacity = length - prefixSize;
+	uint32_t compressedLength = Compression::compress((const uint8_t*)data, length, stored.data() + prefixSize, capacity, dictionary.get());
+	if (compressedLength == 0) return 0;
+
+	memcpy(stored.data(), &length, DECODED_LENGTH_SIZE);
+	if (dictionary != nullptr) memcpy(stored.data() + DECODED_LENGTH_SIZE, &dictionaryID, DICTIONARY_ID_SIZE);
+	stored.resize(prefixSize + compressedLength);
+
+	return (uint64_t)type << RECORD_CODEC_SHIFT;
+}
+
+
+
+/*
+*  @brief Decompresses record data
+*  @param[in] header - record header
+*  @param[in] stored - bytes stored in record (checked by caller)
+*  @param[out] data - buffer of decompressed data length
+*  @return true if decompressed, false if codec or dictionary unknown or data corrupt
+*/
+bool RecordFileIO::decodeRecordData(const RecordHeader& header, const uint8_t* stored, uint8_t* data) {
+
+	CompressionType type = (CompressionType)((header.bitFlags & RECORD_CODEC_MASK) >> RECORD_CODEC_SHIFT);
+	std::shared_ptr<CompressionDictionary> dictionary;
+	uint32_t prefixSize = DECODED_LENGTH_SIZE;
+
+	if (type == CompressionType::LZ_DICTIONARY) {
+		prefixSize += DICTIONARY_ID_SIZE;
+		if (header.dataLength < prefixSize) return false;
+		uint32_t dictionaryID;
+		memcpy(&dictionaryID, stored + DECODED_LENGTH_SIZE, DICTIONARY_ID_SIZE);
+		dictionary = getDictionary(dictionaryID);
+		if (dictionary == nullptr) return false;
+	} else if (type != CompressionType::LZ || header.dataLength < prefixSize) return false;
+
+	uint32_t length = getDecodedLength(header, stored);
+	return Compression::decompress(stored + prefixSize, header.dataLength - prefixSize, data, length, dictionary.get());
+}
+
+
+
+/*
+*  @brief Replaces stored bytes of compressed record in scan buffer with decompressed data
+*  @param[in] header - record header
+*  @param[in,out] buffer - scan buffer, stored bytes are at the end of buffer
+*  @param[in] dataOffset - stored bytes position in buffer
+*  @param[out] length - decompressed data length
+*  @return true if decompressed, false if codec unknown or data corrupt
+*/
+bool RecordFileIO::decodeScanData(const RecordHeader& header, std::vector<uint8_t>& buffer, size_t dataOffset, uint32_t& length) {
+
+	length = header.dataLength;
+	if (!(header.bitFlags & RECORD_CODEC_MASK)) return true;
+
+	std::vector<uint8_t> stored(buffer.begin() + dataOffset, buffer.begin() + dataOffset + header.dataLength);
+	length = getDecodedLength(header, stored.data());
+	buffer.resize(dataOffset + length);
+
+	return decodeRecordData(header, stored.data(), buffer.data() + dataOffset);
+}
+
+
+
+/*
+*  @brief Reads record data length (decompressed length for compressed record)
+*  @param[in] offset - record position in the file
+*  @return data length or zero if record is not found
+*/
+uint32_t RecordFileIO::readDataLength(uint64_t offset) {
+
+	RecordHeader header;
+	uint32_t length = 0;
+
+	lockRecord(offset, false);
+	if (readRecordHeader(offset, header) != NOT_FOUND && !(header.bitFlags & RECORD_DELETED_FLAG)) {
+		length = header.dataLength;
+		if ((header.bitFlags & RECORD_CODEC_MASK) && header.dataLength >= DECODED_LENGTH_SIZE) {
+			cachedFile.read(offset + RECORD_HEADER_SIZE, &length, DECODED_LENGTH_SIZE);
+		}
+	}
+	unlockRecord(offset, false);
+
+	return length;
+}
+
+
+
+/*
+*  @brief Data length of record by its stored bytes
+*  @param[in] header - record header
+*  @param[in] stored - bytes stored in record
+*  @return decompressed length for compressed record, data length otherwise
+*/
+uint32_t RecordFileIO::getDecodedLength(const RecordHeader& header, const uint8_t* stored) {
+	if (!(header.bitFlags & RECORD_CODEC_MASK) || header.dataLength < DECODED_LENGTH_SIZE) return header.dataLength;
+	uint32_t length;
+	memcpy(&length, stored, DECODED_LENGTH_SIZE);
+	return length;
+}
+
+
+
+/*
+*  @brief Overwrites range of compressed record data: decompresses data,
+*  updates range and writes data compressed again (record may move)
+*  @param[in] offset - record position in the file
+*  @param[in] position - first data byte to write
+*  @param[in] data - pointer to new data
+*  @param[in] length - bytes to write
+*  @return true if range written, false if out of data length or data corrupted
+*/
+bool RecordFileIO::writeCompressedRange(uint64_t offset, uint32_t position, const void* data, uint32_t length) {
+
+	RecordHeader header;
+
+	// retry if record has been changed by other thread meanwhile
+	for (int attempt = 0; attempt < 3; attempt++) {
+
+		std::vector<uint8_t> stored, whole;
+		lockRecord(offset, false);
+		bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+		valid = valid && (header.bitFlags & RECORD_CODEC_MASK) && !(header.bitFlags & RECORD_DELETED_FLAG);
+		if (valid) {
+			stored.resize(header.dataLength);
+			valid = readStoredData(offset, header, stored.data());
+			if (valid) whole.resize(getDecodedLength(header, stored.data()));
+			valid = valid && decodeRecordData(header, stored.data(), whole.data());
+		}
+		unlockRecord(offset, false);
+		if (!valid || (uint64_t)position + length > whole.size()) return false;
+		if (length == 0) return true;
+
+		memcpy(whole.data() + position, data, length);
+
+		// write only if record is the same version as decompressed one
+		std::vector<uint64_t> oldPages;
+		uint32_t wholeLength = (uint32_t)whole.size();
+		uint64_t newOffset, codecFlags = encodeRecordData(whole.data(), wholeLength, stored);
+		if (codecFlags != 0) {
+			uint32_t storedLength = (uint32_t)stored.size();
+			newOffset = writeStoredData(offset, stored.data(), storedLength, storedLength, codecFlags, &header, oldPages);
+		} else newOffset = writeStoredData(offset, whole.data(), wholeLength, wholeLength, 0, &header, oldPages);
+		if (newOffset != NOT_FOUND) return true;
+	}
+
+	return false;
+}
+
+
+
+/*
+*  @brief Trains compression dictionary on evenly sampled records and stores
+*  it as the new dictionary version. Records written with shared dictionary
+*  codec from now on use it, existing records keep their dictionary version.
+*  @param[in] dictionarySize - dictionary size in bytes
+*  @return new dictionary ID or zero if there are too few records or file is read only
+*/
+uint32_t RecordFileIO::trainDictionary(uint32_t dictionarySize) {
+
+	if (!cachedFile.isOpen() || cachedFile.isReadOnly()) return 0;
+	dictionarySize = std::clamp(dictionarySize, DICTIONARY_MIN_SIZE, COMPRESSION_MAX_DICTIONARY);
+
+	// one dictionary version is trained at once
+	std::unique_lock growLock(dictionaryGrowMutex);
+
+	// sample every n-th record, records larger than chunk are not typical documents
+	uint64_t stride = std::max<uint64_t>(1, getTotalRecords() / DICTIONARY_SAMPLES);
+	uint64_t samplesBudget = (uint64_t)dictionarySize * DICTIONARY_SAMPLES_RATIO;
+	uint64_t sampledBytes = 0, index = 0;
+	std::vector<std::vector<uint8_t>> samples;
+	RecordScanner scanner(*this);
+	ScanRecord record;
+	while (sampledBytes < samplesBudget && scanner.next(record)) {
+		if (index++ % stride != 0 || record.length > RECORD_CHUNK_SIZE) continue;
+		samples.emplace_back(record.data, record.data + record.length);
+		sampledBytes += record.length;
+	}
+
+	std::vector<uint8_t> dictionary = Compression::trainDictionary(samples, dictionarySize);
+	if (dictionary.size() < DICTIONARY_MIN_SIZE) return 0;
+
+	// store dictionary as system record linked to the previous version
+	uint32_t dictionaryID = getDictionaryID() + 1;
+	uint32_t size = (uint32_t)dictionary.size();
+	uint64_t previous;
+	{
+		std::shared_lock lock(headerMutex);
+		previous = storageHeader.lastDictionary;
+	}
+	std::vector<uint8_t> data(DICTIONARY_HEADER_SIZE + size);
+	memcpy(data.data(), &dictionaryID, sizeof(uint32_t));
+	memcpy(data.data() + sizeof(uint32_t), &size, sizeof(uint32_t));
+	memcpy(data.data() + 2 * sizeof(uint32_t), &previous, sizeof(uint64_t));
+	memcpy(data.data() + DICTIONARY_HEADER_SIZE, dictionary.data(), size);
+
+	RecordHeader header;
+	uint64_t offset = allocateSystemRecord((uint32_t)data.size(), header, data.data());
+	if (offset == NOT_FOUND) return 0;
+	{
+		std::unique_lock lock(headerMutex);
+		storageHeader.lastDictionary = offset;
+		writeStorageHeader();
+	}
+
+	std::unique_lock lock(dictionaryMutex);
+	dictionaries[dictionaryID] = std::make_shared<CompressionDictionary>(dictionary.data(), size);
+
+	return dictionaryID;
+}
+
+
+
+/*
+*  @brief Returns the latest dictionary ID used to compress new records
+*  @return dictionary ID or zero if no dictionary trained
+*/
+uint32_t RecordFileIO::getDictionaryID() {
+	std::shared_lock lock(dictionaryMutex);
+	return dictionaries.empty() ? 0 : dictionaries.rbegin()->first;
+}
+
+
+
+/*
+*  @brief Returns dictionary of given version
+*  @param[in] dictionaryID - dictionary ID
+*  @return dictionary or nullptr if there is no such dictionary
+*/
+std::shared_ptr<CompressionDictionary> RecordFileIO::getDictionary(uint32_t dictionaryID) {
+	std::shared_lock lock(dictionaryMutex);
+	auto it = dictionaries.find(dictionaryID);
+	return it != dictionaries.end() ? it->second : nullptr;
+}
+
+
+
+/*
+*  @brief Loads all dictionary versions walking dictionaries chain
+*  @return true if dictionaries chain is consistent, false otherwise
+*/
+bool RecordFileIO::loadDictionaries() {
+
+	RecordHeader header;
+	uint64_t offset;
+
+	{
+		std::shared_lock lock(headerMutex);
+		offset = storageHeader.lastDictionary;
+	}
+
+	std::unique_lock lock(dictionaryMutex);
+	dictionaries.clear();
+
+	std::vector<uint8_t> data;
+	uint32_t previousID = UINT32_MAX;
+	while (offset != NOT_FOUND) {
+		if (readRecordHeader(offset, header) == NOT_FOUND) return false;
+		if (!(header.bitFlags & RECORD_SYSTEM_FLAG) || (header.bitFlags & RECORD_DELETED_FLAG)) return false;
+		if (header.dataLength < DICTIONARY_HEADER_SIZE || header.dataLength > header.recordCapacity) return false;
+		data.resize(header.dataLength);
+		cachedFile.read(offset + RECORD_HEADER_SIZE, data.data(), header.dataLength);
+		if (checksum(data.data(), header.dataLength) != header.dataChecksum) return false;
+
+		// versions decrease along the chain (otherwise chain is corrupt or cyclic)
+		uint32_t dictionaryID, size;
+		memcpy(&dictionaryID, data.data(), sizeof(uint32_t));
+		memcpy(&size, data.data() + sizeof(uint32_t), sizeof(uint32_t));
+		memcpy(&offset, data.data() + 2 * sizeof(uint32_t), sizeof(uint64_t));
+		if (dictionaryID == 0 || dictionaryID >= previousID) return false;
+		if (size != header.dataLength - DICTIONARY_HEADER_SIZE) return false;
+		dictionaries[dictionaryID] = std::make_shared<CompressionDictionary>(data.data() + DICTIONARY_HEADER_SIZE, size);
+		previousID = dictionaryID;
+	}
+
+	return true;
+}
+
+
+
+/*
+*  @brief Relinks dictionaries chain to dictionary moved by upgrade
+*  (called by open, file is not shared yet)
+*  @param[in] offset - old dictionary position
+*  @param[in] newOffset - new dictionary position
+*  @return true if relinked or it is not in chain, false if chain write failed
+*/
+bool RecordFileIO::moveDictionary(uint64_t offset, uint64_t newOffset) {
+
+	if (storageHeader.lastDictionary == offset) {
+		storageHeader.lastDictionary = newOffset;
+		return true;
+	}
+
+	// newer dictionary keeps position of previous one in its data
+	RecordHeader header;
+	std::vector<uint8_t> data;
+	uint64_t current = storageHeader.lastDictionary;
+	while (current != NOT_FOUND) {
+		if (readRecordHeader(current, header) == NOT_FOUND) return false;
+		data.resize(header.dataLength);
+		if (cachedFile.read(current + RECORD_HEADER_SIZE, data.data(), header.dataLength) != header.dataLength) return false;
+		uint64_t previous;
+		memcpy(&previous, data.data() + 2 * sizeof(uint32_t), sizeof(uint64_t));
+		if (previous == offset) {
+			memcpy(data.data() + 2 * sizeof(uint32_t), &newOffset, sizeof(uint64_t));
+			header.dataChecksum = checksum(data.data(), header.dataLength);
+			if (cachedFile.write(current + RECORD_HEADER_SIZE, data.data(), header.dataLength) != header.dataLength) return false;
+			return writeRecordHeader(current, header) != NOT_FOUND;
+		}
+		current = previous;
+	}
+
+	return true;
+}
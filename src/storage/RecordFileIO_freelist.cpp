@@ -47,32 +47,42 @@ uint64_t RecordFileIO::getFromFreeList(uint32_t capacity, RecordHeader& result,
 		if (freeRecord.recordCapacity >= capacity && (freeRecord.bitFlags & RECORD_DELETED_FLAG)) {
 
 			// Remove free record from the free list
-			removeRecordFromFreeList(freeRecord);
+			removeRecordFromFreeList(freeRecordOffset, freeRecord);
+
+			// Return unused tail of oversized free record back to the free list
+			uint32_t recordCapacity = splitFreeRecord(freeRecordOffset, freeRecord, capacity);
 
 			// update last record to point to new record
 			RecordHeader previousRecord;
 
 			// connect new record with previous			
-			result.recordCapacity = freeRecord.recordCapacity;
+			result.recordCapacity = recordCapacity;
 			result.dataLength = length;
 			result.dataChecksum = checksum((uint8_t*)data, length);
-			// turn off "record deleted" bit
-			result.bitFlags = freeRecord.bitFlags & (~RECORD_DELETED_FLAG);
+			// bit flags (record ID) are set by caller, stale flags of free record are dropped
 
-			// update storage header last record to new record
+			// connect new record to the last record and update storage header
 			if (createNewRecord) {
-				std::shared_lock lock(headerMutex);
-				// connect to previous record
+				// unique lock for whole relinking, so concurrent appends can't lose the link
+				std::unique_lock lock(headerMutex);
 				previousRecordPos = storageHeader.lastRecord;
 
 				result.next = NOT_FOUND;
-				result.previous = previousRecordPos;					
-
-				lockRecord(previousRecordPos, true);
-				readRecordHeader(previousRecordPos, previousRecord);
-				previousRecord.next = freeRecordOffset;
-				writeRecordHeader(previousRecordPos, previousRecord);
-				unlockRecord(previousRecordPos, true);
+				result.previous = previousRecordPos;
+
+				if (previousRecordPos != NOT_FOUND) {
+					lockRecord(previousRecordPos, true);
+					readRecordHeader(previousRecordPos, previousRecord);
+					previousRecord.next = freeRecordOffset;
+					writeRecordHeader(previousRecordPos, previousRecord);
+					unlockRecord(previousRecordPos, true);
+				}
+
+				// if all records were deleted, new record becomes first one
+				if (storageHeader.firstRecord == NOT_FOUND) storageHeader.firstRecord = freeRecordOffset;
+				storageHeader.lastRecord = freeRecordOffset;
+				storageHeader.totalRecords++;
+				writeStorageHeader();
 			}
 
 			// Update record
@@ -81,14 +91,6 @@ uint64_t RecordFileIO::getFromFreeList(uint32_t capacity, RecordHeader& result,
 			cachedFile.write(freeRecordOffset + RECORD_HEADER_SIZE, data, length);
 			unlockRecord(freeRecordOffset, true);
 
-			// Update storage header
-			if (createNewRecord) {
-				std::unique_lock lock(headerMutex);
-				storageHeader.lastRecord = freeRecordOffset;
-				storageHeader.totalRecords++;
-				writeStorageHeader();
-			}
-
 			return freeRecordOffset;
 		}
 
@@ -103,14 +105,15 @@ uint64_t RecordFileIO::getFromFreeList(uint32_t capacity, RecordHeader& result,
 
 
 /*
-*  @brief Put record to the free list
+*  @brief Put record to the free list and merge it with physically adjacent free records
 *  @return true - if record added to the free list, false - if not found
 */
 bool RecordFileIO::addRecordToFreeList(uint64_t offset) {
 
 	RecordHeader newFreeRecord;
-	RecordHeader previousFreeRecord;
-	size_t previousFreeRecordOffset;
+
+	// Synchronize all modification in free list
+	std::unique_lock freeLock(freeListMutex);
 
 	lockRecord(offset, false);
 	if (readRecordHeader(offset, newFreeRecord) == NOT_FOUND) {
@@ -122,6 +125,48 @@ bool RecordFileIO::addRecordToFreeList(uint64_t offset) {
 	// Check if already deleted
 	if (newFreeRecord.bitFlags & RECORD_DELETED_FLAG) return false;
 
+	// Set data length and data checksum to zero, then mark as deleted	
+	newFreeRecord.next = NOT_FOUND;
+	newFreeRecord.previous = NOT_FOUND;
+	newFreeRecord.dataLength = 0;
+	newFreeRecord.dataChecksum = 0;
+	// turn on "record deleted" bit
+	newFreeRecord.bitFlags |= RECORD_DELETED_FLAG;
+	// Save record header before merge, so cursors at this position are invalidated
+	lockRecord(offset, true);
+	writeRecordHeader(offset, newFreeRecord);
+	unlockRecord(offset, true);
+
+	// Merge with free neighbours and add merged record to the free list
+	releaseRecord(offset, newFreeRecord);
+
+	return true;
+}
+
+
+
+/*
+*  @brief Merges deleted record with free neighbours and adds it to the free list (caller locks freeListMutex)
+*  @param[in] offset - position of record already marked as deleted
+*  @param[in] freeRecord - header of deleted record
+*/
+void RecordFileIO::releaseRecord(uint64_t offset, RecordHeader& freeRecord) {
+	uint64_t freeRecordOffset = coalesceFreeRecord(offset, freeRecord);
+	linkFreeRecord(freeRecordOffset, freeRecord);
+}
+
+
+
+/*
+*  @brief Appends deleted record to the end of free list (caller locks freeListMutex)
+*  @param[in] offset - position of deleted record in the file
+*  @param[in] freeRecord - header of deleted record (links are updated)
+*/
+void RecordFileIO::linkFreeRecord(uint64_t offset, RecordHeader& freeRecord) {
+
+	RecordHeader previousFreeRecord;
+	uint64_t previousFreeRecordOffset;
+
 	{
 		std::unique_lock lock(headerMutex);
 		// Update previous free record to reference next new free record
@@ -136,13 +181,9 @@ bool RecordFileIO::addRecordToFreeList(uint64_t offset) {
 		// save storage header
 		writeStorageHeader();
 	}
-	
 
 	// if free records list is not empty
 	if (previousFreeRecordOffset != NOT_FOUND) {
-		// Synchronize all modification in free list
-		//std::unique_lock freeLock(freeListMutex);
-
 		// load previous last record
 		lockRecord(previousFreeRecordOffset, true);
 		readRecordHeader(previousFreeRecordOffset, previousFreeRecord);
@@ -153,29 +194,142 @@ bool RecordFileIO::addRecordToFreeList(uint64_t offset) {
 		unlockRecord(previousFreeRecordOffset, true);
 	}
 
-	// Update new free record fields	
-	newFreeRecord.next = NOT_FOUND;
 	// Point to the previous free record position
-	newFreeRecord.previous = previousFreeRecordOffset;
-	// Set data length and data checksum to zero, then mark as deleted	
-	newFreeRecord.dataLength = 0;
-	newFreeRecord.dataChecksum = 0;
-	// turn on "record deleted" bit
-	newFreeRecord.bitFlags |= RECORD_DELETED_FLAG;
+	freeRecord.next = NOT_FOUND;
+	freeRecord.previous = previousFreeRecordOffset;
+	freeRecord.dataLength = 0;
+	freeRecord.dataChecksum = 0;
+	freeRecord.bitFlags |= RECORD_DELETED_FLAG;
+
 	// Save record header
 	lockRecord(offset, true);
-	writeRecordHeader(offset, newFreeRecord);
+	writeRecordHeader(offset, freeRecord);
 	unlockRecord(offset, true);
 
-	return true;
+	// Register free record for physical neighbour lookups
+	freeRecordsMap[offset] = freeRecord.recordCapacity;
+}
+
+
+
+/*
+*  @brief Splits removed from free list record if it much bigger than requested (caller locks freeListMutex)
+*  @param[in] offset - position of the record taken from free list
+*  @param[in] freeRecord - header of the record taken from free list
+*  @param[in] capacity - requested capacity
+*  @return capacity of the record after split
+*/
+uint32_t RecordFileIO::splitFreeRecord(uint64_t offset, RecordHeader& freeRecord, uint32_t capacity) {
+
+	// Check if remainder is big enough to become separate record
+	uint64_t remainder = freeRecord.recordCapacity - capacity;
+	if (capacity == 0 || remainder < RECORD_HEADER_SIZE + MINIMAL_SPLIT_CAPACITY) {
+		return freeRecord.recordCapacity;
+	}
+
+	// Remainder starts right after requested capacity
+	uint64_t remainderOffset = offset + RECORD_HEADER_SIZE + capacity;
+	RecordHeader remainderRecord{};
+	remainderRecord.next = NOT_FOUND;
+	remainderRecord.previous = NOT_FOUND;
+	remainderRecord.bitFlags = RECORD_DELETED_FLAG;
+	remainderRecord.recordCapacity = static_cast<uint32_t>(remainder - RECORD_HEADER_SIZE);
+
+	// Merge remainder with right neighbour if it is free and add to the free list
+	releaseRecord(remainderOffset, remainderRecord);
+
+	return capacity;
 }
 
 
+
+/*
+*  @brief Merges deleted record with physically adjacent free records (caller locks freeListMutex)
+*  @param[in] offset - position of deleted record, which is not in the free list yet
+*  @param[in,out] freeRecord - header of deleted record, updated to merged record header
+*  @return position of merged record
+*/
+uint64_t RecordFileIO::coalesceFreeRecord(uint64_t offset, RecordHeader& freeRecord) {
+
+	RecordHeader neighbour;
+	uint64_t mergedCapacity;
+
+	// Right neighbour starts right after the record capacity
+	uint64_t rightOffset = offset + RECORD_HEADER_SIZE + freeRecord.recordCapacity;
+	auto right = freeRecordsMap.find(rightOffset);
+	if (right != freeRecordsMap.end()) {
+		mergedCapacity = freeRecord.recordCapacity + RECORD_HEADER_SIZE + right->second;
+		if (mergedCapacity <= UINT32_MAX) {
+			lockRecord(rightOffset, true);
+			bool isFree = readRecordHeader(rightOffset, neighbour) != NOT_FOUND;
+			isFree = isFree && (neighbour.bitFlags & RECORD_DELETED_FLAG);
+			if (isFree) removeRecordFromFreeList(rightOffset, neighbour);
+			unlockRecord(rightOffset, true);
+			if (isFree) freeRecord.recordCapacity = static_cast<uint32_t>(mergedCapacity);
+		}
+	}
+
+	// Left neighbour is the nearest free record which ends at record position
+	auto left = freeRecordsMap.lower_bound(offset);
+	if (left != freeRecordsMap.begin()) {
+		--left;
+		uint64_t leftOffset = left->first;
+		if (leftOffset + RECORD_HEADER_SIZE + left->second == offset) {
+			mergedCapacity = left->second + RECORD_HEADER_SIZE + freeRecord.recordCapacity;
+			if (mergedCapacity <= UINT32_MAX) {
+				lockRecord(leftOffset, true);
+				bool isFree = readRecordHeader(leftOffset, neighbour) != NOT_FOUND;
+				isFree = isFree && (neighbour.bitFlags & RECORD_DELETED_FLAG);
+				if (isFree) removeRecordFromFreeList(leftOffset, neighbour);
+				unlockRecord(leftOffset, true);
+				if (isFree) {
+					neighbour.recordCapacity = static_cast<uint32_t>(mergedCapacity);
+					memcpy(&freeRecord, &neighbour, RECORD_HEADER_SIZE);
+					offset = leftOffset;
+				}
+			}
+		}
+	}
+
+	return offset;
+}
+
+
+
+/*
+*  @brief Loads free records positions to the memory for physical neighbour lookups
+*  @return true - if free list is consistent, false - otherwise
+*/
+bool RecordFileIO::loadFreeRecordsMap() {
+
+	RecordHeader freeRecord;
+	uint64_t offset, totalFreeRecords;
+
+	std::unique_lock freeLock(freeListMutex);
+	{
+		std::shared_lock lock(headerMutex);
+		offset = storageHeader.firstFreeRecord;
+		totalFreeRecords = storageHeader.totalFreeRecords;
+	}
+
+	freeRecordsMap.clear();
+	while (offset != NOT_FOUND && freeRecordsMap.size() < totalFreeRecords) {
+		if (readRecordHeader(offset, freeRecord) == NOT_FOUND) return false;
+		freeRecordsMap[offset] = freeRecord.recordCapacity;
+		offset = freeRecord.next;
+	}
+
+	return freeRecordsMap.size() == totalFreeRecords;
+}
+
+
+
 /*
 *  @brief Remove record from free list and update siblings interlinks
+*  @param[in] offset - position of record to remove from free list
 *  @param[in] freeRecord - header of record to remove from free list
 */
-void RecordFileIO::removeRecordFromFreeList(RecordHeader& freeRecord) {
+void RecordFileIO::removeRecordFromFreeList(uint64_t offset, RecordHeader& freeRecord) {
 
 	if (!(freeRecord.bitFlags & RECORD_DELETED_FLAG)) {
 		std::cerr << "restoring already restored record\n";
@@ -251,5 +405,6 @@ void RecordFileIO::removeRecordFromFreeList(RecordHeader& freeRecord) {
 		writeStorageHeader();		
 	}
 
-	
+	// Free record is not a physical neighbour candidate anymore
+	freeRecordsMap.erase(offset);
 }
\ No newline at end of file
@@ -1,19 +1,33 @@
 #include "RecordFileIO.h"
 
+#include <algorithm>
+#include <iterator>
+
 using namespace Cloudless::Storage;
 
 //-----------------------------------------------------------------------------
 // Storage header read/write methods
+//
+// Storage header size of each format version: records lists (v1), record ID
+// table (v2), checksum type and header checksum (v3), overflow pages (v4),
+// compression dictionaries (v5), transaction journal (v6). Records of older
+// version start right after its smaller header, so upgrade moves records
+// overlapping the current header to the end of data.
 //-----------------------------------------------------------------------------
+constexpr uint64_t STORAGE_HEADER_SIZES[] = { 0, 64, 80, 88, 104, 112, 120, STORAGE_HEADER_SIZE };
+constexpr uint32_t CHECKSUMMED_HEADER_VERSION = 3;
+
+static_assert(std::size(STORAGE_HEADER_SIZES) == KNOWLEDGE_VERSION + 1, "Header size of every version must be known");
 
 /*
 * @brief Initialize in memory storage header for new database (not synchronized)
 */
-void RecordFileIO::createStorageHeader() {
+void RecordFileIO::createStorageHeader(ChecksumType checksumType) {
 
 	storageHeader.signature = KNOWLEDGE_SIGNATURE;
 	storageHeader.version = KNOWLEDGE_VERSION;
 	storageHeader.endOfData = STORAGE_HEADER_SIZE;
+	dataStart = STORAGE_HEADER_SIZE;
 
 	storageHeader.totalRecords = 0;
 	storageHeader.firstRecord = NOT_FOUND;
@@ -22,6 +36,19 @@ void RecordFileIO::createStorageHeader() {
 	storageHeader.totalFreeRecords = 0;
 	storageHeader.firstFreeRecord = NOT_FOUND;
 	storageHeader.lastFreeRecord = NOT_FOUND;
+
+	storageHeader.nextRecordID = 1;
+	storageHeader.idTableRecord = NOT_FOUND;
+
+	storageHeader.totalFreeOverflowPages = 0;
+	storageHeader.firstFreeOverflowPage = NOT_FOUND;
+
+	storageHeader.lastDictionary = NOT_FOUND;
+	storageHeader.transactionJournal = NOT_FOUND;
+	storageHeader.commitStamp = 0;
+
+	storageHeader.checksumType = (uint32_t)checksumType;
+	checksumFunction = Checksum::getFunction(checksumType);
 	
 	writeStorageHeader();
 }
@@ -37,6 +64,10 @@ bool RecordFileIO::writeStorageHeader() {
 	uint64_t bytesWritten;
 	size_t ratioValue;
 
+	// header of older version is smaller than current one, so it is never rewritten
+	if (storageHeader.version != KNOWLEDGE_VERSION) return false;
+
+	storageHeader.headerChecksum = checksum((uint8_t*)&storageHeader, STORAGE_HEADER_PAYLOAD_SIZE);
 	bytesWritten = cachedFile.write(0, &storageHeader, STORAGE_HEADER_SIZE);
 	if (bytesWritten != STORAGE_HEADER_SIZE) return false;
 	ratioValue = storageHeader.totalFreeRecords / FREE_RECORD_LOOKUP_RATIO;
@@ -50,19 +81,53 @@ bool RecordFileIO::writeStorageHeader() {
 
 
 /*
-*  @brief Loads file storage header to memory storage header (not synchronized)
+*  @brief Loads file storage header to memory storage header (not synchronized).
+*  Header of older format version gets empty values of the fields it lacks.
 *  @return true - if succeeded, false - if failed
 */
 bool RecordFileIO::loadStorageHeader() {
 
-	// read storage header
+	// read signature and version to know header size
 	StorageHeader sh;
-	uint64_t bytesRead = cachedFile.read(0, &sh, STORAGE_HEADER_SIZE);
-	if (bytesRead != STORAGE_HEADER_SIZE) return false;
+	uint8_t buffer[STORAGE_HEADER_SIZE];
+	uint64_t bytesRead = cachedFile.read(0, &sh, 2 * sizeof(uint32_t));
+	if (bytesRead != 2 * sizeof(uint32_t)) return false;
 
 	// check signature and version
 	if (sh.signature != KNOWLEDGE_SIGNATURE) return false;
-	if (sh.version != KNOWLEDGE_VERSION) return false;
+	if (sh.version == 0 || sh.version > KNOWLEDGE_VERSION) return false;
+	uint64_t headerSize = STORAGE_HEADER_SIZES[sh.version];
+	bytesRead = cachedFile.read(0, buffer, headerSize);
+	if (bytesRead != headerSize) return false;
+
+	// fields appended by later versions (versions 1-2 used Adler-32 checksum)
+	sh.nextRecordID = 1;
+	sh.idTableRecord = NOT_FOUND;
+	sh.totalFreeOverflowPages = 0;
+	sh.firstFreeOverflowPage = NOT_FOUND;
+	sh.lastDictionary = NOT_FOUND;
+	sh.transactionJournal = NOT_FOUND;
+	sh.commitStamp = 0;
+	sh.checksumType = (uint32_t)ChecksumType::ADLER32;
+	sh.headerChecksum = 0;
+
+	// checksum type and header checksum always close the header
+	uint64_t fieldsSize = headerSize;
+	if (sh.version >= CHECKSUMMED_HEADER_VERSION) {
+		fieldsSize -= 2 * sizeof(uint32_t);
+		memcpy(&sh.checksumType, buffer + fieldsSize, sizeof(uint32_t));
+		memcpy(&sh.headerChecksum, buffer + fieldsSize + sizeof(uint32_t), sizeof(uint32_t));
+	}
+	memcpy(&sh, buffer, fieldsSize);
+
+	// select checksum algorithm of the file and check header consistency
+	ChecksumFunction fileChecksum = Checksum::getFunction((ChecksumType)sh.checksumType);
+	if (fileChecksum == nullptr) return false;
+	if (sh.version >= CHECKSUMMED_HEADER_VERSION) {
+		uint32_t headerChecksum = fileChecksum(buffer, headerSize - sizeof(uint32_t));
+		if (headerChecksum != sh.headerChecksum) return false;
+	}
+	checksumFunction = fileChecksum;
 
 	// adjust free page lookup depth	
 	size_t ratioValue = sh.totalFreeRecords / FREE_RECORD_LOOKUP_RATIO;
@@ -70,8 +135,170 @@ bool RecordFileIO::loadStorageHeader() {
 	freeLookupDepth.store(value);
 
 	memcpy(&storageHeader, &sh, STORAGE_HEADER_SIZE);
+	dataStart = headerSize;
 
 	return true;
 }
 
 
+
+/*
+*  @brief Upgrades file of older format version to the current one and gives
+*  record IDs to records of version 1 (called by open, file is not shared yet)
+*  @return true - if file is of current version, false - if upgrade failed
+*/
+bool RecordFileIO::upgradeStorage() {
+	if (storageHeader.version != KNOWLEDGE_VERSION && !relocateHeaderArea()) return false;
+	return assignRecordIDs();
+}
+
+
+
+/*
+*  @brief Moves records overlapping current storage header to the end of data,
+*  writes current header over older one and releases space of moved records.
+*  Moved copies and relinked neighbours are flushed before older header is
+*  overwritten, and records are moved to the same positions every time, so
+*  interrupted upgrade is repeated from the start on next open. System
+*  records (ID table pages, journal, dictionaries) are relinked by position.
+*  @return true - if succeeded, false - if failed
+*/
+bool RecordFileIO::relocateHeaderArea() {
+
+	RecordHeader header, sibling;
+	std::vector<uint8_t> buffer(RECORD_CHUNK_SIZE);
+	uint64_t endOfData = storageHeader.endOfData;
+
+	// Records overlapping current header, the rest must fit free record header
+	std::vector<uint64_t> records;
+	uint64_t areaEnd = dataStart;
+	while (areaEnd < endOfData && areaEnd != STORAGE_HEADER_SIZE && areaEnd < STORAGE_HEADER_SIZE + RECORD_HEADER_SIZE) {
+		if (readRecordHeader(areaEnd, header) == NOT_FOUND) return false;
+		records.push_back(areaEnd);
+		areaEnd += RECORD_HEADER_SIZE + header.recordCapacity;
+	}
+
+	// If all records overlap current header, moved records follow released space
+	uint64_t releasedEnd = std::max(areaEnd, STORAGE_HEADER_SIZE);
+	if (releasedEnd > STORAGE_HEADER_SIZE) {
+		releasedEnd = std::max(releasedEnd, STORAGE_HEADER_SIZE + RECORD_HEADER_SIZE);
+	}
+	if (areaEnd >= endOfData) storageHeader.endOfData = releasedEnd;
+
+	for (uint64_t offset : records) {
+
+		// Copy record as is to the end of data (free record without data)
+		if (readRecordHeader(offset, header) == NOT_FOUND) return false;
+		bool isFree = header.bitFlags & RECORD_DELETED_FLAG;
+		uint64_t newOffset = storageHeader.endOfData;
+		storageHeader.endOfData += RECORD_HEADER_SIZE + header.recordCapacity;
+		for (uint64_t position = 0; !isFree && position < header.recordCapacity; position += RECORD_CHUNK_SIZE) {
+			uint64_t length = std::min<uint64_t>(RECORD_CHUNK_SIZE, header.recordCapacity - position);
+			if (cachedFile.read(offset + RECORD_HEADER_SIZE + position, buffer.data(), length) != length) return false;
+			if (cachedFile.write(newOffset + RECORD_HEADER_SIZE + position, buffer.data(), length) != length) return false;
+		}
+		if (writeRecordHeader(newOffset, header) == NOT_FOUND) return false;
+
+		// Relink ID table page chain, journal or dictionaries chain
+		if (!isFree && (header.bitFlags & RECORD_SYSTEM_FLAG)) {
+			if (!moveSystemRecord(offset, newOffset)) return false;
+			continue;
+		}
+
+		// Relink siblings in records list or free list
+		if (header.previous != NOT_FOUND) {
+			if (readRecordHeader(header.previous, sibling) == NOT_FOUND) return false;
+			sibling.next = newOffset;
+			writeRecordHeader(header.previous, sibling);
+		}
+		if (header.next != NOT_FOUND) {
+			if (readRecordHeader(header.next, sibling) == NOT_FOUND) return false;
+			sibling.previous = newOffset;
+			writeRecordHeader(header.next, sibling);
+		}
+
+		if (isFree) {
+			if (storageHeader.firstFreeRecord == offset) storageHeader.firstFreeRecord = newOffset;
+			if (storageHeader.lastFreeRecord == offset) storageHeader.lastFreeRecord = newOffset;
+			freeRecordsMap.erase(offset);
+			freeRecordsMap[newOffset] = header.recordCapacity;
+		} else {
+			// records of version 1 have no ID yet
+			if (storageHeader.firstRecord == offset) storageHeader.firstRecord = newOffset;
+			if (storageHeader.lastRecord == offset) storageHeader.lastRecord = newOffset;
+			setRecordOffset(header.bitFlags & RECORD_ID_MASK, newOffset);
+		}
+	}
+
+	// Overwrite older header only when moved records are persisted
+	if (!cachedFile.flush()) return false;
+	storageHeader.version = KNOWLEDGE_VERSION;
+	if (!writeStorageHeader() || !cachedFile.flush()) return false;
+	dataStart = STORAGE_HEADER_SIZE;
+
+	// Space of moved records becomes free record right after current header
+	if (releasedEnd > STORAGE_HEADER_SIZE) {
+		RecordHeader freeRecord{};
+		freeRecord.next = NOT_FOUND;
+		freeRecord.previous = NOT_FOUND;
+		freeRecord.bitFlags = RECORD_DELETED_FLAG;
+		freeRecord.recordCapacity = (uint32_t)(releasedEnd - STORAGE_HEADER_SIZE - RECORD_HEADER_SIZE);
+		std::unique_lock freeLock(freeListMutex);
+		releaseRecord(STORAGE_HEADER_SIZE, freeRecord);
+	}
+
+	return cachedFile.flush();
+}
+
+
+
+/*
+*  @brief Relinks system record moved by upgrade to its new position. Record
+*  linked from nowhere is a leftover of interrupted upgrade (its copy at the
+*  same position is linked already) or of interrupted allocation, so it is
+*  released with the rest of header area.
+*  @param[in] offset - old record position
+*  @param[in] newOffset - new record position
+*  @return true - if relinked or not linked, false - if failed
+*/
+bool RecordFileIO::moveSystemRecord(uint64_t offset, uint64_t newOffset) {
+	if (isIDTablePage(offset)) return moveIDTablePage(offset, newOffset);
+	if (storageHeader.transactionJournal == offset) {
+		storageHeader.transactionJournal = newOffset;
+		return true;
+	}
+	return moveDictionary(offset, newOffset);
+}
+
+
+
+/*
+*  @brief Gives record IDs to records of format version 1 in records list order,
+*  so the last record without ID means assignment was interrupted
+*  (called by open, file is not shared yet)
+*  @return true - if all records have IDs, false - if failed
+*/
+bool RecordFileIO::assignRecordIDs() {
+
+	RecordHeader header;
+	uint64_t offset = storageHeader.lastRecord;
+
+	if (offset == NOT_FOUND) return true;
+	if (readRecordHeader(offset, header) == NOT_FOUND) return false;
+	if ((header.bitFlags & RECORD_ID_MASK) != 0) return true;
+
+	offset = storageHeader.firstRecord;
+	while (offset != NOT_FOUND) {
+		if (readRecordHeader(offset, header) == NOT_FOUND) return false;
+		if ((header.bitFlags & RECORD_ID_MASK) == 0) {
+			uint64_t recordID = reserveRecordID();
+			if (recordID == NOT_FOUND) return false;
+			header.bitFlags |= recordID;
+			if (writeRecordHeader(offset, header) == NOT_FOUND) return false;
+			if (!setRecordOffset(recordID, offset)) return false;
+		}
+		offset = header.next;
+	}
+
+	return cachedFile.flush();
+}
@@ -0,0 +1,199 @@
+#include "RecordFileIO.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Record ID table methods
+//
+// Record ID is a stable logical identifier of record, which does not change
+// when record moves (update, compaction). ID table maps record ID to its
+// current position and is stored in chained system records (pages):
+//
+//   [ next page offset ][ offset of ID 1 ][ offset of ID 2 ] ...
+//
+// Page offsets are kept in memory, so lookup costs a single cached read.
+// Lock order: storage header -> record -> ID table.
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Reserves new record ID and makes sure ID table has a slot for it
+*  @return new record ID or NOT_FOUND if IDs are exhausted or table can't grow
+*/
+uint64_t RecordFileIO::reserveRecordID() {
+
+	uint64_t recordID;
+	{
+		std::unique_lock lock(headerMutex);
+		if (storageHeader.nextRecordID > RECORD_ID_MASK) return NOT_FOUND;
+		recordID = storageHeader.nextRecordID++;
+		writeStorageHeader();
+	}
+
+	// Grow ID table if there is no page for new ID yet
+	uint64_t pageIndex = (recordID - 1) / ID_TABLE_PAGE_ENTRIES;
+	{
+		std::shared_lock lock(idTableMutex);
+		if (pageIndex < idTablePages.size()) return recordID;
+	}
+
+	std::unique_lock growLock(idTableGrowMutex);
+	while (true) {
+		{
+			std::shared_lock lock(idTableMutex);
+			if (pageIndex < idTablePages.size()) break;
+		}
+		if (!appendIDTablePage()) return NOT_FOUND;
+	}
+
+	return recordID;
+}
+
+
+
+/*
+*  @brief Returns current position of record with given ID
+*  @param[in] recordID - record ID
+*  @return record position or NOT_FOUND if there is no such record
+*/
+uint64_t RecordFileIO::getRecordOffset(uint64_t recordID) {
+
+	if (recordID == 0 || recordID > RECORD_ID_MASK) return NOT_FOUND;
+
+	uint64_t pageIndex = (recordID - 1) / ID_TABLE_PAGE_ENTRIES;
+	uint64_t slot = (recordID - 1) % ID_TABLE_PAGE_ENTRIES + 1;
+	uint64_t offset = NOT_FOUND;
+
+	std::shared_lock lock(idTableMutex);
+	if (pageIndex >= idTablePages.size()) return NOT_FOUND;
+	uint64_t entryOffset = idTablePages[pageIndex] + RECORD_HEADER_SIZE + slot * sizeof(uint64_t);
+	if (cachedFile.read(entryOffset, &offset, sizeof(uint64_t)) != sizeof(uint64_t)) return NOT_FOUND;
+
+	return offset;
+}
+
+
+
+/*
+*  @brief Updates position of record with given ID
+*  @param[in] recordID - record ID
+*  @param[in] offset - record position or NOT_FOUND if record deleted
+*  @return true if updated, false otherwise
+*/
+bool RecordFileIO::setRecordOffset(uint64_t recordID, uint64_t offset) {
+
+	if (recordID == 0 || recordID > RECORD_ID_MASK) return false;
+
+	uint64_t pageIndex = (recordID - 1) / ID_TABLE_PAGE_ENTRIES;
+	uint64_t slot = (recordID - 1) % ID_TABLE_PAGE_ENTRIES + 1;
+
+	std::unique_lock lock(idTableMutex);
+	if (pageIndex >= idTablePages.size()) return false;
+	uint64_t entryOffset = idTablePages[pageIndex] + RECORD_HEADER_SIZE + slot * sizeof(uint64_t);
+
+	return cachedFile.write(entryOffset, &offset, sizeof(uint64_t)) == sizeof(uint64_t);
+}
+
+
+
+/*
+*  @brief Allocates new ID table page and links it to the end of pages chain
+*  (caller holds idTableGrowMutex)
+*  @return true if page appended, false otherwise
+*/
+bool RecordFileIO::appendIDTablePage() {
+
+	// All slots and next page link are NOT_FOUND initially
+	std::vector<uint8_t> page(ID_TABLE_PAGE_CAPACITY, 0xFF);
+	RecordHeader header;
+
+	uint64_t offset = allocateSystemRecord(ID_TABLE_PAGE_CAPACITY, header, page.data());
+	if (offset == NOT_FOUND) return false;
+
+	std::unique_lock lock(headerMutex);
+	std::unique_lock idLock(idTableMutex);
+	if (idTablePages.empty()) {
+		storageHeader.idTableRecord = offset;
+		writeStorageHeader();
+	} else {
+		cachedFile.write(idTablePages.back() + RECORD_HEADER_SIZE, &offset, sizeof(uint64_t));
+	}
+	idTablePages.push_back(offset);
+
+	return true;
+}
+
+
+
+/*
+*  @brief Loads ID table pages positions walking pages chain
+*  @return true if pages chain is consistent, false otherwise
+*/
+bool RecordFileIO::loadIDTable() {
+
+	RecordHeader header;
+	uint64_t offset, maxPages;
+
+	{
+		std::shared_lock lock(headerMutex);
+		offset = storageHeader.idTableRecord;
+		maxPages = (storageHeader.nextRecordID + ID_TABLE_PAGE_ENTRIES - 1) / ID_TABLE_PAGE_ENTRIES;
+	}
+
+	std::unique_lock lock(idTableMutex);
+	idTablePages.clear();
+
+	while (offset != NOT_FOUND) {
+		// more pages than IDs require means chain is corrupt (or cyclic)
+		if (idTablePages.size() >= maxPages) return false;
+		if (readRecordHeader(offset, header) == NOT_FOUND) return false;
+		if (!(header.bitFlags & RECORD_SYSTEM_FLAG) || (header.bitFlags & RECORD_DELETED_FLAG)) return false;
+		if (header.recordCapacity < ID_TABLE_PAGE_CAPACITY) return false;
+		idTablePages.push_back(offset);
+		// read next page link
+		uint64_t bytesRead = cachedFile.read(offset + RECORD_HEADER_SIZE, &offset, sizeof(uint64_t));
+		if (bytesRead != sizeof(uint64_t)) return false;
+	}
+
+	return true;
+}
+
+
+
+/*
+*  @brief Checks if system record at given position is ID table page
+*  @param[in] offset - system record position
+*  @return true if it is ID table page, false otherwise
+*/
+bool RecordFileIO::isIDTablePage(uint64_t offset) {
+	std::shared_lock lock(idTableMutex);
+	return std::find(idTablePages.begin(), idTablePages.end(), offset) != idTablePages.end();
+}
+
+
+
+/*
+*  @brief Updates ID table page position after page has been moved
+*  (caller holds headerMutex and idTableMutex)
+*  @param[in] offset - old page position
+*  @param[in] newOffset - new page position
+*  @return true if page found and relinked, false otherwise
+*/
+bool RecordFileIO::moveIDTablePage(uint64_t offset, uint64_t newOffset) {
+
+	auto it = std::find(idTablePages.begin(), idTablePages.end(), offset);
+	if (it == idTablePages.end()) return false;
+
+	// relink previous page or storage header to the new position
+	if (it == idTablePages.begin()) {
+		storageHeader.idTableRecord = newOffset;
+		writeStorageHeader();
+	} else {
+		cachedFile.write(*std::prev(it) + RECORD_HEADER_SIZE, &newOffset, sizeof(uint64_t));
+	}
+	*it = newOffset;
+
+	return true;
+}
@@ -1,5 +1,6 @@
 #include "RecordFileIO.h"
 
+#include <bit>
 
 using namespace Cloudless::Storage;
 
@@ -9,30 +10,80 @@ using namespace Cloudless::Storage;
 *  @param[in] exclusive - true if unique lock, false if shared lock
 */
 void RecordFileIO::lockRecord(uint64_t offset, bool exclusive) {
+	recordLocks.lock(offset, exclusive);
+}
 
-	std::shared_ptr<RecordLock> recordLock;
 
-	{
-		std::shared_lock<std::shared_mutex> mapLock(recordLocksMutex);     // shared lock records map (RAII)
-		auto it = recordLocks.find(offset);                        // search record with given offset
-		if (it != recordLocks.end()) {                             // if found
-			recordLock = it->second;                               // get record lock structure std::shared_ptr
-			if (recordLock) recordLock->counter.fetch_add(1);      // if it exists increment pointers counter
+
+/**
+*  @brief Unlocks record by its offset in file
+*  @param[in] offset - record position in file
+*  @param[in] exclusive - true if unique lock, false if shared lock
+*/
+void RecordFileIO::unlockRecord(uint64_t offset, bool exclusive) {
+	recordLocks.unlock(offset, exclusive);
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Record lock table methods
+//-----------------------------------------------------------------------------
+
+
+/**
+*  @brief Releases all record locks of all stripes
+*/
+RecordLockTable::~RecordLockTable() {
+	for (RecordLockStripe& stripe : stripes) {
+		for (RecordLock* list : { stripe.locks, stripe.pool }) {
+			while (list != nullptr) {
+				RecordLock* next = list->next;
+				delete list;
+				list = next;
+			}
 		}
 	}
+}
 
-	if (!recordLock) {                                             // if record lock is not found
-		std::unique_lock<std::shared_mutex> mapLock(recordLocksMutex);     // exclusive lock records map (RAII)
-		auto it = recordLocks.find(offset);                        // acknowledge that record lock exists
-		if (it == recordLocks.end()) {                             // if record lock not exists
-			recordLock = std::make_shared<RecordLock>();           // create new one
-			recordLocks[offset] = recordLock;                      // add it to the records mapp
-			recordLock->counter.fetch_add(1);                      // increment pointers counter
-		}
-		else {                                                   // if record lock exists
-			recordLock = it->second;                               // get it
-			recordLock->counter.fetch_add(1);                      // increment pointers counter
+
+
+/**
+*  @brief Picks stripe by record offset hash (Fibonacci hashing)
+*  @param[in] offset - record position in file
+*  @return stripe of record lock table
+*/
+RecordLockStripe& RecordLockTable::getStripe(uint64_t offset) {
+	constexpr uint32_t STRIPE_BITS = std::countr_zero(RECORD_LOCK_STRIPES);
+	uint64_t index = (offset * 0x9E3779B97F4A7C15ULL) >> (64 - STRIPE_BITS);
+	return stripes[index];
+}
+
+
+
+/**
+*  @brief Locks record by its offset in file
+*  @param[in] offset - record position in file
+*  @param[in] exclusive - true if unique lock, false if shared lock
+*/
+void RecordLockTable::lock(uint64_t offset, bool exclusive) {
+
+	RecordLockStripe& stripe = getStripe(offset);
+	RecordLock* recordLock;
+
+	{
+		std::lock_guard stripeLock(stripe.mutex);                 // lock stripe only for lookup
+		recordLock = stripe.locks;                                 // search record lock with given offset
+		while (recordLock != nullptr && recordLock->offset != offset) recordLock = recordLock->next;
+		if (recordLock == nullptr) {                               // if record lock is not found
+			recordLock = stripe.pool;                              // take it from the pool
+			if (recordLock != nullptr) stripe.pool = recordLock->next;
+			else recordLock = new RecordLock();                    // or create new one if pool is empty
+			recordLock->offset = offset;
+			recordLock->next = stripe.locks;                       // add it to the stripe locks
+			stripe.locks = recordLock;
 		}
+		recordLock->counter++;                                     // lock can't be reused while counter > 0
 	}
 
 	if (exclusive) 	                                               // if exclusive lock requested
@@ -49,30 +100,26 @@ void RecordFileIO::lockRecord(uint64_t offset, bool exclusive) {
 *  @param[in] offset - record position in file
 *  @param[in] exclusive - true if unique lock, false if shared lock
 */
-void RecordFileIO::unlockRecord(uint64_t offset, bool exclusive) {
-	std::shared_ptr<RecordLock> recordLock;
+void RecordLockTable::unlock(uint64_t offset, bool exclusive) {
 
-	{
-		std::shared_lock<std::shared_mutex> mapLock(recordLocksMutex);    // shared lock records map (RAII)
-		auto it = recordLocks.find(offset);                       // search record with given offset
-		if (it == recordLocks.end()) return;                      // if not found - do nothing and return
-		recordLock = it->second;                                  // get RecordLock shared_ptr by offset
-		if (!recordLock) return;                                  // if not found - do nothing and return
-	}
+	RecordLockStripe& stripe = getStripe(offset);
+	std::lock_guard stripeLock(stripe.mutex);
 
-	if (exclusive)                                                // if exclusive lock requested
-		recordLock->mutex.unlock();		                          // do exclusive lock
-	else                                                          // otherwise
-		recordLock->mutex.unlock_shared();                        // do shared lock
+	RecordLock** link = &stripe.locks;                             // search record lock with given offset
+	while (*link != nullptr && (*link)->offset != offset) link = &(*link)->next;
+	RecordLock* recordLock = *link;
+	if (recordLock == nullptr) return;                             // if not found - do nothing and return
 
-	{
-		std::unique_lock<std::shared_mutex> mapLock(recordLocksMutex);	  // exclusive lock records map (RAII)
-		if (recordLock->counter.fetch_sub(1) == 1) {              // if no other locks left
-			auto it = recordLocks.find(offset);                   // acknowledge that RecordLock exists again
-			if (it != recordLocks.end()) {
-				recordLocks.erase(offset);                        // erase from records map
-			}
-		}
+	if (exclusive)                                                 // if exclusive lock requested
+		recordLock->mutex.unlock();		                           // do exclusive unlock
+	else                                                           // otherwise
+		recordLock->mutex.unlock_shared();                         // do shared unlock
+
+	if (--recordLock->counter == 0) {                              // if no other holders or waiters left
+		*link = recordLock->next;                                  // remove from stripe locks
+		recordLock->offset = NOT_FOUND;
+		recordLock->next = stripe.pool;                            // return it to the pool
+		stripe.pool = recordLock;
 	}
 
 }
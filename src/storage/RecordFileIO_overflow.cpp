@@ -0,0 +1,331 @@
+#include "RecordFileIO.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Overflow pages methods
+//
+// Record with data of OVERFLOW_THRESHOLD or more keeps data in fixed size
+// overflow pages (system records of OVERFLOW_PAGE_SIZE capacity). Record
+// itself keeps only small table of pages positions and pages checksums:
+//
+//   [ page 0 position ] ... [ page N position ][ page 0 checksum ] ... [ page N checksum ]
+//
+// Data update writes only changed pages to new pages (copy on write) and
+// switches pages table at once, unchanged pages are shared with previous
+// version. Released pages are kept in the free pages map (persisted as
+// doubly linked chain of free pages) and reused by lowest position first.
+// Lock order: overflow pages -> free list -> storage header -> record.
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Checks if system record header is overflow page header
+*/
+static bool isOverflowPage(const RecordHeader& header) {
+	constexpr uint64_t PAGE_FLAGS = RECORD_SYSTEM_FLAG | RECORD_OVERFLOW_FLAG;
+	if ((header.bitFlags & (PAGE_FLAGS | RECORD_DELETED_FLAG)) != PAGE_FLAGS) return false;
+	return (header.bitFlags & RECORD_ID_MASK) == 0 && header.recordCapacity >= OVERFLOW_PAGE_SIZE;
+}
+
+
+
+/*
+*  @brief Takes overflow page from free pages map or allocates new one
+*  @return overflow page position or NOT_FOUND if failed
+*/
+uint64_t RecordFileIO::allocateOverflowPage() {
+
+	{
+		std::unique_lock lock(overflowMutex);
+		if (!overflowFreePages.empty()) {
+
+			uint64_t offset = *overflowFreePages.begin();
+			overflowFreePages.erase(overflowFreePages.begin());
+
+			RecordHeader page, sibling;
+			std::unique_lock headerLock(headerMutex);
+			lockRecord(offset, true);
+			readRecordHeader(offset, page);
+			uint64_t previous = page.previous;
+			uint64_t next = page.next;
+			page.previous = NOT_FOUND;
+			page.next = NOT_FOUND;
+			writeRecordHeader(offset, page);
+			unlockRecord(offset, true);
+
+			// unlink page from free pages chain
+			if (previous != NOT_FOUND) {
+				lockRecord(previous, true);
+				readRecordHeader(previous, sibling);
+				sibling.next = next;
+				writeRecordHeader(previous, sibling);
+				unlockRecord(previous, true);
+			} else storageHeader.firstFreeOverflowPage = next;
+
+			if (next != NOT_FOUND) {
+				lockRecord(next, true);
+				readRecordHeader(next, sibling);
+				sibling.previous = previous;
+				writeRecordHeader(next, sibling);
+				unlockRecord(next, true);
+			}
+
+			storageHeader.totalFreeOverflowPages--;
+			writeStorageHeader();
+
+			return offset;
+		}
+	}
+
+	// no free pages - allocate new page from free records or at the end of file
+	RecordHeader page;
+	page.bitFlags = RECORD_OVERFLOW_FLAG;
+	return allocatePendingRecord(OVERFLOW_PAGE_SIZE, page);
+}
+
+
+
+/*
+*  @brief Puts overflow pages to the free pages map
+*  @param[in] pages - overflow pages positions
+*/
+void RecordFileIO::freeOverflowPages(const std::vector<uint64_t>& pages) {
+
+	if (pages.empty()) return;
+
+	std::unique_lock lock(overflowMutex);
+	std::unique_lock headerLock(headerMutex);
+
+	RecordHeader page, sibling;
+
+	for (uint64_t offset : pages) {
+
+		if (overflowFreePages.count(offset) > 0) continue;
+
+		// push page to the head of free pages chain
+		lockRecord(offset, true);
+		bool valid = readRecordHeader(offset, page) != NOT_FOUND && isOverflowPage(page);
+		if (valid) {
+			page.previous = NOT_FOUND;
+			page.next = storageHeader.firstFreeOverflowPage;
+			writeRecordHeader(offset, page);
+		}
+		unlockRecord(offset, true);
+		if (!valid) continue;
+
+		if (page.next != NOT_FOUND) {
+			lockRecord(page.next, true);
+			readRecordHeader(page.next, sibling);
+			sibling.previous = offset;
+			writeRecordHeader(page.next, sibling);
+			unlockRecord(page.next, true);
+		}
+
+		storageHeader.firstFreeOverflowPage = offset;
+		storageHeader.totalFreeOverflowPages++;
+		overflowFreePages.insert(offset);
+	}
+
+	writeStorageHeader();
+}
+
+
+
+/*
+*  @brief Loads free overflow pages positions walking free pages chain
+*  @return true if free pages chain is consistent, false otherwise
+*/
+bool RecordFileIO::loadOverflowFreeMap() {
+
+	RecordHeader page;
+	uint64_t offset, totalPages;
+
+	{
+		std::shared_lock lock(headerMutex);
+		offset = storageHeader.firstFreeOverflowPage;
+		totalPages = storageHeader.totalFreeOverflowPages;
+	}
+
+	std::unique_lock lock(overflowMutex);
+	overflowFreePages.clear();
+
+	uint64_t pagesCount = 0;
+	while (offset != NOT_FOUND) {
+		// more pages than counted means chain is corrupt (or cyclic)
+		if (pagesCount++ >= totalPages) return false;
+		if (readRecordHeader(offset, page) == NOT_FOUND) return false;
+		if (!isOverflowPage(page)) return false;
+		overflowFreePages.insert(offset);
+		offset = page.next;
+	}
+
+	return overflowFreePages.size() == totalPages;
+}
+
+
+
+/*
+*  @brief Extracts overflow pages positions from pages table
+*  @param[in] header - overflow record header
+*  @param[in] table - overflow pages table
+*  @param[out] pages - overflow pages positions
+*/
+void RecordFileIO::getOverflowPages(const RecordHeader& header, const std::vector<uint8_t>& table, std::vector<uint64_t>& pages) {
+	uint32_t pagesCount = getChunksCount(header.dataLength);
+	pages.resize(pagesCount);
+	if (pagesCount > 0) memcpy(pages.data(), table.data(), pagesCount * sizeof(uint64_t));
+}
+
+
+
+/*
+*  @brief Writes data to overflow pages and builds pages table. Pages of previous
+*  data version with the same content are shared, other pages are allocated.
+*  @param[in] data - record data
+*  @param[in] length - record data length
+*  @param[in] oldHeader - header of previous record version (nullptr if none)
+*  @param[in] oldTable - pages table of previous version (if it is overflow record)
+*  @param[out] table - pages table
+*  @param[out] allocated - newly allocated pages
+*  @return true if written, false if pages allocation failed
+*/
+bool RecordFileIO::writeOverflowPages(const uint8_t* data, uint32_t length, const RecordHeader* oldHeader,
+	const std::vector<uint8_t>& oldTable, std::vector<uint8_t>& table, std::vector<uint64_t>& allocated) {
+
+	RecordHeader header{};
+	header.dataLength = length;
+	header.bitFlags = RECORD_OVERFLOW_FLAG;
+	table.assign(getStoredLength(header), 0);
+
+	bool shareable = oldHeader != nullptr && (oldHeader->bitFlags & RECORD_OVERFLOW_FLAG);
+	uint32_t oldPagesCount = shareable ? getChunksCount(oldHeader->dataLength) : 0;
+	uint32_t pagesCount = getChunksCount(length);
+	std::vector<uint8_t> page;
+
+	for (uint32_t i = 0; i < pagesCount; i++) {
+
+		uint32_t pageStart = i * OVERFLOW_PAGE_SIZE;
+		uint32_t pageLength = std::min(OVERFLOW_PAGE_SIZE, length - pageStart);
+		const uint8_t* source = data + pageStart;
+		uint32_t pageChecksum = checksum(source, pageLength);
+		uint64_t pagePosition = NOT_FOUND;
+
+		// share old page if its content is the same (checksum first, then bytes)
+		if (i < oldPagesCount && std::min(OVERFLOW_PAGE_SIZE, oldHeader->dataLength - pageStart) == pageLength) {
+			if (getChunkChecksum(*oldHeader, oldTable, i) == pageChecksum) {
+				uint64_t oldPosition = getChunkPosition(NOT_FOUND, *oldHeader, oldTable, i);
+				page.resize(pageLength);
+				cachedFile.read(oldPosition, page.data(), pageLength);
+				if (memcmp(page.data(), source, pageLength) == 0) pagePosition = oldPosition - RECORD_HEADER_SIZE;
+			}
+		}
+
+		// otherwise write page content to the new page
+		if (pagePosition == NOT_FOUND) {
+			pagePosition = allocateOverflowPage();
+			if (pagePosition == NOT_FOUND) return false;
+			allocated.push_back(pagePosition);
+			cachedFile.write(pagePosition + RECORD_HEADER_SIZE, source, pageLength);
+		}
+
+		memcpy(table.data() + i * sizeof(uint64_t), &pagePosition, sizeof(uint64_t));
+		setChunkChecksum(header, table, i, pageChecksum);
+	}
+
+	return true;
+}
+
+
+
+/*
+*  @brief Creates new record with data in overflow pages
+*  @param[in] recordID - reserved record ID
+*  @param[in] data - pointer to data
+*  @param[in] length - length of data in bytes
+*  @return returns shared pointer to the new record or nullptr if fails
+*/
+std::shared_ptr<RecordCursor> RecordFileIO::createOverflowRecord(uint64_t recordID, const void* data, uint32_t length) {
+
+	// Write data to pages
+	std::vector<uint8_t> table, noTable;
+	std::vector<uint64_t> allocated;
+	if (!writeOverflowPages((const uint8_t*)data, length, nullptr, noTable, table, allocated)) {
+		freeOverflowPages(allocated);
+		return nullptr;
+	}
+
+	// Write pages table to hidden record and publish it
+	RecordHeader header;
+	header.bitFlags = recordID | RECORD_OVERFLOW_FLAG;
+	uint64_t offset = allocatePendingRecord((uint32_t)table.size(), header);
+	if (offset == NOT_FOUND) {
+		freeOverflowPages(allocated);
+		return nullptr;
+	}
+	cachedFile.write(offset + RECORD_HEADER_SIZE, table.data(), table.size());
+	header.dataLength = length;
+	header.dataChecksum = checksum(table.data(), table.size());
+	if (!publishRecord(offset, header)) return nullptr;
+
+	return std::make_shared<RecordCursor>(*this, header, offset);
+}
+
+
+
+/*
+*  @brief Updates record data storing it in overflow pages, only changed pages
+*  are written. Pages which are not used by the new version are released.
+*  @param[in] offset - record position in the file
+*  @param[in] data - pointer to new data
+*  @param[in] length - length of data in bytes
+*  @return returns record position if OK or NOT_FOUND if failed to write
+*/
+uint64_t RecordFileIO::writeOverflowData(uint64_t offset, const void* data, uint32_t length) {
+
+	RecordHeader header, newHeader{};
+	newHeader.dataLength = length;
+	newHeader.bitFlags = RECORD_OVERFLOW_FLAG;
+
+	// retry if record has been changed by other thread meanwhile
+	for (int attempt = 0; attempt < 3; attempt++) {
+
+		// Read current version of record and its pages table
+		std::vector<uint8_t> oldTable;
+		lockRecord(offset, false);
+		bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+		valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+		if (valid && (header.bitFlags & RECORD_OVERFLOW_FLAG)) valid = loadChunksTable(offset, header, oldTable);
+		unlockRecord(offset, false);
+		if (!valid) return NOT_FOUND;
+
+		// Write changed pages
+		std::vector<uint8_t> table;
+		std::vector<uint64_t> allocated, oldPages, newPages;
+		if (!writeOverflowPages((const uint8_t*)data, length, &header, oldTable, table, allocated)) {
+			freeOverflowPages(allocated);
+			return NOT_FOUND;
+		}
+
+		// Switch record to the new pages table if record is not changed meanwhile
+		uint64_t newOffset = writeStoredData(offset, table.data(), (uint32_t)table.size(), length, RECORD_OVERFLOW_FLAG, &header, oldPages);
+		if (newOffset == NOT_FOUND) {
+			freeOverflowPages(allocated);
+			continue;
+		}
+
+		// Release old version pages not shared with the new version
+		getOverflowPages(newHeader, table, newPages);
+		std::sort(oldPages.begin(), oldPages.end());
+		std::sort(newPages.begin(), newPages.end());
+		std::vector<uint64_t> released;
+		std::set_difference(oldPages.begin(), oldPages.end(), newPages.begin(), newPages.end(), std::back_inserter(released));
+		freeOverflowPages(released);
+
+		return newOffset;
+	}
+
+	return NOT_FOUND;
+}
@@ -1,6 +1,7 @@
 #include "RecordFileIO.h"
 
 #include <iostream>
+#include <algorithm>
 
 using namespace Cloudless::Storage;
 
@@ -77,13 +78,20 @@ uint64_t RecordFileIO::readRecordData(uint64_t offset, void* data) {
 	}
 
 	RecordHeader recordHeader;
-	uint64_t dataOffset;
 	bool invalidated = false;
+	bool consistent = false;
 
 	lockRecord(offset, false);
 	if (readRecordHeader(offset, recordHeader) != NOT_FOUND) {
-		dataOffset = offset + RECORD_HEADER_SIZE;
-		cachedFile.read(dataOffset, data, recordHeader.dataLength);
+		if (recordHeader.bitFlags & RECORD_CODEC_MASK) {
+			// read compressed data, check its consistency and decompress
+			std::vector<uint8_t> stored(recordHeader.dataLength);
+			consistent = readStoredData(offset, recordHeader, stored.data());
+			consistent = consistent && decodeRecordData(recordHeader, stored.data(), (uint8_t*)data);
+		} else {
+			// read data and check its consistency by checksum
+			consistent = readStoredData(offset, recordHeader, (uint8_t*)data);
+		}
 	} else invalidated = true;
 	unlockRecord(offset, false);
 
@@ -92,9 +100,7 @@ uint64_t RecordFileIO::readRecordData(uint64_t offset, void* data) {
 		return NOT_FOUND;
 	}
 
-	// check data consistency by checksum
-	uint32_t dataCheckSum = checksum((uint8_t*)data, recordHeader.dataLength);
-	if (dataCheckSum != recordHeader.dataChecksum) {
+	if (!consistent) {
 		std::cerr << "Record data read failed at pos=" << offset << "\n";
 		return NOT_FOUND;
 	}
@@ -104,6 +110,39 @@ uint64_t RecordFileIO::readRecordData(uint64_t offset, void* data) {
 
 
 
+/*
+* @brief Reads whole record data of any layout (plain, chunked, overflow pages)
+* and checks its consistency (caller holds record lock)
+* @param[in] offset - record position in the file
+* @param[in] header - record header
+* @param[out] data - buffer of data length
+* @return true if data is consistent, false otherwise
+*/
+bool RecordFileIO::readStoredData(uint64_t offset, const RecordHeader& header, uint8_t* data) {
+
+	// plain record data follows header
+	if (!(header.bitFlags & (RECORD_CHUNKED_FLAG | RECORD_OVERFLOW_FLAG))) {
+		cachedFile.read(offset + RECORD_HEADER_SIZE, data, header.dataLength);
+		return checksum(data, header.dataLength) == header.dataChecksum;
+	}
+
+	// chunked record data is checked chunk by chunk
+	std::vector<uint8_t> table;
+	if (!loadChunksTable(offset, header, table)) return false;
+
+	uint32_t chunksCount = getChunksCount(header.dataLength);
+	for (uint32_t i = 0; i < chunksCount; i++) {
+		uint32_t chunkStart = i * RECORD_CHUNK_SIZE;
+		uint32_t chunkLength = std::min(RECORD_CHUNK_SIZE, header.dataLength - chunkStart);
+		cachedFile.read(getChunkPosition(offset, header, table, i), data + chunkStart, chunkLength);
+		if (checksum(data + chunkStart, chunkLength) != getChunkChecksum(header, table, i)) return false;
+	}
+
+	return true;
+}
+
+
+
 /*
 * @brief Updates record's data in current position.
 * if data length exceeds current record capacity,
@@ -117,16 +156,70 @@ uint64_t RecordFileIO::writeRecordData(uint64_t offset, const void* data, uint32
 
 	if (isReadOnly() || offset == NOT_FOUND || data == nullptr || length == 0) return NOT_FOUND;
 
+	// large data is stored in overflow pages
+	if (length >= OVERFLOW_THRESHOLD) return writeOverflowData(offset, data, length);
+
+	// otherwise data is stored in record with single checksum (compressed if enabled)
+	std::vector<uint8_t> stored;
+	std::vector<uint64_t> oldPages;
+	uint64_t newOffset, codecFlags = encodeRecordData(data, length, stored);
+	if (codecFlags != 0) {
+		uint32_t storedLength = (uint32_t)stored.size();
+		newOffset = writeStoredData(offset, stored.data(), storedLength, storedLength, codecFlags, nullptr, oldPages);
+	} else newOffset = writeStoredData(offset, data, length, length, 0, nullptr, oldPages);
+
+	// release overflow pages if record was stored in them
+	if (newOffset != NOT_FOUND) freeOverflowPages(oldPages);
+
+	return newOffset;
+}
+
+
+
+/*
+* @brief Updates record's stored data: data itself, compressed data or overflow pages table.
+* if stored data length exceeds current record capacity,
+* then record moves to new place with appropriate capacity.
+* @param[in] offset - record position in the file
+* @param[in] stored - pointer to data stored in record
+* @param[in] storedLength - length of stored data in bytes
+* @param[in] dataLength - record data length
+* @param[in] layoutFlags - record data layout flags (RECORD_OVERFLOW_FLAG, codec or 0)
+* @param[in] expected - header of record version the update is based on (nullptr for any)
+* @param[out] oldPages - overflow pages of replaced record version
+* @return returns record position if OK or NOT_FOUND if failed to write
+*/
+uint64_t RecordFileIO::writeStoredData(uint64_t offset, const void* stored, uint32_t storedLength, uint32_t dataLength,
+	uint64_t layoutFlags, const RecordHeader* expected, std::vector<uint64_t>& oldPages) {
+
+	constexpr uint64_t LAYOUT_FLAGS = RECORD_CHUNKED_FLAG | RECORD_OVERFLOW_FLAG | RECORD_CODEC_MASK;
+
 	RecordHeader recordHeader;
+	std::vector<uint8_t> oldTable;
 	uint64_t bytesWritten;
 
+	// record must be live and of expected version
+	auto isExpected = [&](const RecordHeader& header) {
+		if (header.bitFlags & RECORD_DELETED_FLAG) return false;
+		if (expected == nullptr) return true;
+		return header.dataLength == expected->dataLength && header.dataChecksum == expected->dataChecksum &&
+			(header.bitFlags & LAYOUT_FLAGS) == (expected->bitFlags & LAYOUT_FLAGS);
+	};
+
+	// overflow pages of version being replaced (caller holds record lock)
+	auto collectOldPages = [&](const RecordHeader& header) {
+		oldPages.clear();
+		if (!(header.bitFlags & RECORD_OVERFLOW_FLAG)) return;
+		if (loadChunksTable(offset, header, oldTable)) getOverflowPages(header, oldTable, oldPages);
+	};
+
 	// exclusive lock record
 	lockRecord(offset, true);
 
 	// reads it header
 	uint64_t pos = readRecordHeader(offset, recordHeader);
-	// if header is corrupt or record deleted - return
-	if (pos == NOT_FOUND || recordHeader.bitFlags & RECORD_DELETED_FLAG) {
+	// if header is corrupt, record deleted or changed - return
+	if (pos == NOT_FOUND || !isExpected(recordHeader)) {
 		unlockRecord(offset, true);
 		return NOT_FOUND;
 	}
@@ -135,15 +228,17 @@ uint64_t RecordFileIO::writeRecordData(uint64_t offset, const void* data, uint32
 	//------------------------------------------------------------------	
 	// if there is enough capacity in record
 	//------------------------------------------------------------------
-	if (length <= recordHeader.recordCapacity) {
-		// Update header data length info
-		recordHeader.dataLength = length;
+	if (storedLength <= recordHeader.recordCapacity) {
+		collectOldPages(recordHeader);
+		// Update header data length info and layout
+		recordHeader.dataLength = dataLength;
+		recordHeader.bitFlags = (recordHeader.bitFlags & ~LAYOUT_FLAGS) | layoutFlags;
 		// Update data and header checksum
-		recordHeader.dataChecksum = checksum((uint8_t*)data, length);
+		recordHeader.dataChecksum = checksum((uint8_t*)stored, storedLength);
 		recordHeader.headChecksum = checksum((uint8_t*)&recordHeader, RECORD_HEADER_PAYLOAD_SIZE);
 
 		bytesWritten = cachedFile.write(offset, &recordHeader, RECORD_HEADER_SIZE);
-		bytesWritten += cachedFile.write(offset + RECORD_HEADER_SIZE, data, length);
+		bytesWritten += cachedFile.write(offset + RECORD_HEADER_SIZE, stored, storedLength);
 
 		unlockRecord(offset, true);
 		return offset;
@@ -156,18 +251,41 @@ uint64_t RecordFileIO::writeRecordData(uint64_t offset, const void* data, uint32
 	RecordHeader newRecordHeader;
 	uint64_t newOffset;
 	
-	// Copy record header
+	// Copy record header (new record keeps siblings links and record ID)
 	memcpy(&newRecordHeader, &recordHeader,  RECORD_HEADER_SIZE);	
+	newRecordHeader.bitFlags = (newRecordHeader.bitFlags & ~LAYOUT_FLAGS) | layoutFlags;
+	// Unlock record while allocating, allocator locks free list, storage header and last record
+	unlockRecord(offset, true);
+
 	// Find free record of required length and write it
-	newOffset = allocateRecord(length, newRecordHeader, data, length, false);
-	if (newOffset == NOT_FOUND) return NOT_FOUND;		
-	// Lock new location
-	lockRecord(newOffset, true);
+	newOffset = allocateRecord(storedLength, newRecordHeader, stored, storedLength, false);
+	if (newOffset == NOT_FOUND) return NOT_FOUND;
+	// New record is not linked yet, so its data length is set before relinking
+	newRecordHeader.dataLength = dataLength;
 
-	// Unlock previous location
-	unlockRecord(offset, true);
-	// Delete old record and add it to the free records list	
-	if (!addRecordToFreeList(offset)) return NOT_FOUND;
+	// Relink under free list and storage header locks, so siblings and first/last links are consistent
+	std::unique_lock freeLock(freeListMutex);
+	std::unique_lock headerLock(headerMutex);
+
+	// Lock record again and check it was not deleted or changed meanwhile
+	lockRecord(offset, true);
+	pos = readRecordHeader(offset, recordHeader);
+	if (pos == NOT_FOUND || !isExpected(recordHeader)) {
+		unlockRecord(offset, true);
+		headerLock.unlock();
+		freeLock.unlock();
+		addRecordToFreeList(newOffset);
+		return NOT_FOUND;
+	}
+	collectOldPages(recordHeader);
+	// Siblings could change meanwhile, so take actual links
+	newRecordHeader.previous = recordHeader.previous;
+	newRecordHeader.next = recordHeader.next;
+	lockRecord(newOffset, true);
+	writeRecordHeader(newOffset, newRecordHeader);
+	unlockRecord(newOffset, true);
+	// Record ID now points to the new position
+	setRecordOffset(newRecordHeader.bitFlags & RECORD_ID_MASK, newOffset);
 
 	// lock and update siblings
 	RecordHeader leftSiblingHeader;
@@ -193,10 +311,26 @@ uint64_t RecordFileIO::writeRecordData(uint64_t offset, const void* data, uint32
 		unlockRecord(rightSiblingOffset, true);
 	}
 
-	newRecordHeader.previous = leftSiblingOffset;
-	newRecordHeader.next = rightSiblingOffset;
-	writeRecordHeader(newOffset, newRecordHeader);
-	unlockRecord(newOffset, true);
+	// if moved record was first or last, update storage header
+	if (storageHeader.firstRecord == offset) storageHeader.firstRecord = newOffset;
+	if (storageHeader.lastRecord == offset) storageHeader.lastRecord = newOffset;
+	writeStorageHeader();
+
+	// Mark old record as deleted, so cursors at this position follow record ID
+	RecordHeader freeRecord;
+	memcpy(&freeRecord, &recordHeader, RECORD_HEADER_SIZE);
+	freeRecord.next = NOT_FOUND;
+	freeRecord.previous = NOT_FOUND;
+	freeRecord.dataLength = 0;
+	freeRecord.dataChecksum = 0;
+	freeRecord.bitFlags = RECORD_DELETED_FLAG;
+	writeRecordHeader(offset, freeRecord);
+	unlockRecord(offset, true);
+	headerLock.unlock();
+
+	// Add old record to the free records list (may merge with neighbours)
+	releaseRecord(offset, freeRecord);
+	freeLock.unlock();
 
 	// Update current record and position
 	memcpy(&recordHeader, &newRecordHeader, RECORD_HEADER_SIZE);
@@ -207,24 +341,317 @@ uint64_t RecordFileIO::writeRecordData(uint64_t offset, const void* data, uint32
 
 
 
+/*
+* @brief Reads range of record data. Chunked (or overflow) record is verified only
+* by chunks overlapping the range, plain record is read and verified as a whole,
+* compressed record is decompressed as a whole.
+* @param[in] offset - record position in the file
+* @param[in] position - first data byte to read
+* @param[out] data - pointer to the user buffer
+* @param[in] length - bytes to read
+* @return bytes read or zero if range is out of data or data corrupted
+*/
+uint32_t RecordFileIO::readRecordRange(uint64_t offset, uint32_t position, void* data, uint32_t length) {
+
+	if (offset == NOT_FOUND || data == nullptr || length == 0) return 0;
+
+	RecordHeader header;
+	uint32_t bytesRead = 0;
+
+	lockRecord(offset, false);
+	bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+	valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+	if (valid && (header.bitFlags & RECORD_CODEC_MASK)) {
+
+		std::vector<uint8_t> stored(header.dataLength), whole;
+		valid = readStoredData(offset, header, stored.data());
+		if (valid) whole.resize(getDecodedLength(header, stored.data()));
+		valid = valid && decodeRecordData(header, stored.data(), whole.data());
+		if (valid && position < whole.size()) {
+			bytesRead = std::min(length, (uint32_t)whole.size() - position);
+			memcpy(data, whole.data() + position, bytesRead);
+		}
+
+	} else if (valid && position < header.dataLength) {
+
+		uint32_t count = std::min(length, header.dataLength - position);
+		uint8_t* target = (uint8_t*)data;
+
+		if (header.bitFlags & (RECORD_CHUNKED_FLAG | RECORD_OVERFLOW_FLAG)) {
+			// checksums table is small, check it first
+			std::vector<uint8_t> table;
+			valid = loadChunksTable(offset, header, table);
+
+			// read and check only chunks overlapping requested range
+			std::vector<uint8_t> chunk;
+			uint32_t lastChunk = (position + count - 1) / RECORD_CHUNK_SIZE;
+			for (uint32_t i = position / RECORD_CHUNK_SIZE; valid && i <= lastChunk; i++) {
+				uint32_t chunkStart = i * RECORD_CHUNK_SIZE;
+				uint32_t chunkLength = std::min(RECORD_CHUNK_SIZE, header.dataLength - chunkStart);
+				uint32_t from = std::max(position, chunkStart);
+				uint32_t to = std::min(position + count, chunkStart + chunkLength);
+				uint64_t chunkPosition = getChunkPosition(offset, header, table, i);
+				uint32_t chunkChecksum = getChunkChecksum(header, table, i);
+				if (from == chunkStart && to == chunkStart + chunkLength) {
+					// whole chunk requested - read it right to the user buffer
+					uint8_t* chunkData = target + (from - position);
+					cachedFile.read(chunkPosition, chunkData, chunkLength);
+					valid = checksum(chunkData, chunkLength) == chunkChecksum;
+				} else {
+					chunk.resize(chunkLength);
+					cachedFile.read(chunkPosition, chunk.data(), chunkLength);
+					valid = checksum(chunk.data(), chunkLength) == chunkChecksum;
+					if (valid) memcpy(target + (from - position), chunk.data() + (from - chunkStart), to - from);
+				}
+			}
+		} else {
+			// plain record has the only checksum for all data
+			std::vector<uint8_t> whole(header.dataLength);
+			cachedFile.read(offset + RECORD_HEADER_SIZE, whole.data(), header.dataLength);
+			valid = checksum(whole.data(), header.dataLength) == header.dataChecksum;
+			if (valid) memcpy(target, whole.data() + position, count);
+		}
+
+		if (valid) bytesRead = count;
+	}
+	unlockRecord(offset, false);
+
+	return bytesRead;
+}
+
+
+
+/*
+* @brief Overwrites range of record data in place (data length is not changed).
+* Chunked (or overflow) record rewrites only chunks overlapping the range and
+* their checksums, plain record is read to recalculate its checksum. Compressed
+* record is decompressed, updated and compressed again (record may move).
+* @param[in] offset - record position in the file
+* @param[in] position - first data byte to write
+* @param[in] data - pointer to new data
+* @param[in] length - bytes to write
+* @return true if range written, false if out of data length or data corrupted
+*/
+bool RecordFileIO::writeRecordRange(uint64_t offset, uint32_t position, const void* data, uint32_t length) {
+
+	if (isReadOnly() || offset == NOT_FOUND || data == nullptr) return false;
+
+	RecordHeader header;
+	const uint8_t* source = (const uint8_t*)data;
+
+	lockRecord(offset, true);
+	bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+	valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+	if (valid && (header.bitFlags & RECORD_CODEC_MASK)) {
+		unlockRecord(offset, true);
+		return writeCompressedRange(offset, position, data, length);
+	}
+	valid = valid && (uint64_t)position + length <= header.dataLength;
+	if (valid && length > 0) {
+
+		uint64_t dataOffset = offset + RECORD_HEADER_SIZE;
+
+		if (header.bitFlags & (RECORD_CHUNKED_FLAG | RECORD_OVERFLOW_FLAG)) {
+			std::vector<uint8_t> table;
+			valid = loadChunksTable(offset, header, table);
+
+			// partially overwritten chunks (the first and the last) are checked and
+			// new checksums are calculated before any chunk is written
+			std::vector<uint8_t> chunk;
+			uint32_t firstChunk = position / RECORD_CHUNK_SIZE;
+			uint32_t lastChunk = (position + length - 1) / RECORD_CHUNK_SIZE;
+			for (uint32_t i = firstChunk; valid && i <= lastChunk; i++) {
+				uint32_t chunkStart = i * RECORD_CHUNK_SIZE;
+				uint32_t chunkLength = std::min(RECORD_CHUNK_SIZE, header.dataLength - chunkStart);
+				uint32_t from = std::max(position, chunkStart);
+				uint32_t to = std::min(position + length, chunkStart + chunkLength);
+				const uint8_t* chunkSource = source + (from - position);
+				if (from == chunkStart && to == chunkStart + chunkLength) {
+					setChunkChecksum(header, table, i, checksum(chunkSource, chunkLength));
+				} else {
+					chunk.resize(chunkLength);
+					uint64_t chunkPosition = getChunkPosition(offset, header, table, i);
+					valid = cachedFile.read(chunkPosition, chunk.data(), chunkLength) == chunkLength;
+					valid = valid && checksum(chunk.data(), chunkLength) == getChunkChecksum(header, table, i);
+					if (valid) {
+						memcpy(chunk.data() + (from - chunkStart), chunkSource, to - from);
+						setChunkChecksum(header, table, i, checksum(chunk.data(), chunkLength));
+					}
+				}
+			}
+
+			// then chunks are updated, and the table and header after them
+			for (uint32_t i = firstChunk; valid && i <= lastChunk; i++) {
+				uint32_t chunkStart = i * RECORD_CHUNK_SIZE;
+				uint32_t chunkLength = std::min(RECORD_CHUNK_SIZE, header.dataLength - chunkStart);
+				uint32_t from = std::max(position, chunkStart);
+				uint32_t to = std::min(position + length, chunkStart + chunkLength);
+				uint64_t chunkPosition = getChunkPosition(offset, header, table, i);
+				valid = cachedFile.write(chunkPosition + (from - chunkStart), source + (from - position), to - from) == to - from;
+			}
+
+			if (valid) {
+				cachedFile.write(dataOffset, table.data(), table.size());
+				header.dataChecksum = checksum(table.data(), table.size());
+			}
+		} else {
+			std::vector<uint8_t> whole(header.dataLength);
+			cachedFile.read(dataOffset, whole.data(), header.dataLength);
+			valid = checksum(whole.data(), header.dataLength) == header.dataChecksum;
+			if (valid) {
+				memcpy(whole.data() + position, source, length);
+				cachedFile.write(dataOffset + position, source, length);
+				header.dataChecksum = checksum(whole.data(), header.dataLength);
+			}
+		}
+
+		if (valid) writeRecordHeader(offset, header);
+	}
+	unlockRecord(offset, true);
+
+	return valid;
+}
+/*
+* @brief Checks record data consistency. Plain record data is covered by
+* the data checksum, chunked record data is covered by chunk checksums table
+* and the table is covered by the data checksum. Overflow record data is in
+* overflow pages, so only its pages table is checked.
+* @param[in] header - record header
+* @param[in] table - chunks table (ignored for plain record)
+* @param[in] data - record data (ignored for overflow record)
+* @return true if data is consistent, false otherwise
+*/
+bool RecordFileIO::verifyRecordData(const RecordHeader& header, const uint8_t* table, const uint8_t* data) {
+
+	if (header.bitFlags & RECORD_OVERFLOW_FLAG) {
+		return checksum(table, getStoredLength(header)) == header.dataChecksum;
+	}
+
+	if (!(header.bitFlags & RECORD_CHUNKED_FLAG)) {
+		return checksum(data, header.dataLength) == header.dataChecksum;
+	}
+
+	uint32_t chunksCount = getChunksCount(header.dataLength);
+	if (checksum(table, chunksCount * sizeof(uint32_t)) != header.dataChecksum) return false;
+
+	for (uint32_t i = 0; i < chunksCount; i++) {
+		uint32_t chunkStart = i * RECORD_CHUNK_SIZE;
+		uint32_t chunkLength = std::min(RECORD_CHUNK_SIZE, header.dataLength - chunkStart);
+		uint32_t expected;
+		memcpy(&expected, table + i * sizeof(uint32_t), sizeof(uint32_t));
+		if (checksum(data + chunkStart, chunkLength) != expected) return false;
+	}
+
+	return true;
+}
+
+
+
+/*
+* @brief Reads and checks chunks table of chunked or overflow record: chunk
+* checksums, preceded by overflow pages positions for overflow record
+* (caller holds record lock)
+* @param[in] offset - record position in the file
+* @param[in] header - record header
+* @param[out] table - chunks table
+* @return true if table is consistent, false otherwise
+*/
+bool RecordFileIO::loadChunksTable(uint64_t offset, const RecordHeader& header, std::vector<uint8_t>& table) {
+	uint64_t tableSize = getStoredLength(header);
+	if (header.bitFlags & RECORD_CHUNKED_FLAG) tableSize -= header.dataLength;
+	table.resize(tableSize);
+	if (tableSize > 0 && cachedFile.read(offset + RECORD_HEADER_SIZE, table.data(), tableSize) != tableSize) return false;
+	return checksum(table.data(), tableSize) == header.dataChecksum;
+}
+
+
+
+/*
+* @brief Position of chunk data in file: after chunks table for chunked record
+* or in overflow page for overflow record
+* @param[in] offset - record position in the file
+* @param[in] header - record header
+* @param[in] table - chunks table
+* @param[in] index - chunk index
+* @return chunk data position
+*/
+uint64_t RecordFileIO::getChunkPosition(uint64_t offset, const RecordHeader& header, const std::vector<uint8_t>& table, uint32_t index) {
+	if (header.bitFlags & RECORD_OVERFLOW_FLAG) {
+		uint64_t pagePosition;
+		memcpy(&pagePosition, table.data() + index * sizeof(uint64_t), sizeof(uint64_t));
+		return pagePosition + RECORD_HEADER_SIZE;
+	}
+	uint64_t tableSize = (uint64_t)getChunksCount(header.dataLength) * sizeof(uint32_t);
+	return offset + RECORD_HEADER_SIZE + tableSize + (uint64_t)index * RECORD_CHUNK_SIZE;
+}
+
+
+
+/*
+* @brief Returns checksum of chunk from chunks table
+* @param[in] header - record header
+* @param[in] table - chunks table
+* @param[in] index - chunk index
+* @return chunk checksum
+*/
+uint32_t RecordFileIO::getChunkChecksum(const RecordHeader& header, const std::vector<uint8_t>& table, uint32_t index) {
+	uint64_t checksumsOffset = 0;
+	if (header.bitFlags & RECORD_OVERFLOW_FLAG) checksumsOffset = (uint64_t)getChunksCount(header.dataLength) * sizeof(uint64_t);
+	uint32_t value;
+	memcpy(&value, table.data() + checksumsOffset + index * sizeof(uint32_t), sizeof(uint32_t));
+	return value;
+}
+
+
+
+/*
+* @brief Updates checksum of chunk in chunks table
+* @param[in] header - record header
+* @param[in,out] table - chunks table
+* @param[in] index - chunk index
+* @param[in] value - chunk checksum
+*/
+void RecordFileIO::setChunkChecksum(const RecordHeader& header, std::vector<uint8_t>& table, uint32_t index, uint32_t value) {
+	uint64_t checksumsOffset = 0;
+	if (header.bitFlags & RECORD_OVERFLOW_FLAG) checksumsOffset = (uint64_t)getChunksCount(header.dataLength) * sizeof(uint64_t);
+	memcpy(table.data() + checksumsOffset + index * sizeof(uint32_t), &value, sizeof(uint32_t));
+}
+
+
+
+/*
+* @brief Number of chunks in data of given length
+* @param[in] length - data length
+* @return number of chunk checksums
+*/
+uint32_t RecordFileIO::getChunksCount(uint32_t length) {
+	return (uint32_t)(((uint64_t)length + RECORD_CHUNK_SIZE - 1) / RECORD_CHUNK_SIZE);
+}
+
+
+
+/*
+* @brief Bytes stored in record data area: data and chunk checksums table if chunked,
+* overflow pages table if data is stored in overflow pages
+* @param[in] header - record header
+* @return stored bytes count
+*/
+uint64_t RecordFileIO::getStoredLength(const RecordHeader& header) {
+	uint64_t chunksCount = getChunksCount(header.dataLength);
+	// overflow record keeps pages positions and checksums, data is in pages
+	if (header.bitFlags & RECORD_OVERFLOW_FLAG) return chunksCount * (sizeof(uint64_t) + sizeof(uint32_t));
+	if (header.bitFlags & RECORD_CHUNKED_FLAG) return chunksCount * sizeof(uint32_t) + header.dataLength;
+	return header.dataLength;
+}
+
 
 
 /**
-*  @brief Adler-32 checksum algoritm (strightforward and not efficent, but its okay)
+*  @brief Checksum of data using algorithm selected by storage header
 *  @param[in] data - byte array of data to be checksummed
 *  @param[in] length - length of data in bytes
 *  @return 32-bit checksum of given data
 */
 uint32_t RecordFileIO::checksum(const uint8_t* data, uint64_t length) {
-
-	const uint32_t MOD_ADLER = 65521;
-	uint32_t a = 1, b = 0;
-	uint64_t index;
-	// Process each byte of the data in order
-	for (index = 0; index < length; ++index)
-	{
-		a = (a + data[index]) % MOD_ADLER;
-		b = (b + a) % MOD_ADLER;
-	}
-	return (b << 16) | a;
-}
\ No newline at end of file
+	return checksumFunction(data, length);
+}
@@ -0,0 +1,314 @@
+#include "RecordFileIO.h"
+
+#include <cstring>
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Multi-record transactions methods
+//
+// Transaction buffers its writes and remembers versions (length, checksum and
+// layout) of records it has read or written. Commit holds version gate
+// exclusively, so no other write runs meanwhile, checks remembered versions
+// are still current (optimistic concurrency) and applies writes. Before any
+// write is applied the whole write set is stored as journal (system record)
+// referenced from storage header and flushed to storage device:
+//
+//   [ writes count ][ reserved ] { [ record ID ][ operation ][ length ][ data ] }
+//
+// Journal is released after writes are applied and flushed. Transaction is
+// committed once its journal is flushed: if writes fail or are not flushed,
+// journal stays and is applied again by the next commit or on open (if
+// storage was not closed properly). Writes are idempotent by record ID, so
+// transaction is done entirely.
+// Lock order: version gate -> free list -> header -> records.
+//-----------------------------------------------------------------------------
+
+constexpr uint32_t JOURNAL_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr uint32_t JOURNAL_ENTRY_HEADER_SIZE = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+constexpr uint32_t TRANSACTION_WRITE_ATTEMPTS = 3;
+
+
+/*
+*  @brief Reads record by ID with its header under record lock
+*  @param[in] recordID - record ID
+*  @param[out] header - record header (record version)
+*  @param[out] data - record data (nullptr if only header needed)
+*  @return true if record exists and data is consistent, false otherwise
+*/
+bool RecordFileIO::readRecordVersion(uint64_t recordID, RecordHeader& header, std::vector<uint8_t>* data) {
+
+	for (uint32_t attempt = 0; attempt < SNAPSHOT_READ_ATTEMPTS; attempt++) {
+
+		uint64_t offset = getRecordOffset(recordID);
+		if (offset == NOT_FOUND) return false;
+
+		lockRecord(offset, false);
+		bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+		valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+		valid = valid && (header.bitFlags & RECORD_ID_MASK) == recordID;
+		bool consistent = valid && (data == nullptr || readDecodedData(offset, header, *data));
+		unlockRecord(offset, false);
+
+		if (consistent) return true;
+		if (valid) return false;
+
+		// record moved (compaction or update) meanwhile, retry by ID table
+		std::this_thread::yield();
+	}
+
+	return false;
+}
+
+
+
+/*
+*  @brief Checks if record has the same data as expected version (position may differ)
+*  @param[in] header - current record header
+*  @param[in] expected - record header of expected version
+*  @return true if record version is the same, false otherwise
+*/
+bool RecordFileIO::isSameVersion(const RecordHeader& header, const RecordHeader& expected) {
+	constexpr uint64_t LAYOUT_FLAGS = RECORD_CHUNKED_FLAG | RECORD_OVERFLOW_FLAG | RECORD_CODEC_MASK;
+	return header.dataLength == expected.dataLength && header.dataChecksum == expected.dataChecksum &&
+		(header.bitFlags & LAYOUT_FLAGS) == (expected.bitFlags & LAYOUT_FLAGS);
+}
+
+
+
+/*
+*  @brief Validates and applies transaction writes atomically
+*  @param[in] reads - record versions transaction relies on
+*  @param[in] writes - transaction writes by record ID
+*  @return true if committed (journal flushed, writes are applied now or from
+*  journal later), false if records changed meanwhile or journal write failed
+*/
+bool RecordFileIO::commitTransaction(const TransactionReads& reads, const TransactionWrites& writes) {
+
+	if (isReadOnly() && !writes.empty()) return false;
+
+	// Commit is exclusive to other writes and snapshots opening
+	std::unique_lock gate(versionGate);
+
+	// Journal of committed transaction which writes failed is completed first
+	if (!replayJournal()) return false;
+
+	// Records must be as transaction has seen them
+	RecordHeader header;
+	for (auto& [recordID, expected] : reads) {
+		if (!readRecordVersion(recordID, header, nullptr)) return false;
+		if (!isSameVersion(header, expected)) return false;
+	}
+	if (writes.empty()) return true;
+
+	// Transaction is committed as soon as its journal is on storage device
+	uint64_t journal = writeJournal(writes);
+	if (journal == NOT_FOUND) return false;
+
+	// Keep versions of all records for open snapshots before any write
+	std::vector<std::shared_ptr<RecordVersion>> versions;
+	for (auto& [recordID, write] : writes) {
+		if (write.operation == TransactionOperation::CREATE) versions.push_back(keepCreatedVersion(recordID));
+		else versions.push_back(keepVersion(getRecordOffset(recordID)));
+	}
+
+	// Writes become visible to snapshots at once
+	bool applied = applyJournal(writes);
+	uint64_t timestamp = ++commitTimestamp;
+	for (auto& version : versions) tagVersion(version, true, timestamp);
+
+	// Journal is kept if writes failed or are not on storage device yet,
+	// so they are completed by next commit or on next open
+	if (applied && cachedFile.flush()) clearJournal(journal);
+
+	return true;
+}
+
+
+
+/*
+*  @brief Stores transaction writes as journal and flushes it to storage device
+*  @param[in] writes - transaction writes by record ID
+*  @return journal position or NOT_FOUND if failed
+*/
+uint64_t RecordFileIO::writeJournal(const TransactionWrites& writes) {
+
+	uint64_t size = JOURNAL_HEADER_SIZE;
+	for (auto& [recordID, write] : writes) size += JOURNAL_ENTRY_HEADER_SIZE + write.data.size();
+	if (size > UINT32_MAX - RECORD_HEADER_SIZE) return NOT_FOUND;
+
+	std::vector<uint8_t> journal(size);
+	uint32_t writesCount = (uint32_t)writes.size();
+	uint32_t reserved = 0;
+	memcpy(journal.data(), &writesCount, sizeof(uint32_t));
+	memcpy(journal.data() + sizeof(uint32_t), &reserved, sizeof(uint32_t));
+
+	uint8_t* entry = journal.data() + JOURNAL_HEADER_SIZE;
+	for (auto& [recordID, write] : writes) {
+		uint32_t operation = (uint32_t)write.operation;
+		uint32_t length = (uint32_t)write.data.size();
+		memcpy(entry, &recordID, sizeof(uint64_t));
+		memcpy(entry + sizeof(uint64_t), &operation, sizeof(uint32_t));
+		memcpy(entry + sizeof(uint64_t) + sizeof(uint32_t), &length, sizeof(uint32_t));
+		if (length > 0) memcpy(entry + JOURNAL_ENTRY_HEADER_SIZE, write.data.data(), length);
+		entry += JOURNAL_ENTRY_HEADER_SIZE + length;
+	}
+
+	RecordHeader header;
+	uint64_t offset = allocateSystemRecord((uint32_t)size, header, journal.data());
+	if (offset == NOT_FOUND) return NOT_FOUND;
+	// records state changes with every journal written
+	{
+		std::unique_lock lock(headerMutex);
+		storageHeader.transactionJournal = offset;
+		storageHeader.commitStamp++;
+		writeStorageHeader();
+	}
+
+	if (!cachedFile.flush()) {
+		clearJournal(offset);
+		return NOT_FOUND;
+	}
+
+	return offset;
+}
+
+
+
+/*
+*  @brief Applies transaction writes in record ID order
+*  @param[in] writes - transaction writes by record ID
+*  @return true if all writes applied, false otherwise
+*/
+bool RecordFileIO::applyJournal(const TransactionWrites& writes) {
+	bool applied = true;
+	for (auto& [recordID, write] : writes) {
+		applied = applyWrite(recordID, write) && applied;
+	}
+	return applied;
+}
+
+
+
+/*
+*  @brief Applies single write of transaction. Write applied once again gives
+*  the same result, so journal can be replayed after interrupted commit.
+*  @param[in] recordID - record ID
+*  @param[in] write - operation and record data
+*  @return true if write applied, false otherwise
+*/
+bool RecordFileIO::applyWrite(uint64_t recordID, const TransactionWrite& write) {
+
+	const uint8_t* data = write.data.data();
+	uint32_t length = (uint32_t)write.data.size();
+
+	switch (write.operation) {
+
+	case TransactionOperation::CREATE:
+		if (getRecordOffset(recordID) == NOT_FOUND) return insertRecord(recordID, data, length) != nullptr;
+		// record has been created before commit was interrupted
+		if (length == 0) return true;
+		[[fallthrough]];
+
+	case TransactionOperation::UPDATE:
+		// record could be moved by compaction meanwhile, so retry by ID table
+		for (uint32_t attempt = 0; attempt < TRANSACTION_WRITE_ATTEMPTS; attempt++) {
+			uint64_t offset = getRecordOffset(recordID);
+			if (offset == NOT_FOUND) return false;
+			if (writeRecordData(offset, data, length) != NOT_FOUND) return true;
+		}
+		return false;
+
+	case TransactionOperation::REMOVE:
+		for (uint32_t attempt = 0; attempt < TRANSACTION_WRITE_ATTEMPTS; attempt++) {
+			uint64_t offset = getRecordOffset(recordID);
+			if (offset == NOT_FOUND) return true;
+			auto cursor = getRecord(offset);
+			if (cursor != nullptr && cursor->getRecordID() == recordID && unlinkRecord(cursor)) return true;
+		}
+		return false;
+	}
+
+	return false;
+}
+
+
+
+/*
+*  @brief Releases journal of completed transaction and flushes storage.
+*  Applied writes must be flushed before, since flush writes pages in page
+*  number order and cleared header could reach storage device first.
+*  @param[in] offset - journal position
+*  @return true if succeeded, false otherwise
+*/
+bool RecordFileIO::clearJournal(uint64_t offset) {
+
+	{
+		std::unique_lock lock(headerMutex);
+		storageHeader.transactionJournal = NOT_FOUND;
+		writeStorageHeader();
+	}
+
+	// journal could be not written at all if storage was not closed properly
+	RecordHeader header;
+	bool isJournal = readRecordHeader(offset, header) != NOT_FOUND;
+	isJournal = isJournal && (header.bitFlags & RECORD_SYSTEM_FLAG) && !(header.bitFlags & RECORD_DELETED_FLAG);
+	if (isJournal) addRecordToFreeList(offset);
+
+	return cachedFile.flush();
+}
+
+
+
+/*
+*  @brief Completes transaction interrupted after its journal was written
+*  (called by open and by commit while version gate is held)
+*  @return true if there was no journal or it is applied, false otherwise
+*/
+bool RecordFileIO::replayJournal() {
+
+	uint64_t offset;
+	{
+		std::shared_lock lock(headerMutex);
+		offset = storageHeader.transactionJournal;
+	}
+	if (offset == NOT_FOUND || isReadOnly()) return true;
+
+	// journal which is not consistent has not been committed, nothing was applied
+	RecordHeader header;
+	std::vector<uint8_t> journal;
+	bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+	valid = valid && (header.bitFlags & RECORD_SYSTEM_FLAG) && !(header.bitFlags & RECORD_DELETED_FLAG);
+	valid = valid && header.dataLength >= JOURNAL_HEADER_SIZE && header.dataLength <= header.recordCapacity;
+	if (valid) {
+		journal.resize(header.dataLength);
+		cachedFile.read(offset + RECORD_HEADER_SIZE, journal.data(), header.dataLength);
+		valid = checksum(journal.data(), header.dataLength) == header.dataChecksum;
+	}
+	if (!valid) return clearJournal(offset);
+
+	// parse writes checking bounds
+	TransactionWrites writes;
+	uint32_t writesCount;
+	memcpy(&writesCount, journal.data(), sizeof(uint32_t));
+	size_t position = JOURNAL_HEADER_SIZE;
+	for (uint32_t i = 0; i < writesCount; i++) {
+		if (position + JOURNAL_ENTRY_HEADER_SIZE > journal.size()) return false;
+		uint64_t recordID;
+		uint32_t operation, length;
+		memcpy(&recordID, journal.data() + position, sizeof(uint64_t));
+		memcpy(&operation, journal.data() + position + sizeof(uint64_t), sizeof(uint32_t));
+		memcpy(&length, journal.data() + position + sizeof(uint64_t) + sizeof(uint32_t), sizeof(uint32_t));
+		position += JOURNAL_ENTRY_HEADER_SIZE;
+		if (position + length > journal.size()) return false;
+		auto& write = writes[recordID];
+		write.operation = (TransactionOperation)operation;
+		write.data.assign(journal.data() + position, journal.data() + position + length);
+		position += length;
+	}
+
+	if (!applyJournal(writes) || !cachedFile.flush()) return false;
+
+	return clearJournal(offset);
+}
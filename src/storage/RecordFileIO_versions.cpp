@@ -0,0 +1,358 @@
+#include "RecordFileIO.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace Cloudless::Storage;
+
+//-----------------------------------------------------------------------------
+// Record versions methods (snapshot isolation)
+//
+// Snapshot sees records as they were at its open timestamp. While snapshots
+// are open, writer keeps record data it replaces as record version before the
+// write and tags version by commit timestamp after the write. Snapshot reads
+// the current record without record locks and takes the oldest version
+// replaced after snapshot opened if there is one (checked again after read,
+// so concurrent write is never seen half done):
+//
+//   version 1 (validTo 5) -> version 2 (validTo 9) -> current record
+//   snapshot 3 reads version 1, snapshot 7 reads version 2, snapshot 9 current
+//
+// Writes hold version gate shared, snapshot opens holding it exclusively, so
+// there are no writes in progress started before snapshot. Version is removed
+// when no open snapshot is older than its commit.
+//
+// Versions are kept in memory: every record replaced while a snapshot is open
+// costs its whole data (overflow records too), so long snapshot over heavily
+// updated file grows versions without bound. Versions data is limited by
+// versions limit: when exceeded, the oldest snapshots expire (their reads fail)
+// and versions only they needed are released.
+// Lock order: version gate -> records locks, versions mutex is the last one.
+//-----------------------------------------------------------------------------
+
+
+/*
+*  @brief Sets versions data limit, the oldest snapshots expire when exceeded
+*  @param[in] bytes - record versions data bytes kept for open snapshots
+*/
+void RecordFileIO::setVersionsLimit(uint64_t bytes) {
+	versionsLimit.store(bytes);
+	std::lock_guard lock(versionsMutex);
+	expireSnapshots();
+}
+
+
+
+/*
+*  @brief Returns versions data limit
+*  @return record versions data bytes kept for open snapshots before they expire
+*/
+uint64_t RecordFileIO::getVersionsLimit() {
+	return versionsLimit.load();
+}
+
+
+
+/*
+*  @brief Returns number of record versions kept for open snapshots
+*  @return record versions count
+*/
+uint64_t RecordFileIO::getTotalVersions() {
+	std::lock_guard lock(versionsMutex);
+	uint64_t total = 0;
+	for (auto& [recordID, versions] : recordVersions) total += versions.size();
+	return total;
+}
+
+
+
+/*
+*  @brief Returns memory taken by record versions kept for open snapshots
+*  @return record versions data bytes
+*/
+uint64_t RecordFileIO::getTotalVersionBytes() {
+	std::lock_guard lock(versionsMutex);
+	return versionsBytes;
+}
+
+
+
+/*
+*  @brief Starts record write: keeps record data as version if snapshots are open.
+*  Caller must call commitVersion after the write.
+*  @param[in] offset - record position (pending record is versioned as not existing)
+*  @return record version or nullptr if no snapshot needs it
+*/
+std::shared_ptr<RecordVersion> RecordFileIO::beginVersion(uint64_t offset) {
+	versionGate.lock_shared();
+	return keepVersion(offset);
+}
+
+
+
+/*
+*  @brief Completes record write: tags version by commit timestamp
+*  @param[in] version - record version returned by beginVersion
+*  @param[in] committed - true if record has been written, false if write failed
+*/
+void RecordFileIO::commitVersion(std::shared_ptr<RecordVersion> version, bool committed) {
+	uint64_t timestamp = committed ? ++commitTimestamp : commitTimestamp.load();
+	tagVersion(version, committed, timestamp);
+	versionGate.unlock_shared();
+}
+
+
+
+/*
+*  @brief Keeps record data as version if snapshots are open (caller holds version gate)
+*  @param[in] offset - record position (pending record is versioned as not existing)
+*  @return record version or nullptr if no snapshot needs it
+*/
+std::shared_ptr<RecordVersion> RecordFileIO::keepVersion(uint64_t offset) {
+
+	{
+		std::lock_guard lock(versionsMutex);
+		if (activeSnapshots.empty()) return nullptr;
+	}
+
+	// snapshots can't be opened meanwhile, so record data is the version they see
+	RecordHeader header;
+	auto version = std::make_shared<RecordVersion>();
+	lockRecord(offset, false);
+	bool valid = readRecordHeader(offset, header) != NOT_FOUND && !(header.bitFlags & RECORD_DELETED_FLAG);
+	version->recordID = header.bitFlags & RECORD_ID_MASK;
+	version->validTo = VERSION_PENDING;
+	version->exists = valid && !(header.bitFlags & RECORD_SYSTEM_FLAG);
+	if (version->exists) version->exists = readDecodedData(offset, header, version->data);
+	unlockRecord(offset, false);
+	if (!valid || version->recordID == 0) return nullptr;
+
+	std::lock_guard lock(versionsMutex);
+	recordVersions[version->recordID].push_back(version);
+	versionsBytes += version->data.size();
+	expireSnapshots();
+
+	return version;
+}
+
+
+
+/*
+*  @brief Keeps version of record being created with reserved ID, so snapshots
+*  opened after ID reservation don't see it (caller holds version gate)
+*  @param[in] recordID - record ID
+*  @return record version or nullptr if no snapshot needs it
+*/
+std::shared_ptr<RecordVersion> RecordFileIO::keepCreatedVersion(uint64_t recordID) {
+
+	std::lock_guard lock(versionsMutex);
+	if (activeSnapshots.empty()) return nullptr;
+
+	auto version = std::make_shared<RecordVersion>();
+	version->recordID = recordID;
+	version->validTo = VERSION_PENDING;
+	version->exists = false;
+	recordVersions[recordID].push_back(version);
+
+	return version;
+}
+
+
+
+/*
+*  @brief Tags version by commit timestamp or drops it
+*  @param[in] version - record version (nullptr if not kept)
+*  @param[in] committed - true if record has been written, false if write failed
+*  @param[in] timestamp - commit timestamp
+*/
+void RecordFileIO::tagVersion(std::shared_ptr<RecordVersion> version, bool committed, uint64_t timestamp) {
+
+	if (version == nullptr) return;
+
+	std::lock_guard lock(versionsMutex);
+	auto it = recordVersions.find(version->recordID);
+	if (!committed || activeSnapshots.empty()) {
+		// version is not needed if record has not changed or no snapshots left
+		auto& versions = it->second;
+		versions.erase(std::find(versions.begin(), versions.end(), version));
+		if (versions.empty()) recordVersions.erase(it);
+		versionsBytes -= version->data.size();
+	} else version->validTo = timestamp;
+}
+
+
+
+/*
+*  @brief Finds version visible to snapshot: the oldest version replaced after snapshot opened
+*  @param[in] recordID - record ID
+*  @param[in] timestamp - snapshot timestamp
+*  @param[out] result - visible record version
+*  @return true if version found, false if current record is visible
+*/
+bool RecordFileIO::findVersion(uint64_t recordID, uint64_t timestamp, std::shared_ptr<RecordVersion>& result) {
+
+	std::lock_guard lock(versionsMutex);
+	auto it = recordVersions.find(recordID);
+	if (it == recordVersions.end()) return false;
+
+	result = nullptr;
+	for (auto& version : it->second) {
+		if (version->validTo <= timestamp) continue;
+		if (result == nullptr || version->validTo < result->validTo) result = version;
+	}
+
+	return result != nullptr;
+}
+
+
+
+/*
+*  @brief Opens snapshot waiting for writes in progress
+*  @param[out] nextRecordID - first record ID created after snapshot
+*  @param[out] sequence - snapshot open sequence
+*  @return snapshot timestamp
+*/
+uint64_t RecordFileIO::openSnapshot(uint64_t& nextRecordID, uint64_t& sequence) {
+
+	std::unique_lock gate(versionGate);
+	{
+		std::shared_lock lock(headerMutex);
+		nextRecordID = storageHeader.nextRecordID;
+	}
+
+	// snapshots open one by one, so sequence order is timestamp order
+	std::lock_guard lock(versionsMutex);
+	uint64_t timestamp = commitTimestamp.load();
+	sequence = ++snapshotSequence;
+	activeSnapshots[sequence] = timestamp;
+
+	return timestamp;
+}
+
+
+
+/*
+*  @brief Closes snapshot and removes versions no open snapshot needs
+*  @param[in] sequence - snapshot open sequence
+*/
+void RecordFileIO::releaseSnapshot(uint64_t sequence) {
+	std::lock_guard lock(versionsMutex);
+	activeSnapshots.erase(sequence);
+	collectVersions();
+}
+
+
+
+/*
+*  @brief Expires the oldest snapshots while versions data exceeds the limit
+*  (caller holds versions mutex)
+*/
+void RecordFileIO::expireSnapshots() {
+	while (versionsBytes > versionsLimit.load() && !activeSnapshots.empty()) {
+		auto oldest = activeSnapshots.begin();
+		expiredSequence.store(oldest->first);
+		activeSnapshots.erase(oldest);
+		collectVersions();
+	}
+}
+
+
+
+/*
+*  @brief Removes committed versions no open snapshot needs (caller holds versions mutex)
+*/
+void RecordFileIO::collectVersions() {
+
+	// version committed before the oldest open snapshot is seen by none
+	uint64_t oldest = activeSnapshots.empty() ? VERSION_PENDING : activeSnapshots.begin()->second;
+	for (auto it = recordVersions.begin(); it != recordVersions.end();) {
+		auto& versions = it->second;
+		auto unused = std::stable_partition(versions.begin(), versions.end(), [oldest](auto& version) {
+			return version->validTo == VERSION_PENDING || version->validTo > oldest;
+		});
+		for (auto version = unused; version != versions.end(); ++version) versionsBytes -= (*version)->data.size();
+		versions.erase(unused, versions.end());
+		it = versions.empty() ? recordVersions.erase(it) : std::next(it);
+	}
+}
+
+
+
+/*
+*  @brief Checks if snapshot expired because versions data exceeded the limit
+*  @param[in] sequence - snapshot open sequence
+*  @return true if snapshot expired, false otherwise
+*/
+bool RecordFileIO::isSnapshotExpired(uint64_t sequence) {
+	return sequence <= expiredSequence.load();
+}
+
+
+
+/*
+*  @brief Reads record data visible to snapshot without record locks
+*  @param[in] recordID - record ID
+*  @param[in] timestamp - snapshot timestamp
+*  @param[in] sequence - snapshot open sequence
+*  @param[out] data - record data
+*  @return true if record is visible to snapshot, false if it is not, data is
+*  corrupt or snapshot expired
+*/
+bool RecordFileIO::readSnapshotData(uint64_t recordID, uint64_t timestamp, uint64_t sequence, std::vector<uint8_t>& data) {
+
+	std::shared_ptr<RecordVersion> version;
+	RecordHeader header;
+
+	for (uint32_t attempt = 0; attempt < SNAPSHOT_READ_ATTEMPTS; attempt++) {
+
+		// record replaced after snapshot opened
+		if (findVersion(recordID, timestamp, version)) break;
+
+		// current record is visible, read it and check it's still the same record
+		uint64_t offset = getRecordOffset(recordID);
+		if (offset == NOT_FOUND) {
+			if (findVersion(recordID, timestamp, version)) break;
+			return false;
+		}
+		bool valid = readRecordHeader(offset, header) != NOT_FOUND;
+		valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+		valid = valid && (header.bitFlags & RECORD_ID_MASK) == recordID;
+		valid = valid && readDecodedData(offset, header, data);
+
+		// write started meanwhile could change data being read,
+		// version it kept could be released by snapshot expiry
+		if (findVersion(recordID, timestamp, version)) break;
+		if (valid) return !isSnapshotExpired(sequence);
+
+		// record moved (compaction or update) or reused, retry by ID table
+		std::this_thread::yield();
+	}
+
+	if (version == nullptr || !version->exists || isSnapshotExpired(sequence)) return false;
+	data = version->data;
+	return true;
+}
+
+
+
+/*
+*  @brief Reads whole record data of any layout and decompresses it
+*  (caller holds record lock or checks record has not changed)
+*  @param[in] offset - record position in the file
+*  @param[in] header - record header
+*  @param[out] data - record data
+*  @return true if data is consistent, false otherwise
+*/
+bool RecordFileIO::readDecodedData(uint64_t offset, const RecordHeader& header, std::vector<uint8_t>& data) {
+
+	if (!(header.bitFlags & RECORD_CODEC_MASK)) {
+		data.resize(header.dataLength);
+		return readStoredData(offset, header, data.data());
+	}
+
+	std::vector<uint8_t> stored(header.dataLength);
+	if (!readStoredData(offset, header, stored.data())) return false;
+	data.resize(getDecodedLength(header, stored.data()));
+
+	return decodeRecordData(header, stored.data(), data.data());
+}
@@ -0,0 +1,200 @@
+/******************************************************************************
+*
+*  RecordScanner class implementation
+*
+*  RecordScanner is designed for fast linear traversal of all records, for
+*  example to build search indexes or export data. Unlike RecordCursor it
+*  reads ahead a batch of records following "next" links: file is read in
+*  windows (growing while records follow in file order), record headers and
+*  data are validated by checksums in memory, and record is re-read under
+*  record lock only if it is changing concurrently. Scanner yields record
+*  position, header and data span.
+*
+*  Features:
+*    - read ahead of records in batches without redundant header re-reads
+*    - data consistency check (checksum)
+*    - weakly consistent traversal while records are modified
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "RecordFileIO.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief RecordScanner constructor, scanner starts from the first record
+*  @param[in] rf - records file
+*  @param[in] readAhead - number of records read ahead at once
+*/
+RecordScanner::RecordScanner(RecordFileIO& rf, uint32_t readAhead) : recordFile(rf) {
+	readAheadCount = std::max(1u, readAhead);
+	window.resize(SCAN_WINDOW_SIZE);
+	windowSize = SCAN_WINDOW_SIZE;
+	reset();
+}
+
+
+/*
+*  @brief Moves scanner back to the first record
+*/
+void RecordScanner::reset() {
+	std::shared_lock lock(recordFile.headerMutex);
+	nextPosition = recordFile.storageHeader.firstRecord;
+	interrupted = false;
+	entries.clear();
+	buffer.clear();
+	currentEntry = 0;
+}
+
+
+/*
+*  @brief Checks if scan stopped before the last record, because record
+*  in the chain has been deleted or corrupt
+*  @return true if scan interrupted, false otherwise
+*/
+bool RecordScanner::isInterrupted() {
+	return interrupted;
+}
+
+
+/*
+*  @brief Yields next record
+*  @param[out] record - record position, header and data span (valid until next call)
+*  @return true if record yielded, false if there is no more records
+*/
+bool RecordScanner::next(ScanRecord& record) {
+
+	if (currentEntry >= entries.size() && !readAhead()) return false;
+
+	ScanEntry& entry = entries[currentEntry++];
+	record.offset = entry.offset;
+	memcpy(&record.header, &entry.header, RECORD_HEADER_SIZE);
+	record.data = buffer.data() + entry.dataOffset;
+	record.length = entry.dataLength;
+
+	return true;
+}
+
+
+/*
+*  @brief Reads ahead batch of records following the records chain
+*  @return true if at least one record has been read, false otherwise
+*/
+bool RecordScanner::readAhead() {
+
+	entries.clear();
+	buffer.clear();
+	currentEntry = 0;
+
+	uint64_t endOfData;
+	{
+		std::shared_lock lock(recordFile.headerMutex);
+		endOfData = recordFile.storageHeader.endOfData;
+	}
+
+	uint64_t windowStart = 0, windowEnd = 0;
+	size_t windowRecords = 0;
+	CachedFileIO& cachedFile = recordFile.cachedFile;
+
+	while (entries.size() < readAheadCount && nextPosition != NOT_FOUND) {
+
+		uint64_t offset = nextPosition;
+
+		// Read next file window if record header is out of current window
+		if (offset < windowStart || offset + RECORD_HEADER_SIZE > windowEnd) {
+			// grow window while records follow in file order, shrink when they are scattered
+			if (windowEnd > windowStart) {
+				if (windowRecords > 1) windowSize = std::min<size_t>(windowSize * 2, SCAN_WINDOW_SIZE);
+				else windowSize = std::max<size_t>(windowSize / 2, SCAN_MIN_WINDOW_SIZE);
+			}
+			windowStart = offset;
+			windowRecords = 0;
+			size_t length = (size_t)std::min<uint64_t>(windowSize, endOfData > offset ? endOfData - offset : 0);
+			windowEnd = windowStart + (length > 0 ? cachedFile.read(offset, window.data(), length) : 0);
+		}
+		windowRecords++;
+
+		ScanEntry entry;
+		entry.offset = offset;
+		entry.dataOffset = buffer.size();
+		size_t tableSize = 0;
+		bool valid = false;
+
+		// Validate header and data in memory
+		if (offset + RECORD_HEADER_SIZE <= windowEnd) {
+			RecordHeader& header = entry.header;
+			memcpy(&header, window.data() + (offset - windowStart), RECORD_HEADER_SIZE);
+			valid = recordFile.checksum((uint8_t*)&header, RECORD_HEADER_PAYLOAD_SIZE) == header.headChecksum;
+			valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+			// overflow record data is in overflow pages, so it is read under record lock
+			valid = valid && !(header.bitFlags & RECORD_OVERFLOW_FLAG);
+			if (valid) {
+				uint64_t dataStart = offset + RECORD_HEADER_SIZE;
+				size_t storedLength = (size_t)RecordFileIO::getStoredLength(header);
+				buffer.resize(entry.dataOffset + storedLength);
+				uint8_t* data = buffer.data() + entry.dataOffset;
+				if (dataStart + storedLength <= windowEnd) {
+					memcpy(data, window.data() + (dataStart - windowStart), storedLength);
+				} else if (storedLength > 0) {
+					// record is bigger than the window rest
+					cachedFile.read(dataStart, data, storedLength);
+				}
+				tableSize = storedLength - header.dataLength;
+				valid = recordFile.verifyRecordData(header, data, data + tableSize);
+			}
+		}
+
+		// Record is being changed (or window is stale), so read it under record lock
+		if (!valid) {
+			buffer.resize(entry.dataOffset);
+			tableSize = 0;
+			valid = readLocked(offset, entry.header);
+		}
+
+		// Decompress compressed record data
+		valid = valid && recordFile.decodeScanData(entry.header, buffer, entry.dataOffset, entry.dataLength);
+
+		// Record deleted or corrupt - chain can't be followed
+		if (!valid) {
+			buffer.resize(entry.dataOffset);
+			interrupted = true;
+			nextPosition = NOT_FOUND;
+			break;
+		}
+
+		// skip chunk checksums table of chunked record
+		entry.dataOffset += tableSize;
+		entries.push_back(entry);
+		nextPosition = entry.header.next;
+	}
+
+	return !entries.empty();
+}
+
+
+/*
+*  @brief Reads record header and data to the buffer end under record lock
+*  @param[in] offset - record position
+*  @param[out] header - record header
+*  @return true if record is live and consistent, false otherwise
+*/
+bool RecordScanner::readLocked(uint64_t offset, RecordHeader& header) {
+
+	size_t dataOffset = buffer.size();
+
+	recordFile.lockRecord(offset, false);
+	bool valid = recordFile.readRecordHeader(offset, header) != NOT_FOUND;
+	valid = valid && !(header.bitFlags & (RECORD_DELETED_FLAG | RECORD_SYSTEM_FLAG));
+	if (valid) {
+		buffer.resize(dataOffset + header.dataLength);
+		valid = recordFile.readStoredData(offset, header, buffer.data() + dataOffset);
+	}
+	recordFile.unlockRecord(offset, false);
+
+	return valid;
+}
@@ -0,0 +1,106 @@
+/******************************************************************************
+*
+*  RecordSnapshot class implementation
+*
+*  RecordSnapshot is designed for consistent reads while records are being
+*  modified, for example to export data or build indexes without blocking
+*  editors. Snapshot sees every record as it was when snapshot opened: later
+*  updates, removals and new records are not visible. Snapshot reads take no
+*  record locks, writers keep replaced record versions while open snapshots
+*  need them and versions are released when the last such snapshot closes.
+*  Versions are kept in memory, so if they exceed versions limit of records
+*  file, the oldest snapshots expire and their reads fail (see isValid).
+*
+*  Features:
+*    - snapshot isolation of records (by record ID)
+*    - lock free reads, readers never block writers
+*    - garbage collection of record versions
+*    - expiry of the oldest snapshots over versions memory limit
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "RecordFileIO.h"
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief Opens snapshot of records (waits for writes in progress)
+*  @param[in] rf - records file
+*/
+RecordSnapshot::RecordSnapshot(RecordFileIO& rf) : recordFile(rf) {
+	timestamp = recordFile.openSnapshot(nextRecordID, sequence);
+	currentID = 0;
+}
+
+
+
+/*
+*  @brief Closes snapshot, record versions kept for it are released
+*/
+RecordSnapshot::~RecordSnapshot() {
+	recordFile.releaseSnapshot(sequence);
+}
+
+
+
+/*
+*  @brief Reads record data as it was when snapshot opened
+*  @param[in] recordID - record ID
+*  @param[out] data - record data
+*  @return true if record existed when snapshot opened, false otherwise or if snapshot expired
+*/
+bool RecordSnapshot::getRecordData(uint64_t recordID, std::vector<uint8_t>& data) {
+	if (recordID == 0 || recordID >= nextRecordID) return false;
+	return recordFile.readSnapshotData(recordID, timestamp, sequence, data);
+}
+
+
+
+/*
+*  @brief Reads next record of snapshot in record ID order
+*  @param[out] recordID - record ID
+*  @param[out] data - record data
+*  @return true if record read, false if there are no more records or snapshot expired
+*/
+bool RecordSnapshot::next(uint64_t& recordID, std::vector<uint8_t>& data) {
+	while (currentID + 1 < nextRecordID && isValid()) {
+		currentID++;
+		if (recordFile.readSnapshotData(currentID, timestamp, sequence, data)) {
+			recordID = currentID;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+/*
+*  @brief Restarts records traversal from the first record ID
+*/
+void RecordSnapshot::reset() {
+	currentID = 0;
+}
+
+
+
+/*
+*  @brief Checks if snapshot is still readable (not expired by versions limit)
+*  @return true if snapshot reads are valid, false if snapshot expired
+*/
+bool RecordSnapshot::isValid() {
+	return !recordFile.isSnapshotExpired(sequence);
+}
+
+
+
+/*
+*  @brief Returns timestamp of the last write visible to snapshot
+*  @return commit timestamp
+*/
+uint64_t RecordSnapshot::getTimestamp() {
+	return timestamp;
+}
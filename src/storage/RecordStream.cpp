@@ -0,0 +1,255 @@
+/******************************************************************************
+*
+*  RecordReader & RecordWriter classes implementation
+*
+*  RecordReader and RecordWriter are designed for streaming of large records
+*  (attachments, file downloads and uploads) without holding the whole record
+*  data in memory. RecordWriter creates chunked record: data is split into
+*  chunks of RECORD_CHUNK_SIZE, each chunk has its own checksum and the table
+*  of chunk checksums is stored before data:
+*
+*    [ header ][ chunk checksums table ][ chunk 0 ][ chunk 1 ] ... [ chunk N ]
+*
+*  Header data checksum covers the table, so range read verifies only the
+*  table and chunks overlapping the range. Data of OVERFLOW_THRESHOLD or more
+*  is written chunk by chunk to overflow pages instead. RecordReader reads
+*  record data sequentially by ranges.
+*
+*  Features:
+*    - streaming record write with constant memory (one chunk)
+*    - range read and in place range write with per chunk checksums
+*    - record is published only when all data is written
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "RecordFileIO.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief RecordReader constructor, reader starts from the first data byte
+*  @param[in] cursor - cursor of record to read
+*/
+RecordReader::RecordReader(std::shared_ptr<RecordCursor> cursor) : cursor(cursor) {
+	position = 0;
+	length = (cursor != nullptr) ? cursor->getDataLength() : 0;
+	failed = (cursor == nullptr);
+}
+
+
+/*
+*  @brief Reads next range of record data
+*  @param[out] data - pointer to the user buffer
+*  @param[in] length - maximum bytes to read
+*  @return bytes read, zero if all data read or data corrupted (see isFailed)
+*/
+uint32_t RecordReader::read(void* data, uint32_t length) {
+	if (failed || position >= this->length) return 0;
+	uint32_t bytesRead = cursor->readRange(position, data, length);
+	if (bytesRead == 0 && length > 0) failed = true;
+	position += bytesRead;
+	return bytesRead;
+}
+
+
+/*
+*  @brief Moves reader to given data position
+*  @param[in] position - data byte position
+*  @return true if position is within data length, false otherwise
+*/
+bool RecordReader::seek(uint32_t position) {
+	if (failed || position > length) return false;
+	this->position = position;
+	return true;
+}
+
+
+/*
+*  @brief Returns current data position of reader
+*  @return data byte position
+*/
+uint32_t RecordReader::getPosition() {
+	return position;
+}
+
+
+/*
+*  @brief Returns record data length
+*  @return data length in bytes
+*/
+uint32_t RecordReader::getLength() {
+	return length;
+}
+
+
+/*
+*  @brief Checks if reading failed (record deleted, moved or corrupt)
+*  @return true if failed, false otherwise
+*/
+bool RecordReader::isFailed() {
+	return failed;
+}
+
+
+
+/*
+*  @brief RecordWriter constructor, allocates hidden record for given data length
+*  @param[in] rf - records file
+*  @param[in] length - total data length to be written
+*/
+RecordWriter::RecordWriter(RecordFileIO& rf, uint32_t length) : recordFile(rf) {
+
+	this->length = length;
+	written = 0;
+	offset = NOT_FOUND;
+
+	// large data is written to overflow pages, record keeps only pages table
+	recordHeader.dataLength = length;
+	recordHeader.bitFlags = (length >= OVERFLOW_THRESHOLD) ? RECORD_OVERFLOW_FLAG : RECORD_CHUNKED_FLAG;
+
+	// data and chunk checksums table must fit into record capacity
+	uint64_t storedLength = RecordFileIO::getStoredLength(recordHeader);
+	if (length == 0 || storedLength > UINT32_MAX || recordFile.isReadOnly()) return;
+
+	uint64_t recordID = recordFile.reserveRecordID();
+	if (recordID == NOT_FOUND) return;
+
+	recordHeader.bitFlags |= recordID;
+	offset = recordFile.allocatePendingRecord((uint32_t)storedLength, recordHeader);
+
+	chunk.reserve(std::min(length, RECORD_CHUNK_SIZE));
+	chunkChecksums.reserve(RecordFileIO::getChunksCount(length));
+}
+
+
+/*
+*  @brief RecordWriter destructor, releases record space if not committed
+*/
+RecordWriter::~RecordWriter() {
+	abort();
+}
+
+
+/*
+*  @brief Checks if writer has allocated record and is not committed or aborted
+*  @return true if writer accepts data, false otherwise
+*/
+bool RecordWriter::isValid() {
+	return offset != NOT_FOUND;
+}
+
+
+/*
+*  @brief Appends data to the record
+*  @param[in] data - pointer to data
+*  @param[in] length - data length in bytes
+*  @return true if written, false if writer is not valid or data exceeds record length
+*/
+bool RecordWriter::write(const void* data, uint32_t length) {
+
+	if (offset == NOT_FOUND || data == nullptr) return false;
+	if ((uint64_t)written + length > this->length) return false;
+
+	const uint8_t* source = (const uint8_t*)data;
+
+	while (length > 0) {
+		uint32_t count = std::min<uint32_t>(length, RECORD_CHUNK_SIZE - (uint32_t)chunk.size());
+		chunk.insert(chunk.end(), source, source + count);
+		written += count;
+		source += count;
+		length -= count;
+		// flush complete chunk or the last one
+		if (chunk.size() == RECORD_CHUNK_SIZE || written == this->length) {
+			if (!flushChunk()) return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+*  @brief Writes buffered chunk to the record and keeps its checksum
+*  @return true if written, false otherwise
+*/
+bool RecordWriter::flushChunk() {
+
+	uint32_t chunkSize = (uint32_t)chunk.size();
+	uint64_t chunkOffset;
+
+	if (recordHeader.bitFlags & RECORD_OVERFLOW_FLAG) {
+		uint64_t page = recordFile.allocateOverflowPage();
+		if (page == NOT_FOUND) return false;
+		overflowPages.push_back(page);
+		chunkOffset = page + RECORD_HEADER_SIZE;
+	} else {
+		uint64_t tableSize = (uint64_t)RecordFileIO::getChunksCount(length) * sizeof(uint32_t);
+		chunkOffset = offset + RECORD_HEADER_SIZE + tableSize + (uint64_t)chunkChecksums.size() * RECORD_CHUNK_SIZE;
+	}
+
+	// record is hidden from other threads, so no record lock is needed
+	if (recordFile.cachedFile.write(chunkOffset, chunk.data(), chunkSize) != chunkSize) return false;
+	chunkChecksums.push_back(recordFile.checksum(chunk.data(), chunkSize));
+	chunk.clear();
+
+	return true;
+}
+
+
+/*
+*  @brief Writes chunks table and publishes record in records list
+*  @return cursor of the record or nullptr if not all data written or failed
+*/
+std::shared_ptr<RecordCursor> RecordWriter::commit() {
+
+	if (offset == NOT_FOUND || written != length) return nullptr;
+
+	// overflow pages positions precede chunk checksums in overflow record table
+	std::vector<uint8_t> table;
+	const uint8_t* pages = (const uint8_t*)overflowPages.data();
+	const uint8_t* checksums = (const uint8_t*)chunkChecksums.data();
+	table.insert(table.end(), pages, pages + overflowPages.size() * sizeof(uint64_t));
+	table.insert(table.end(), checksums, checksums + chunkChecksums.size() * sizeof(uint32_t));
+	uint32_t tableSize = (uint32_t)table.size();
+	if (recordFile.cachedFile.write(offset + RECORD_HEADER_SIZE, table.data(), tableSize) != tableSize) return nullptr;
+
+	recordHeader.dataLength = length;
+	recordHeader.dataChecksum = recordFile.checksum(table.data(), tableSize);
+	// record didn't exist for snapshots opened before it is published
+	auto version = recordFile.beginVersion(offset);
+	bool published = recordFile.publishRecord(offset, recordHeader);
+	recordFile.commitVersion(version, published);
+	if (!published) return nullptr;
+
+	std::shared_ptr<RecordCursor> cursor = std::make_shared<RecordCursor>(recordFile, recordHeader, offset);
+	overflowPages.clear();
+	offset = NOT_FOUND;
+
+	return cursor;
+}
+
+
+/*
+*  @brief Cancels writing and releases record space
+*/
+void RecordWriter::abort() {
+	if (offset == NOT_FOUND) return;
+	recordFile.freeOverflowPages(overflowPages);
+	recordFile.addRecordToFreeList(offset);
+	overflowPages.clear();
+	offset = NOT_FOUND;
+}
+
+
+/*
+*  @brief Returns number of data bytes written so far
+*  @return bytes written
+*/
+uint32_t RecordWriter::getWrittenBytes() {
+	return written;
+}
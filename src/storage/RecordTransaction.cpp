@@ -0,0 +1,190 @@
+/******************************************************************************
+*
+*  RecordTransaction class implementation
+*
+*  RecordTransaction is designed for changes that span several records and
+*  must be done all or nothing, for example to move data between records or
+*  to update record and records referring to it. Writes are buffered in the
+*  transaction and are not visible to others until commit. Commit checks
+*  that records transaction has read or written were not changed by others
+*  meanwhile and applies all writes at once, otherwise nothing is written
+*  and transaction can be retried.
+*
+*  Features:
+*    - atomic commit of record creations, updates and removals
+*    - optimistic concurrency control, no record locks held by transaction
+*    - reads see own buffered writes
+*    - commit journal completes interrupted commit on next open
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "RecordFileIO.h"
+
+using namespace Cloudless::Storage;
+
+
+/*
+*  @brief Begins transaction
+*  @param[in] rf - records file
+*/
+RecordTransaction::RecordTransaction(RecordFileIO& rf) : recordFile(rf) {
+	active = true;
+}
+
+
+
+/*
+*  @brief Aborts transaction if it has not been committed
+*/
+RecordTransaction::~RecordTransaction() {
+	abort();
+}
+
+
+
+/*
+*  @brief Creates record when transaction commits, record ID is reserved now
+*  @param[in] data - pointer to data
+*  @param[in] length - length of data in bytes
+*  @return record ID or NOT_FOUND if failed
+*/
+uint64_t RecordTransaction::createRecord(const void* data, uint32_t length) {
+	if (!active || recordFile.isReadOnly() || (data == nullptr && length > 0)) return NOT_FOUND;
+	uint64_t recordID = recordFile.reserveRecordID();
+	if (recordID == NOT_FOUND) return NOT_FOUND;
+	auto& write = writeSet[recordID];
+	write.operation = TransactionOperation::CREATE;
+	write.data.assign((const uint8_t*)data, (const uint8_t*)data + length);
+	return recordID;
+}
+
+
+
+/*
+*  @brief Reads record data including writes of this transaction
+*  @param[in] recordID - record ID
+*  @param[out] data - record data
+*  @return true if record exists, false otherwise
+*/
+bool RecordTransaction::getRecordData(uint64_t recordID, std::vector<uint8_t>& data) {
+	if (!active) return false;
+	auto it = writeSet.find(recordID);
+	if (it == writeSet.end()) return readRecord(recordID, &data);
+	if (it->second.operation == TransactionOperation::REMOVE) return false;
+	data = it->second.data;
+	return true;
+}
+
+
+
+/*
+*  @brief Replaces record data when transaction commits
+*  @param[in] recordID - record ID
+*  @param[in] data - pointer to new data
+*  @param[in] length - length of data in bytes
+*  @return true if write buffered, false if record doesn't exist
+*/
+bool RecordTransaction::setRecordData(uint64_t recordID, const void* data, uint32_t length) {
+	if (!active || data == nullptr || length == 0) return false;
+	auto it = writeSet.find(recordID);
+	if (it != writeSet.end()) {
+		// record created by this transaction stays created
+		if (it->second.operation == TransactionOperation::REMOVE) return false;
+		it->second.data.assign((const uint8_t*)data, (const uint8_t*)data + length);
+		return true;
+	}
+	if (!readRecord(recordID, nullptr)) return false;
+	auto& write = writeSet[recordID];
+	write.operation = TransactionOperation::UPDATE;
+	write.data.assign((const uint8_t*)data, (const uint8_t*)data + length);
+	return true;
+}
+
+
+
+/*
+*  @brief Removes record when transaction commits
+*  @param[in] recordID - record ID
+*  @return true if removal buffered, false if record doesn't exist
+*/
+bool RecordTransaction::removeRecord(uint64_t recordID) {
+	if (!active) return false;
+	auto it = writeSet.find(recordID);
+	if (it != writeSet.end()) {
+		if (it->second.operation == TransactionOperation::REMOVE) return false;
+		// record created by this transaction is just not created
+		if (it->second.operation == TransactionOperation::CREATE) writeSet.erase(it);
+		else {
+			it->second.operation = TransactionOperation::REMOVE;
+			it->second.data.clear();
+		}
+		return true;
+	}
+	if (!readRecord(recordID, nullptr)) return false;
+	writeSet[recordID].operation = TransactionOperation::REMOVE;
+	return true;
+}
+
+
+
+/*
+*  @brief Applies all writes of transaction at once and ends transaction
+*  @return true if committed (writes which failed are completed from journal
+*  by next commit or on open), false if records were changed by others
+*  meanwhile or journal write failed (nothing is written then)
+*/
+bool RecordTransaction::commit() {
+	if (!active) return false;
+	bool committed = recordFile.commitTransaction(readSet, writeSet);
+	abort();
+	return committed;
+}
+
+
+
+/*
+*  @brief Discards writes and ends transaction (reserved record IDs stay unused)
+*/
+void RecordTransaction::abort() {
+	readSet.clear();
+	writeSet.clear();
+	active = false;
+}
+
+
+
+/*
+*  @brief Checks if transaction is neither committed nor aborted
+*  @return true if transaction is active
+*/
+bool RecordTransaction::isActive() {
+	return active;
+}
+
+
+
+/*
+*  @brief Returns number of records written by transaction
+*  @return records count
+*/
+size_t RecordTransaction::getWritesCount() {
+	return writeSet.size();
+}
+
+
+
+/*
+*  @brief Reads current record and remembers its version to validate on commit
+*  @param[in] recordID - record ID
+*  @param[out] data - record data (nullptr if only version needed)
+*  @return true if record exists, false otherwise
+*/
+bool RecordTransaction::readRecord(uint64_t recordID, std::vector<uint8_t>* data) {
+	RecordHeader header;
+	if (!recordFile.readRecordVersion(recordID, header, data)) return false;
+	// the first version seen is the one transaction relies on
+	readSet.emplace(recordID, header);
+	return true;
+}
@@ -0,0 +1,782 @@
+/******************************************************************************
+*
+*  SlottedFileIO class implementation
+*
+*  Slotted file is a header page followed by slotted pages. Records data is
+*  packed after page header, slot directory grows backwards from page end:
+*
+*    page: [ header ] [ record ] [ record ] ... [ free ] ... [ slot 1 ] [ slot 0 ]
+*
+*  Removal and shrinking leave gaps between records, page is compacted when
+*  contiguous free space doesn't fit new data. Records don't move between
+*  pages, so (page, slot) address stays valid until record removal. Slot of
+*  removed record is reused by the next record inserted into its page.
+*  Every page change rewrites whole page with its checksum, page is verified
+*  on each read. Free bytes of pages are kept in memory (loaded on open) to
+*  pick page for insertion.
+*
+*  Record grown beyond free space of its page is moved to other page, and
+*  its slot keeps forwarding stub (address of moved data), so record address
+*  never changes. Stubs are changed and moved data is released only under
+*  exclusive forward lock, so readers following stub never see it dangling.
+*  Lock order: forward -> page -> space.
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "SlottedFileIO.h"
+
+#include <algorithm>
+
+using namespace Cloudless::Storage;
+
+
+/*
+* @brief SlottedFileIO constructor
+*/
+SlottedFileIO::SlottedFileIO() : slottedHeader{} {
+	// Checksum algorithm is set by file header on open
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+	insertHint = 1;
+	totalRecords.store(0);
+}
+
+
+
+/*
+* @brief SlottedFileIO destructor and finalizations
+*/
+SlottedFileIO::~SlottedFileIO() {
+	if (!cachedFile.isOpen()) return;
+	close();
+}
+
+
+
+/**
+* @brief Opens slotted file and loads free space of its pages
+* @return true if file successfuly opened, false otherwise
+*/
+bool SlottedFileIO::open(const char* path, bool isReadOnly, size_t cacheSize) {
+
+	std::unique_lock lock(storageMutex);
+
+	// Check if file is open
+	if (!cachedFile.open(path, isReadOnly, cacheSize)) {
+		const char* msg = "Can't operate on closed cached file.";
+		throw std::runtime_error(msg);
+	}
+
+	// If file is empty and write is permitted, then write initial header
+	if (cachedFile.getFileSize() == 0 && !cachedFile.isReadOnly()) {
+		createSlottedHeader();
+	}
+
+	if (!loadSlottedHeader()) {
+		const char* msg = "Slotted file header is invalid or corrupt.\n";
+		throw std::runtime_error(msg);
+	}
+
+	loadPages();
+
+	return true;
+}
+
+
+
+/**
+* @brief Closes slotted file persisting changed pages
+* @return true if file successfuly closed, false otherwise
+*/
+bool SlottedFileIO::close() {
+	std::unique_lock lock(storageMutex);
+	if (!cachedFile.isOpen()) return false;
+	pagesFreeBytes.clear();
+	totalRecords.store(0);
+	return cachedFile.close();
+}
+
+
+
+/**
+*  @brief Persists all changed cache pages to storage device
+*  @return true if all changed cache pages been persisted, false otherwise
+*/
+bool SlottedFileIO::flush() {
+	std::unique_lock lock(storageMutex);
+	return cachedFile.flush();
+}
+
+
+bool SlottedFileIO::isOpen() {
+	return cachedFile.isOpen();
+}
+
+
+bool SlottedFileIO::isReadOnly() {
+	return cachedFile.isReadOnly();
+}
+
+
+/*
+*  @brief Returns file size including pages not persisted yet
+*  @return file size in bytes
+*/
+uint64_t SlottedFileIO::getFileSize() {
+	std::lock_guard lock(spaceMutex);
+	return pagesFreeBytes.size() * PAGE_SIZE;
+}
+
+
+uint64_t SlottedFileIO::getTotalRecords() {
+	return totalRecords.load();
+}
+
+
+uint64_t SlottedFileIO::getTotalPages() {
+	std::lock_guard lock(spaceMutex);
+	return pagesFreeBytes.empty() ? 0 : pagesFreeBytes.size() - 1;
+}
+
+
+uint32_t SlottedFileIO::getMaxDataLength() {
+	return SLOTTED_MAX_DATA_LENGTH;
+}
+
+
+void SlottedFileIO::resetCacheStats() {
+	cachedFile.resetStats();
+}
+
+
+double SlottedFileIO::getCacheStats(CachedFileStats type) {
+	return cachedFile.getStats(type);
+}
+
+
+//-----------------------------------------------------------------------------
+// Records methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Creates new record in page with enough free space
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes (up to SLOTTED_MAX_DATA_LENGTH)
+* @return record address or NOT_FOUND if fails
+*/
+uint64_t SlottedFileIO::createRecord(const void* data, uint32_t length) {
+	if (cachedFile.isReadOnly() || length > SLOTTED_MAX_DATA_LENGTH) return NOT_FOUND;
+	if (data == nullptr && length > 0) return NOT_FOUND;
+	uint64_t address = insertRecord(data, length, 0, NOT_FOUND);
+	if (address != NOT_FOUND) totalRecords.fetch_add(1);
+	return address;
+}
+
+
+
+/*
+* @brief Reads record data following forwarding stub if record was moved
+* @param[in] address - record address
+* @param[out] data - record data
+* @return true if record read, false if it doesn't exist or page is corrupt
+*/
+bool SlottedFileIO::getRecordData(uint64_t address, std::vector<uint8_t>& data) {
+
+	std::shared_lock forwardLock(forwardMutex);
+	uint16_t flags;
+	if (!readSlot(address, data, flags) || (flags & SLOTTED_SLOT_MOVED)) return false;
+	if (flags & SLOTTED_SLOT_FORWARD) {
+		uint64_t target = *(const uint64_t*)data.data();
+		return readSlot(target, data, flags) && (flags & SLOTTED_SLOT_MOVED);
+	}
+	return true;
+}
+
+
+
+/*
+* @brief Rewrites record data in its page. If record doesn't fit its page
+* anymore, it's moved to other page and forwarding stub keeps its address.
+* @param[in] address - record address
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes
+* @return true if record updated, false if it doesn't exist or fails
+*/
+bool SlottedFileIO::setRecordData(uint64_t address, const void* data, uint32_t length) {
+
+	if (cachedFile.isReadOnly() || length > SLOTTED_MAX_DATA_LENGTH) return false;
+	if (data == nullptr && length > 0) return false;
+
+	// most updates fit record's own page
+	{
+		std::shared_lock forwardLock(forwardMutex);
+		uint64_t pageNo = address >> SLOTTED_SLOT_BITS;
+		alignas(8) uint8_t page[PAGE_SIZE];
+		std::unique_lock pageLock(getPageLock(pageNo));
+		SlottedSlot* slot = loadSlot(address, page);
+		if (slot == nullptr || (slot->length & SLOTTED_SLOT_MOVED)) return false;
+		if (!(slot->length & SLOTTED_SLOT_FORWARD)) {
+			if (rewriteInPage(page, slot, data, length, 0)) return storePage(pageNo, page);
+		}
+	}
+
+	return forwardRecord(address, data, length);
+}
+
+
+
+/*
+* @brief Removes record (and its moved data) and frees its slot
+* @param[in] address - record address
+* @return true if record removed, false if it doesn't exist
+*/
+bool SlottedFileIO::removeRecord(uint64_t address) {
+
+	if (cachedFile.isReadOnly()) return false;
+
+	uint64_t pageNo = address >> SLOTTED_SLOT_BITS;
+	alignas(8) uint8_t page[PAGE_SIZE];
+	{
+		std::shared_lock forwardLock(forwardMutex);
+		std::unique_lock pageLock(getPageLock(pageNo));
+		SlottedSlot* slot = loadSlot(address, page);
+		if (slot == nullptr || (slot->length & SLOTTED_SLOT_MOVED)) return false;
+		if (!(slot->length & SLOTTED_SLOT_FORWARD)) {
+			removeFromPage(page, slot);
+			if (!storePage(pageNo, page)) return false;
+			totalRecords.fetch_sub(1);
+			return true;
+		}
+	}
+
+	// stub and moved data are removed while no one follows the stub
+	std::unique_lock forwardLock(forwardMutex);
+	uint64_t target;
+	{
+		std::unique_lock pageLock(getPageLock(pageNo));
+		SlottedSlot* slot = loadSlot(address, page);
+		if (slot == nullptr || !(slot->length & SLOTTED_SLOT_FORWARD)) return false;
+		memcpy(&target, page + slot->offset, sizeof(target));
+		removeFromPage(page, slot);
+		if (!storePage(pageNo, page)) return false;
+	}
+	removeSlot(target);
+	totalRecords.fetch_sub(1);
+	return true;
+}
+
+
+
+/*
+* @brief Returns address of the first record
+* @return record address or NOT_FOUND if there are no records
+*/
+uint64_t SlottedFileIO::getFirstRecord() {
+	return findRecord(1, 0);
+}
+
+
+
+/*
+* @brief Returns address of the next record in address order
+* @param[in] address - current record address
+* @return next record address or NOT_FOUND if there are no more records
+*/
+uint64_t SlottedFileIO::getNextRecord(uint64_t address) {
+	uint64_t pageNo = address >> SLOTTED_SLOT_BITS;
+	uint32_t slotNo = (uint32_t)(address & SLOTTED_SLOT_MASK);
+	if (slotNo == SLOTTED_SLOT_MASK) return findRecord(pageNo + 1, 0);
+	return findRecord(pageNo, slotNo + 1);
+}
+
+
+
+/*
+* @brief Searches first used slot starting from given page and slot
+* @param[in] pageNo - page number to start from
+* @param[in] startSlot - slot number to start from in the first page
+* @return record address or NOT_FOUND if there are no more records
+*/
+uint64_t SlottedFileIO::findRecord(uint64_t pageNo, uint32_t startSlot) {
+
+	uint64_t pagesCount = getTotalPages() + 1;
+
+	alignas(8) uint8_t page[PAGE_SIZE];
+	for (pageNo = std::max<uint64_t>(pageNo, 1); pageNo < pagesCount; pageNo++, startSlot = 0) {
+		std::shared_lock pageLock(getPageLock(pageNo));
+		if (!readPage(pageNo, page)) continue;
+		SlottedPageHeader* header = (SlottedPageHeader*)page;
+		for (uint32_t i = startSlot; i < header->slotsCount; i++) {
+			SlottedSlot* slot = getSlot(page, i);
+			if (slot->offset != 0 && !(slot->length & SLOTTED_SLOT_MOVED)) return (pageNo << SLOTTED_SLOT_BITS) | i;
+		}
+	}
+	return NOT_FOUND;
+}
+
+
+//-----------------------------------------------------------------------------
+// Forwarding methods
+//-----------------------------------------------------------------------------
+
+
+/*
+* @brief Moves record data to other page and points record slot to it.
+* Previous moved data is updated in place if it fits, or released.
+* @param[in] address - record address
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes
+* @return true if record updated, false if it doesn't exist or fails
+*/
+bool SlottedFileIO::forwardRecord(uint64_t address, const void* data, uint32_t length) {
+
+	std::unique_lock forwardLock(forwardMutex);
+	uint64_t pageNo = address >> SLOTTED_SLOT_BITS;
+	uint64_t previous = NOT_FOUND;
+	alignas(8) uint8_t page[PAGE_SIZE];
+
+	// page could get free space meanwhile
+	{
+		std::unique_lock pageLock(getPageLock(pageNo));
+		SlottedSlot* slot = loadSlot(address, page);
+		if (slot == nullptr || (slot->length & SLOTTED_SLOT_MOVED)) return false;
+		if (slot->length & SLOTTED_SLOT_FORWARD) memcpy(&previous, page + slot->offset, sizeof(previous));
+		else if (rewriteInPage(page, slot, data, length, 0)) return storePage(pageNo, page);
+	}
+
+	// moved data is updated where it is
+	if (previous != NOT_FOUND) {
+		uint64_t targetPageNo = previous >> SLOTTED_SLOT_BITS;
+		std::unique_lock pageLock(getPageLock(targetPageNo));
+		SlottedSlot* slot = loadSlot(previous, page);
+		if (slot == nullptr) return false;
+		if (rewriteInPage(page, slot, data, length, SLOTTED_SLOT_MOVED)) return storePage(targetPageNo, page);
+	}
+
+	uint64_t target = insertRecord(data, length, SLOTTED_SLOT_MOVED, pageNo);
+	if (target == NOT_FOUND) return false;
+	{
+		std::unique_lock pageLock(getPageLock(pageNo));
+		SlottedSlot* slot = loadSlot(address, page);
+		bool stored = slot != nullptr && rewriteInPage(page, slot, &target, sizeof(target), SLOTTED_SLOT_FORWARD);
+		if (!stored || !storePage(pageNo, page)) {
+			pageLock.unlock();
+			removeSlot(target);
+			return false;
+		}
+	}
+	if (previous != NOT_FOUND) removeSlot(previous);
+	return true;
+}
+
+
+
+/*
+* @brief Inserts data into page with enough free space
+* @param[in] data - pointer to data
+* @param[in] length - length of data in bytes
+* @param[in] flags - slot flags
+* @param[in] excludedPage - page not to insert into (NOT_FOUND - any)
+* @return slot address or NOT_FOUND if fails
+*/
+uint64_t SlottedFileIO::insertRecord(const void* data, uint32_t length, uint16_t flags, uint64_t excludedPage) {
+
+	alignas(8) uint8_t page[PAGE_SIZE];
+	for (;;) {
+		uint64_t pageNo = pickPage(length, excludedPage);
+		if (pageNo == NOT_FOUND) return NOT_FOUND;
+
+		// other writer could take free space of page meanwhile
+		std::unique_lock pageLock(getPageLock(pageNo));
+		if (!readPage(pageNo, page)) {
+			setPageFreeBytes(pageNo, 0);
+			continue;
+		}
+		uint32_t slot = insertIntoPage(page, data, length, flags);
+		if (slot == NOT_FOUND) {
+			setPageFreeBytes(pageNo, ((SlottedPageHeader*)page)->freeBytes);
+			continue;
+		}
+		if (!storePage(pageNo, page)) return NOT_FOUND;
+		return (pageNo << SLOTTED_SLOT_BITS) | slot;
+	}
+}
+
+
+
+/*
+* @brief Reads slot data and flags
+* @param[in] address - slot address
+* @param[out] data - slot data
+* @param[out] flags - slot flags
+* @return true if slot is used, false otherwise
+*/
+bool SlottedFileIO::readSlot(uint64_t address, std::vector<uint8_t>& data, uint16_t& flags) {
+	alignas(8) uint8_t page[PAGE_SIZE];
+	std::shared_lock pageLock(getPageLock(address >> SLOTTED_SLOT_BITS));
+	SlottedSlot* slot = loadSlot(address, page);
+	if (slot == nullptr) return false;
+	uint16_t length = slot->length & SLOTTED_LENGTH_MASK;
+	flags = slot->length & ~SLOTTED_LENGTH_MASK;
+	data.assign(page + slot->offset, page + slot->offset + length);
+	return true;
+}
+
+
+
+/*
+* @brief Frees slot regardless of its flags
+* @param[in] address - slot address
+* @return true if slot freed, false otherwise
+*/
+bool SlottedFileIO::removeSlot(uint64_t address) {
+	uint64_t pageNo = address >> SLOTTED_SLOT_BITS;
+	alignas(8) uint8_t page[PAGE_SIZE];
+	std::unique_lock pageLock(getPageLock(pageNo));
+	SlottedSlot* slot = loadSlot(address, page);
+	if (slot == nullptr) return false;
+	removeFromPage(page, slot);
+	return storePage(pageNo, page);
+}
+
+
+//-----------------------------------------------------------------------------
+// Pages methods
+//-----------------------------------------------------------------------------
+
+
+std::shared_mutex& SlottedFileIO::getPageLock(uint64_t pageNo) {
+	return pageLocks[pageNo % SLOTTED_LOCK_STRIPES];
+}
+
+
+
+/*
+*  @brief Picks page with enough free space for new record and its slot.
+*  Page reserve is kept for updates, so new page is appended if none fits.
+*  @param[in] length - record data length
+*  @param[in] excludedPage - page not to pick (NOT_FOUND - any)
+*  @return page number or NOT_FOUND if file can't grow
+*/
+uint64_t SlottedFileIO::pickPage(uint32_t length, uint64_t excludedPage) {
+
+	std::lock_guard lock(spaceMutex);
+	uint64_t required = length + SLOTTED_SLOT_SIZE + SLOTTED_PAGE_RESERVE;
+	uint64_t pagesCount = pagesFreeBytes.size();
+
+	// last insertion page first, then first fit
+	if (insertHint < pagesCount && insertHint != excludedPage && pagesFreeBytes[insertHint] >= required) return insertHint;
+	for (uint64_t pageNo = 1; pageNo < pagesCount; pageNo++) {
+		if (pagesFreeBytes[pageNo] >= required && pageNo != excludedPage) return insertHint = pageNo;
+	}
+
+	// pages are addressed within 48 bits of address
+	if (pagesCount >= (1ULL << (64 - SLOTTED_SLOT_BITS))) return NOT_FOUND;
+
+	// new page is written before it's visible to other writers
+	alignas(8) uint8_t page[PAGE_SIZE];
+	initPage(page);
+	if (!writePage(pagesCount, page)) return NOT_FOUND;
+	pagesFreeBytes.push_back(((SlottedPageHeader*)page)->freeBytes);
+	return insertHint = pagesCount;
+}
+
+
+
+void SlottedFileIO::setPageFreeBytes(uint64_t pageNo, uint16_t freeBytes) {
+	std::lock_guard lock(spaceMutex);
+	pagesFreeBytes[pageNo] = freeBytes;
+}
+
+
+
+/*
+*  @brief Reads page of address and returns its used slot, page must be locked
+*  @param[in] address - slot address
+*  @param[out] page - page buffer of PAGE_SIZE bytes
+*  @return pointer to slot in page buffer or nullptr if slot isn't used
+*/
+SlottedSlot* SlottedFileIO::loadSlot(uint64_t address, uint8_t* page) {
+	uint64_t pageNo = address >> SLOTTED_SLOT_BITS;
+	uint32_t slotNo = (uint32_t)(address & SLOTTED_SLOT_MASK);
+	if (pageNo == 0 || pageNo >= getTotalPages() + 1 || !readPage(pageNo, page)) return nullptr;
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+	if (slotNo >= header->slotsCount) return nullptr;
+	SlottedSlot* slot = getSlot(page, slotNo);
+	return slot->offset == 0 ? nullptr : slot;
+}
+
+
+
+/*
+*  @brief Writes changed page and updates its free space
+*  @param[in] pageNo - page number
+*  @param[in] page - page buffer of PAGE_SIZE bytes
+*  @return true if page written, false otherwise
+*/
+bool SlottedFileIO::storePage(uint64_t pageNo, uint8_t* page) {
+	if (!writePage(pageNo, page)) return false;
+	setPageFreeBytes(pageNo, ((SlottedPageHeader*)page)->freeBytes);
+	return true;
+}
+
+
+
+/*
+*  @brief Reads page and checks its consistency
+*  @param[in] pageNo - page number
+*  @param[out] page - page buffer of PAGE_SIZE bytes
+*  @return true if page is consistent, false otherwise
+*/
+bool SlottedFileIO::readPage(uint64_t pageNo, uint8_t* page) {
+	if (cachedFile.read(pageNo * PAGE_SIZE, page, PAGE_SIZE) != PAGE_SIZE) return false;
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+	uint32_t checksum = checksumFunction(page + SLOTTED_CHECKSUM_SIZE, PAGE_SIZE - SLOTTED_CHECKSUM_SIZE);
+	return checksum == header->pageChecksum;
+}
+
+
+
+/*
+*  @brief Updates page checksum and writes page
+*  @param[in] pageNo - page number
+*  @param[in] page - page buffer of PAGE_SIZE bytes
+*  @return true if page written, false otherwise
+*/
+bool SlottedFileIO::writePage(uint64_t pageNo, uint8_t* page) {
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+	header->pageChecksum = checksumFunction(page + SLOTTED_CHECKSUM_SIZE, PAGE_SIZE - SLOTTED_CHECKSUM_SIZE);
+	return cachedFile.write(pageNo * PAGE_SIZE, page, PAGE_SIZE) == PAGE_SIZE;
+}
+
+
+
+void SlottedFileIO::initPage(uint8_t* page) {
+	memset(page, 0, PAGE_SIZE);
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+	header->dataEnd = (uint16_t)SLOTTED_PAGE_HEADER_SIZE;
+	header->freeBytes = (uint16_t)SLOTTED_PAGE_CAPACITY;
+}
+
+
+
+SlottedSlot* SlottedFileIO::getSlot(uint8_t* page, uint32_t slot) {
+	return (SlottedSlot*)(page + PAGE_SIZE - (slot + 1) * SLOTTED_SLOT_SIZE);
+}
+
+
+
+uint64_t SlottedFileIO::getContiguousFreeBytes(const uint8_t* page, uint16_t slotsCount) {
+	const SlottedPageHeader* header = (const SlottedPageHeader*)page;
+	uint64_t directoryStart = PAGE_SIZE - slotsCount * SLOTTED_SLOT_SIZE;
+	// new slot may take bytes up to data end, so there is no free space
+	if (header->dataEnd >= directoryStart) return 0;
+	return directoryStart - header->dataEnd;
+}
+
+
+
+/*
+*  @brief Moves records to the page start closing gaps between them
+*  @param[in] page - page buffer of PAGE_SIZE bytes
+*/
+void SlottedFileIO::compactPage(uint8_t* page) {
+
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+
+	// records keep their order, so moving down never overwrites next record
+	std::vector<SlottedSlot*> used;
+	used.reserve(header->recordsCount);
+	for (uint32_t i = 0; i < header->slotsCount; i++) {
+		SlottedSlot* slot = getSlot(page, i);
+		if (slot->offset != 0) used.push_back(slot);
+	}
+	std::sort(used.begin(), used.end(), [](SlottedSlot* a, SlottedSlot* b) { return a->offset < b->offset; });
+
+	uint16_t position = (uint16_t)SLOTTED_PAGE_HEADER_SIZE;
+	for (SlottedSlot* slot : used) {
+		uint16_t length = slot->length & SLOTTED_LENGTH_MASK;
+		if (slot->offset != position) memmove(page + position, page + slot->offset, length);
+		slot->offset = position;
+		position += length;
+	}
+	header->dataEnd = position;
+}
+
+
+
+/*
+*  @brief Inserts data into page reusing free slot if any
+*  @param[in] page - page buffer of PAGE_SIZE bytes
+*  @param[in] data - pointer to data
+*  @param[in] length - length of data in bytes
+*  @param[in] flags - slot flags
+*  @return slot number or NOT_FOUND if data doesn't fit the page
+*/
+uint32_t SlottedFileIO::insertIntoPage(uint8_t* page, const void* data, uint32_t length, uint16_t flags) {
+
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+
+	uint32_t slotNo = header->slotsCount;
+	for (uint32_t i = 0; i < header->slotsCount; i++) {
+		if (getSlot(page, i)->offset == 0) {
+			slotNo = i;
+			break;
+		}
+	}
+	bool newSlot = (slotNo == header->slotsCount);
+	if (newSlot && slotNo > SLOTTED_SLOT_MASK - 1) return (uint32_t)NOT_FOUND;
+
+	uint64_t required = length + (newSlot ? SLOTTED_SLOT_SIZE : 0);
+	if (required > header->freeBytes) return (uint32_t)NOT_FOUND;
+
+	uint16_t slotsCount = (uint16_t)(header->slotsCount + (newSlot ? 1 : 0));
+	// compact if data (even empty) would overlap slots directory with new slot
+	if (PAGE_SIZE - slotsCount * SLOTTED_SLOT_SIZE < header->dataEnd + length) compactPage(page);
+
+	SlottedSlot* slot = getSlot(page, slotNo);
+	slot->offset = header->dataEnd;
+	slot->length = (uint16_t)(length | flags);
+	if (length > 0) memcpy(page + slot->offset, data, length);
+
+	header->slotsCount = slotsCount;
+	header->recordsCount++;
+	if (flags & SLOTTED_SLOT_MOVED) header->movedCount++;
+	header->dataEnd += (uint16_t)length;
+	header->freeBytes -= (uint16_t)required;
+
+	return slotNo;
+}
+
+
+
+/*
+*  @brief Replaces slot data in page
+*  @param[in] page - page buffer of PAGE_SIZE bytes
+*  @param[in] slot - used slot in page buffer
+*  @param[in] data - pointer to data
+*  @param[in] length - length of data in bytes
+*  @param[in] flags - new slot flags
+*  @return true if data replaced, false if it doesn't fit the page
+*/
+bool SlottedFileIO::rewriteInPage(uint8_t* page, SlottedSlot* slot, const void* data, uint32_t length, uint16_t flags) {
+
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+	uint16_t oldLength = slot->length & SLOTTED_LENGTH_MASK;
+
+	if (length <= oldLength) {
+		// shrinking leaves gap after data
+		if (length > 0) memcpy(page + slot->offset, data, length);
+		header->freeBytes += (uint16_t)(oldLength - length);
+		slot->length = (uint16_t)(length | flags);
+		return true;
+	}
+
+	if (length - oldLength > header->freeBytes) return false;
+
+	// release old data, compact page if new data doesn't fit after last record
+	header->freeBytes += oldLength;
+	slot->offset = 0;
+	slot->length = 0;
+	if (PAGE_SIZE - header->slotsCount * SLOTTED_SLOT_SIZE < header->dataEnd + length) compactPage(page);
+	slot->offset = header->dataEnd;
+	slot->length = (uint16_t)(length | flags);
+	memcpy(page + slot->offset, data, length);
+	header->dataEnd += (uint16_t)length;
+	header->freeBytes -= (uint16_t)length;
+	return true;
+}
+
+
+
+/*
+*  @brief Frees slot in page, trailing free slots are dropped from directory
+*  @param[in] page - page buffer of PAGE_SIZE bytes
+*  @param[in] slot - used slot in page buffer
+*/
+void SlottedFileIO::removeFromPage(uint8_t* page, SlottedSlot* slot) {
+
+	SlottedPageHeader* header = (SlottedPageHeader*)page;
+
+	header->freeBytes += slot->length & SLOTTED_LENGTH_MASK;
+	header->recordsCount--;
+	if (slot->length & SLOTTED_SLOT_MOVED) header->movedCount--;
+	slot->offset = 0;
+	slot->length = 0;
+
+	while (header->slotsCount > 0 && getSlot(page, header->slotsCount - 1)->offset == 0) {
+		header->slotsCount--;
+		header->freeBytes += SLOTTED_SLOT_SIZE;
+	}
+	if (header->recordsCount == 0) initPage(page);
+}
+
+
+//-----------------------------------------------------------------------------
+// Header methods
+//-----------------------------------------------------------------------------
+
+
+void SlottedFileIO::createSlottedHeader() {
+	slottedHeader.signature = SLOTTED_SIGNATURE;
+	slottedHeader.version = SLOTTED_VERSION;
+	slottedHeader.checksumType = (uint32_t)ChecksumType::CRC32C;
+	checksumFunction = Checksum::getFunction(ChecksumType::CRC32C);
+	slottedHeader.headerChecksum = checksumFunction((const uint8_t*)&slottedHeader, SLOTTED_HEADER_PAYLOAD_SIZE);
+
+	// header occupies whole first page, so slotted pages are page aligned
+	alignas(8) uint8_t page[PAGE_SIZE] = {};
+	memcpy(page, &slottedHeader, SLOTTED_HEADER_SIZE);
+	cachedFile.write(0, page, PAGE_SIZE);
+}
+
+
+
+/*
+*  @brief Loads file header and checks its consistency
+*  @return true - if succeeded, false - if failed
+*/
+bool SlottedFileIO::loadSlottedHeader() {
+
+	SlottedHeader header;
+	if (cachedFile.read(0, &header, SLOTTED_HEADER_SIZE) != SLOTTED_HEADER_SIZE) return false;
+	if (header.signature != SLOTTED_SIGNATURE || header.version != SLOTTED_VERSION) return false;
+
+	ChecksumFunction fileChecksum = Checksum::getFunction((ChecksumType)header.checksumType);
+	if (fileChecksum == nullptr) return false;
+	if (fileChecksum((const uint8_t*)&header, SLOTTED_HEADER_PAYLOAD_SIZE) != header.headerChecksum) return false;
+
+	checksumFunction = fileChecksum;
+	slottedHeader = header;
+	return true;
+}
+
+
+
+/*
+*  @brief Loads free space and records count of all pages. Corrupt pages
+*  get no free space, so they are never written and their reads fail.
+*  @return true - if all pages consistent, false - otherwise
+*/
+bool SlottedFileIO::loadPages() {
+
+	uint64_t pagesCount = (cachedFile.getFileSize() + PAGE_SIZE - 1) / PAGE_SIZE;
+	pagesFreeBytes.assign(std::max<uint64_t>(pagesCount, 1), 0);
+	totalRecords.store(0);
+	insertHint = 1;
+
+	bool consistent = true;
+	alignas(8) uint8_t page[PAGE_SIZE];
+	for (uint64_t pageNo = 1; pageNo < pagesCount; pageNo++) {
+		if (!readPage(pageNo, page)) {
+			consistent = false;
+			continue;
+		}
+		SlottedPageHeader* header = (SlottedPageHeader*)page;
+		pagesFreeBytes[pageNo] = header->freeBytes;
+		totalRecords.fetch_add(header->recordsCount - header->movedCount);
+	}
+	return consistent;
+}
@@ -0,0 +1,167 @@
+/******************************************************************************
+*
+*  SlottedFileIO class header
+*
+*  SlottedFileIO is slotted-page store for small records (ratings, counters,
+*  short comments), where 40 bytes record header of RecordFileIO is a large
+*  overhead. Each page keeps records packed after page header and directory
+*  of 4 bytes slots at page end. Record is addressed by (page, slot) pair,
+*  and its page is verified by single checksum instead of per record ones.
+*
+*  Features:
+*    - create/read/update/delete small records by (page, slot) address
+*    - 4 bytes per record overhead, dense cache and file usage
+*    - in page updates, pages keep reserve for records growth
+*    - grown records move to other page keeping their address (forwarding)
+*    - navigate records in address order
+*    - data consistency check (one checksum per page)
+*    - thread safety (page level locks)
+*
+*  (C) Cloudless, Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include "CachedFileIO.h"
+#include "Checksum.h"
+
+#include <vector>
+#include <shared_mutex>
+
+
+namespace Cloudless {
+
+	namespace Storage {
+
+		//----------------------------------------------------------------------------
+		// Slotted file header signature and version
+		//----------------------------------------------------------------------------
+		constexpr uint32_t SLOTTED_SIGNATURE = 0x544F4C53;        // SLOT signature
+		constexpr uint32_t SLOTTED_VERSION = 0x00000001;          // Version 1
+
+		constexpr uint32_t SLOTTED_SLOT_BITS = 16;                // Address is (page << 16) | slot
+		constexpr uint64_t SLOTTED_SLOT_MASK = (1ULL << SLOTTED_SLOT_BITS) - 1;
+		constexpr uint32_t SLOTTED_MAX_DATA_LENGTH = PAGE_SIZE / 4; // Max small record length
+		constexpr uint32_t SLOTTED_PAGE_RESERVE = PAGE_SIZE / 10; // Free space kept for updates
+		constexpr uint32_t SLOTTED_LOCK_STRIPES = 64;             // Page locks count
+
+		constexpr uint16_t SLOTTED_SLOT_FORWARD = 0x8000;         // Slot keeps address of moved data
+		constexpr uint16_t SLOTTED_SLOT_MOVED = 0x4000;           // Slot keeps moved data of other slot
+		constexpr uint16_t SLOTTED_LENGTH_MASK = 0x0FFF;          // Data length bits of slot length
+
+		//----------------------------------------------------------------------------
+		// Slotted file header structure (16 bytes), occupies first page
+		//----------------------------------------------------------------------------
+		struct SlottedHeader {
+			uint32_t      signature;           // SLOT signature
+			uint32_t      version;             // Format version
+			uint32_t      checksumType;        // Checksum algorithm (ChecksumType)
+			uint32_t      headerChecksum;      // Checksum for header consistency check
+		};
+
+		constexpr uint64_t SLOTTED_HEADER_SIZE = sizeof(SlottedHeader);
+		constexpr uint64_t SLOTTED_HEADER_PAYLOAD_SIZE = SLOTTED_HEADER_SIZE - sizeof(SlottedHeader::headerChecksum);
+
+		//----------------------------------------------------------------------------
+		// Slotted page header structure (16 bytes), checksum covers rest of page
+		//----------------------------------------------------------------------------
+		struct SlottedPageHeader {
+			uint32_t      pageChecksum;        // Checksum of page data after this field
+			uint16_t      slotsCount;          // Slots in directory (used and free)
+			uint16_t      recordsCount;        // Used slots
+			uint16_t      dataEnd;             // End of records data area
+			uint16_t      freeBytes;           // Free bytes including gaps between records
+			uint16_t      movedCount;          // Used slots keeping moved data
+			uint16_t      reserved;            // Reserved (zero)
+		};
+
+		//----------------------------------------------------------------------------
+		// Slot of directory (4 bytes), slots grow from page end, free slot has zero offset
+		//----------------------------------------------------------------------------
+		struct SlottedSlot {
+			uint16_t      offset;              // Record data offset in page
+			uint16_t      length;              // Record data length and slot flags
+		};
+
+		constexpr uint64_t SLOTTED_PAGE_HEADER_SIZE = sizeof(SlottedPageHeader);
+		constexpr uint64_t SLOTTED_SLOT_SIZE = sizeof(SlottedSlot);
+		constexpr uint64_t SLOTTED_CHECKSUM_SIZE = sizeof(SlottedPageHeader::pageChecksum);
+		constexpr uint64_t SLOTTED_PAGE_CAPACITY = PAGE_SIZE - SLOTTED_PAGE_HEADER_SIZE;
+
+		//----------------------------------------------------------------------------
+		// SlottedFileIO
+		//----------------------------------------------------------------------------
+		class SlottedFileIO {
+		public:
+			SlottedFileIO();
+			SlottedFileIO(const SlottedFileIO&) = delete;
+			void operator=(const SlottedFileIO&) = delete;
+			~SlottedFileIO();
+
+			bool open(const char* path, bool isReadOnly = false, size_t cacheSize = DEFAULT_CACHE);
+			bool flush();
+			bool isOpen();
+			bool isReadOnly();
+			bool close();
+
+			uint64_t getFileSize();
+			uint64_t getTotalRecords();
+			uint64_t getTotalPages();
+			uint32_t getMaxDataLength();
+
+			uint64_t createRecord(const void* data, uint32_t length);
+			bool     getRecordData(uint64_t address, std::vector<uint8_t>& data);
+			bool     setRecordData(uint64_t address, const void* data, uint32_t length);
+			bool     removeRecord(uint64_t address);
+
+			uint64_t getFirstRecord();
+			uint64_t getNextRecord(uint64_t address);
+
+			void   resetCacheStats();
+			double getCacheStats(CachedFileStats type);
+
+		protected:
+
+			std::shared_mutex storageMutex;
+			std::shared_mutex pageLocks[SLOTTED_LOCK_STRIPES]; // Page locks by page number
+			std::mutex        spaceMutex;                 // Pages free space and file growth
+			std::shared_mutex forwardMutex;               // Forwarding stubs changes
+
+			CachedFileIO      cachedFile;
+			SlottedHeader     slottedHeader;
+			ChecksumFunction  checksumFunction;
+
+			std::vector<uint16_t> pagesFreeBytes;         // Free bytes by page number (0 - header page)
+			uint64_t              insertHint;             // Page of last insertion
+			std::atomic<uint64_t> totalRecords;
+
+			void     createSlottedHeader();
+			bool     loadSlottedHeader();
+			bool     loadPages();
+
+			bool     forwardRecord(uint64_t address, const void* data, uint32_t length);
+			uint64_t insertRecord(const void* data, uint32_t length, uint16_t flags, uint64_t excludedPage);
+			bool     readSlot(uint64_t address, std::vector<uint8_t>& data, uint16_t& flags);
+			bool     removeSlot(uint64_t address);
+			uint64_t findRecord(uint64_t pageNo, uint32_t startSlot);
+
+			std::shared_mutex& getPageLock(uint64_t pageNo);
+			uint64_t pickPage(uint32_t length, uint64_t excludedPage);
+			void     setPageFreeBytes(uint64_t pageNo, uint16_t freeBytes);
+			SlottedSlot* loadSlot(uint64_t address, uint8_t* page);
+			bool     storePage(uint64_t pageNo, uint8_t* page);
+			bool     readPage(uint64_t pageNo, uint8_t* page);
+			bool     writePage(uint64_t pageNo, uint8_t* page);
+
+			static void     initPage(uint8_t* page);
+			static void     compactPage(uint8_t* page);
+			static uint64_t getContiguousFreeBytes(const uint8_t* page, uint16_t slotsCount);
+			static uint32_t insertIntoPage(uint8_t* page, const void* data, uint32_t length, uint16_t flags);
+			static bool     rewriteInPage(uint8_t* page, SlottedSlot* slot, const void* data, uint32_t length, uint16_t flags);
+			static void     removeFromPage(uint8_t* page, SlottedSlot* slot);
+			static SlottedSlot* getSlot(uint8_t* page, uint32_t slot);
+		};
+
+	}
+
+}
@@ -4,6 +4,12 @@
 #include "RecordFileIO.h"
 #include "TestCachedFileIO.h"
 #include "TestRecordFileIO.h"
+#include "TestChecksum.h"
+#include "TestLogFileIO.h"
+#include "TestSlottedFileIO.h"
+#include "TestBPlusTree.h"
+#include "TestDocumentStore.h"
+#include "TestHashIndex.h"
 
 #include <ctime>
 #include <iomanip>
@@ -34,9 +40,21 @@ int main()
 	CloudlessTests ct;	
 	TestCachedFileIO cfiot;
 	TestRecordFileIO rfiot;
+	TestChecksum csumt;
+	TestLogFileIO lfiot;
+	TestSlottedFileIO sfiot;
+	TestBPlusTree bptt;
+	TestDocumentStore dst;
+	TestHashIndex hit;
 
 	//ct.addTestCase(&cfiot);
+	ct.addTestCase(&csumt);
 	ct.addTestCase(&rfiot);
+	ct.addTestCase(&lfiot);
+	ct.addTestCase(&sfiot);
+	ct.addTestCase(&bptt);
+	ct.addTestCase(&dst);
+	ct.addTestCase(&hit);
 
 	std::filesystem::current_path("F:/");
 
@@ -0,0 +1,980 @@
+/******************************************************************************
+*
+*  BPlusTree class tests implementation
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "TestBPlusTree.h"
+
+
+using namespace Cloudless;
+using namespace Cloudless::Storage;
+using namespace Cloudless::Tests;
+
+
+std::string TestBPlusTree::getName() const {
+	return "BPlusTree index consistency and performance";
+}
+
+
+void TestBPlusTree::init() {
+	fileName = "index.bin";
+	samplesCount = 100000;
+	benchmarkKeys = 1000000;
+	if (std::filesystem::exists(fileName)) std::filesystem::remove(fileName);
+	expected.clear();
+	finalResult = true;
+}
+
+
+void TestBPlusTree::execute() {
+	finalResult = consistency() && stringKeys() && hierarchicalKeys() && nodeSearch() && recordsIndex() && bulkLoading() && concurrency() && keyCache() && bloomFilter();
+	benchmark();
+	ycsbBenchmark();
+}
+
+
+bool TestBPlusTree::verify() const {
+	return finalResult;
+}
+
+
+void TestBPlusTree::cleanup() {
+	expected.clear();
+}
+
+
+//------------------------------------------------------------------------------------------------------------------
+
+
+bool TestBPlusTree::verifyKeys(BPlusTree& tree) {
+
+	if (tree.getTotalKeys() != expected.size() || !tree.checkIntegrity()) return false;
+
+	// point lookups of existing and removed keys
+	uint64_t value;
+	for (auto& [key, expectedValue] : expected) {
+		if (!tree.find(key, value) || value != expectedValue) return false;
+		if (expected.count(key + 1) == 0 && tree.find(key + 1, value)) return false;
+	}
+
+	// forward and backward scans in keys order
+	auto it = expected.begin();
+	auto cursor = tree.getFirst();
+	if (!expected.empty() && cursor == nullptr) return false;
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (cursor->getKeyAsUInt64() != it->first || cursor->getValue() != it->second) return false;
+		if (cursor->next() != (i + 1 < expected.size())) return false;
+		++it;
+	}
+	auto rit = expected.rbegin();
+	cursor = tree.getLast();
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (cursor->getKeyAsUInt64() != rit->first || cursor->getValue() != rit->second) return false;
+		if (cursor->previous() != (i + 1 < expected.size())) return false;
+		++rit;
+	}
+	return true;
+}
+
+
+
+bool TestBPlusTree::consistency() {
+
+	std::mt19937_64 random(2041);
+	bool result = true, ranges = true;
+	uint32_t maxHeight = 0;
+	{
+		BPlusTree tree;
+		tree.open(fileName);
+
+		// random inserts split nodes, duplicates are rejected
+		for (size_t i = 0; i < samplesCount; i++) {
+			uint64_t key = random() % (samplesCount * 10);
+			bool inserted = tree.insert(key, i);
+			if (inserted != (expected.count(key) == 0)) result = false;
+			if (inserted) expected[key] = i;
+		}
+		maxHeight = tree.getHeight();
+
+		// updates, then removals merging and borrowing nodes
+		for (auto& [key, value] : expected) {
+			if (random() % 3 != 0) continue;
+			value = value + samplesCount;
+			result = result && tree.update(key, value);
+		}
+		std::vector<uint64_t> removed;
+		for (auto& [key, value] : expected) {
+			if (random() % 4 != 0) removed.push_back(key);
+		}
+		for (uint64_t key : removed) {
+			result = result && tree.remove(key) && !tree.remove(key);
+			expected.erase(key);
+		}
+
+		// range scans from random keys
+		for (size_t i = 0; i < 1000 && ranges; i++) {
+			uint64_t from = random() % (samplesCount * 10);
+			auto it = expected.lower_bound(from);
+			auto cursor = tree.seek(from);
+			if ((it == expected.end()) != (cursor == nullptr)) ranges = false;
+			for (size_t j = 0; j < 50 && cursor != nullptr && it != expected.end(); j++) {
+				if (cursor->getKeyAsUInt64() != it->first) ranges = false;
+				++it;
+				if (cursor->next() != (it != expected.end())) ranges = false;
+			}
+		}
+
+		result = result && verifyKeys(tree);
+		tree.close();
+	}
+
+	// tree header and nodes are loaded on open, free pages are reused
+	BPlusTree reopened;
+	reopened.open(fileName);
+	bool loaded = verifyKeys(reopened);
+	uint64_t pages = reopened.getTotalPages();
+	for (uint64_t key = 0; key < samplesCount / 10; key++) {
+		if (expected.count(key) == 0 && reopened.insert(key, key)) expected[key] = key;
+	}
+	bool reused = reopened.getTotalPages() == pages && verifyKeys(reopened);
+	reopened.close();
+
+	result = result && ranges && loaded && reused;
+
+	std::stringstream ss;
+	ss << "Keys " << expected.size() << " of " << samplesCount << " inserted, height " << maxHeight;
+	ss << " (changes: " << result << ", ranges: " << ranges << ", loaded: " << loaded << ", pages reused: " << reused << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestBPlusTree::stringKeys() {
+
+	const char* stringsFile = "index_strings.bin";
+	if (std::filesystem::exists(stringsFile)) std::filesystem::remove(stringsFile);
+
+	std::mt19937 random(2042);
+	std::map<std::string, uint64_t> keys;
+	bool result = true;
+
+	BPlusTree tree;
+	tree.open(stringsFile);
+
+	// keys of various length (up to max length) make uneven nodes
+	for (size_t i = 0; i < samplesCount / 4; i++) {
+		std::string key = "article:" + std::to_string(random() % 1000000);
+		if (random() % 100 == 0) key += std::string(random() % BTREE_MAX_KEY_LENGTH, 'x');
+		if (key.size() > BTREE_MAX_KEY_LENGTH) key.resize(BTREE_MAX_KEY_LENGTH);
+		if (tree.insert(key.data(), (uint32_t)key.size(), i)) keys[key] = i;
+	}
+	std::string tooLong(BTREE_MAX_KEY_LENGTH + 1, 'x');
+	result = result && !tree.insert(tooLong.data(), (uint32_t)tooLong.size(), 0);
+	result = result && tree.insert("", 0, 0) && tree.remove("", 0);
+
+	std::vector<std::string> removed;
+	for (auto& [key, value] : keys) {
+		if (random() % 3 == 0) removed.push_back(key);
+	}
+	for (auto& key : removed) {
+		result = result && tree.remove(key.data(), (uint32_t)key.size());
+		keys.erase(key);
+	}
+	result = result && tree.checkIntegrity() && tree.getTotalKeys() == keys.size();
+
+	// prefix range scan
+	std::string prefix = "article:5";
+	auto it = keys.lower_bound(prefix);
+	auto cursor = tree.seek(prefix.data(), (uint32_t)prefix.size());
+	size_t scanned = 0;
+	while (cursor != nullptr && it != keys.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+		std::string key(cursor->getKey().begin(), cursor->getKey().end());
+		result = result && key == it->first && cursor->getValue() == it->second;
+		scanned++;
+		++it;
+		if (!cursor->next()) break;
+	}
+
+	uint64_t value;
+	for (auto& [key, expectedValue] : keys) {
+		if (!tree.find(key.data(), (uint32_t)key.size(), value) || value != expectedValue) result = false;
+	}
+	tree.close();
+
+	std::stringstream ss;
+	ss << "String keys " << keys.size() << " (prefix scan " << scanned << " keys)";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+
+bool TestBPlusTree::hierarchicalKeys() {
+
+	const char* pathsFile = "index_paths.bin";
+	const char* loadedFile = "index_paths_loaded.bin";
+	for (const char* file : { pathsFile, loadedFile }) {
+		if (std::filesystem::exists(file)) std::filesystem::remove(file);
+	}
+
+	// "category/subcategory/article-slug" keys share long prefixes
+	std::mt19937 random(2044);
+	std::map<std::string, uint64_t> keys;
+	size_t keyBytes = 0;
+	char buffer[128];
+	while (keys.size() < samplesCount) {
+		snprintf(buffer, sizeof(buffer), "category-%02u/subcategory-%02u/article-slug-%06u",
+			(uint32_t)(random() % 10), (uint32_t)(random() % 20), (uint32_t)(random() % 1000000));
+		if (keys.emplace(buffer, keys.size()).second) keyBytes += strlen(buffer);
+	}
+
+	bool result = true;
+	BPlusTree tree, loaded;
+	tree.open(pathsFile);
+	loaded.open(loadedFile);
+	{
+		BPlusTreeBuilder builder(loaded);
+		for (auto& [key, value] : keys) {
+			result = result && tree.insert(key.data(), (uint32_t)key.size(), value);
+			result = result && builder.add(key.data(), (uint32_t)key.size(), value);
+		}
+		result = result && builder.commit();
+	}
+
+	uint64_t value;
+	for (auto& [key, expectedValue] : keys) {
+		if (!tree.find(key.data(), (uint32_t)key.size(), value) || value != expectedValue) result = false;
+		if (!loaded.find(key.data(), (uint32_t)key.size(), value) || value != expectedValue) result = false;
+	}
+
+	// subcategory scan crosses leaves separated by truncated keys
+	std::string prefix = "category-05/subcategory-07/";
+	size_t scanned = 0, expectedScan = 0;
+	for (auto it = keys.lower_bound(prefix); it != keys.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) expectedScan++;
+	auto cursor = tree.seek(prefix.data(), (uint32_t)prefix.size());
+	while (cursor != nullptr && std::equal(prefix.begin(), prefix.end(), cursor->getKey().begin())) {
+		scanned++;
+		if (!cursor->next()) break;
+	}
+	result = result && scanned == expectedScan && tree.checkIntegrity() && loaded.checkIntegrity();
+
+	// keys per page against entries storing whole keys ([length][key][value] + offset)
+	double averageKey = (double)keyBytes / keys.size();
+	double wholeKeysPerNode = BTREE_NODE_CAPACITY * BTREE_BULK_FILL_FACTOR / (averageKey + 12);
+	double keysPerNode = (double)keys.size() / (loaded.getTotalPages() - 1);
+	result = result && keysPerNode > wholeKeysPerNode * 2;
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Hierarchical keys " << keys.size() << " of " << averageKey << " bytes, height " << tree.getHeight();
+	ss << " (loaded " << loaded.getHeight() << "), " << keysPerNode << " keys per node vs " << wholeKeysPerNode << " uncompressed";
+	tree.close();
+	loaded.close();
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+bool TestBPlusTree::nodeSearch() {
+
+	// vectorized heads search against scalar one and std::lower_bound, heads have
+	// runs of duplicates and cross sign bit
+	std::mt19937 random(2044);
+	std::vector<BTreeNodeSlot> slots(1024);
+	bool result = true;
+	for (uint32_t count = 0; count <= slots.size() && result; count += 7) {
+		uint32_t head = 0x7FFFFE00;
+		for (uint32_t i = 0; i < count; i++) slots[i].head = (head += random() % 3);
+		for (uint32_t probe = 0x7FFFFDFF; probe <= head + 1; probe++) {
+			uint32_t expectedIndex = (uint32_t)(std::lower_bound(slots.begin(), slots.begin() + count, probe,
+				[](const BTreeNodeSlot& slot, uint32_t value) { return slot.head < value; }) - slots.begin());
+			result = result && BTreeNode::searchHeads(slots.data(), count, probe) == expectedIndex;
+			result = result && BTreeNode::searchHeadsScalar(slots.data(), count, probe) == expectedIndex;
+		}
+	}
+
+	// full leaf of every second key, lookups of all keys (found and missing)
+	const size_t lookups = 1000000;
+	uint8_t page[PAGE_SIZE];
+	auto measure = [&](std::vector<std::string>& keys, uint32_t& count, double& nodeTime, double& stdTime) {
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		BTreeNode node(page);
+		node.init(BTREE_LEAF);
+		count = 0;
+		while (count * 2 < keys.size() && node.insertAt(count, (const uint8_t*)keys[count * 2].data(), (uint16_t)keys[count * 2].size(), count)) count++;
+		std::vector<std::string> queries(keys.begin(), keys.begin() + count * 2);
+		std::shuffle(queries.begin(), queries.end(), random);
+
+		// previous binary search: whole key comparison per step
+		std::vector<uint32_t> indices(count);
+		std::iota(indices.begin(), indices.end(), 0);
+		auto keyLess = [&node](uint32_t index, const std::string& key) {
+			return node.compareKey(index, (const uint8_t*)key.data(), (uint16_t)key.size()) < 0;
+		};
+		auto keyGreater = [&node](const std::string& key, uint32_t index) {
+			return node.compareKey(index, (const uint8_t*)key.data(), (uint16_t)key.size()) > 0;
+		};
+		bool matched = true;
+		for (const std::string& key : queries) {
+			const uint8_t* bytes = (const uint8_t*)key.data();
+			uint16_t length = (uint16_t)key.size();
+			matched = matched && node.lowerBound(bytes, length) == std::lower_bound(indices.begin(), indices.end(), key, keyLess) - indices.begin();
+			matched = matched && node.upperBound(bytes, length) == std::upper_bound(indices.begin(), indices.end(), key, keyGreater) - indices.begin();
+		}
+
+		uint64_t nodeSum = 0, stdSum = 0;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < lookups; i++) {
+			const std::string& key = queries[i % queries.size()];
+			nodeSum += node.lowerBound((const uint8_t*)key.data(), (uint16_t)key.size());
+		}
+		auto nodeEndTime = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < lookups; i++) {
+			const std::string& key = queries[i % queries.size()];
+			stdSum += std::lower_bound(indices.begin(), indices.end(), key, keyLess) - indices.begin();
+		}
+		auto stdEndTime = std::chrono::high_resolution_clock::now();
+		nodeTime = std::chrono::duration<double, std::nano>(nodeEndTime - startTime).count() / lookups;
+		stdTime = std::chrono::duration<double, std::nano>(stdEndTime - nodeEndTime).count() / lookups;
+		return matched && count > 0 && nodeSum == stdSum;
+	};
+
+	// integer keys have unique heads, hierarchical keys have runs of equal heads
+	std::vector<std::string> integerKeys, pathKeys;
+	uint8_t encoded[sizeof(uint64_t)];
+	char buffer[128];
+	for (size_t i = 0; i < 4096; i++) {
+		BPlusTree::encodeKey(random() % 1000000, encoded);
+		integerKeys.emplace_back((const char*)encoded, sizeof(encoded));
+		snprintf(buffer, sizeof(buffer), "category-%02u/subcategory-%02u/article-slug-%06u",
+			(uint32_t)(random() % 10), (uint32_t)(random() % 20), (uint32_t)(random() % 1000000));
+		pathKeys.emplace_back(buffer);
+	}
+	uint32_t integerCount, pathCount;
+	double integerTime, integerStdTime, pathTime, pathStdTime;
+	result = result && measure(integerKeys, integerCount, integerTime, integerStdTime);
+	result = result && measure(pathKeys, pathCount, pathTime, pathStdTime);
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Node search (" << BTreeNode::getSearchImplementation() << ") vs std::lower_bound: ";
+	ss << integerCount << " integer keys " << integerTime << " vs " << integerStdTime << " ns (x" << integerStdTime / integerTime << "), ";
+	ss << pathCount << " path keys " << pathTime << " vs " << pathStdTime << " ns (x" << pathStdTime / pathTime << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+bool TestBPlusTree::recordsIndex() {
+
+	const char* recordsFile = "index_records.bin";
+	const char* indexFile = "index_articles.bin";
+	for (auto name : { recordsFile, indexFile }) {
+		if (std::filesystem::exists(name)) std::filesystem::remove(name);
+	}
+
+	std::mt19937 random(2043);
+	RecordFileIO records;
+	BPlusTree index;
+	records.open(recordsFile);
+	index.open(indexFile);
+
+	// documents keyed by article ID, index maps key to record position
+	std::map<uint64_t, std::string> articles;
+	for (size_t i = 0; i < samplesCount / 10; i++) {
+		uint64_t articleID = random() % 10000000;
+		if (articles.count(articleID) != 0) continue;
+		std::string document = "{\"id\":" + std::to_string(articleID) + ",\"title\":\"Article " + std::to_string(i) + "\"}";
+		auto cursor = records.createRecord(document.data(), (uint32_t)document.size());
+		if (cursor == nullptr || !index.insert(articleID, cursor->getPosition())) return false;
+		articles[articleID] = document;
+	}
+
+	// documents in key range are fetched by record positions
+	bool result = true;
+	size_t fetched = 0;
+	std::vector<char> buffer;
+	auto it = articles.lower_bound(5000000);
+	for (auto cursor = index.seek(5000000); cursor != nullptr && fetched < 1000; fetched++, ++it) {
+		auto record = records.getRecord(cursor->getValue());
+		if (record == nullptr || it == articles.end() || cursor->getKeyAsUInt64() != it->first) { result = false; break; }
+		buffer.resize(record->getDataLength());
+		record->getRecordData(buffer.data());
+		result = result && std::string(buffer.begin(), buffer.end()) == it->second;
+		if (!cursor->next()) break;
+	}
+
+	index.close();
+	records.close();
+
+	std::stringstream ss;
+	ss << "Documents " << articles.size() << " indexed by article ID, " << fetched << " fetched by key range";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestBPlusTree::bulkLoading() {
+
+	const char* loadedFile = "index_loaded.bin";
+	std::mt19937_64 random(2045);
+	bool result = true, rejected = true;
+	uint32_t height = 0;
+
+	// sizes around single leaf and levels boundaries, various fill factors
+	for (size_t count : { (size_t)0, (size_t)1, (size_t)400, (size_t)450, samplesCount }) {
+		for (double fillFactor : { 0.5, 0.9, 1.0 }) {
+
+			if (std::filesystem::exists(loadedFile)) std::filesystem::remove(loadedFile);
+			expected.clear();
+			BPlusTree tree;
+			tree.open(loadedFile);
+			{
+				BPlusTreeBuilder builder(tree, fillFactor);
+				uint64_t key = 0;
+				for (size_t i = 0; i < count; i++) {
+					key += 1 + random() % 16;
+					result = result && builder.add(key, i);
+					expected[key] = i;
+				}
+				// keys out of order are rejected
+				if (count > 0) rejected = rejected && !builder.add(key, 0) && !builder.add(key - 1, 0);
+				result = result && builder.commit() && !builder.isValid();
+			}
+			height = std::max(height, tree.getHeight());
+			result = result && verifyKeys(tree);
+
+			// loaded tree takes usual changes
+			for (size_t i = 0; i < count / 2; i++) {
+				uint64_t key = random() % (count * 16 + 1);
+				if (expected.count(key) == 0) {
+					result = result && tree.insert(key, key);
+					expected[key] = key;
+				} else {
+					result = result && tree.remove(key);
+					expected.erase(key);
+				}
+			}
+			result = result && verifyKeys(tree);
+
+			// builder accepts only empty tree
+			if (!expected.empty()) {
+				BPlusTreeBuilder builder(tree);
+				rejected = rejected && !builder.isValid() && !builder.add(UINT64_MAX, 0);
+			}
+			tree.close();
+		}
+	}
+
+	// aborted load leaves tree empty and its pages reusable
+	if (std::filesystem::exists(loadedFile)) std::filesystem::remove(loadedFile);
+	BPlusTree tree;
+	tree.open(loadedFile);
+	{
+		BPlusTreeBuilder builder(tree);
+		for (uint64_t key = 0; key < samplesCount; key++) builder.add(key, key);
+	}
+	uint64_t pages = tree.getTotalPages();
+	{
+		BPlusTreeBuilder builder(tree);
+		for (uint64_t key = 0; key < samplesCount; key++) builder.add(key, key);
+		result = result && builder.commit();
+	}
+	bool aborted = tree.getTotalPages() == pages && tree.getTotalKeys() == samplesCount && tree.checkIntegrity();
+	tree.close();
+
+	result = result && rejected && aborted;
+
+	std::stringstream ss;
+	ss << "Bulk loading up to " << samplesCount << " keys, height " << height;
+	ss << " (loaded: " << result << ", wrong order rejected: " << rejected << ", aborted load reused: " << aborted << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestBPlusTree::concurrency() {
+
+	const char* concurrentFile = "index_concurrent.bin";
+	if (std::filesystem::exists(concurrentFile)) std::filesystem::remove(concurrentFile);
+
+	// small cache, so nodes are evicted while threads use them
+	BPlusTree tree;
+	tree.open(concurrentFile, false, DEFAULT_CACHE);
+
+	// writers own keys by remainder, so each writer knows expected results
+	size_t writersCount = std::max(4u, std::thread::hardware_concurrency());
+	uint64_t keysRange = samplesCount * 2;
+	std::vector<std::map<uint64_t, uint64_t>> written(writersCount);
+	std::atomic<bool> writersResult = true, readersResult = true, stop = false;
+	std::atomic<uint64_t> scans = 0;
+
+	auto writer = [&](size_t writerNo) {
+		std::mt19937_64 random(writerNo + 1);
+		std::map<uint64_t, uint64_t>& keys = written[writerNo];
+		for (size_t i = 0; i < samplesCount / 2; i++) {
+			uint64_t key = (random() % (keysRange / writersCount)) * writersCount + writerNo;
+			uint64_t value = (key << 20) | (i & 0xFFFFF);
+			uint64_t operation = random() % 10;
+			bool exists = keys.count(key) != 0;
+			if (operation < 6) {
+				// 60% inserts, 20% updates, 20% removes
+				bool inserted = tree.insert(key, value);
+				if (inserted == exists) writersResult = false;
+				if (inserted) keys[key] = value;
+			} else if (operation < 8) {
+				bool updated = tree.update(key, value);
+				if (updated != exists) writersResult = false;
+				if (updated) keys[key] = value;
+			} else {
+				if (tree.remove(key) != exists) writersResult = false;
+				keys.erase(key);
+			}
+		}
+	};
+
+	// readers see keys in order and values of their keys
+	auto reader = [&](bool forward) {
+		std::mt19937_64 random(forward ? 2043 : 2046);
+		while (!stop) {
+			auto cursor = forward ? tree.getFirst() : tree.getLast();
+			uint64_t previous = 0;
+			for (bool first = true; cursor != nullptr; first = false) {
+				uint64_t key = cursor->getKeyAsUInt64();
+				if (!first && (forward ? key <= previous : key >= previous)) readersResult = false;
+				if ((cursor->getValue() >> 20) != key) readersResult = false;
+				previous = key;
+				if (!(forward ? cursor->next() : cursor->previous())) break;
+			}
+			for (size_t i = 0; i < 1000; i++) {
+				uint64_t key = random() % keysRange, value;
+				if (tree.find(key, value) && (value >> 20) != key) readersResult = false;
+			}
+			scans++;
+		}
+	};
+
+	std::vector<std::thread> writers, readers;
+	readers.emplace_back(reader, true);
+	readers.emplace_back(reader, false);
+	for (size_t i = 0; i < writersCount; i++) writers.emplace_back(writer, i);
+	for (auto& thread : writers) thread.join();
+	stop = true;
+	for (auto& thread : readers) thread.join();
+
+	expected.clear();
+	for (auto& keys : written) expected.insert(keys.begin(), keys.end());
+	bool consistent = verifyKeys(tree);
+	uint32_t height = tree.getHeight();
+	tree.close();
+
+	bool result = writersResult && readersResult && consistent;
+
+	std::stringstream ss;
+	ss << "Concurrency " << writersCount << " writers, 2 readers (" << scans << " scans), " << expected.size();
+	ss << " keys, height " << height << " (writes: " << writersResult << ", reads: " << readersResult;
+	ss << ", consistent: " << consistent << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+void TestBPlusTree::benchmark() {
+
+	const char* benchmarkFile = "index_benchmark.bin";
+	if (std::filesystem::exists(benchmarkFile)) std::filesystem::remove(benchmarkFile);
+
+	// random keys order, lookups in other random order
+	std::vector<uint64_t> keys(benchmarkKeys);
+	std::mt19937_64 random(2044);
+	for (size_t i = 0; i < benchmarkKeys; i++) keys[i] = i * 2;
+	std::shuffle(keys.begin(), keys.end(), random);
+
+	BPlusTree tree;
+	tree.open(benchmarkFile, false, DEFAULT_CACHE * 4);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < benchmarkKeys; i++) tree.insert(keys[i], i);
+	tree.flush();
+	auto insertTime = std::chrono::high_resolution_clock::now();
+
+	std::shuffle(keys.begin(), keys.end(), random);
+	tree.resetCacheStats();
+	uint64_t value, found = 0;
+	for (size_t i = 0; i < benchmarkKeys; i++) found += tree.find(keys[i], value);
+	double lookupReads = tree.getCacheStats(CachedFileStats::TOTAL_REQUESTS) / double(benchmarkKeys);
+	auto findTime = std::chrono::high_resolution_clock::now();
+
+	uint64_t scanned = 0;
+	for (auto cursor = tree.getFirst(); cursor != nullptr; ) {
+		scanned++;
+		if (!cursor->next()) break;
+	}
+	auto scanTime = std::chrono::high_resolution_clock::now();
+
+	uint32_t height = tree.getHeight();
+	uint64_t fileSize = tree.getFileSize();
+	tree.close();
+
+	// same keys sorted are bulk loaded to new tree
+	const char* loadedFile = "index_benchmark_loaded.bin";
+	if (std::filesystem::exists(loadedFile)) std::filesystem::remove(loadedFile);
+	std::sort(keys.begin(), keys.end());
+	BPlusTree loaded;
+	loaded.open(loadedFile, false, DEFAULT_CACHE * 4);
+	auto loadStartTime = std::chrono::high_resolution_clock::now();
+	BPlusTreeBuilder builder(loaded);
+	for (size_t i = 0; i < benchmarkKeys; i++) builder.add(keys[i], i);
+	bool built = builder.commit() && loaded.flush();
+	auto loadTime = std::chrono::high_resolution_clock::now();
+	uint64_t loadedSize = loaded.getFileSize();
+	built = built && loaded.getTotalKeys() == benchmarkKeys;
+	loaded.close();
+
+	double insertSeconds = std::chrono::duration<double>(insertTime - startTime).count();
+	double findSeconds = std::chrono::duration<double>(findTime - insertTime).count();
+	double scanSeconds = std::chrono::duration<double>(scanTime - findTime).count();
+	double loadSeconds = std::chrono::duration<double>(loadTime - loadStartTime).count();
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Keys " << benchmarkKeys << ", height " << height << ", file " << fileSize / 1024 / 1024 << "Mb: ";
+	ss << "insert " << benchmarkKeys / insertSeconds / 1000 << "K/s, find " << benchmarkKeys / findSeconds / 1000;
+	ss << "K/s (" << lookupReads << " page reads), scan " << scanned / scanSeconds / 1000000 << "M/s";
+	printResult(ss.str().c_str(), found == benchmarkKeys && scanned == benchmarkKeys);
+
+	std::stringstream bs;
+	bs.precision(3);
+	bs << "Bulk loading " << benchmarkKeys / loadSeconds / 1000000 << "M/s (x" << insertSeconds / loadSeconds;
+	bs << " faster than inserts), file " << loadedSize / 1024 / 1024 << "Mb (x" << double(fileSize) / double(loadedSize) << " smaller)";
+	printResult(bs.str().c_str(), built);
+}
+
+
+
+//------------------------------------------------------------------------------------------------------------------
+// YCSB scrambled Zipfian keys: popular keys are spread over keys range
+//------------------------------------------------------------------------------------------------------------------
+class ZipfianGenerator {
+public:
+	ZipfianGenerator(uint64_t items, double theta = 0.99) : items(items), theta(theta) {
+		double zeta2 = zeta(2);
+		zetaN = zeta(items);
+		alpha = 1.0 / (1.0 - theta);
+		eta = (1.0 - std::pow(2.0 / double(items), 1.0 - theta)) / (1.0 - zeta2 / zetaN);
+	}
+
+	uint64_t next(std::mt19937_64& random) {
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+		double uz = u * zetaN;
+		uint64_t rank;
+		if (uz < 1.0) rank = 0;
+		else if (uz < 1.0 + std::pow(0.5, theta)) rank = 1;
+		else rank = std::min(items - 1, (uint64_t)(double(items) * std::pow(eta * u - eta + 1.0, alpha)));
+		return (rank * 0x9E3779B97F4A7C15ULL) % items;
+	}
+
+private:
+	double zeta(uint64_t count) {
+		double sum = 0;
+		for (uint64_t i = 1; i <= count; i++) sum += 1.0 / std::pow(double(i), theta);
+		return sum;
+	}
+
+	uint64_t items;
+	double theta, zetaN, alpha, eta;
+};
+
+
+
+void TestBPlusTree::ycsbBenchmark() {
+
+	const char* ycsbFile = "index_ycsb.bin";
+	if (std::filesystem::exists(ycsbFile)) std::filesystem::remove(ycsbFile);
+
+	// records are bulk loaded, cache keeps whole tree (in-memory workload)
+	BPlusTree tree;
+	tree.open(ycsbFile, false, DEFAULT_CACHE * 64);
+	{
+		BPlusTreeBuilder builder(tree);
+		for (uint64_t i = 0; i < benchmarkKeys; i++) builder.add(i * 2, i);
+		builder.commit();
+	}
+
+	struct Workload {
+		const char* name;
+		uint32_t readPercent;     // reads (scans in E), others are updates (inserts in E)
+		bool scans;
+	};
+	const Workload workloads[] = {
+		{ "A (50% read, 50% update)", 50, false },
+		{ "B (95% read, 5% update)", 95, false },
+		{ "C (100% read)", 100, false },
+		{ "E (95% scan, 5% insert)", 95, true }
+	};
+
+	ZipfianGenerator zipfian(benchmarkKeys);
+	std::atomic<uint64_t> insertedKeys = 0;
+	std::atomic<bool> result = true;
+	size_t operations = benchmarkKeys / 4;
+	size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	auto worker = [&](const Workload& workload, size_t threadNo, size_t threadOperations) {
+		std::mt19937_64 random(threadNo + 2043);
+		uint64_t value;
+		for (size_t i = 0; i < threadOperations; i++) {
+			uint64_t key = zipfian.next(random) * 2;
+			bool isRead = random() % 100 < workload.readPercent;
+			if (workload.scans && isRead) {
+				// short range scan from popular key
+				size_t length = 1 + random() % 100;
+				auto cursor = tree.seek(key);
+				for (size_t j = 1; cursor != nullptr && j < length; j++) {
+					if (!cursor->next()) break;
+				}
+			} else if (workload.scans) {
+				uint64_t newKey = (benchmarkKeys + insertedKeys.fetch_add(1)) * 2;
+				if (!tree.insert(newKey, i)) result = false;
+			} else if (isRead) {
+				if (!tree.find(key, value)) result = false;
+			} else if (!tree.update(key, i)) result = false;
+		}
+	};
+
+	for (const Workload& workload : workloads) {
+		std::stringstream ss;
+		ss.precision(3);
+		ss << "YCSB " << workload.name << " Kops/s:";
+		double singleThread = 0;
+		for (size_t threadsCount = 1; ; threadsCount = std::min(threadsCount * 2, maxThreads)) {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			{
+				std::vector<std::thread> threads;
+				for (size_t i = 0; i < threadsCount; i++) threads.emplace_back(worker, std::cref(workload), i, operations / threadsCount);
+				for (auto& thread : threads) thread.join();
+			}
+			auto endTime = std::chrono::high_resolution_clock::now();
+			double seconds = std::chrono::duration<double>(endTime - startTime).count();
+			double throughput = double(operations / threadsCount * threadsCount) / seconds;
+			if (threadsCount == 1) singleThread = throughput;
+			ss << " " << threadsCount << (threadsCount == 1 ? " thread " : " threads ") << throughput / 1000;
+			if (threadsCount > 1) ss << " (x" << throughput / singleThread << ")";
+			if (threadsCount == maxThreads) break;
+			ss << ",";
+		}
+		printResult(ss.str().c_str(), result);
+	}
+
+	bool consistent = tree.checkIntegrity() && tree.getTotalKeys() == benchmarkKeys + insertedKeys;
+	tree.close();
+	std::stringstream ss;
+	ss << "YCSB " << benchmarkKeys << " records, " << operations << " operations per run (tree consistent: " << consistent << ")";
+	printResult(ss.str().c_str(), consistent && result);
+}
+
+
+
+bool TestBPlusTree::keyCache() {
+
+	const char* cacheFile = "index_keycache.bin";
+	if (std::filesystem::exists(cacheFile)) std::filesystem::remove(cacheFile);
+
+	// values keep their keys, so readers check values of any key
+	BPlusTree tree;
+	tree.open(cacheFile, false, DEFAULT_CACHE * 64);
+	{
+		BPlusTreeBuilder builder(tree);
+		for (uint64_t i = 0; i < benchmarkKeys; i++) builder.add(i * 2, (i * 2) << 20);
+		builder.commit();
+	}
+
+	// popular keys lookups latency: tree descent vs key cache
+	const size_t cachedKeys = 65536;
+	ZipfianGenerator zipfian(benchmarkKeys);
+	std::mt19937_64 random(2048);
+	std::vector<uint64_t> lookups(samplesCount);
+	for (auto& key : lookups) key = zipfian.next(random) * 2;
+
+	auto medianLatency = [&](bool& found) {
+		std::vector<double> latencies(lookups.size());
+		uint64_t value;
+		for (size_t i = 0; i < lookups.size(); i++) {
+			auto startTime = std::chrono::high_resolution_clock::now();
+			bool isFound = tree.find(lookups[i], value);
+			auto endTime = std::chrono::high_resolution_clock::now();
+			if (!isFound || (value >> 20) != lookups[i]) found = false;
+			latencies[i] = std::chrono::duration<double, std::nano>(endTime - startTime).count();
+		}
+		std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2, latencies.end());
+		return latencies[latencies.size() / 2];
+	};
+
+	bool found = true;
+	double treeLatency = medianLatency(found);
+	tree.setKeyCache(cachedKeys);
+	medianLatency(found);
+	double cachedLatency = medianLatency(found);
+	bool bounded = tree.getKeyCacheSize() <= cachedKeys + BTREE_KEY_CACHE_SHARDS;
+
+	// writers change popular keys they own and read them back through cache
+	size_t writersCount = std::max(4u, std::thread::hardware_concurrency());
+	std::vector<std::map<uint64_t, uint64_t>> written(writersCount);
+	std::atomic<bool> writersResult = true, readersResult = true, stop = false;
+
+	auto writer = [&](size_t writerNo) {
+		std::mt19937_64 writerRandom(writerNo + 2048);
+		std::map<uint64_t, uint64_t>& keys = written[writerNo];
+		uint64_t value;
+		for (size_t i = 0; i < samplesCount / 2; i++) {
+			uint64_t key = lookups[writerRandom() % lookups.size()];
+			if ((key / 2) % writersCount != writerNo) continue;
+			bool exists = keys.count(key) == 0 || keys[key] != NOT_FOUND;
+			uint64_t newValue = (key << 20) | (i & 0xFFFFF);
+			if (writerRandom() % 10 == 0) {
+				// removed key is inserted back later
+				bool changed = exists ? tree.remove(key) : tree.insert(key, newValue);
+				if (!changed) writersResult = false;
+				keys[key] = exists ? NOT_FOUND : newValue;
+			} else if (exists) {
+				if (!tree.update(key, newValue)) writersResult = false;
+				keys[key] = newValue;
+			}
+			bool isFound = tree.find(key, value);
+			if (isFound != (keys[key] != NOT_FOUND) || (isFound && value != keys[key])) writersResult = false;
+		}
+	};
+
+	auto reader = [&](size_t readerNo) {
+		std::mt19937_64 readerRandom(readerNo + 2049);
+		uint64_t value;
+		while (!stop) {
+			uint64_t key = lookups[readerRandom() % lookups.size()];
+			if (tree.find(key, value) && (value >> 20) != key) readersResult = false;
+		}
+	};
+
+	std::vector<std::thread> writers, readers;
+	for (size_t i = 0; i < 2; i++) readers.emplace_back(reader, i);
+	for (size_t i = 0; i < writersCount; i++) writers.emplace_back(writer, i);
+	for (auto& thread : writers) thread.join();
+	stop = true;
+	for (auto& thread : readers) thread.join();
+
+	// cached values and tree values are the last written
+	bool coherent = true;
+	for (size_t pass = 0; pass < 2; pass++) {
+		for (auto& keys : written) {
+			for (auto& [key, expectedValue] : keys) {
+				uint64_t value;
+				bool isFound = tree.find(key, value);
+				if (isFound != (expectedValue != NOT_FOUND) || (isFound && value != expectedValue)) coherent = false;
+			}
+		}
+		tree.setKeyCache(0);
+	}
+	tree.close();
+
+	bool result = found && bounded && writersResult && readersResult && coherent;
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Key cache " << cachedKeys << " keys: popular keys lookup p50 " << treeLatency << "ns, cached " << cachedLatency;
+	ss << "ns (x" << treeLatency / cachedLatency << "), " << writersCount << " writers coherent: " << (writersResult && coherent);
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestBPlusTree::bloomFilter() {
+
+	const char* filterFile = "index_bloom.bin";
+	const double falsePositiveRate = 0.01;
+	std::string bloomFile = std::string(filterFile) + ".bloom";
+	if (std::filesystem::exists(filterFile)) std::filesystem::remove(filterFile);
+	if (std::filesystem::exists(bloomFile)) std::filesystem::remove(bloomFile);
+
+	// measured false positive rate of filter filled to capacity
+	BPlusTreeBloomFilter filter;
+	filter.create(benchmarkKeys, falsePositiveRate);
+	for (uint64_t i = 0; i < benchmarkKeys; i++) filter.add((const uint8_t*)&i, sizeof(i));
+	bool noFalseNegatives = true;
+	uint64_t falsePositives = 0;
+	for (uint64_t i = 0; i < benchmarkKeys; i++) {
+		uint64_t absent = i + benchmarkKeys;
+		if (!filter.mayContain((const uint8_t*)&i, sizeof(i))) noFalseNegatives = false;
+		falsePositives += filter.mayContain((const uint8_t*)&absent, sizeof(absent));
+	}
+	double measuredRate = double(falsePositives) / double(benchmarkKeys);
+	double bitsPerKey = double(filter.getSize() * 8) / double(benchmarkKeys);
+
+	// even keys are bulk loaded with filter, odd keys are absent
+	BPlusTree tree;
+	tree.open(filterFile, false, DEFAULT_CACHE * 4);
+	tree.setBloomFilter(falsePositiveRate, benchmarkKeys * 2);
+	{
+		BPlusTreeBuilder builder(tree);
+		for (uint64_t i = 0; i < benchmarkKeys; i++) builder.add(i * 2, i);
+		builder.commit();
+	}
+
+	auto absentLookups = [&](bool& absent) {
+		uint64_t value;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (uint64_t i = 0; i < samplesCount; i++) {
+			if (tree.find(i * 2 + 1, value)) absent = false;
+		}
+		auto endTime = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double>(endTime - startTime).count();
+	};
+
+	bool absent = true, found = true;
+	uint64_t value;
+	for (uint64_t i = 0; i < benchmarkKeys; i++) {
+		if (!tree.find(i * 2, value) || value != i) found = false;
+	}
+	tree.resetCacheStats();
+	double filteredSeconds = absentLookups(absent);
+	double filteredReads = tree.getCacheStats(CachedFileStats::TOTAL_REQUESTS) / double(samplesCount);
+	tree.setBloomFilter(0);
+	tree.resetCacheStats();
+	double treeSeconds = absentLookups(absent);
+	double treeReads = tree.getCacheStats(CachedFileStats::TOTAL_REQUESTS) / double(samplesCount);
+
+	// filter saved on close is loaded with keys inserted before close
+	tree.setBloomFilter(falsePositiveRate, benchmarkKeys * 2);
+	for (uint64_t i = 0; i < samplesCount; i++) tree.insert(i * 2 + 1, i);
+	tree.close();
+	bool persisted = std::filesystem::exists(bloomFile);
+	tree.open(filterFile, false, DEFAULT_CACHE * 4);
+	persisted = persisted && tree.setBloomFilter(falsePositiveRate, benchmarkKeys * 2);
+	for (uint64_t i = 0; i < samplesCount; i++) {
+		if (!tree.find(i * 2 + 1, value) || value != i) persisted = false;
+	}
+	tree.close();
+
+	// key inserted without filter invalidates saved one, so filter is built again
+	tree.open(filterFile, false, DEFAULT_CACHE * 4);
+	tree.insert(benchmarkKeys * 2 + 1, 1);
+	tree.close();
+	tree.open(filterFile, false, DEFAULT_CACHE * 4);
+	bool rebuilt = tree.setBloomFilter(falsePositiveRate, benchmarkKeys * 2) && tree.find(benchmarkKeys * 2 + 1, value);
+	rebuilt = rebuilt && !tree.remove(benchmarkKeys * 4 + 1) && tree.checkIntegrity();
+	tree.close();
+
+	bool result = noFalseNegatives && measuredRate < falsePositiveRate * 1.5 && found && absent && persisted && rebuilt;
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Bloom filter " << bitsPerKey << " bits/key, false positives " << measuredRate * 100 << "% (target ";
+	ss << falsePositiveRate * 100 << "%): absent keys lookup x" << treeSeconds / filteredSeconds << " faster, ";
+	ss << filteredReads << " page reads instead of " << treeReads << ", persisted: " << persisted;
+	printResult(ss.str().c_str(), result);
+	return result;
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+*
+*  BPlusTree class test header
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <cmath>
+
+#include "CloudlessTests.h"
+#include "BPlusTree.h"
+#include "RecordFileIO.h"
+
+namespace Cloudless {
+
+	namespace Tests {
+
+		class TestBPlusTree : public ITestCase {
+		public:
+			std::string getName() const override;
+			void init() override;
+			void execute() override;
+			bool verify() const override;
+			void cleanup() override;
+		private:
+			bool consistency();
+			bool stringKeys();
+			bool hierarchicalKeys();
+			bool nodeSearch();
+			bool recordsIndex();
+			bool bulkLoading();
+			bool concurrency();
+			bool keyCache();
+			bool bloomFilter();
+			void benchmark();
+			void ycsbBenchmark();
+			bool verifyKeys(Storage::BPlusTree& tree);
+
+			const char* fileName;
+			size_t samplesCount;
+			size_t benchmarkKeys;                        // Raise toward 100M keys on fast storage
+			std::map<uint64_t, uint64_t> expected;       // Values by key
+		};
+	}
+
+}
@@ -0,0 +1,146 @@
+/******************************************************************************
+*
+*  Checksum class tests implementation
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "TestChecksum.h"
+
+
+using namespace Cloudless;
+using namespace Cloudless::Storage;
+using namespace Cloudless::Tests;
+
+
+/**
+*  @brief Previous Adler-32 implementation (modulo per byte), the reference
+*/
+static uint32_t adler32Reference(const uint8_t* data, uint64_t length) {
+	const uint32_t MOD_ADLER = 65521;
+	uint32_t a = 1, b = 0;
+	for (uint64_t index = 0; index < length; ++index) {
+		a = (a + data[index]) % MOD_ADLER;
+		b = (b + a) % MOD_ADLER;
+	}
+	return (b << 16) | a;
+}
+
+
+
+std::string TestChecksum::getName() const {
+	return "Checksum consistency and performance";
+}
+
+
+void TestChecksum::init() {
+	// Random data for largest record size (1Mb attachment)
+	std::mt19937 random(2025);
+	data.resize(1024 * 1024);
+	for (auto& byte : data) byte = (uint8_t)random();
+	finalResult = true;
+}
+
+
+void TestChecksum::execute() {
+	finalResult = knownValues() && implementationsMatch();
+	// Record header payload, typical JSON documents, attachments
+	for (size_t length : { 36, 256, 1024, 16384, 1024 * 1024 }) {
+		benchmark(length);
+	}
+}
+
+
+bool TestChecksum::verify() const {
+	return finalResult;
+}
+
+
+void TestChecksum::cleanup() {
+	data.clear();
+	data.shrink_to_fit();
+}
+
+
+//------------------------------------------------------------------------------------------------------------------
+
+
+bool TestChecksum::knownValues() {
+
+	const uint8_t* wikipedia = (const uint8_t*)"Wikipedia";
+	const uint8_t* digits = (const uint8_t*)"123456789";
+
+	bool result = Checksum::adler32(wikipedia, 9) == 0x11E60398;
+	result = result && Checksum::adler32Scalar(wikipedia, 9) == 0x11E60398;
+	result = result && Checksum::crc32c(digits, 9) == 0xE3069283;
+	result = result && Checksum::crc32cScalar(digits, 9) == 0xE3069283;
+	result = result && Checksum::adler32(nullptr, 0) == 1 && Checksum::crc32c(nullptr, 0) == 0;
+
+	std::stringstream ss;
+	ss << "Known checksum values (" << Checksum::getImplementation(ChecksumType::ADLER32) << ", ";
+	ss << Checksum::getImplementation(ChecksumType::CRC32C) << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestChecksum::implementationsMatch() {
+
+	bool result = true;
+	std::mt19937 random(42);
+
+	// All lengths around SIMD blocks and NMAX boundaries, then random lengths and alignments
+	for (size_t i = 0; i < 20000 && result; i++) {
+		size_t length = (i < 12000) ? i : random() % data.size();
+		size_t offset = (i < 12000) ? i % 7 : random() % (data.size() - length + 1);
+		const uint8_t* buffer = data.data() + offset;
+		uint32_t adler = adler32Reference(buffer, length);
+		result = result && Checksum::adler32Scalar(buffer, length) == adler;
+		result = result && Checksum::adler32(buffer, length) == adler;
+		result = result && Checksum::crc32c(buffer, length) == Checksum::crc32cScalar(buffer, length);
+	}
+
+	// Worst case for deferred modulo: all bytes are 0xFF
+	std::vector<uint8_t> ones(100000, 0xFF);
+	result = result && Checksum::adler32(ones.data(), ones.size()) == adler32Reference(ones.data(), ones.size());
+
+	printResult("Dispatched implementations match reference implementations", result);
+	return result;
+}
+
+
+
+double TestChecksum::throughput(ChecksumFunction function, size_t length, uint32_t& result) {
+
+	// Checksum about 256Mb of data in total
+	size_t iterations = std::max<size_t>(1, 256 * 1024 * 1024 / length);
+	size_t positions = data.size() / length;
+	uint32_t accumulator = 0;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		accumulator += function(data.data() + (i % positions) * length, length);
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	result = accumulator;
+	double duration = (endTime - startTime).count() / 1000000000.0;
+	return double(iterations * length) / duration / 1024.0 / 1024.0;
+}
+
+
+
+void TestChecksum::benchmark(size_t length) {
+
+	uint32_t reference, adler, crc;
+	double referenceSpeed = throughput(adler32Reference, length, reference);
+	double adlerSpeed = throughput(Checksum::adler32, length, adler);
+	double crcSpeed = throughput(Checksum::crc32c, length, crc);
+
+	std::stringstream ss;
+	ss << "Checksum " << length << " bytes: previous " << (int)referenceSpeed << " Mb/s, ";
+	ss << "Adler-32 " << (int)adlerSpeed << " Mb/s, CRC32C " << (int)crcSpeed << " Mb/s";
+	printResult(ss.str().c_str(), reference == adler);
+}
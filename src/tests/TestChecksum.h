@@ -0,0 +1,40 @@
+/******************************************************************************
+*
+*  Checksum class test header
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "CloudlessTests.h"
+#include "Checksum.h"
+
+namespace Cloudless {
+
+	namespace Tests {
+
+		class TestChecksum : public ITestCase {
+		public:
+			std::string getName() const override;
+			void init() override;
+			void execute() override;
+			bool verify() const override;
+			void cleanup() override;
+		private:
+			bool knownValues();
+			bool implementationsMatch();
+			void benchmark(size_t length);
+			double throughput(Storage::ChecksumFunction function, size_t length, uint32_t& result);
+
+			std::vector<uint8_t> data;
+		};
+	}
+
+}
@@ -0,0 +1,533 @@
+/******************************************************************************
+*
+*  DocumentStore class tests implementation
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "TestDocumentStore.h"
+
+
+using namespace Cloudless;
+using namespace Cloudless::Storage;
+using namespace Cloudless::Tests;
+
+
+constexpr uint32_t TEST_AUTHORS = 50;
+constexpr uint32_t TEST_CATEGORIES = 20;
+
+
+//-----------------------------------------------------------------------------
+// Documents store which commits records and stops before indexes are updated
+// and flushed, as if process was terminated, to check indexes are rebuilt
+//-----------------------------------------------------------------------------
+class InterruptedIndexStore : public DocumentStore {
+public:
+	bool commitRecordsOnly(uint64_t recordID, const std::string& json) {
+		std::lock_guard lock(commitMutex);
+		RecordTransaction transaction(records);
+		if (!transaction.setRecordData(recordID, json.data(), (uint32_t)json.size())) return false;
+		return markIndexesChanged() && transaction.commit();
+	}
+	void stop() {
+		for (auto& [jsonPath, index] : indexes) index->close();
+		indexes.clear();
+		records.close();
+	}
+};
+
+
+std::string TestDocumentStore::getName() const {
+	return "DocumentStore secondary indexes consistency and performance";
+}
+
+
+void TestDocumentStore::init() {
+	fileName = "documents.bin";
+	samplesCount = 10000;
+	for (auto& entry : std::filesystem::directory_iterator(".")) {
+		if (entry.path().filename().string().rfind(fileName, 0) == 0) std::filesystem::remove(entry.path());
+	}
+	expected.clear();
+	finalResult = true;
+}
+
+
+void TestDocumentStore::execute() {
+	finalResult = valuesOrder() && indexesMaintenance();
+	navigationBenchmark();
+	finalResult = coveringListing() && finalResult;
+	finalResult = incompleteProjection() && finalResult;
+	finalResult = staleIndexes() && finalResult;
+}
+
+
+bool TestDocumentStore::verify() const {
+	return finalResult;
+}
+
+
+void TestDocumentStore::cleanup() {
+	expected.clear();
+}
+
+
+//------------------------------------------------------------------------------------------------------------------
+
+
+std::string TestDocumentStore::makeArticle(std::mt19937& random, TestArticle& article) {
+
+	std::string number = std::to_string(random());
+	article.title = "Article \"" + number + "\"";
+	article.author = "author-" + std::to_string(random() % TEST_AUTHORS);
+	article.categories.clear();
+	uint32_t categoriesCount = random() % 3;
+	for (uint32_t i = 0; i < categoriesCount; i++) article.categories.push_back("category-" + std::to_string(random() % TEST_CATEGORIES));
+	article.updatedAt = 1700000000.0 + random() % 1000000;
+	article.rating = (random() % 50) / 10.0;
+
+	// single category is a string, several are array, none - no member
+	std::string json = "{\"title\":\"Article \\\"" + number + "\\\"\",\"author\":\"" + article.author + "\",";
+	if (categoriesCount == 1) json += "\"category\":\"" + article.categories[0] + "\",";
+	if (categoriesCount > 1) json += "\"category\":[\"" + article.categories[0] + "\",\"" + article.categories[1] + "\"],";
+	json += "\"updatedAt\":" + std::to_string((uint64_t)article.updatedAt);
+	json += ",\"meta\":{\"draft\":false,\"rating\":" + std::to_string(article.rating) + "}";
+	return json + ",\"body\":\"" + std::string(random() % 500, 'x') + "\"}";
+}
+
+
+
+bool TestDocumentStore::declareIndexes(DocumentStore& store) {
+	return store.createIndex("author") && store.createIndex("category") &&
+		store.createIndex("updatedAt") && store.createIndex("meta.rating");
+}
+
+
+
+bool TestDocumentStore::verifyIndexes(DocumentStore& store, std::mt19937& random) {
+
+	std::map<std::string, std::set<uint64_t>> byAuthor, byCategory;
+	for (auto& [recordID, article] : expected) {
+		byAuthor[article.author].insert(recordID);
+		for (auto& category : article.categories) byCategory[category].insert(recordID);
+	}
+
+	// equality lookups return record IDs in ascending order
+	std::vector<uint64_t> recordIDs;
+	for (uint32_t i = 0; i < TEST_AUTHORS; i++) {
+		std::string author = "author-" + std::to_string(i);
+		DocumentValue value = DocumentIndex::encodeString(author);
+		if (!store.findIDs("author", value, value, recordIDs)) return false;
+		if (recordIDs != std::vector<uint64_t>(byAuthor[author].begin(), byAuthor[author].end())) return false;
+	}
+	for (uint32_t i = 0; i < TEST_CATEGORIES; i++) {
+		std::string category = "category-" + std::to_string(i);
+		DocumentValue value = DocumentIndex::encodeString(category);
+		if (!store.findIDs("category", value, value, recordIDs)) return false;
+		if (recordIDs != std::vector<uint64_t>(byCategory[category].begin(), byCategory[category].end())) return false;
+	}
+
+	// range lookups return documents in values order
+	for (int i = 0; i < 20; i++) {
+		double from = 1700000000.0 + random() % 1000000;
+		double to = from + random() % 100000;
+		if (!store.findIDs("updatedAt", DocumentIndex::encodeNumber(from), DocumentIndex::encodeNumber(to), recordIDs)) return false;
+		std::vector<std::pair<double, uint64_t>> inRange;
+		for (auto& [recordID, article] : expected) {
+			if (article.updatedAt >= from && article.updatedAt <= to) inRange.emplace_back(article.updatedAt, recordID);
+		}
+		std::sort(inRange.begin(), inRange.end());
+		if (recordIDs.size() != inRange.size()) return false;
+		for (size_t j = 0; j < inRange.size(); j++) {
+			if (recordIDs[j] != inRange[j].second) return false;
+		}
+	}
+	size_t topRated = 0;
+	for (auto& [recordID, article] : expected) topRated += (article.rating >= 4.0) ? 1 : 0;
+	if (!store.findIDs("meta.rating", DocumentIndex::encodeNumber(4.0), DocumentIndex::encodeNumber(5.0), recordIDs)) return false;
+	if (recordIDs.size() != topRated) return false;
+
+	// positions of documents
+	std::vector<uint64_t> positions;
+	DocumentValue author = DocumentIndex::encodeString("author-1");
+	if (!store.find("author", author, positions) || positions.size() != byAuthor["author-1"].size()) return false;
+	size_t index = 0;
+	for (uint64_t recordID : byAuthor["author-1"]) {
+		auto cursor = store.getRecords().getRecordByID(recordID);
+		if (cursor == nullptr || cursor->getPosition() != positions[index++]) return false;
+	}
+	return true;
+}
+
+
+
+bool TestDocumentStore::valuesOrder() {
+
+	// values in ascending order, equal neighbours are marked
+	struct OrderedValue { const char* json; bool equalToPrevious; };
+	const OrderedValue ordered[] = {
+		{ "null", false }, { "false", false }, { "true", false },
+		{ "-1e300", false }, { "-2.5", false }, { "-1", false }, { "0", false }, { "-0", true },
+		{ "1e-300", false }, { "1", false }, { "1.0", true }, { "2.5", false }, { "1e300", false },
+		{ "\"\"", false }, { "\"\\u0000\"", false }, { "\"\\u0000a\"", false }, { "\"a\"", false },
+		{ "\"a\\u0000\"", false }, { "\"ab\"", false }, { "\"\\u00e9\"", false }, { "\"\xC3\xA9\"", true },
+		{ "\"\\ud83d\\ude00\"", false }, { "\"\xF0\x9F\x98\x80\"", true }
+	};
+
+	DocumentIndex index("v");
+	std::vector<DocumentValue> values;
+	DocumentValue previous;
+	bool result = true;
+	for (size_t i = 0; i < sizeof(ordered) / sizeof(ordered[0]); i++) {
+		std::string json = std::string("{\"v\":") + ordered[i].json + "}";
+		result = result && index.extractValues((const uint8_t*)json.data(), json.size(), values) && values.size() == 1;
+		if (!result) break;
+		if (i > 0) result = ordered[i].equalToPrevious ? values[0] == previous : previous < values[0];
+		previous = values[0];
+	}
+
+	// nested path skips other members, arrays give each scalar element
+	std::string nested = "{\"x\":{\"b\":1},\"a\":{\"c\":[1,{\"b\":2}],\"b\":\"found\"}}";
+	DocumentIndex nestedIndex("a.b");
+	result = result && nestedIndex.extractValues((const uint8_t*)nested.data(), nested.size(), values);
+	result = result && values.size() == 1 && values[0] == DocumentIndex::encodeString("found");
+	std::string array = "{\"v\":[\"x\",[\"nested\"],{\"o\":1},\"y\",3]}";
+	result = result && index.extractValues((const uint8_t*)array.data(), array.size(), values) && values.size() == 3;
+	std::string malformed = "{\"v\":tru}";
+	result = result && !index.extractValues((const uint8_t*)malformed.data(), malformed.size(), values);
+
+	// truncated string keeps terminator, values decode back
+	std::string text, zeros(2 * DOCUMENT_MAX_VALUE_LENGTH, '\0');
+	DocumentValue truncated = DocumentIndex::encodeString(zeros);
+	result = result && truncated.size() <= DOCUMENT_MAX_VALUE_LENGTH;
+	result = result && DocumentIndex::getValueLength(truncated.data(), truncated.size()) == truncated.size();
+	result = result && DocumentIndex::decodeString(truncated, text) && zeros.compare(0, text.size(), text) == 0;
+	result = result && DocumentIndex::decodeString(DocumentIndex::encodeString(std::string("a\0b", 3)), text) && text == std::string("a\0b", 3);
+	double number = 0;
+	result = result && DocumentIndex::decodeNumber(DocumentIndex::encodeNumber(-2.5), number) && number == -2.5;
+	result = result && DocumentIndex::decodeNumber(DocumentIndex::encodeNumber(1e300), number) && number == 1e300;
+
+	printResult("Index values order: null, booleans, numbers, strings (escapes decoded)", result);
+	return result;
+}
+
+
+
+bool TestDocumentStore::indexesMaintenance() {
+
+	std::mt19937 random(2046);
+	bool result = true;
+	TestArticle article;
+	{
+		DocumentStore store;
+		store.open(fileName);
+		result = store.createIndex("author") && store.createIndex("category") && store.createIndex("updatedAt");
+
+		// single document commits and transactions of several documents
+		for (size_t i = 0; i < samplesCount / 2; i++) {
+			std::string json = makeArticle(random, article);
+			uint64_t recordID = store.insertDocument(json.data(), (uint32_t)json.size());
+			result = result && recordID != NOT_FOUND;
+			expected[recordID] = article;
+		}
+		for (size_t i = 0; i < samplesCount / 2; i += 10) {
+			DocumentTransaction transaction(store);
+			std::map<uint64_t, TestArticle> created;
+			for (size_t j = 0; j < 10; j++) {
+				std::string json = makeArticle(random, article);
+				created[transaction.insertDocument(json.data(), (uint32_t)json.size())] = article;
+			}
+			result = result && transaction.commit();
+			expected.insert(created.begin(), created.end());
+		}
+
+		// index declared later is loaded from existing documents
+		result = result && store.createIndex("meta.rating");
+
+		// updates and removals in transactions
+		std::vector<uint64_t> recordIDs;
+		for (auto& [recordID, expectedArticle] : expected) recordIDs.push_back(recordID);
+		std::shuffle(recordIDs.begin(), recordIDs.end(), random);
+		for (size_t i = 0; i + 10 <= recordIDs.size() / 2; i += 10) {
+			DocumentTransaction transaction(store);
+			std::map<uint64_t, TestArticle> updated;
+			for (size_t j = i; j < i + 10; j++) {
+				if (j % 5 == 0) result = result && transaction.removeDocument(recordIDs[j]);
+				else {
+					std::string json = makeArticle(random, article);
+					result = result && transaction.updateDocument(recordIDs[j], json.data(), (uint32_t)json.size());
+					updated[recordIDs[j]] = article;
+				}
+			}
+			result = result && transaction.commit();
+			for (size_t j = i; j < i + 10; j++) {
+				if (j % 5 == 0) expected.erase(recordIDs[j]);
+				else expected[recordIDs[j]] = updated[recordIDs[j]];
+			}
+		}
+
+		// aborted transaction changes nothing, transaction conflicting
+		// with committed update fails and keeps indexes of that update
+		uint64_t recordID = expected.begin()->first;
+		{
+			DocumentTransaction aborted(store);
+			std::string json = makeArticle(random, article);
+			result = result && aborted.updateDocument(recordID, json.data(), (uint32_t)json.size());
+			result = result && aborted.insertDocument(json.data(), (uint32_t)json.size()) != NOT_FOUND;
+			aborted.abort();
+		}
+		DocumentTransaction conflicting(store);
+		std::string json = makeArticle(random, article);
+		result = result && conflicting.updateDocument(recordID, json.data(), (uint32_t)json.size());
+		json = makeArticle(random, article);
+		result = result && store.updateDocument(recordID, json.data(), (uint32_t)json.size());
+		expected[recordID] = article;
+		result = result && !conflicting.commit();
+
+		result = result && verifyIndexes(store, random);
+		store.close();
+	}
+
+	// indexes are opened as is, dropped index is built again
+	DocumentStore reopened;
+	reopened.open(fileName);
+	bool loaded = declareIndexes(reopened) && verifyIndexes(reopened, random);
+	loaded = loaded && reopened.dropIndex("author") && !reopened.hasIndex("author");
+	loaded = loaded && reopened.createIndex("author") && verifyIndexes(reopened, random);
+	reopened.close();
+	result = result && loaded;
+
+	std::stringstream ss;
+	ss << "Documents " << expected.size() << " with 4 indexes (transactions: " << result << ", reopened and rebuilt: " << loaded << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+void TestDocumentStore::navigationBenchmark() {
+
+	DocumentStore store;
+	store.open(fileName);
+	bool result = declareIndexes(store);
+
+	// each category documents by index and by scan of all documents
+	uint64_t indexed = 0, scanned = 0;
+	std::vector<uint64_t> positions;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < TEST_CATEGORIES; i++) {
+		result = result && store.find("category", DocumentIndex::encodeString("category-" + std::to_string(i)), positions);
+		indexed += positions.size();
+	}
+	auto indexTime = std::chrono::high_resolution_clock::now();
+
+	DocumentIndex category("category");
+	std::vector<DocumentValue> values;
+	for (uint32_t i = 0; i < TEST_CATEGORIES; i++) {
+		DocumentValue value = DocumentIndex::encodeString("category-" + std::to_string(i));
+		RecordScanner scanner(store.getRecords());
+		ScanRecord record;
+		while (scanner.next(record)) {
+			category.extractValues(record.data, record.length, values);
+			if (std::find(values.begin(), values.end(), value) != values.end()) scanned++;
+		}
+	}
+	auto scanTime = std::chrono::high_resolution_clock::now();
+	store.close();
+
+	double indexSeconds = std::chrono::duration<double>(indexTime - startTime).count();
+	double scanSeconds = std::chrono::duration<double>(scanTime - indexTime).count();
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Category navigation of " << indexed << " documents: index " << indexSeconds * 1000 << "ms, scan ";
+	ss << scanSeconds * 1000 << "ms (x" << scanSeconds / indexSeconds << " faster)";
+	printResult(ss.str().c_str(), result && indexed == scanned);
+}
+
+
+
+bool TestDocumentStore::coveringListing() {
+
+	const std::vector<std::string> projection = { "title", "updatedAt", "meta.rating" };
+	DocumentStore store;
+	store.open(fileName);
+
+	// path with index is declared with projection after the index is dropped
+	bool result = store.createIndex("category") && !store.createIndex("category", projection);
+	result = result && store.dropIndex("category") && store.createIndex("category", projection);
+
+	// change of projected field is change of index key
+	std::mt19937 random(2047);
+	TestArticle article;
+	uint64_t recordID = expected.begin()->first;
+	std::string json = makeArticle(random, article);
+	result = result && store.updateDocument(recordID, json.data(), (uint32_t)json.size());
+	expected[recordID] = article;
+
+	// category lists sorted by date: from index entries and from records
+	typedef std::tuple<double, uint64_t, std::string, double> ListedArticle;
+	std::vector<ListedArticle> listed, fetched;
+	std::vector<DocumentEntry> entries;
+	std::string title;
+	double updatedAt, rating;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < TEST_CATEGORIES; i++) {
+		DocumentValue category = DocumentIndex::encodeString("category-" + std::to_string(i));
+		result = result && store.findEntries("category", category, category, entries);
+		for (auto& entry : entries) {
+			DocumentIndex::decodeString(entry.fields[0], title);
+			DocumentIndex::decodeNumber(entry.fields[1], updatedAt);
+			DocumentIndex::decodeNumber(entry.fields[2], rating);
+			listed.emplace_back(updatedAt, entry.recordID, title, rating);
+		}
+	}
+	std::sort(listed.rbegin(), listed.rend());
+	auto indexTime = std::chrono::high_resolution_clock::now();
+
+	DocumentIndex titleField("title"), updatedAtField("updatedAt"), ratingField("meta.rating");
+	std::vector<DocumentValue> values;
+	std::vector<uint8_t> document;
+	std::vector<uint64_t> recordIDs;
+	for (uint32_t i = 0; i < TEST_CATEGORIES; i++) {
+		DocumentValue category = DocumentIndex::encodeString("category-" + std::to_string(i));
+		result = result && store.findIDs("category", category, category, recordIDs);
+		for (uint64_t id : recordIDs) {
+			if (!store.getDocument(id, document)) return false;
+			titleField.extractValues(document.data(), document.size(), values);
+			DocumentIndex::decodeString(values[0], title);
+			updatedAtField.extractValues(document.data(), document.size(), values);
+			DocumentIndex::decodeNumber(values[0], updatedAt);
+			ratingField.extractValues(document.data(), document.size(), values);
+			DocumentIndex::decodeNumber(values[0], rating);
+			fetched.emplace_back(updatedAt, id, title, rating);
+		}
+	}
+	std::sort(fetched.rbegin(), fetched.rend());
+	auto recordsTime = std::chrono::high_resolution_clock::now();
+	store.close();
+
+	// both lists match the articles written
+	size_t categorized = 0;
+	for (auto& [id, expectedArticle] : expected) {
+		std::set<std::string> categories(expectedArticle.categories.begin(), expectedArticle.categories.end());
+		categorized += categories.size();
+	}
+	result = result && listed == fetched && listed.size() == categorized;
+	for (auto& [listedAt, id, listedTitle, listedRating] : listed) {
+		const TestArticle& expectedArticle = expected[id];
+		if (expectedArticle.title != listedTitle || expectedArticle.updatedAt != listedAt || expectedArticle.rating != listedRating) result = false;
+	}
+
+	double indexSeconds = std::chrono::duration<double>(indexTime - startTime).count();
+	double recordsSeconds = std::chrono::duration<double>(recordsTime - indexTime).count();
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Category listing of " << listed.size() << " articles: covering index " << indexSeconds * 1000 << "ms, records ";
+	ss << recordsSeconds * 1000 << "ms (x" << recordsSeconds / indexSeconds << " faster)";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestDocumentStore::incompleteProjection() {
+
+	DocumentStore store;
+	store.open((std::string(fileName) + ".projection").c_str());
+	bool result = store.createIndex("category", { "title", "updatedAt" });
+
+	// key has 15 bytes before projection: title of 1010 characters is
+	// truncated, updatedAt doesn't fit after title of 1000 characters
+	std::map<uint64_t, std::string> titles;
+	for (size_t titleLength : { 1010, 1000, 5 }) {
+		std::string title(titleLength, 'x');
+		std::string json = "{\"category\":\"long\",\"title\":\"" + title + "\"";
+		if (titleLength > 5) json += ",\"updatedAt\":7";
+		json += "}";
+		uint64_t recordID = store.insertDocument(json.data(), (uint32_t)json.size());
+		result = result && recordID != NOT_FOUND;
+		titles[recordID] = title;
+	}
+
+	// incomplete entries fields are read from records, missing field stays null
+	std::vector<DocumentEntry> entries;
+	DocumentValue category = DocumentIndex::encodeString("long");
+	result = result && store.findEntries("category", category, category, entries) && entries.size() == titles.size();
+	std::string title;
+	double updatedAt = 0;
+	for (auto& entry : entries) {
+		result = result && entry.complete && entry.fields.size() == 2 && DocumentIndex::decodeString(entry.fields[0], title);
+		if (!result) break;
+		result = titles[entry.recordID] == title;
+		if (title.size() > 5) {
+			result = result && DocumentIndex::decodeNumber(entry.fields[1], updatedAt) && updatedAt == 7;
+		} else {
+			result = result && entry.fields[1] == DocumentIndex::encodeNull();
+		}
+	}
+	store.close();
+
+	printResult("Covering index fields that didn't fit key are read from records", result);
+	return result;
+}
+
+
+
+bool TestDocumentStore::staleIndexes() {
+
+	std::mt19937 random(2048);
+	TestArticle article;
+	bool stopped = false;
+	{
+		InterruptedIndexStore interrupted;
+		interrupted.open(fileName);
+		stopped = declareIndexes(interrupted);
+		uint64_t recordID = std::next(expected.begin(), expected.size() / 2)->first;
+		std::string json = makeArticle(random, article);
+		stopped = stopped && interrupted.commitRecordsOnly(recordID, json);
+		expected[recordID] = article;
+		interrupted.stop();
+	}
+
+	// indexes left behind records are rebuilt on open
+	DocumentStore reopened;
+	reopened.open(fileName);
+	bool rebuilt = declareIndexes(reopened) && verifyIndexes(reopened, random);
+	reopened.close();
+
+	// indexes flushed in sync are opened as is
+	DocumentStore synced;
+	synced.open(fileName);
+	rebuilt = rebuilt && declareIndexes(synced) && verifyIndexes(synced, random);
+	synced.close();
+
+	// index not declared while documents changed has other commit stamp
+	bool undeclared = false;
+	{
+		DocumentStore partial;
+		partial.open(fileName);
+		undeclared = partial.createIndex("updatedAt");
+		size_t index = 0;
+		for (auto& [recordID, expectedArticle] : expected) {
+			if (index++ % 100 != 0) continue;
+			std::string json = makeArticle(random, article);
+			undeclared = undeclared && partial.updateDocument(recordID, json.data(), (uint32_t)json.size());
+			expectedArticle = article;
+		}
+		partial.close();
+	}
+	DocumentStore declared;
+	declared.open(fileName);
+	undeclared = undeclared && declareIndexes(declared) && verifyIndexes(declared, random);
+	declared.close();
+
+	bool result = stopped && rebuilt && undeclared;
+	std::stringstream ss;
+	ss << "Indexes behind records are rebuilt on open (interrupted commit: " << rebuilt << ", undeclared index: " << undeclared << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
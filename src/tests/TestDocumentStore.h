@@ -0,0 +1,65 @@
+/******************************************************************************
+*
+*  DocumentStore class test header
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <filesystem>
+#include <algorithm>
+
+#include "CloudlessTests.h"
+#include "DocumentStore.h"
+
+namespace Cloudless {
+
+	namespace Tests {
+
+		//----------------------------------------------------------------------------
+		// Article document fields kept to check index lookups
+		//----------------------------------------------------------------------------
+		struct TestArticle {
+			std::string              title;
+			std::string              author;
+			std::vector<std::string> categories;
+			double                   updatedAt;
+			double                   rating;
+		};
+
+		class TestDocumentStore : public ITestCase {
+		public:
+			std::string getName() const override;
+			void init() override;
+			void execute() override;
+			bool verify() const override;
+			void cleanup() override;
+		private:
+			bool valuesOrder();
+			bool indexesMaintenance();
+			void navigationBenchmark();
+			bool coveringListing();
+			bool incompleteProjection();
+			bool staleIndexes();
+			bool verifyIndexes(Storage::DocumentStore& store, std::mt19937& random);
+			std::string makeArticle(std::mt19937& random, TestArticle& article);
+			bool declareIndexes(Storage::DocumentStore& store);
+
+			const char* fileName;
+			size_t samplesCount;
+			std::map<uint64_t, TestArticle> expected;    // Articles by record ID
+		};
+	}
+
+}
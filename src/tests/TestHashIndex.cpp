@@ -0,0 +1,299 @@
+/******************************************************************************
+*
+*  HashIndex class tests implementation
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "TestHashIndex.h"
+
+
+using namespace Cloudless;
+using namespace Cloudless::Storage;
+using namespace Cloudless::Tests;
+
+
+//-----------------------------------------------------------------------------
+// Hash index which stops as process stopped without flush: cached pages reach
+// the file, but index doesn't mark itself flushed
+//-----------------------------------------------------------------------------
+class StoppedHashIndex : public HashIndex {
+public:
+	void stop() {
+		cachedFile.close();
+		directory.clear();
+		directoryPages.clear();
+	}
+};
+
+
+std::string TestHashIndex::getName() const {
+	return "HashIndex consistency and performance";
+}
+
+
+void TestHashIndex::init() {
+	fileName = "hash.bin";
+	samplesCount = 100000;
+	benchmarkKeys = 1000000;
+	if (std::filesystem::exists(fileName)) std::filesystem::remove(fileName);
+	expected.clear();
+	finalResult = true;
+}
+
+
+void TestHashIndex::execute() {
+	finalResult = consistency() && stringKeys();
+	finalResult = stoppedSplits() && finalResult;
+	benchmark();
+}
+
+
+bool TestHashIndex::verify() const {
+	return finalResult;
+}
+
+
+void TestHashIndex::cleanup() {
+	expected.clear();
+}
+
+
+//------------------------------------------------------------------------------------------------------------------
+
+
+bool TestHashIndex::verifyKeys(HashIndex& index) {
+	if (index.getTotalKeys() != expected.size() || !index.checkIntegrity()) return false;
+	uint64_t value;
+	for (auto& [key, expectedValue] : expected) {
+		if (!index.find(key, value) || value != expectedValue) return false;
+		if (expected.count(key + 1) == 0 && index.find(key + 1, value)) return false;
+	}
+	return true;
+}
+
+
+
+bool TestHashIndex::consistency() {
+
+	std::mt19937_64 random(2050);
+	bool result = true;
+	uint32_t depth = 0;
+	uint64_t buckets = 0;
+	double loadFactor = 0;
+	{
+		HashIndex index;
+		index.open(fileName);
+
+		// random inserts split buckets and double directory, duplicates are rejected
+		for (size_t i = 0; i < samplesCount; i++) {
+			uint64_t key = random() % (samplesCount * 10);
+			bool inserted = index.insert(key, i);
+			if (inserted != (expected.count(key) == 0)) result = false;
+			if (inserted) expected[key] = i;
+		}
+		depth = index.getGlobalDepth();
+		buckets = index.getTotalBuckets();
+		loadFactor = index.getLoadFactor();
+
+		// updates, then removals
+		for (auto& [key, value] : expected) {
+			if (random() % 3 != 0) continue;
+			value = value + samplesCount;
+			result = result && index.update(key, value);
+		}
+		std::vector<uint64_t> removed;
+		for (auto& [key, value] : expected) {
+			if (random() % 4 != 0) removed.push_back(key);
+		}
+		for (uint64_t key : removed) {
+			result = result && index.remove(key) && !index.remove(key) && !index.update(key, 0);
+			expected.erase(key);
+		}
+
+		result = result && verifyKeys(index);
+		index.close();
+	}
+
+	// header and directory are loaded on open, removed keys space is reused
+	HashIndex reopened;
+	reopened.open(fileName);
+	bool loaded = verifyKeys(reopened);
+	uint64_t pages = reopened.getTotalPages();
+	for (uint64_t key = 0; key < samplesCount / 10; key++) {
+		if (expected.count(key) == 0 && reopened.insert(key, key)) expected[key] = key;
+	}
+	bool reused = reopened.getTotalPages() == pages && verifyKeys(reopened);
+	reopened.close();
+
+	// full buckets are split in halves, so buckets are half to fully loaded
+	bool grown = depth > 0 && buckets > 1 && loadFactor > 0.5 && loadFactor < 0.9;
+	result = result && loaded && reused && grown;
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Keys " << expected.size() << " of " << samplesCount << " inserted, depth " << depth << ", buckets " << buckets;
+	ss << ", load factor " << loadFactor << " (loaded: " << loaded << ", space reused: " << reused << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestHashIndex::stringKeys() {
+
+	const char* stringsFile = "hash_strings.bin";
+	if (std::filesystem::exists(stringsFile)) std::filesystem::remove(stringsFile);
+
+	// variable length keys up to max length, empty key is valid key
+	std::mt19937 random(2051);
+	std::map<std::string, uint64_t> strings;
+	HashIndex index;
+	index.open(stringsFile);
+	bool result = index.insert("", 0, 7) && !index.insert("", 0, 8);
+	strings[""] = 7;
+	for (uint64_t i = 0; i < samplesCount / 10; i++) {
+		size_t length = random() % 64 == 0 ? HASH_MAX_KEY_LENGTH : 1 + random() % 40;
+		std::string key(length, 'a');
+		for (auto& c : key) c = char('a' + random() % 26);
+		if (strings.count(key) != 0) continue;
+		result = result && index.insert(key.data(), (uint32_t)key.size(), i);
+		strings[key] = i;
+	}
+	std::string tooLong(HASH_MAX_KEY_LENGTH + 1, 'x');
+	result = result && !index.insert(tooLong.data(), (uint32_t)tooLong.size(), 0);
+	index.close();
+
+	index.open(stringsFile, true);
+	uint64_t value;
+	for (auto& [key, expectedValue] : strings) {
+		if (!index.find(key.data(), (uint32_t)key.size(), value) || value != expectedValue) result = false;
+	}
+	result = result && index.getTotalKeys() == strings.size() && index.checkIntegrity() && !index.insert("z", 1, 0);
+	index.close();
+
+	std::stringstream ss;
+	ss << "String keys " << strings.size() << " (up to " << HASH_MAX_KEY_LENGTH << " bytes) inserted and found";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestHashIndex::stoppedSplits() {
+
+	const char* stoppedFile = "hash_stopped.bin";
+	if (std::filesystem::exists(stoppedFile)) std::filesystem::remove(stoppedFile);
+
+	// keys inserted after flush split buckets and double directory, then index stops
+	std::mt19937_64 random(2053);
+	std::map<uint64_t, uint64_t> keys;
+	uint32_t flushedDepth = 0, stoppedDepth = 0;
+	bool result = true;
+	{
+		StoppedHashIndex index;
+		index.open(stoppedFile);
+		for (uint64_t i = 0; i < samplesCount; i++) {
+			if (i == samplesCount / 10) {
+				result = result && index.flush();
+				flushedDepth = index.getGlobalDepth();
+			}
+			uint64_t key = random();
+			if (keys.count(key) != 0) continue;
+			result = result && index.insert(key, i);
+			keys[key] = i;
+		}
+		stoppedDepth = index.getGlobalDepth();
+		index.stop();
+	}
+
+	// directory and header written with splits find every key on open
+	bool reopened = false;
+	HashIndex index;
+	try {
+		reopened = index.open(stoppedFile);
+	} catch (const std::runtime_error&) {
+		reopened = false;
+	}
+	uint64_t value;
+	bool found = reopened && index.getTotalKeys() == keys.size() && index.checkIntegrity();
+	for (auto& [key, expectedValue] : keys) {
+		if (!found) break;
+		found = index.find(key, value) && value == expectedValue;
+	}
+	if (reopened) index.close();
+
+	result = result && stoppedDepth > flushedDepth && reopened && found;
+	std::stringstream ss;
+	ss << "Index stopped without flush after splits (depth " << flushedDepth << " to " << stoppedDepth;
+	ss << ") reopened: " << reopened << ", keys found: " << found;
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+void TestHashIndex::benchmark() {
+
+	const char* hashFile = "hash_benchmark.bin";
+	const char* treeFile = "hash_benchmark_tree.bin";
+	if (std::filesystem::exists(hashFile)) std::filesystem::remove(hashFile);
+	if (std::filesystem::exists(treeFile)) std::filesystem::remove(treeFile);
+
+	// random 16-byte UUIDs as document IDs, lookups in other random order
+	std::mt19937_64 random(2052);
+	std::vector<std::array<uint64_t, 2>> keys(benchmarkKeys);
+	for (auto& key : keys) key = { random(), random() };
+
+	HashIndex index;
+	BPlusTree tree;
+	index.open(hashFile, false, DEFAULT_CACHE * 4);
+	tree.open(treeFile, false, DEFAULT_CACHE * 4);
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < benchmarkKeys; i++) index.insert(keys[i].data(), 16, i);
+	index.flush();
+	auto hashInsertTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < benchmarkKeys; i++) tree.insert(keys[i].data(), 16, i);
+	tree.flush();
+	auto treeInsertTime = std::chrono::high_resolution_clock::now();
+
+	std::shuffle(keys.begin(), keys.end(), random);
+	uint64_t value, hashFound = 0, treeFound = 0;
+	index.resetCacheStats();
+	tree.resetCacheStats();
+	auto lookupTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < benchmarkKeys; i++) hashFound += index.find(keys[i].data(), 16, value);
+	auto hashFindTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < benchmarkKeys; i++) treeFound += tree.find(keys[i].data(), 16, value);
+	auto treeFindTime = std::chrono::high_resolution_clock::now();
+
+	double hashReads = index.getCacheStats(CachedFileStats::TOTAL_REQUESTS) / double(benchmarkKeys);
+	double treeReads = tree.getCacheStats(CachedFileStats::TOTAL_REQUESTS) / double(benchmarkKeys);
+	uint64_t hashSize = index.getFileSize(), treeSize = tree.getFileSize();
+	uint32_t depth = index.getGlobalDepth();
+	double loadFactor = index.getLoadFactor();
+	bool consistent = index.checkIntegrity();
+	index.close();
+	tree.close();
+
+	double hashInsertSeconds = std::chrono::duration<double>(hashInsertTime - startTime).count();
+	double treeInsertSeconds = std::chrono::duration<double>(treeInsertTime - hashInsertTime).count();
+	double hashFindSeconds = std::chrono::duration<double>(hashFindTime - lookupTime).count();
+	double treeFindSeconds = std::chrono::duration<double>(treeFindTime - hashFindTime).count();
+
+	std::stringstream ss;
+	ss.precision(3);
+	ss << "Hash index " << benchmarkKeys << " UUIDs, depth " << depth << ", load " << loadFactor << ", file ";
+	ss << hashSize / 1024 / 1024 << "Mb: insert " << benchmarkKeys / hashInsertSeconds / 1000 << "K/s, find ";
+	ss << benchmarkKeys / hashFindSeconds / 1000 << "K/s (" << hashReads << " page reads)";
+	printResult(ss.str().c_str(), hashFound == benchmarkKeys && consistent);
+
+	std::stringstream bs;
+	bs.precision(3);
+	bs << "B+ Tree same UUIDs, file " << treeSize / 1024 / 1024 << "Mb: insert " << benchmarkKeys / treeInsertSeconds / 1000;
+	bs << "K/s, find " << benchmarkKeys / treeFindSeconds / 1000 << "K/s (" << treeReads << " page reads), hash find x";
+	bs << treeFindSeconds / hashFindSeconds << " faster";
+	printResult(bs.str().c_str(), treeFound == benchmarkKeys);
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+*
+*  HashIndex class test header
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <array>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+
+#include "CloudlessTests.h"
+#include "HashIndex.h"
+#include "BPlusTree.h"
+
+namespace Cloudless {
+
+	namespace Tests {
+
+		class TestHashIndex : public ITestCase {
+		public:
+			std::string getName() const override;
+			void init() override;
+			void execute() override;
+			bool verify() const override;
+			void cleanup() override;
+		private:
+			bool consistency();
+			bool stringKeys();
+			bool stoppedSplits();
+			void benchmark();
+			bool verifyKeys(Storage::HashIndex& index);
+
+			const char* fileName;
+			size_t samplesCount;
+			size_t benchmarkKeys;                        // Raise toward 100M keys on fast storage
+			std::map<uint64_t, uint64_t> expected;       // Values by key
+		};
+	}
+
+}
@@ -0,0 +1,303 @@
+/******************************************************************************
+*
+*  LogFileIO class tests implementation
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "TestLogFileIO.h"
+
+
+using namespace Cloudless;
+using namespace Cloudless::Storage;
+using namespace Cloudless::Tests;
+
+
+constexpr uint32_t TEST_SEGMENT_SIZE = 64 * 1024;   // Small segments to exercise cleaning
+
+
+std::string TestLogFileIO::getName() const {
+	return "LogFileIO consistency, segments cleaning and performance";
+}
+
+
+void TestLogFileIO::init() {
+	fileName = "log.bin";
+	samplesCount = 5000;
+	if (std::filesystem::exists(fileName)) std::filesystem::remove(fileName);
+	expected.clear();
+	finalResult = true;
+}
+
+
+void TestLogFileIO::execute() {
+	finalResult = consistency() && cleaning() && backgroundCleaning();
+	writeBenchmark();
+}
+
+
+bool TestLogFileIO::verify() const {
+	return finalResult;
+}
+
+
+void TestLogFileIO::cleanup() {
+	expected.clear();
+}
+
+
+//------------------------------------------------------------------------------------------------------------------
+
+
+std::string TestLogFileIO::makeDocument(std::mt19937& random, size_t length) {
+	static const char* words[] = { "article", "comment", "author", "version", "title", "text", "peer", "cloud" };
+	std::string document = "{\"id\":" + std::to_string(random()) + ",\"text\":\"";
+	while (document.size() < length) {
+		document += words[random() % 8];
+		document += ' ';
+	}
+	return document + "\"}";
+}
+
+
+
+bool TestLogFileIO::verifyRecords(LogFileIO& log) {
+
+	if (log.getTotalRecords() != expected.size()) return false;
+
+	// every record by ID
+	std::vector<uint8_t> data;
+	for (auto& [recordID, document] : expected) {
+		auto cursor = log.getRecordByID(recordID);
+		if (cursor == nullptr || cursor->getDataLength() != document.size()) return false;
+		data.resize(document.size());
+		if (!cursor->getRecordData(data.data())) return false;
+		if (memcmp(data.data(), document.data(), document.size()) != 0) return false;
+	}
+
+	// navigation in ID order
+	auto it = expected.begin();
+	auto cursor = log.getFirstRecord();
+	size_t count = 0;
+	while (cursor != nullptr && it != expected.end()) {
+		if (cursor->getRecordID() != it->first) return false;
+		count++;
+		++it;
+		if (!cursor->next()) break;
+	}
+
+	return count == expected.size();
+}
+
+
+
+bool TestLogFileIO::consistency() {
+
+	std::mt19937 random(2029);
+	bool result = true;
+	{
+		LogFileIO log;
+		log.open(fileName, false, DEFAULT_CACHE, TEST_SEGMENT_SIZE, false);
+
+		// new articles, new versions of articles and removals
+		for (size_t i = 0; i < samplesCount; i++) {
+			std::string document = makeDocument(random, 100 + random() % 1400);
+			auto cursor = log.createRecord(document.data(), (uint32_t)document.size());
+			if (cursor == nullptr) return false;
+			expected[cursor->getRecordID()] = document;
+		}
+		for (size_t i = 0; i < samplesCount / 2; i++) {
+			auto cursor = log.getRecordByID(random() % samplesCount + 1);
+			if (cursor == nullptr) continue;
+			std::string document = makeDocument(random, 100 + random() % 1400);
+			result = result && cursor->setRecordData(document.data(), (uint32_t)document.size());
+			expected[cursor->getRecordID()] = document;
+		}
+		for (size_t i = 0; i < samplesCount / 5; i++) {
+			uint64_t recordID = random() % samplesCount + 1;
+			auto cursor = log.getRecordByID(recordID);
+			if (cursor == nullptr) continue;
+			result = result && log.removeRecord(cursor) && !cursor->isValid();
+			expected.erase(recordID);
+		}
+		result = result && verifyRecords(log);
+		log.close();
+	}
+
+	// index is rebuilt replaying segments
+	LogFileIO reopened;
+	reopened.open(fileName, false, DEFAULT_CACHE, TEST_SEGMENT_SIZE, false);
+	bool replayed = verifyRecords(reopened);
+
+	// new record gets new ID after reopen
+	std::string document = makeDocument(random, 500);
+	auto cursor = reopened.createRecord(document.data(), (uint32_t)document.size());
+	replayed = replayed && cursor != nullptr && cursor->getRecordID() > samplesCount;
+	if (cursor != nullptr) expected[cursor->getRecordID()] = document;
+	reopened.close();
+
+	std::stringstream ss;
+	ss << "Log records " << expected.size() << " (versions and tombstones: " << result;
+	ss << ", replayed on open: " << replayed << ")";
+	printResult(ss.str().c_str(), result && replayed);
+	return result && replayed;
+}
+
+
+
+bool TestLogFileIO::cleaning() {
+
+	LogFileIO log;
+	log.open(fileName, false, DEFAULT_CACHE, TEST_SEGMENT_SIZE, false);
+
+	// cleaning moves live records and reuses segments
+	double garbageBefore = log.getGarbageRatio();
+	uint64_t segmentsBefore = log.getTotalSegments();
+	uint32_t cleaned = log.clean(0.0);
+	double garbageAfter = log.getGarbageRatio();
+	bool result = cleaned > 0 && garbageAfter < garbageBefore && log.getFreeSegments() > 0;
+	result = result && verifyRecords(log);
+
+	// new versions fill cleaned segments before file grows
+	std::mt19937 random(2030);
+	uint64_t fileSize = log.getFileSize();
+	uint64_t freeSegments = log.getFreeSegments();
+	uint64_t written = 0;
+	for (auto& [recordID, document] : expected) {
+		if (written + document.size() > (freeSegments - 1) * (TEST_SEGMENT_SIZE / 2)) break;
+		document = makeDocument(random, document.size());
+		auto cursor = log.getRecordByID(recordID);
+		result = result && cursor != nullptr && cursor->setRecordData(document.data(), (uint32_t)document.size());
+		written += document.size();
+	}
+	bool reused = log.getFileSize() == fileSize;
+	log.close();
+
+	// removed records stay removed after their tombstones are cleaned
+	LogFileIO reopened;
+	reopened.open(fileName, false, DEFAULT_CACHE, TEST_SEGMENT_SIZE, false);
+	bool consistent = verifyRecords(reopened);
+	reopened.close();
+
+	result = result && reused && consistent;
+
+	std::stringstream ss;
+	ss << "Segment cleaning " << cleaned << "/" << segmentsBefore << " segments, garbage ";
+	ss << garbageBefore * 100 << "% -> " << garbageAfter * 100 << "% (reused: " << reused;
+	ss << ", consistent after reopen: " << consistent << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestLogFileIO::backgroundCleaning() {
+
+	const char* backgroundFile = "log_background.bin";
+	if (std::filesystem::exists(backgroundFile)) std::filesystem::remove(backgroundFile);
+
+	LogFileIO log;
+	log.open(backgroundFile, false, DEFAULT_CACHE, TEST_SEGMENT_SIZE, true);
+
+	// hot set of records rewritten many times
+	std::mt19937 random(2031);
+	std::map<uint64_t, std::string> hot;
+	uint64_t liveBytes = 0;
+	for (size_t i = 0; i < 200; i++) {
+		std::string document = makeDocument(random, 500);
+		auto cursor = log.createRecord(document.data(), (uint32_t)document.size());
+		hot[cursor->getRecordID()] = document;
+		liveBytes += document.size();
+	}
+	for (int round = 0; round < 100; round++) {
+		for (auto& [recordID, document] : hot) {
+			document = makeDocument(random, 400 + random() % 200);
+			log.getRecordByID(recordID)->setRecordData(document.data(), (uint32_t)document.size());
+		}
+	}
+	uint64_t peakSize = log.getFileSize();
+
+	// cleaner catches up, then new versions fit cleaned segments
+	for (int wait = 0; wait < 50 && log.getGarbageRatio() > LOG_CLEANING_GARBAGE_RATIO; wait++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(LOG_CLEANING_PERIOD_MS));
+	}
+	bool bounded = log.getGarbageRatio() <= LOG_CLEANING_GARBAGE_RATIO && log.getSegmentsCleaned() > 0;
+	for (auto& [recordID, document] : hot) {
+		document = makeDocument(random, 400 + random() % 200);
+		log.getRecordByID(recordID)->setRecordData(document.data(), (uint32_t)document.size());
+	}
+	bounded = bounded && log.getFileSize() == peakSize;
+
+	bool consistent = true;
+	std::vector<uint8_t> data;
+	for (auto& [recordID, document] : hot) {
+		auto cursor = log.getRecordByID(recordID);
+		data.resize(document.size());
+		consistent = consistent && cursor != nullptr && cursor->getRecordData(data.data());
+		consistent = consistent && memcmp(data.data(), document.data(), document.size()) == 0;
+	}
+	uint64_t cleaned = log.getSegmentsCleaned();
+	log.close();
+
+	bool result = bounded && consistent;
+
+	std::stringstream ss;
+	ss << "Background cleaning " << cleaned << " segments, peak file " << peakSize / 1024 << "Kb for ";
+	ss << liveBytes / 1024 << "Kb live data (bounded: " << bounded << ", consistent: " << consistent << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+void TestLogFileIO::writeBenchmark() {
+
+	const char* logFile = "log_benchmark.bin";
+	const char* recordsFile = "records_benchmark.bin";
+	for (auto name : { logFile, recordsFile }) {
+		if (std::filesystem::exists(name)) std::filesystem::remove(name);
+	}
+
+	// mostly new article versions and appended comments
+	std::mt19937 random(2032);
+	size_t articles = samplesCount / 5;
+	std::vector<std::string> documents;
+	std::vector<uint64_t> targets;
+	for (size_t i = 0; i < samplesCount * 4; i++) {
+		bool comment = random() % 10 < 3;
+		documents.push_back(makeDocument(random, comment ? 200 + random() % 200 : 600 + random() % 900));
+		targets.push_back(comment ? 0 : random() % articles + 1);
+	}
+	uint64_t payload = 0;
+	for (auto& document : documents) payload += document.size();
+
+	auto run = [&](auto& storage) {
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < articles; i++) storage.createRecord(documents[i].data(), (uint32_t)documents[i].size());
+		for (size_t i = articles; i < documents.size(); i++) {
+			if (targets[i] == 0) storage.createRecord(documents[i].data(), (uint32_t)documents[i].size());
+			else storage.getRecordByID(targets[i])->setRecordData(documents[i].data(), (uint32_t)documents[i].size());
+		}
+		storage.flush();
+		auto endTime = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double>(endTime - startTime).count();
+	};
+
+	double logTime, recordsTime;
+	{
+		LogFileIO log;
+		log.open(logFile);
+		logTime = run(log);
+	}
+	{
+		RecordFileIO records;
+		records.open(recordsFile);
+		recordsTime = run(records);
+	}
+
+	std::stringstream ss;
+	ss << "Versions and comments write: log " << payload / 1024.0 / 1024.0 / logTime << " Mb/s, ";
+	ss << "records file " << payload / 1024.0 / 1024.0 / recordsTime << " Mb/s (x" << recordsTime / logTime << ")";
+	printResult(ss.str().c_str(), true);
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+*
+*  LogFileIO class test header
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <string>
+#include <filesystem>
+
+#include "CloudlessTests.h"
+#include "LogFileIO.h"
+#include "RecordFileIO.h"
+
+namespace Cloudless {
+
+	namespace Tests {
+
+		class TestLogFileIO : public ITestCase {
+		public:
+			std::string getName() const override;
+			void init() override;
+			void execute() override;
+			bool verify() const override;
+			void cleanup() override;
+		private:
+			bool consistency();
+			bool cleaning();
+			bool backgroundCleaning();
+			void writeBenchmark();
+			bool verifyRecords(Storage::LogFileIO& log);
+			std::string makeDocument(std::mt19937& random, size_t length);
+
+			const char* fileName;
+			size_t samplesCount;
+			std::map<uint64_t, std::string> expected;   // Record data by record ID
+		};
+	}
+
+}
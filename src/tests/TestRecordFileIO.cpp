@@ -16,6 +16,174 @@ using namespace Cloudless::Storage;
 using namespace Cloudless::Tests;
 
 
+//-----------------------------------------------------------------------------
+// Previous record locks implementation (global map of shared pointers),
+// kept to compare lock table throughput against it
+//-----------------------------------------------------------------------------
+class MapRecordLocks {
+public:
+	void lock(uint64_t offset, bool exclusive) {
+		std::shared_ptr<LegacyLock> recordLock;
+		{
+			std::shared_lock mapLock(locksMutex);
+			auto it = locks.find(offset);
+			if (it != locks.end()) {
+				recordLock = it->second;
+				recordLock->counter.fetch_add(1);
+			}
+		}
+		if (!recordLock) {
+			std::unique_lock mapLock(locksMutex);
+			auto it = locks.find(offset);
+			if (it == locks.end()) {
+				recordLock = std::make_shared<LegacyLock>();
+				locks[offset] = recordLock;
+			} else recordLock = it->second;
+			recordLock->counter.fetch_add(1);
+		}
+		if (exclusive) recordLock->mutex.lock(); else recordLock->mutex.lock_shared();
+	}
+
+	void unlock(uint64_t offset, bool exclusive) {
+		std::shared_ptr<LegacyLock> recordLock;
+		{
+			std::shared_lock mapLock(locksMutex);
+			auto it = locks.find(offset);
+			if (it == locks.end() || !it->second) return;
+			recordLock = it->second;
+		}
+		if (exclusive) recordLock->mutex.unlock(); else recordLock->mutex.unlock_shared();
+		{
+			std::unique_lock mapLock(locksMutex);
+			if (recordLock->counter.fetch_sub(1) == 1) locks.erase(offset);
+		}
+	}
+
+private:
+	struct LegacyLock {
+		std::shared_mutex    mutex;
+		std::atomic<int32_t> counter{ 0 };
+	};
+	std::shared_mutex locksMutex;
+	std::unordered_map<uint64_t, std::shared_ptr<LegacyLock>> locks;
+};
+
+
+
+//-----------------------------------------------------------------------------
+// Records file which stops commit right after transaction journal is written,
+// as if process was terminated, to check journal is applied on next open
+//-----------------------------------------------------------------------------
+class InterruptedCommitFile : public RecordFileIO {
+public:
+	uint64_t reserveID() { return reserveRecordID(); }
+	bool writeJournalOnly(const TransactionWrites& writes) { return writeJournal(writes) != NOT_FOUND; }
+	bool applyFirstWrite(const TransactionWrites& writes) {
+		if (writeJournal(writes) == NOT_FOUND) return false;
+		auto first = writes.begin();
+		return applyWrite(first->first, first->second) && cachedFile.flush();
+	}
+	bool commitWrites(const TransactionWrites& writes) { return commitTransaction({}, writes); }
+	bool createReserved(uint64_t recordID, const std::string& data) {
+		return insertRecord(recordID, data.data(), (uint32_t)data.size()) != nullptr;
+	}
+};
+
+
+
+//-----------------------------------------------------------------------------
+// Writes records file of format version 1, 2 or 6 as earlier releases did:
+// smaller storage header, Adler-32 checksums, record ID table since version 2,
+// header checksum since version 3. Free record follows the first record, so
+// both overlap current header (version 6: ID table page overlaps it).
+//-----------------------------------------------------------------------------
+static void putLegacyRecord(std::vector<uint8_t>& file, uint64_t offset, RecordHeader header, const void* data, uint32_t length) {
+	header.dataLength = length;
+	header.dataChecksum = length > 0 ? Checksum::adler32((const uint8_t*)data, length) : 0;
+	header.headChecksum = Checksum::adler32((const uint8_t*)&header, RECORD_HEADER_PAYLOAD_SIZE);
+	file.resize(std::max<uint64_t>(file.size(), offset + RECORD_HEADER_SIZE + header.recordCapacity));
+	memcpy(file.data() + offset, &header, RECORD_HEADER_SIZE);
+	if (length > 0) memcpy(file.data() + offset + RECORD_HEADER_SIZE, data, length);
+}
+
+static bool writeLegacyFile(const char* path, uint32_t version, const std::vector<std::string>& records) {
+
+	constexpr uint32_t FREE_CAPACITY = 16;
+	uint64_t headerSize = (version == 1) ? 64 : (version == 2) ? 80 : 120;
+	uint64_t position = headerSize;
+	uint64_t idTablePage = NOT_FOUND;
+	if (version >= 2) {
+		idTablePage = position;
+		position += RECORD_HEADER_SIZE + ID_TABLE_PAGE_CAPACITY;
+	}
+
+	// place records one after another, free record after the first one
+	std::vector<uint64_t> offsets;
+	uint64_t freeRecord = NOT_FOUND;
+	for (size_t i = 0; i < records.size(); i++) {
+		offsets.push_back(position);
+		position += RECORD_HEADER_SIZE + records[i].size();
+		if (i == 0) {
+			freeRecord = position;
+			position += RECORD_HEADER_SIZE + FREE_CAPACITY;
+		}
+	}
+
+	std::vector<uint8_t> file(headerSize);
+	std::vector<uint64_t> idTable(ID_TABLE_PAGE_CAPACITY / sizeof(uint64_t), NOT_FOUND);
+	RecordHeader header{};
+	for (size_t i = 0; i < records.size(); i++) {
+		header.previous = (i > 0) ? offsets[i - 1] : NOT_FOUND;
+		header.next = (i + 1 < records.size()) ? offsets[i + 1] : NOT_FOUND;
+		header.bitFlags = (version >= 2) ? i + 1 : 0;
+		header.recordCapacity = (uint32_t)records[i].size();
+		putLegacyRecord(file, offsets[i], header, records[i].data(), header.recordCapacity);
+		idTable[i + 1] = offsets[i];
+	}
+	header.previous = NOT_FOUND;
+	header.next = NOT_FOUND;
+	header.bitFlags = RECORD_DELETED_FLAG;
+	header.recordCapacity = FREE_CAPACITY;
+	putLegacyRecord(file, freeRecord, header, nullptr, 0);
+	if (version >= 2) {
+		header.bitFlags = RECORD_SYSTEM_FLAG;
+		header.recordCapacity = ID_TABLE_PAGE_CAPACITY;
+		putLegacyRecord(file, idTablePage, header, idTable.data(), ID_TABLE_PAGE_CAPACITY);
+	}
+
+	// older header is a prefix of current one
+	StorageHeader sh{};
+	sh.signature = KNOWLEDGE_SIGNATURE;
+	sh.version = version;
+	sh.endOfData = position;
+	sh.totalRecords = records.size();
+	sh.firstRecord = offsets.front();
+	sh.lastRecord = offsets.back();
+	sh.totalFreeRecords = 1;
+	sh.firstFreeRecord = freeRecord;
+	sh.lastFreeRecord = freeRecord;
+	sh.nextRecordID = records.size() + 1;
+	sh.idTableRecord = idTablePage;
+	sh.firstFreeOverflowPage = NOT_FOUND;
+	sh.lastDictionary = NOT_FOUND;
+	sh.transactionJournal = NOT_FOUND;
+	if (version < 3) memcpy(file.data(), &sh, headerSize);
+	else {
+		uint32_t checksumType = (uint32_t)ChecksumType::ADLER32;
+		memcpy(file.data(), &sh, headerSize - 2 * sizeof(uint32_t));
+		memcpy(file.data() + headerSize - 2 * sizeof(uint32_t), &checksumType, sizeof(uint32_t));
+		uint32_t headerChecksum = Checksum::adler32(file.data(), headerSize - sizeof(uint32_t));
+		memcpy(file.data() + headerSize - sizeof(uint32_t), &headerChecksum, sizeof(uint32_t));
+	}
+
+	// cached file writes whole pages
+	file.resize((file.size() + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE);
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)file.data(), file.size());
+	return out.good();
+}
+
+
 std::string TestRecordFileIO::getName() const {
 	return "RecordFileIO input, output, consistency and performance";
 }
@@ -43,6 +211,19 @@ void TestRecordFileIO::execute() {
 
 	singlethreaded();
 	multithreaded();
+	scanRecords();
+	parallelScan();
+	reuseFreeSpace();
+	compaction();
+	stableRecordIDs();
+	formatUpgrade();
+	streamingRecords();
+	overflowRecords();
+	compressedRecords();
+	dictionaryCompression();
+	snapshotIsolation();
+	transactions();
+	recordLocksBenchmark();
 
 	std::stringstream ss;
 	ss << "Total records: " << db->getTotalRecords();
@@ -521,4 +702,1152 @@ bool TestRecordFileIO::editRecords(bool verbose) {
 		printResult(ss.str().c_str(), result);
 	}
 	return result;	
-}
\ No newline at end of file
+}
+
+
+
+bool TestRecordFileIO::scanRecords() {
+
+	std::vector<uint8_t> buffer;
+	uint64_t cursorRecords = 0, cursorBytes = 0;
+	uint64_t scanRecords = 0, scanBytes = 0;
+
+	// Traverse all records with cursor
+	auto startTime = std::chrono::high_resolution_clock::now();
+	auto cursor = db->getFirstRecord();
+	while (cursor != nullptr) {
+		buffer.resize(cursor->getDataLength());
+		if (!cursor->getRecordData(buffer.data())) break;
+		cursorRecords++;
+		cursorBytes += buffer.size();
+		if (!cursor->next()) break;
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double cursorDuration = (endTime - startTime).count() / 1000000000.0;
+
+	// Traverse all records with scanner
+	startTime = std::chrono::high_resolution_clock::now();
+	RecordScanner scanner(*db);
+	ScanRecord record;
+	while (scanner.next(record)) {
+		scanRecords++;
+		scanBytes += record.length;
+	}
+	endTime = std::chrono::high_resolution_clock::now();
+	double scanDuration = (endTime - startTime).count() / 1000000000.0;
+
+	bool result = !scanner.isInterrupted() && scanRecords == db->getTotalRecords();
+	result = result && scanRecords == cursorRecords && scanBytes == cursorBytes;
+
+	std::stringstream ss;
+	ss << "Scanning " << scanRecords << " records: cursor " << cursorDuration << "s, ";
+	ss << "scanner " << scanDuration << "s (x" << cursorDuration / scanDuration << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::parallelScan() {
+
+	// Collect record positions with sequential scanner
+	std::vector<uint64_t> expected;
+	uint64_t expectedBytes = 0;
+	RecordScanner scanner(*db);
+	ScanRecord record;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	while (scanner.next(record)) {
+		expected.push_back(record.offset);
+		expectedBytes += record.length;
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double scanDuration = (endTime - startTime).count() / 1000000000.0;
+	std::sort(expected.begin(), expected.end());
+
+	// Unordered parallel scan - records delivered concurrently by workers
+	std::mutex resultMutex;
+	std::vector<uint64_t> unordered;
+	std::atomic<uint64_t> unorderedBytes = 0;
+	ParallelScanner parallelScanner(*db);
+	startTime = std::chrono::high_resolution_clock::now();
+	bool result = parallelScanner.scan([&](const ScanRecord& r) {
+		unorderedBytes += r.length;
+		std::lock_guard lock(resultMutex);
+		unordered.push_back(r.offset);
+		return true;
+	});
+	endTime = std::chrono::high_resolution_clock::now();
+	double parallelDuration = (endTime - startTime).count() / 1000000000.0;
+	std::sort(unordered.begin(), unordered.end());
+	result = result && unordered == expected && unorderedBytes == expectedBytes;
+	result = result && parallelScanner.getResyncs() == 0;
+
+	// Ordered parallel scan - records delivered in file order
+	std::vector<uint64_t> ordered;
+	ParallelScanner orderedScanner(*db, 4, true);
+	result = result && orderedScanner.scan([&](const ScanRecord& r) {
+		ordered.push_back(r.offset);
+		return true;
+	});
+	result = result && ordered == expected;
+
+	// Scan stopped by callback
+	uint64_t visited = 0;
+	ParallelScanner stoppedScanner(*db, 4, true);
+	bool stopped = !stoppedScanner.scan([&](const ScanRecord&) { return ++visited < 10; });
+	result = result && (expected.size() < 10 || (stopped && visited == 10));
+
+	std::stringstream ss;
+	ss << "Parallel scan of " << unordered.size() << " records: scanner " << scanDuration << "s, ";
+	ss << "parallel " << parallelDuration << "s (x" << scanDuration / parallelDuration << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::reuseFreeSpace() {
+
+	const char* fragmentsFile = "fragments.bin";
+	if (std::filesystem::exists(fragmentsFile)) {
+		std::filesystem::remove(fragmentsFile);
+	}
+
+	RecordFileIO rf;
+	if (!rf.open(fragmentsFile)) return false;
+
+	// create three adjacent records of 1000 bytes
+	std::vector<char> data(1000, 'X');
+	std::vector<std::shared_ptr<RecordCursor>> cursors;
+	for (int i = 0; i < 3; i++) {
+		cursors.push_back(rf.createRecord(data.data(), (uint32_t)data.size()));
+	}
+
+	// delete first and last records, then the middle one to merge all of them
+	rf.removeRecord(cursors[0]);
+	rf.removeRecord(cursors[2]);
+	bool merged = rf.getTotalFreeRecords() == 2;
+	rf.removeRecord(cursors[1]);
+	merged = merged && rf.getTotalFreeRecords() == 1 && rf.getTotalRecords() == 0;
+
+	// small record takes only requested capacity, remainder stays free
+	auto small = rf.createRecord(data.data(), 100);
+	bool split = small != nullptr && small->getRecordCapacity() == 100;
+	split = split && rf.getTotalFreeRecords() == 1 && rf.getTotalRecords() == 1;
+
+	// remainder should be big enough for two more records without file growth
+	auto first = rf.createRecord(data.data(), 1000);
+	auto second = rf.createRecord(data.data(), 1000);
+	split = split && first != nullptr && second != nullptr;
+	split = split && first->getPosition() < second->getPosition();
+	split = split && second->getPosition() < cursors[2]->getPosition() + RECORD_HEADER_SIZE + 1000;
+
+	// reading all records in ascending order after reuse
+	size_t counter = 0;
+	auto cursor = rf.getFirstRecord();
+	while (cursor != nullptr && cursor->getRecordData(data.data())) {
+		counter++;
+		if (!cursor->next()) break;
+	}
+	bool consistent = counter == rf.getTotalRecords();
+
+	rf.close();
+
+	bool result = merged && split && consistent;
+	std::stringstream ss;
+	ss << "Free records split and merge (merged: " << merged << ", split: " << split << ", consistent: " << consistent << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::compaction() {
+
+	const char* compactionFile = "compaction.bin";
+	if (std::filesystem::exists(compactionFile)) {
+		std::filesystem::remove(compactionFile);
+	}
+
+	RecordFileIO rf;
+	if (!rf.open(compactionFile)) return false;
+
+	// generate records and delete every second one in the first half of file
+	char buffer[1024];
+	size_t recordsCount = samplesCount;
+	for (size_t i = 0; i < recordsCount; i++) {
+		int length = snprintf(buffer, sizeof(buffer), "Compaction record #%zu with random number %d", i, std::rand());
+		rf.createRecord(buffer, (uint32_t)length);
+	}
+	auto cursor = rf.getFirstRecord();
+	for (size_t i = 0; i < recordsCount / 2 && cursor != nullptr; i++) {
+		if (i % 2 == 0) rf.removeRecord(cursor); else cursor->next();
+	}
+	rf.flush();
+	uint64_t totalRecords = rf.getTotalRecords();
+	uint64_t fileSizeBefore = rf.getFileSize();
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	bool result = rf.compact();
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double duration = (endTime - startTime).count() / 1000000000.0;
+	uint64_t fileSizeAfter = rf.getFileSize();
+
+	// check all records are still readable and linked
+	size_t counter = 0;
+	cursor = rf.getFirstRecord();
+	while (cursor != nullptr && cursor->getRecordData(buffer)) {
+		counter++;
+		if (!cursor->next()) break;
+	}
+	result = result && (counter == totalRecords) && (fileSizeAfter < fileSizeBefore);
+	result = result && rf.getCompactionStats(CompactionStats::BYTES_RECLAIMED) == double(fileSizeBefore - fileSizeAfter);
+
+	std::stringstream ss;
+	ss << "Compaction moved " << rf.getCompactionStats(CompactionStats::RECORDS_MOVED) << " records ";
+	ss << "and reclaimed " << rf.getCompactionStats(CompactionStats::BYTES_RECLAIMED) << " bytes in " << duration << "s";
+	printResult(ss.str().c_str(), result);
+
+	rf.close();
+	return result;
+}
+
+
+
+bool TestRecordFileIO::streamingRecords() {
+
+	const char* streamsFile = "streams.bin";
+	if (std::filesystem::exists(streamsFile)) {
+		std::filesystem::remove(streamsFile);
+	}
+
+	RecordFileIO rf;
+	if (!rf.open(streamsFile)) return false;
+
+	// source data of several chunks with incomplete last chunk
+	std::vector<uint8_t> source(16 * RECORD_CHUNK_SIZE + 123);
+	for (size_t i = 0; i < source.size(); i++) source[i] = (uint8_t)(std::rand() & 0xFF);
+
+	// abandoned writer must not leave a record
+	{
+		RecordWriter abandoned(rf, 1000);
+		abandoned.write(source.data(), 500);
+	}
+	bool written = rf.getTotalRecords() == 0;
+
+	// stream record in uneven pieces
+	RecordWriter writer(rf, (uint32_t)source.size());
+	for (size_t position = 0; position < source.size(); position += 10000) {
+		uint32_t length = (uint32_t)std::min<size_t>(10000, source.size() - position);
+		written = written && writer.write(source.data() + position, length);
+	}
+	auto cursor = writer.commit();
+	written = written && cursor != nullptr && rf.getTotalRecords() == 1;
+	if (!written) {
+		printResult("Streaming records (written: 0)", false);
+		return false;
+	}
+	uint64_t recordID = cursor->getRecordID();
+
+	// read it sequentially by reader and whole by cursor
+	std::vector<uint8_t> data(source.size());
+	RecordReader reader(cursor);
+	uint32_t bytesRead = 0, length;
+	while ((length = reader.read(data.data() + bytesRead, 4096)) > 0) bytesRead += length;
+	bool read = !reader.isFailed() && bytesRead == source.size() && data == source;
+	std::fill(data.begin(), data.end(), 0);
+	read = read && cursor->getRecordData(data.data()) && data == source;
+
+	// ranges crossing chunk boundary are verified and written in place
+	uint8_t range[100], patch[100];
+	std::fill(patch, patch + sizeof(patch), 0xAB);
+	uint32_t position = 3 * RECORD_CHUNK_SIZE - 50;
+	read = read && cursor->readRange(position, range, sizeof(range)) == sizeof(range);
+	read = read && memcmp(range, source.data() + position, sizeof(range)) == 0;
+	bool edited = cursor->writeRange(position, patch, sizeof(patch));
+	memcpy(source.data() + position, patch, sizeof(patch));
+	edited = edited && cursor->getPosition() == rf.getRecordByID(recordID)->getPosition();
+	edited = edited && cursor->getRecordData(data.data()) && data == source;
+	edited = edited && !cursor->writeRange((uint32_t)source.size() - 10, patch, sizeof(patch));
+
+	// plain record supports ranges too
+	auto plain = rf.createRecord(source.data(), 1000);
+	edited = edited && plain->writeRange(10, patch, 20);
+	edited = edited && plain->readRange(0, range, 40) == 40 && memcmp(range + 10, patch, 20) == 0;
+
+	// scanners see chunked record data
+	RecordScanner scanner(rf);
+	ScanRecord record;
+	bool scanned = scanner.next(record) && record.length == source.size();
+	scanned = scanned && memcmp(record.data, source.data(), source.size()) == 0;
+
+	// corrupt byte in chunk 5 is detected only by reads touching chunk 5
+	uint64_t corruptPosition = cursor->getPosition() + RECORD_HEADER_SIZE;
+	corruptPosition += RecordFileIO::getChunksCount((uint32_t)source.size()) * sizeof(uint32_t);
+	corruptPosition += 5 * RECORD_CHUNK_SIZE + 10;
+	rf.close();
+	{
+		std::fstream file(streamsFile, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(corruptPosition);
+		file.put((char)(source[5 * RECORD_CHUNK_SIZE + 10] ^ 0xFF));
+	}
+	bool corruption = rf.open(streamsFile);
+	cursor = corruption ? rf.getRecordByID(recordID) : nullptr;
+	corruption = corruption && cursor != nullptr;
+	corruption = corruption && cursor->readRange(0, data.data(), 5 * RECORD_CHUNK_SIZE) == 5 * RECORD_CHUNK_SIZE;
+	corruption = corruption && cursor->readRange(5 * RECORD_CHUNK_SIZE, data.data(), 100) == 0;
+	corruption = corruption && cursor->readRange(6 * RECORD_CHUNK_SIZE, data.data(), 100) == 100;
+	corruption = corruption && !cursor->getRecordData(data.data());
+
+	// write ending in corrupt chunk 5 is rejected before chunk 4 is changed
+	corruption = corruption && !cursor->writeRange(5 * RECORD_CHUNK_SIZE - 50, patch, sizeof(patch));
+	corruption = corruption && cursor->readRange(4 * RECORD_CHUNK_SIZE, data.data(), RECORD_CHUNK_SIZE) == RECORD_CHUNK_SIZE;
+	corruption = corruption && memcmp(data.data(), source.data() + 4 * RECORD_CHUNK_SIZE, RECORD_CHUNK_SIZE) == 0;
+	rf.close();
+
+	bool result = written && read && edited && scanned && corruption;
+
+	std::stringstream ss;
+	ss << "Streaming records (written: " << written << ", read: " << read << ", edited: " << edited;
+	ss << ", scanned: " << scanned << ", corruption detected: " << corruption << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::overflowRecords() {
+
+	const char* overflowFile = "overflow.bin";
+	if (std::filesystem::exists(overflowFile)) {
+		std::filesystem::remove(overflowFile);
+	}
+
+	RecordFileIO rf;
+	if (!rf.open(overflowFile)) return false;
+
+	// large record with incomplete last page
+	std::vector<uint8_t> source(OVERFLOW_THRESHOLD + 10 * OVERFLOW_PAGE_SIZE + 321);
+	for (size_t i = 0; i < source.size(); i++) source[i] = (uint8_t)(std::rand() & 0xFF);
+	uint32_t pagesCount = RecordFileIO::getChunksCount((uint32_t)source.size());
+
+	auto cursor = rf.createRecord(source.data(), (uint32_t)source.size());
+	bool created = cursor != nullptr && rf.getTotalRecords() == 1;
+	if (!created) {
+		printResult("Overflow records (created: 0)", false);
+		return false;
+	}
+	uint64_t recordID = cursor->getRecordID();
+	std::vector<uint8_t> data(source.size());
+	created = cursor->getRecordData(data.data()) && data == source;
+
+	// one byte edit writes one new page and releases one old page
+	uint64_t fileSize = rf.getFileSize();
+	source[7 * OVERFLOW_PAGE_SIZE + 5] ^= 0xFF;
+	bool edited = cursor->setRecordData(source.data(), (uint32_t)source.size());
+	edited = edited && rf.getTotalFreeOverflowPages() == 1;
+	edited = edited && rf.getFileSize() - fileSize < 2 * OVERFLOW_PAGE_SIZE;
+	edited = edited && cursor->getRecordData(data.data()) && data == source;
+
+	// appended data reuses released page and shares all other pages
+	source.resize(source.size() + 1000, 0x5A);
+	edited = edited && cursor->setRecordData(source.data(), (uint32_t)source.size());
+	edited = edited && rf.getTotalFreeOverflowPages() == 1;
+	data.resize(source.size());
+	edited = edited && cursor->getRecordData(data.data()) && data == source;
+
+	// ranges are read and written in place in pages
+	uint8_t range[100], patch[100];
+	std::fill(patch, patch + sizeof(patch), 0xCD);
+	uint32_t position = 2 * OVERFLOW_PAGE_SIZE - 40;
+	bool ranges = cursor->writeRange(position, patch, sizeof(patch));
+	memcpy(source.data() + position, patch, sizeof(patch));
+	ranges = ranges && cursor->readRange(position - 10, range, sizeof(range)) == sizeof(range);
+	ranges = ranges && memcmp(range, source.data() + position - 10, sizeof(range)) == 0;
+
+	// scanners read data from pages
+	RecordScanner scanner(rf);
+	ScanRecord record;
+	bool scanned = scanner.next(record) && record.length == source.size();
+	scanned = scanned && memcmp(record.data, source.data(), source.size()) == 0;
+	ParallelScanner parallelScanner(rf, 2);
+	parallelScanner.scan([&](const ScanRecord& record) {
+		scanned = scanned && record.length == source.size() && memcmp(record.data, source.data(), source.size()) == 0;
+		return true;
+	});
+	scanned = scanned && parallelScanner.getScannedRecords() == 1;
+
+	// free pages map survives reopen
+	rf.close();
+	bool reused = rf.open(overflowFile) && rf.getTotalFreeOverflowPages() == 1;
+	cursor = rf.getRecordByID(recordID);
+	reused = reused && cursor != nullptr && cursor->getRecordData(data.data()) && data == source;
+
+	// record shrunk below threshold releases all pages (appended data fits last page)
+	uint64_t freePages = pagesCount + 1;
+	reused = reused && cursor->setRecordData(source.data(), 1000);
+	reused = reused && rf.getTotalFreeOverflowPages() == freePages;
+	reused = reused && cursor->getDataLength() == 1000;
+
+	// new large record reuses free pages without file growth
+	fileSize = rf.getFileSize();
+	auto second = rf.createRecord(source.data(), OVERFLOW_THRESHOLD);
+	reused = reused && second != nullptr && rf.getFileSize() == fileSize;
+	reused = reused && rf.getTotalFreeOverflowPages() == freePages - OVERFLOW_THRESHOLD / OVERFLOW_PAGE_SIZE;
+
+	// removed record releases its pages
+	reused = reused && rf.removeRecord(second);
+	reused = reused && rf.getTotalFreeOverflowPages() == freePages;
+	rf.close();
+	reused = reused && rf.open(overflowFile) && rf.getTotalFreeOverflowPages() == freePages;
+	rf.close();
+
+	bool result = created && edited && ranges && scanned && reused;
+
+	std::stringstream ss;
+	ss << "Overflow records (created: " << created << ", edited: " << edited << ", ranges: " << ranges;
+	ss << ", scanned: " << scanned << ", pages reused: " << reused << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+/*
+*  @brief Generates JSON article document of about 500-1500 bytes
+*/
+static std::string makeArticle(size_t index, std::mt19937& random) {
+	static const char* words[] = { "storage", "record", "index", "page", "cache", "knowledge",
+		"document", "query", "graph", "node", "search", "cloud", "data", "value", "field" };
+	std::stringstream ss;
+	ss << "{\"id\":" << index << ",\"type\":\"article\",\"author\":{\"id\":" << random() % 100;
+	ss << ",\"name\":\"Author " << random() % 100 << "\"},\"tags\":[\"" << words[random() % 15] << "\",\"";
+	ss << words[random() % 15] << "\"],\"title\":\"";
+	for (int i = 0; i < 6; i++) ss << words[random() % 15] << (i < 5 ? " " : "\",\"text\":\"");
+	size_t wordsCount = 60 + random() % 140;
+	for (size_t i = 0; i < wordsCount; i++) ss << words[random() % 15] << (i % 12 == 11 ? ". " : " ");
+	ss << "\",\"views\":" << random() % 100000 << ",\"published\":true}";
+	return ss.str();
+}
+
+
+
+bool TestRecordFileIO::compressedRecords() {
+
+	const char* plainFile = "uncompressed.bin";
+	const char* compressedFile = "compressed.bin";
+	for (const char* name : { plainFile, compressedFile }) {
+		if (std::filesystem::exists(name)) std::filesystem::remove(name);
+	}
+
+	// codec round trip for empty, tiny, repetitive and incompressible data
+	std::mt19937 random(2025);
+	std::vector<uint8_t> noise(100000), packed, unpacked;
+	for (auto& byte : noise) byte = (uint8_t)random();
+	std::vector<std::vector<uint8_t>> samples = { {}, { 1, 2, 3 }, std::vector<uint8_t>(70000, 'A'), noise };
+	bool codec = true;
+	for (auto& sample : samples) {
+		uint32_t sampleLength = (uint32_t)sample.size();
+		packed.resize(Compression::getMaxCompressedLength(sampleLength));
+		unpacked.resize(sampleLength);
+		uint32_t packedLength = Compression::compress(sample.data(), sampleLength, packed.data(), (uint32_t)packed.size());
+		codec = codec && packedLength > 0 && Compression::decompress(packed.data(), packedLength, unpacked.data(), sampleLength);
+		codec = codec && unpacked == sample;
+		// truncated block must be rejected
+		codec = codec && (packedLength < 2 || !Compression::decompress(packed.data(), packedLength - 1, unpacked.data(), sampleLength));
+	}
+
+	// same JSON articles are written to uncompressed and compressed files
+	std::vector<std::string> articles;
+	size_t payload = 0;
+	for (size_t i = 0; i < samplesCount; i++) {
+		articles.push_back(makeArticle(i, random));
+		payload += articles.back().size();
+	}
+
+	double writeTime[2], readTime[2];
+	uint64_t fileSize[2];
+	bool consistent = true;
+
+	for (int compressed = 0; compressed < 2; compressed++) {
+		RecordFileIO rf;
+		if (!rf.open(compressed ? compressedFile : plainFile)) return false;
+		if (compressed) rf.setCompression(CompressionType::LZ);
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (auto& article : articles) {
+			consistent = consistent && rf.createRecord(article.data(), (uint32_t)article.size()) != nullptr;
+		}
+		rf.flush();
+		auto midTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<char> buffer(4096);
+		auto cursor = rf.getFirstRecord();
+		size_t index = 0;
+		if (cursor != nullptr) do {
+			uint32_t length = cursor->getDataLength();
+			bool read = index < articles.size() && length == articles[index].size() && cursor->getRecordData(buffer.data());
+			consistent = consistent && read && memcmp(buffer.data(), articles[index].data(), length) == 0;
+			index++;
+		} while (cursor->next());
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		consistent = consistent && index == articles.size();
+		writeTime[compressed] = (midTime - startTime).count() / 1000000000.0;
+		readTime[compressed] = (endTime - midTime).count() / 1000000000.0;
+		fileSize[compressed] = rf.getFileSize();
+		rf.close();
+	}
+
+	// edits, ranges and scanners work with compressed and uncompressed records mixed
+	RecordFileIO rf;
+	bool mixed = rf.open(compressedFile);
+	rf.setCompression(CompressionType::LZ);
+	auto cursor = mixed ? rf.getFirstRecord() : nullptr;
+	mixed = mixed && cursor != nullptr;
+	if (mixed) {
+		std::string edited = articles[0] + articles[1];
+		mixed = cursor->setRecordData(edited.data(), (uint32_t)edited.size());
+		mixed = mixed && cursor->getDataLength() == edited.size();
+		articles[0] = edited;
+
+		char range[64];
+		mixed = mixed && cursor->readRange(100, range, sizeof(range)) == sizeof(range);
+		mixed = mixed && memcmp(range, articles[0].data() + 100, sizeof(range)) == 0;
+		memset(range, '#', sizeof(range));
+		mixed = mixed && cursor->writeRange(200, range, sizeof(range));
+		memcpy(articles[0].data() + 200, range, sizeof(range));
+
+		// record written without compression is read as is
+		rf.setCompression(CompressionType::NONE);
+		mixed = mixed && cursor->next() && cursor->setRecordData(articles[1].data(), (uint32_t)articles[1].size());
+		rf.setCompression(CompressionType::LZ);
+		mixed = mixed && cursor->getDataLength() == articles[1].size();
+
+		RecordScanner scanner(rf);
+		ScanRecord record;
+		for (size_t i = 0; i < articles.size() && mixed; i++) {
+			mixed = scanner.next(record) && record.length == articles[i].size();
+			mixed = mixed && memcmp(record.data, articles[i].data(), record.length) == 0;
+		}
+		ParallelScanner parallelScanner(rf);
+		size_t matched = 0;
+		parallelScanner.scan([&](const ScanRecord& record) {
+			auto found = rf.getRecord(record.offset);
+			if (found != nullptr && record.length == found->getDataLength()) matched++;
+			return true;
+		});
+		mixed = mixed && matched == articles.size();
+	}
+	rf.close();
+
+	double ratio = double(fileSize[0]) / double(fileSize[1]);
+	double megabytes = payload / 1024.0 / 1024.0;
+	bool result = codec && consistent && mixed && ratio > 1.0;
+
+	std::stringstream ss;
+	ss << "Compression x" << ratio;
+	ss << ", write " << megabytes / writeTime[0] << "/" << megabytes / writeTime[1] << " Mb/s";
+	ss << ", read " << megabytes / readTime[0] << "/" << megabytes / readTime[1] << " Mb/s (plain/LZ)";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::dictionaryCompression() {
+
+	const char* lzFile = "lz.bin";
+	const char* dictionaryFile = "dictionary.bin";
+	for (const char* name : { lzFile, dictionaryFile }) {
+		if (std::filesystem::exists(name)) std::filesystem::remove(name);
+	}
+
+	std::mt19937 random(2026);
+	std::vector<std::string> articles, expected;
+	size_t payload = 0;
+	for (size_t i = 0; i < samplesCount; i++) {
+		articles.push_back(makeArticle(i, random));
+		payload += articles.back().size();
+	}
+
+	// codec round trip, block compressed with dictionary can't be read without it
+	std::vector<std::vector<uint8_t>> samples;
+	for (size_t i = 0; i < articles.size(); i += 10) samples.emplace_back(articles[i].begin(), articles[i].end());
+	std::vector<uint8_t> trained = Compression::trainDictionary(samples, DICTIONARY_SIZE);
+	CompressionDictionary dictionary(trained.data(), (uint32_t)trained.size());
+	std::vector<uint8_t> packed(8192), unpacked(8192);
+	const uint8_t* sample = (const uint8_t*)articles[1].data();
+	uint32_t sampleLength = (uint32_t)articles[1].size();
+	uint32_t packedLength = Compression::compress(sample, sampleLength, packed.data(), (uint32_t)packed.size(), &dictionary);
+	bool codec = trained.size() == DICTIONARY_SIZE && packedLength > 0;
+	codec = codec && Compression::decompress(packed.data(), packedLength, unpacked.data(), sampleLength, &dictionary);
+	codec = codec && memcmp(unpacked.data(), sample, sampleLength) == 0;
+	codec = codec && !Compression::decompress(packed.data(), packedLength, unpacked.data(), sampleLength);
+
+	// stored bytes of the same records compressed by LZ and by LZ with dictionary
+	uint64_t storedBytes[2] = { 0, 0 };
+	double trainTime = 0, writeTime = 0, readTime = 0;
+	bool versioned = true;
+	for (int withDictionary = 0; withDictionary < 2; withDictionary++) {
+		RecordFileIO rf;
+		if (!rf.open(withDictionary ? dictionaryFile : lzFile)) return false;
+		rf.setCompression(CompressionType::LZ);
+
+		// dictionary is trained on records stored before
+		if (withDictionary) {
+			for (size_t i = 0; i < samplesCount / 10; i++) {
+				rf.createRecord(articles[i].data(), (uint32_t)articles[i].size());
+				expected.push_back(articles[i]);
+			}
+			auto startTime = std::chrono::high_resolution_clock::now();
+			versioned = rf.trainDictionary() == 1 && rf.getDictionaryID() == 1;
+			trainTime = (std::chrono::high_resolution_clock::now() - startTime).count() / 1000000000.0;
+			rf.setCompression(CompressionType::LZ_DICTIONARY);
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (auto& article : articles) {
+			auto cursor = rf.createRecord(article.data(), (uint32_t)article.size());
+			if (cursor != nullptr) storedBytes[withDictionary] += cursor->getRecordCapacity();
+		}
+		rf.flush();
+		writeTime = (std::chrono::high_resolution_clock::now() - startTime).count() / 1000000000.0;
+		rf.close();
+	}
+	expected.insert(expected.end(), articles.begin(), articles.end());
+
+	// retrained dictionary is the new version, records of both versions are readable after reopen
+	RecordFileIO rf;
+	bool consistent = rf.open(dictionaryFile);
+	rf.setCompression(CompressionType::LZ_DICTIONARY);
+	versioned = versioned && consistent && rf.getDictionaryID() == 1 && rf.trainDictionary() == 2;
+	for (size_t i = 0; i < 100 && consistent; i++) {
+		size_t index = samplesCount / 10 + i * 7;
+		const std::string& article = articles[(index * 13) % articles.size()];
+		auto cursor = rf.getRecordByID(index + 1);
+		consistent = cursor != nullptr && cursor->setRecordData(article.data(), (uint32_t)article.size());
+		expected[index] = article;
+	}
+	rf.close();
+
+	consistent = consistent && rf.open(dictionaryFile);
+	versioned = versioned && rf.getDictionaryID() == 2;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::vector<char> buffer(4096);
+	size_t index = 0, readBytes = 0;
+	auto cursor = consistent ? rf.getFirstRecord() : nullptr;
+	if (cursor != nullptr) do {
+		uint32_t length = cursor->getDataLength();
+		bool read = index < expected.size() && length == expected[index].size() && cursor->getRecordData(buffer.data());
+		consistent = consistent && read && memcmp(buffer.data(), expected[index].data(), length) == 0;
+		readBytes += length;
+		index++;
+	} while (cursor->next());
+	readTime = (std::chrono::high_resolution_clock::now() - startTime).count() / 1000000000.0;
+	consistent = consistent && index == expected.size();
+	rf.close();
+
+	bool result = codec && versioned && consistent && storedBytes[1] < storedBytes[0];
+
+	std::stringstream ss;
+	ss << "Dictionary compression x" << double(payload) / storedBytes[1];
+	ss << " (LZ x" << double(payload) / storedBytes[0] << "), train " << trainTime << "s";
+	ss << ", write " << payload / 1024.0 / 1024.0 / writeTime << " Mb/s";
+	ss << ", read " << readBytes / 1024.0 / 1024.0 / readTime << " Mb/s";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::snapshotIsolation() {
+
+	const char* snapshotFile = "snapshots.bin";
+	if (std::filesystem::exists(snapshotFile)) std::filesystem::remove(snapshotFile);
+
+	RecordFileIO rf;
+	if (!rf.open(snapshotFile)) return false;
+
+	size_t recordsCount = samplesCount / 10;
+	std::vector<std::string> initial;
+	for (size_t i = 0; i < recordsCount; i++) {
+		initial.push_back("Record " + std::to_string(i + 1) + " initial version " + std::string(i % 200, '*'));
+		rf.createRecord(initial.back().data(), (uint32_t)initial.back().size());
+	}
+
+	// record streamed before snapshot opened and published after is not visible to it
+	std::string streamed(1000, 'S');
+	RecordWriter writer(rf, (uint32_t)streamed.size());
+	bool isolated = writer.write(streamed.data(), (uint32_t)streamed.size());
+	auto snapshot = std::make_unique<RecordSnapshot>(rf);
+	isolated = isolated && writer.commit() != nullptr;
+
+	// editor updates (records grow and move), overwrites ranges, removes and creates records
+	std::atomic<bool> done = false;
+	std::atomic<size_t> edits = 0;
+	std::thread editor([&]() {
+		std::mt19937 random(2027);
+		for (int round = 0; round < 3; round++) {
+			for (size_t i = 0; i < recordsCount; i++) {
+				auto cursor = rf.getRecordByID(random() % recordsCount + 1);
+				if (cursor == nullptr) continue;
+				std::string data(50 + random() % 500, (char)('a' + round));
+				switch (random() % 8) {
+				case 0: rf.removeRecord(cursor); break;
+				case 1: rf.createRecord(data.data(), (uint32_t)data.size()); break;
+				case 2: cursor->writeRange(0, "#####", 5); break;
+				default: cursor->setRecordData(data.data(), (uint32_t)data.size());
+				}
+				edits++;
+			}
+			rf.compact(COMPACTION_BATCH_SIZE, 0);
+		}
+		done = true;
+	});
+
+	// snapshot sees records as they were when it opened
+	std::vector<uint8_t> data;
+	uint64_t recordID;
+	size_t passes = 0;
+	auto readSnapshot = [&]() {
+		size_t index = 0;
+		bool same = true;
+		snapshot->reset();
+		while (snapshot->next(recordID, data)) {
+			same = same && index < initial.size() && recordID == index + 1 && data.size() == initial[index].size();
+			same = same && memcmp(data.data(), initial[index].data(), data.size()) == 0;
+			index++;
+		}
+		passes++;
+		return same && index == recordsCount;
+	};
+	while (!done.load()) isolated = readSnapshot() && isolated;
+	editor.join();
+	isolated = readSnapshot() && isolated;
+	uint64_t versionsKept = rf.getTotalVersions();
+
+	// new snapshot sees all edits
+	bool latest = true;
+	{
+		RecordSnapshot current(rf);
+		size_t count = 0;
+		while (current.next(recordID, data)) {
+			auto cursor = rf.getRecordByID(recordID);
+			std::vector<uint8_t> actual(cursor != nullptr ? cursor->getDataLength() : 0);
+			latest = latest && cursor != nullptr && cursor->getRecordData(actual.data()) && actual == data;
+			count++;
+		}
+		latest = latest && count == rf.getTotalRecords();
+	}
+
+	// versions are released with the last snapshot needing them
+	snapshot.reset();
+	bool collected = versionsKept > 0 && rf.getTotalVersions() == 0 && rf.getTotalVersionBytes() == 0;
+
+	// the oldest snapshot expires when versions kept for it exceed the limit
+	constexpr uint64_t VERSIONS_LIMIT = 64 * 1024;
+	rf.setVersionsLimit(VERSIONS_LIMIT);
+	std::string replaced(1000, 'R');
+	bool expired = true;
+	{
+		RecordSnapshot oldest(rf);
+		for (int round = 0; round < 2; round++) {
+			for (uint64_t id = 1; id <= 100; id++) {
+				auto cursor = rf.getRecordByID(id);
+				if (cursor != nullptr) cursor->setRecordData(replaced.data(), (uint32_t)replaced.size());
+			}
+		}
+		RecordSnapshot current(rf);
+		expired = !oldest.isValid() && !oldest.getRecordData(1, data) && !oldest.next(recordID, data);
+		expired = expired && current.isValid() && rf.getTotalVersionBytes() <= VERSIONS_LIMIT;
+		expired = expired && current.next(recordID, data);
+	}
+	expired = expired && rf.getTotalVersionBytes() == 0;
+	rf.setVersionsLimit(VERSIONS_MEMORY_LIMIT);
+	rf.close();
+
+	bool result = isolated && latest && collected && expired;
+
+	std::stringstream ss;
+	ss << "Snapshot " << passes << " reads during " << edits << " edits (isolated: " << isolated;
+	ss << ", latest: " << latest << ", collected: " << collected << ", expired: " << expired << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::transactions() {
+
+	const char* transactionsFile = "transactions.bin";
+	if (std::filesystem::exists(transactionsFile)) std::filesystem::remove(transactionsFile);
+
+	RecordFileIO rf;
+	if (!rf.open(transactionsFile)) return false;
+
+	// accounts with initial balance, transfers keep total balance
+	constexpr uint64_t ACCOUNTS = 100;
+	constexpr uint64_t INITIAL_BALANCE = 1000;
+	for (uint64_t i = 0; i < ACCOUNTS; i++) rf.createRecord(&INITIAL_BALANCE, sizeof(uint64_t));
+
+	auto getBalance = [](const std::vector<uint8_t>& data) {
+		uint64_t balance = 0;
+		if (data.size() == sizeof(uint64_t)) memcpy(&balance, data.data(), sizeof(uint64_t));
+		return balance;
+	};
+
+	// concurrent transfers are retried on conflict, snapshots never see transfer half done
+	size_t threadsCount = 4;
+	size_t transfersPerThread = samplesCount / 20;
+	std::atomic<size_t> conflicts = 0;
+	std::atomic<size_t> snapshotReads = 0;
+	std::atomic<bool> done = false;
+	std::atomic<bool> consistent = true;
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threadsCount; t++) {
+		workers.emplace_back([&, t]() {
+			std::mt19937 random((uint32_t)(2028 + t));
+			std::vector<uint8_t> from, to;
+			for (size_t i = 0; i < transfersPerThread; i++) {
+				uint64_t fromID = random() % ACCOUNTS + 1;
+				uint64_t toID = (fromID + random() % (ACCOUNTS - 1)) % ACCOUNTS + 1;
+				uint64_t amount = random() % 100;
+				for (;;) {
+					RecordTransaction tx(rf);
+					if (!tx.getRecordData(fromID, from) || !tx.getRecordData(toID, to)) break;
+					uint64_t fromBalance = getBalance(from), toBalance = getBalance(to);
+					if (fromBalance < amount) break;
+					fromBalance -= amount;
+					toBalance += amount;
+					tx.setRecordData(fromID, &fromBalance, sizeof(uint64_t));
+					tx.setRecordData(toID, &toBalance, sizeof(uint64_t));
+					std::string log = std::to_string(fromID) + " -> " + std::to_string(toID);
+					tx.createRecord(log.data(), (uint32_t)log.size());
+					if (tx.commit()) break;
+					conflicts++;
+				}
+			}
+		});
+	}
+	std::thread auditor([&]() {
+		std::vector<uint8_t> data;
+		while (!done.load()) {
+			RecordSnapshot snapshot(rf);
+			uint64_t total = 0;
+			for (uint64_t id = 1; id <= ACCOUNTS; id++) {
+				if (snapshot.getRecordData(id, data)) total += getBalance(data);
+			}
+			if (total != ACCOUNTS * INITIAL_BALANCE) consistent = false;
+			snapshotReads++;
+		}
+	});
+	for (auto& worker : workers) worker.join();
+	done = true;
+	auditor.join();
+
+	std::vector<uint8_t> data;
+	uint64_t total = 0;
+	for (uint64_t id = 1; id <= ACCOUNTS; id++) {
+		auto cursor = rf.getRecordByID(id);
+		data.resize(cursor != nullptr ? cursor->getDataLength() : 0);
+		if (cursor != nullptr && cursor->getRecordData(data.data())) total += getBalance(data);
+	}
+	bool atomic = consistent.load() && total == ACCOUNTS * INITIAL_BALANCE;
+
+	// write by others after transaction read the record is a conflict, nothing is written
+	uint64_t balance = 1;
+	RecordTransaction stale(rf);
+	bool conflictDetected = stale.getRecordData(1, data);
+	stale.setRecordData(2, &balance, sizeof(uint64_t));
+	uint64_t staleRecord = stale.createRecord(&balance, sizeof(uint64_t));
+	auto cursor = rf.getRecordByID(1);
+	uint64_t changed = getBalance(data) + 1;
+	conflictDetected = conflictDetected && cursor != nullptr && cursor->setRecordData(&changed, sizeof(uint64_t));
+	conflictDetected = conflictDetected && !stale.commit() && rf.getRecordByID(staleRecord) == nullptr;
+	cursor = rf.getRecordByID(2);
+	conflictDetected = conflictDetected && cursor != nullptr && cursor->getDataLength() == sizeof(uint64_t);
+	data.resize(sizeof(uint64_t));
+	conflictDetected = conflictDetected && cursor->getRecordData(data.data()) && getBalance(data) != balance;
+
+	// small transactions throughput (each commit waits for storage device)
+	size_t transactionsCount = samplesCount / 10;
+	uint64_t firstStamp = rf.getCommitStamp();
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < transactionsCount; i++) {
+		RecordTransaction tx(rf);
+		uint64_t value = i;
+		tx.setRecordData(i % ACCOUNTS + 1, &value, sizeof(uint64_t));
+		tx.setRecordData((i + 1) % ACCOUNTS + 1, &value, sizeof(uint64_t));
+		tx.createRecord(&value, sizeof(uint64_t));
+		tx.commit();
+	}
+	auto endTime = std::chrono::high_resolution_clock::now();
+	double commitTime = std::chrono::duration<double>(endTime - startTime).count();
+	bool stamped = rf.getCommitStamp() == firstStamp + transactionsCount;
+	rf.close();
+
+	// commit interrupted after journal is written is completed on open
+	bool recovered = false;
+	{
+		InterruptedCommitFile interrupted;
+		interrupted.open(transactionsFile);
+		TransactionWrites writes;
+		uint64_t createdID = interrupted.reserveID();
+		std::string created = "created by interrupted commit";
+		writes[1] = { TransactionOperation::UPDATE, std::vector<uint8_t>(8, 0x11) };
+		writes[2] = { TransactionOperation::REMOVE, {} };
+		writes[createdID] = { TransactionOperation::CREATE, std::vector<uint8_t>(created.begin(), created.end()) };
+		recovered = interrupted.writeJournalOnly(writes) && interrupted.getRecordByID(2) != nullptr;
+		interrupted.close();
+
+		RecordFileIO reopened;
+		reopened.open(transactionsFile);
+		cursor = reopened.getRecordByID(1);
+		data.resize(cursor != nullptr ? cursor->getDataLength() : 0);
+		recovered = recovered && cursor != nullptr && cursor->getRecordData(data.data()) && data == writes[1].data;
+		recovered = recovered && reopened.getRecordByID(2) == nullptr;
+		cursor = reopened.getRecordByID(createdID);
+		data.resize(cursor != nullptr ? cursor->getDataLength() : 0);
+		recovered = recovered && cursor != nullptr && cursor->getRecordData(data.data()) && data == writes[createdID].data;
+		stamped = stamped && reopened.getCommitStamp() == firstStamp + transactionsCount + 1;
+		reopened.close();
+
+		// commit interrupted after part of writes reached storage device
+		InterruptedCommitFile partial;
+		partial.open(transactionsFile);
+		writes.clear();
+		writes[1] = { TransactionOperation::UPDATE, std::vector<uint8_t>(8, 0x22) };
+		writes[3] = { TransactionOperation::UPDATE, std::vector<uint8_t>(8, 0x33) };
+		recovered = recovered && partial.applyFirstWrite(writes);
+		partial.close();
+
+		RecordFileIO replayed;
+		replayed.open(transactionsFile);
+		for (auto& [recordID, write] : writes) {
+			cursor = replayed.getRecordByID(recordID);
+			data.resize(cursor != nullptr ? cursor->getDataLength() : 0);
+			recovered = recovered && cursor != nullptr && cursor->getRecordData(data.data()) && data == write.data;
+		}
+		replayed.close();
+
+		// commit with journal flushed is done even if its write fails (record of
+		// reserved ID doesn't exist yet), next commit completes it from journal
+		InterruptedCommitFile failed;
+		failed.open(transactionsFile);
+		uint64_t reservedID = failed.reserveID();
+		writes.clear();
+		writes[1] = { TransactionOperation::UPDATE, std::vector<uint8_t>(8, 0x44) };
+		writes[reservedID] = { TransactionOperation::UPDATE, std::vector<uint8_t>(8, 0x55) };
+		recovered = recovered && failed.commitWrites(writes);
+		uint64_t value = 0x66;
+		RecordTransaction refused(failed);
+		refused.setRecordData(3, &value, sizeof(uint64_t));
+		recovered = recovered && !refused.commit();
+		recovered = recovered && failed.createReserved(reservedID, "created later");
+		RecordTransaction completing(failed);
+		completing.setRecordData(3, &value, sizeof(uint64_t));
+		recovered = recovered && completing.commit();
+		writes[3] = { TransactionOperation::UPDATE, std::vector<uint8_t>((uint8_t*)&value, (uint8_t*)&value + sizeof(uint64_t)) };
+		for (auto& [recordID, write] : writes) {
+			cursor = failed.getRecordByID(recordID);
+			data.resize(cursor != nullptr ? cursor->getDataLength() : 0);
+			recovered = recovered && cursor != nullptr && cursor->getRecordData(data.data()) && data == write.data;
+		}
+		failed.close();
+	}
+
+	bool result = atomic && conflictDetected && recovered && stamped;
+
+	std::stringstream ss;
+	ss << "Transactions " << threadsCount * transfersPerThread << " transfers, " << conflicts << " conflicts retried, ";
+	ss << snapshotReads << " audits (atomic: " << atomic << ", conflict: " << conflictDetected;
+	ss << ", recovered: " << recovered << ", stamped: " << stamped << "), " << transactionsCount / commitTime << " tx/s";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestRecordFileIO::stableRecordIDs() {
+
+	const char* idsFile = "identifiers.bin";
+	if (std::filesystem::exists(idsFile)) {
+		std::filesystem::remove(idsFile);
+	}
+
+	RecordFileIO rf;
+	if (!rf.open(idsFile)) return false;
+
+	// generate records and remember their IDs and contents
+	char buffer[1024];
+	size_t recordsCount = samplesCount;
+	std::unordered_map<uint64_t, std::string> contents;
+	std::vector<uint64_t> ids;
+	for (size_t i = 0; i < recordsCount; i++) {
+		int length = snprintf(buffer, sizeof(buffer), "Record ID test #%zu with random number %d", i, std::rand());
+		auto cursor = rf.createRecord(buffer, (uint32_t)length);
+		if (cursor == nullptr) return false;
+		ids.push_back(cursor->getRecordID());
+		contents[cursor->getRecordID()] = std::string(buffer, length);
+	}
+
+	// keep cursor to the first record, it should follow the record when it moves
+	auto firstCursor = rf.getRecordByID(ids[0]);
+
+	// grow every third record to move it and remove every fifth record
+	for (size_t i = 0; i < recordsCount; i++) {
+		auto cursor = rf.getRecordByID(ids[i]);
+		if (cursor == nullptr) continue;
+		if (i % 5 == 1) {
+			rf.removeRecord(cursor);
+			contents.erase(ids[i]);
+		} else if (i % 3 == 0) {
+			std::string grown = contents[ids[i]] + std::string(64, '+');
+			cursor->setRecordData(grown.data(), (uint32_t)grown.size());
+			contents[ids[i]] = grown;
+		}
+	}
+	bool followed = firstCursor != nullptr && firstCursor->isValid();
+	followed = followed && firstCursor->getRecordID() == ids[0] && firstCursor->getDataLength() == contents[ids[0]].size();
+
+	// moves records again
+	rf.compact();
+
+	// check every record is found by its ID before and after reopen
+	bool consistent = true;
+	for (int pass = 0; pass < 2; pass++) {
+		for (uint64_t id : ids) {
+			auto cursor = rf.getRecordByID(id);
+			auto it = contents.find(id);
+			if (it == contents.end()) {
+				consistent = consistent && cursor == nullptr;
+				continue;
+			}
+			bool found = cursor != nullptr && cursor->getDataLength() == it->second.size();
+			found = found && cursor->getRecordData(buffer) && memcmp(buffer, it->second.data(), it->second.size()) == 0;
+			consistent = consistent && found;
+		}
+		rf.close();
+		if (pass == 0 && !rf.open(idsFile)) return false;
+	}
+
+	bool result = followed && consistent;
+	std::stringstream ss;
+	ss << "Stable record IDs (cursor followed: " << followed << ", lookups consistent: " << consistent << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+bool TestRecordFileIO::formatUpgrade() {
+
+	const char* legacyFile = "legacy.bin";
+
+	std::vector<std::string> original;
+	original.push_back("Legacy 0");
+	for (int i = 1; i < 100; i++) original.push_back("Legacy record #" + std::to_string(i) + " " + std::string(i % 7 * 10, 'x'));
+
+	// walks records list and checks contents (and IDs if file has them)
+	char buffer[256];
+	auto matches = [&](RecordFileIO& rf, const std::vector<std::string>& records, bool withIDs) {
+		size_t index = 0;
+		bool same = rf.getTotalRecords() == records.size();
+		for (auto cursor = rf.getFirstRecord(); same && cursor != nullptr; index++) {
+			same = index < records.size() && cursor->getDataLength() == records[index].size();
+			same = same && cursor->getRecordData(buffer) && memcmp(buffer, records[index].data(), records[index].size()) == 0;
+			if (withIDs) {
+				auto byID = rf.getRecordByID(index + 1);
+				same = same && cursor->getRecordID() == index + 1 && byID != nullptr && byID->getPosition() == cursor->getPosition();
+			}
+			if (!cursor->next()) cursor = nullptr;
+		}
+		return same && index == records.size();
+	};
+
+	bool readable = true, upgraded = true, scanned = true;
+	for (uint32_t version : { 1, 2, 6 }) {
+
+		std::vector<std::string> records = original;
+		if (!writeLegacyFile(legacyFile, version, records)) return false;
+
+		// read only file is read as is
+		{
+			RecordFileIO rf;
+			if (!rf.open(legacyFile, true)) return false;
+			readable = readable && matches(rf, records, version >= 2);
+			size_t scannedRecords = 0;
+			ParallelScanner scanner(rf, 2, true);
+			scanner.scan([&](const ScanRecord&) { scannedRecords++; return true; });
+			scanned = scanned && scannedRecords == records.size() && scanner.getResyncs() == 0;
+		}
+
+		// upgraded file keeps records, gets IDs and current header, and takes new records
+		for (int pass = 0; pass < 2; pass++) {
+			RecordFileIO rf;
+			if (!rf.open(legacyFile)) return false;
+			upgraded = upgraded && matches(rf, records, true) && rf.getTotalFreeRecords() >= 1;
+			if (pass == 0) {
+				records.push_back("Record created after upgrade");
+				upgraded = upgraded && rf.createRecord(records.back().data(), (uint32_t)records.back().size()) != nullptr;
+			}
+		}
+		StorageHeader sh{};
+		std::ifstream in(legacyFile, std::ios::binary);
+		in.read((char*)&sh, sizeof(sh));
+		upgraded = upgraded && sh.version == KNOWLEDGE_VERSION;
+	}
+
+	std::filesystem::remove(legacyFile);
+
+	bool result = readable && upgraded && scanned;
+	std::stringstream ss;
+	ss << "Format versions 1, 2, 6 upgrade (read as is: " << readable << ", scanned: " << scanned << ", upgraded: " << upgraded << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+template <typename Locks>
+static double lockThroughput(Locks& locks, size_t threadsCount, size_t operations) {
+
+	// Every thread locks random records: 80% shared (reads), 20% exclusive (writes)
+	auto worker = [&locks, operations](unsigned seed) {
+		std::mt19937_64 random(seed);
+		for (size_t i = 0; i < operations; i++) {
+			uint64_t offset = STORAGE_HEADER_SIZE + (random() % 4096) * 512;
+			bool exclusive = (random() % 5) == 0;
+			locks.lock(offset, exclusive);
+			locks.unlock(offset, exclusive);
+		}
+	};
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < threadsCount; i++) threads.emplace_back(worker, (unsigned)i + 1);
+	for (auto& thread : threads) thread.join();
+	auto endTime = std::chrono::high_resolution_clock::now();
+
+	double duration = (endTime - startTime).count() / 1000000000.0;
+	return double(threadsCount * operations) / duration;
+}
+
+
+
+bool TestRecordFileIO::recordLocksBenchmark() {
+
+	size_t threadsCount = std::max(2u, std::thread::hardware_concurrency());
+	size_t operations = samplesCount * 100;
+
+	MapRecordLocks mapLocks;
+	RecordLockTable lockTable;
+	double mapThroughput = lockThroughput(mapLocks, threadsCount, operations);
+	double tableThroughput = lockThroughput(lockTable, threadsCount, operations);
+
+	std::stringstream ss;
+	ss << "Record locks " << threadsCount << " threads: map " << mapThroughput / 1000000.0 << " Mops/s, ";
+	ss << "lock table " << tableThroughput / 1000000.0 << " Mops/s (x" << tableThroughput / mapThroughput << ")";
+	printResult(ss.str().c_str(), true);
+	return true;
+}
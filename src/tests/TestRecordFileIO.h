@@ -3,7 +3,12 @@
 #include <iostream>
 #include <sstream>
 #include <filesystem>
+#include <fstream>
 #include <unordered_map>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <algorithm>
 
 #include "CloudlessTests.h"
 #include "RecordFileIO.h"
@@ -28,6 +33,19 @@ namespace Cloudless {
 			bool removeEvenRecords(bool verbose);
 			bool insertNewRecords(size_t recordCount);	
 			bool editRecords(bool verbose);
+			bool scanRecords();
+			bool parallelScan();
+			bool reuseFreeSpace();
+			bool compaction();
+			bool stableRecordIDs();
+			bool formatUpgrade();
+			bool streamingRecords();
+			bool overflowRecords();
+			bool compressedRecords();
+			bool dictionaryCompression();
+			bool snapshotIsolation();
+			bool transactions();
+			bool recordLocksBenchmark();
 
 			char* fileName;
 			size_t samplesCount;
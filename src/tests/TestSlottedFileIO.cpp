@@ -0,0 +1,303 @@
+/******************************************************************************
+*
+*  SlottedFileIO class tests implementation
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+
+#include "TestSlottedFileIO.h"
+
+
+using namespace Cloudless;
+using namespace Cloudless::Storage;
+using namespace Cloudless::Tests;
+
+
+std::string TestSlottedFileIO::getName() const {
+	return "SlottedFileIO consistency and small records density";
+}
+
+
+void TestSlottedFileIO::init() {
+	fileName = "slotted.bin";
+	samplesCount = 20000;
+	if (std::filesystem::exists(fileName)) std::filesystem::remove(fileName);
+	expected.clear();
+	finalResult = true;
+}
+
+
+void TestSlottedFileIO::execute() {
+	finalResult = consistency() && corruption();
+	finalResult = directoryBoundary() && finalResult;
+	densityBenchmark();
+}
+
+
+bool TestSlottedFileIO::verify() const {
+	return finalResult;
+}
+
+
+void TestSlottedFileIO::cleanup() {
+	expected.clear();
+}
+
+
+//------------------------------------------------------------------------------------------------------------------
+
+
+std::string TestSlottedFileIO::makeRating(std::mt19937& random) {
+	std::string rating = "{\"article\":" + std::to_string(random() % 100000);
+	rating += ",\"user\":" + std::to_string(random() % 1000000);
+	return rating + ",\"stars\":" + std::to_string(random() % 5 + 1) + "}";
+}
+
+
+
+bool TestSlottedFileIO::verifyRecords(SlottedFileIO& slotted) {
+
+	if (slotted.getTotalRecords() != expected.size()) return false;
+
+	// every record by address
+	std::vector<uint8_t> data;
+	for (auto& [address, record] : expected) {
+		if (!slotted.getRecordData(address, data) || data.size() != record.size()) return false;
+		if (memcmp(data.data(), record.data(), record.size()) != 0) return false;
+	}
+
+	// navigation in address order
+	auto it = expected.begin();
+	size_t count = 0;
+	for (uint64_t address = slotted.getFirstRecord(); address != NOT_FOUND; address = slotted.getNextRecord(address)) {
+		if (it == expected.end() || address != it->first) return false;
+		count++;
+		++it;
+	}
+
+	return count == expected.size();
+}
+
+
+
+bool TestSlottedFileIO::consistency() {
+
+	std::mt19937 random(2040);
+	bool result = true, reused = true;
+	{
+		SlottedFileIO slotted;
+		slotted.open(fileName);
+
+		// ratings, then changed ratings and comments counters of various length
+		for (size_t i = 0; i < samplesCount; i++) {
+			std::string rating = makeRating(random);
+			uint64_t address = slotted.createRecord(rating.data(), (uint32_t)rating.size());
+			if (address == NOT_FOUND) return false;
+			expected[address] = rating;
+		}
+		for (auto& [address, record] : expected) {
+			if (random() % 2 != 0) continue;
+			std::string rating = makeRating(random) + std::string(random() % 64, ' ');
+			result = result && slotted.setRecordData(address, rating.data(), (uint32_t)rating.size());
+			record = rating;
+		}
+		std::vector<uint64_t> removed;
+		for (auto& [address, record] : expected) {
+			if (random() % 5 == 0) removed.push_back(address);
+		}
+		for (uint64_t address : removed) {
+			result = result && slotted.removeRecord(address) && !slotted.removeRecord(address);
+			expected.erase(address);
+		}
+
+		// new records fill space of removed ones
+		uint64_t fileSize = slotted.getFileSize();
+		for (size_t i = 0; i < removed.size() / 2; i++) {
+			std::string rating = makeRating(random);
+			uint64_t address = slotted.createRecord(rating.data(), (uint32_t)rating.size());
+			result = result && address != NOT_FOUND && expected.count(address) == 0;
+			expected[address] = rating;
+		}
+		reused = slotted.getFileSize() == fileSize;
+
+		result = result && verifyRecords(slotted);
+		slotted.close();
+	}
+
+	// pages and free space are loaded on open
+	SlottedFileIO reopened;
+	reopened.open(fileName);
+	bool loaded = verifyRecords(reopened);
+	reopened.close();
+
+	result = result && reused && loaded;
+
+	std::stringstream ss;
+	ss << "Small records " << expected.size() << " (updates and removals: " << result;
+	ss << ", space reused: " << reused << ", loaded on open: " << loaded << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestSlottedFileIO::corruption() {
+
+	// page 1 damaged outside of storage layer
+	uint64_t firstPageRecords = 0;
+	{
+		std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(PAGE_SIZE + SLOTTED_PAGE_HEADER_SIZE + 3);
+		file.put('#');
+	}
+	for (auto& [address, record] : expected) {
+		if ((address >> SLOTTED_SLOT_BITS) == 1) firstPageRecords++;
+	}
+
+	SlottedFileIO slotted;
+	slotted.open(fileName);
+
+	// records of damaged page (or moved to it) fail, others are read and new ones avoid that page
+	uint64_t failed = 0, intact = 0;
+	std::vector<uint8_t> data;
+	for (auto& [address, record] : expected) {
+		if (!slotted.getRecordData(address, data)) failed++;
+		else if (data.size() == record.size() && memcmp(data.data(), record.data(), record.size()) == 0) intact++;
+	}
+	std::string rating = "{\"article\":1,\"user\":1,\"stars\":5}";
+	uint64_t address = slotted.createRecord(rating.data(), (uint32_t)rating.size());
+	bool avoided = address != NOT_FOUND && (address >> SLOTTED_SLOT_BITS) != 1;
+	slotted.close();
+
+	bool result = firstPageRecords > 0 && failed >= firstPageRecords && intact + failed == expected.size() && avoided;
+
+	std::stringstream ss;
+	ss << "Corrupt page detected: " << failed << " records failed (" << firstPageRecords << " in page), ";
+	ss << intact << " intact (new records avoid page: " << avoided << ")";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+bool TestSlottedFileIO::directoryBoundary() {
+
+	const char* boundaryFile = "slotted_boundary.bin";
+	if (std::filesystem::exists(boundaryFile)) std::filesystem::remove(boundaryFile);
+
+	// records fill page 1 until insert would take its reserve
+	constexpr uint32_t LENGTH = 100;
+	uint64_t count = (SLOTTED_PAGE_CAPACITY - SLOTTED_PAGE_RESERVE) / (LENGTH + SLOTTED_SLOT_SIZE);
+	std::map<uint64_t, std::string> records;
+	SlottedFileIO slotted;
+	slotted.open(boundaryFile);
+	bool result = true;
+	for (uint64_t i = 0; i < count; i++) {
+		std::string record(LENGTH, char('a' + i % 26));
+		uint64_t address = slotted.createRecord(record.data(), LENGTH);
+		result = result && (address >> SLOTTED_SLOT_BITS) == 1;
+		records[address] = record;
+	}
+
+	// the last record grows until data reaches slots directory
+	uint64_t freeBytes = SLOTTED_PAGE_CAPACITY - count * (LENGTH + SLOTTED_SLOT_SIZE);
+	auto last = std::prev(records.end());
+	last->second = std::string(LENGTH + freeBytes, 'z');
+	result = result && slotted.setRecordData(last->first, last->second.data(), (uint32_t)last->second.size());
+
+	// shrunk records leave gaps, so page has space but no contiguous bytes
+	auto it = records.begin();
+	for (uint32_t i = 0; i < SLOTTED_PAGE_RESERVE / LENGTH + 2; i++, ++it) {
+		it->second.clear();
+		result = result && slotted.setRecordData(it->first, "", 0);
+	}
+
+	// inserts need new slot in page 1, empty record as well
+	for (uint32_t length : { 0, 30 }) {
+		std::string record(length, 'n');
+		uint64_t address = slotted.createRecord(record.data(), length);
+		result = result && (address >> SLOTTED_SLOT_BITS) == 1 && records.count(address) == 0;
+		records[address] = record;
+	}
+
+	// records read back after reopen, and each is removed once
+	slotted.close();
+	slotted.open(boundaryFile);
+	std::vector<uint8_t> data;
+	for (auto& [address, record] : records) {
+		result = result && slotted.getRecordData(address, data) && std::string(data.begin(), data.end()) == record;
+	}
+	for (auto& [address, record] : records) {
+		result = result && slotted.removeRecord(address);
+	}
+	result = result && slotted.getTotalRecords() == 0;
+	slotted.close();
+
+	std::stringstream ss;
+	ss << "New slots in page filled up to slots directory (" << records.size() << " records)";
+	printResult(ss.str().c_str(), result);
+	return result;
+}
+
+
+
+void TestSlottedFileIO::densityBenchmark() {
+
+	const char* slottedFile = "slotted_benchmark.bin";
+	const char* recordsFile = "records_small.bin";
+	for (auto name : { slottedFile, recordsFile }) {
+		if (std::filesystem::exists(name)) std::filesystem::remove(name);
+	}
+
+	std::mt19937 random(2041);
+	size_t count = samplesCount * 5;
+	std::vector<std::string> ratings;
+	uint64_t payload = 0;
+	for (size_t i = 0; i < count; i++) {
+		ratings.push_back(makeRating(random));
+		payload += ratings.back().size();
+	}
+
+	// same small cache, so denser file keeps more records cached
+	std::vector<uint64_t> addresses, ids;
+	std::vector<size_t> lookups;
+	for (size_t i = 0; i < count; i++) lookups.push_back(random() % count);
+
+	double slottedWrite, slottedRead, recordsWrite, recordsRead;
+	uint64_t slottedSize, recordsSize;
+	{
+		SlottedFileIO slotted;
+		slotted.open(slottedFile, false, MINIMAL_CACHE * 8);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (auto& rating : ratings) addresses.push_back(slotted.createRecord(rating.data(), (uint32_t)rating.size()));
+		slotted.flush();
+		auto midTime = std::chrono::high_resolution_clock::now();
+		std::vector<uint8_t> data;
+		for (size_t i : lookups) slotted.getRecordData(addresses[i], data);
+		auto endTime = std::chrono::high_resolution_clock::now();
+		slottedWrite = std::chrono::duration<double>(midTime - startTime).count();
+		slottedRead = std::chrono::duration<double>(endTime - midTime).count();
+		slottedSize = slotted.getFileSize();
+	}
+	{
+		RecordFileIO records;
+		records.open(recordsFile, false, MINIMAL_CACHE * 8);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (auto& rating : ratings) ids.push_back(records.createRecord(rating.data(), (uint32_t)rating.size())->getRecordID());
+		records.flush();
+		auto midTime = std::chrono::high_resolution_clock::now();
+		char buffer[256];
+		for (size_t i : lookups) records.getRecordByID(ids[i])->getRecordData(buffer);
+		auto endTime = std::chrono::high_resolution_clock::now();
+		recordsWrite = std::chrono::duration<double>(midTime - startTime).count();
+		recordsRead = std::chrono::duration<double>(endTime - midTime).count();
+		recordsSize = records.getFileSize();
+	}
+
+	std::stringstream ss;
+	ss << "Ratings " << count << " x " << payload / count << " bytes: file slotted " << slottedSize / 1024;
+	ss << "Kb, records " << recordsSize / 1024 << "Kb (x" << double(recordsSize) / double(slottedSize) << "), ";
+	ss << "write x" << recordsWrite / slottedWrite << ", read x" << recordsRead / slottedRead;
+	printResult(ss.str().c_str(), true);
+}
@@ -0,0 +1,49 @@
+/******************************************************************************
+*
+*  SlottedFileIO class test header
+*
+*  (C) Bolat Basheyev 2022-2025
+*
+******************************************************************************/
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <string>
+#include <filesystem>
+
+#include "CloudlessTests.h"
+#include "SlottedFileIO.h"
+#include "RecordFileIO.h"
+
+namespace Cloudless {
+
+	namespace Tests {
+
+		class TestSlottedFileIO : public ITestCase {
+		public:
+			std::string getName() const override;
+			void init() override;
+			void execute() override;
+			bool verify() const override;
+			void cleanup() override;
+		private:
+			bool consistency();
+			bool corruption();
+			bool directoryBoundary();
+			void densityBenchmark();
+			bool verifyRecords(Storage::SlottedFileIO& slotted);
+			std::string makeRating(std::mt19937& random);
+
+			const char* fileName;
+			size_t samplesCount;
+			std::map<uint64_t, std::string> expected;   // Record data by record address
+		};
+	}
+
+}